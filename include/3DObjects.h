@@ -58,6 +58,13 @@ typedef struct {
 } Plane;
 
 
+// CPU-side geometry, also used to pre-transform static objects
+void generateCubeVertices(float* vertices, unsigned int* indices, float size);                                   // pos3 uv2, 24 vertices, 36 indices
+void generateSphereVertices(float* vertices, unsigned int* indices, float radius, int sectorCount, int stackCount); // pos3 normal3 uv2
+void generatePyramidVertices(float* vertices, unsigned int* indices, float baseSize, float height);              // pos3 uv2, 5 vertices, 18 indices
+void generateCylinderVertices(float* vertices, unsigned int* indices, float radius, float height, int sectorCount); // pos3 normal3
+void generatePlaneVertices(float* vertices, unsigned int* indices);                                             // pos3 uv2, 4 vertices, 6 indices
+
 // Cube
 Cube createCube(Vector3 position, Vector4 color, float size);
 void drawCube(const Cube* cube, Matrix4x4 viewMatrix, Matrix4x4 projMatrix);
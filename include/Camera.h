@@ -58,5 +58,9 @@ Matrix4x4 lookAt(Vector3 eye, Vector3 center, Vector3 up);
 Matrix4x4 perspective(float fov, float aspect, float znear, float zfar);
 Matrix4x4 rotateMatrix(float angle, Vector3 axis);
 Matrix4x4 scaleMatrix(Vector3 scale);
+Matrix4x4 composeTransform(Vector3 position, Vector3 rotation, Vector3 scale);
+// Inverse of composeTransform. Shear, from non-uniform scale under a rotated
+// parent, can't be expressed and is dropped
+void decomposeTransform(Matrix4x4 model, Vector3* position, Vector3* rotation, Vector3* scale);
 Matrix4x4 identityMatrix();
 #endif 
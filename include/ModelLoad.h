@@ -2,6 +2,7 @@
 #define MODELLOAD_H
 
 #include "Vectors.h"
+#include "mesh_optimizer.h"
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -9,6 +10,17 @@
 #include <GLFW/glfw3.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MAX_LOD_LEVELS 4 // Detail levels per mesh, level 0 is the full mesh
+
+// Interleaved 20-byte vertex used for imported meshes
+typedef struct {
+    float position[3];
+    signed char normal[4];        // snorm8, w unused
+    unsigned short texCoords[2];  // half float
+} PackedVertex;
 
 typedef struct {
     GLuint VAO;
@@ -17,17 +29,58 @@ typedef struct {
     Vertex* vertices;
     unsigned int* indices;
     unsigned int numVertices;
-    unsigned int numIndices;
+    unsigned int numIndices;        // Level 0
+    GLenum indexType;
+    unsigned int lodCount;          // Coarser levels are extra index ranges over the same vertices
+    unsigned int lodIndexCount[MAX_LOD_LEVELS];
+    size_t lodIndexOffset[MAX_LOD_LEVELS]; // In bytes
+    Meshlet* meshlets;              // Clusters of level 0, culled on the CPU, see meshlet.h
+    float* meshletCullData;
+    unsigned int meshletCount;
 } Mesh;
 
+// CPU-side mesh blobs ready for upload; may point straight into a mapped cache file
+typedef struct {
+    const void* vertices;
+    const void* indices;
+    unsigned int numVertices;
+    unsigned int numIndices;      // All levels, stored back to back
+    unsigned int vertexStride;
+    GLenum indexType;
+    unsigned int lodCount;
+    unsigned int lodIndexCount[MAX_LOD_LEVELS];
+    const Meshlet* meshlets;      // Cover level 0 only
+    unsigned int meshletCount;
+} MeshData;
+
+struct MappedFile;
+
+// CPU result of an import, built off the render thread and uploaded later
+typedef struct {
+    MeshData* meshes;
+    unsigned int meshCount;
+    struct MappedFile* cacheFile; // Set when the blobs point into a mapped mesh cache
+} ImportedModel;
+
 typedef struct {
     Mesh* meshes;
     unsigned int meshCount;
     char path[256];
+    Vector3 boundsCenter;  // Local bounding sphere, used for LOD selection
+    float boundsRadius;
 } Model;
 
 Mesh processMesh(struct aiMesh* mesh, const struct aiScene* scene);
+Mesh allocateMeshBuffers(const MeshData* data);
+Mesh uploadMeshData(const MeshData* data);
+size_t getMeshVertexBytes(const MeshData* data);
+size_t getMeshIndexBytes(const MeshData* data);
+Model* createModel(const char* path, unsigned int meshCount);
+bool importModelData(const char* path, uint64_t contentHash, const struct aiPropertyStore* properties, ImportedModel* out);
+void releaseImportedModel(ImportedModel* imported);
+void computeModelBounds(const ImportedModel* imported, Model* model);
 Model* loadModel(const char* path);
+Model* loadModelWithHash(const char* path, uint64_t contentHash);
 void freeModel(Model* model);
 
 #endif 
@@ -24,7 +24,7 @@ typedef struct {
         Pyramid pyramid;
         Cylinder cylinder;
         Plane plane;
-        Model model; 
+        Model* model; // Shared through the model registry
     } data;
     int textureID;
     bool useTexture;
@@ -7,23 +7,113 @@
 #include "materials.h"
 #include "Vectors.h"
 #include "SceneObject.h"
+#include "components.h"
 
-#define MAX_OBJECTS 1000 
+// Objects live in a slot map. Handles name a slot plus the generation it had
+// when the object was added, so a handle to a removed object simply stops
+// resolving. The objects themselves are kept dense in columns: adding appends,
+// removing moves the last object into the gap, both O(1) and without limit.
+// Dense indices and SceneObject pointers are therefore only stable until the
+// next add or remove; keep handles across frames. The manager re-resolves
+// selected_object itself.
+//
+// SceneObject is the cold record (geometry, material, name and the edited
+// transform). What the per-frame loops read sits in separate columns beside
+// it. Model matrices and bounds are published by the simulation step, the
+// rest is refreshed by updateObjectColumns. Each object also owns an ECS entity
+// with RENDERABLE_COMPONENTS and a scene graph node, removed along with it.
+// The SceneObject transform is local to the parent object, if it has one.
+
+#define OBJECT_MANAGER_INITIAL_CAPACITY 256
+
+#define RENDERABLE_COMPONENTS (COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_RENDERABLE) | COMPONENT_BIT(COMPONENT_BOUNDS))
+
+#define INVALID_OBJECT_HANDLE ((ObjectHandle){ 0, 0 })
+
+#define RENDER_KEY_GEOMETRY_BITS 24  // Low bits of a render key, the material group sits above
+
+// Flags column: derived state and the per-frame claims of the special paths
+#define OBJECT_FLAG_TRANSPARENT     (1u << 0)
+#define OBJECT_FLAG_STATIC_BATCHED  (1u << 1)  // Drawn with its chunk, see static_batch.h
+#define OBJECT_FLAG_SPHERE_IMPOSTOR (1u << 2)  // Ray traced on a quad, see sphere_impostor.h
+#define OBJECT_FLAG_GPU_CULLED      (1u << 3)  // Culled and drawn by compute, see gpu_culling.h
+#define OBJECT_FLAG_INTERPOLATED    (1u << 4)  // Moved by the last tick, drawn between its two tick matrices
+
+// One entry per object of a spawnObjects batch
+typedef struct {
+    Vector3 position;
+    Vector3 rotation;
+    Vector3 scale;
+} ObjectTransform;
 
 typedef struct {
-    SceneObject objects[MAX_OBJECTS];
+    unsigned int generation;
+    int denseIndex;          // -1 while free
+    int nextFree;            // Free list, -1 ends it
+} ObjectSlot;
+
+typedef struct {
+    // Dense columns, the live objects are 0 to count - 1
+    SceneObject* objects;
+    Matrix4x4* modelMatrices;    // As drawn, between the last two ticks for interpolated objects
+    Matrix4x4* previousMatrices; // World at the tick before the last, interpolated objects only
+    Matrix4x4* tickMatrices;     // World at the last tick
+    Vector4* bounds;         // World bounding sphere, center in xyz and radius in w
+    unsigned int* flags;     // OBJECT_FLAG_*
+    int* renderKeys;         // Material then geometry order of the opaque pass
+    ObjectHandle* handles;
     int count;
     int capacity;
+
+    ObjectSlot* slots;
+    int slotCount;
+    int slotCapacity;
+    int freeSlot;
 } ObjectManager;
 
 extern ObjectManager objectManager;
 
 void initObjectManager();
-void addObjectToManager(SceneObject newObject);
-void addObject(Camera* camera, ObjectType type, bool useTexture, int textureIndex, bool colorCreation, Model* model, PBRMaterial material, bool usePBR);
-void removeObject(int index);
+ObjectHandle addObjectToManager(SceneObject newObject);  // Takes over the object's geometry
+ObjectHandle addObject(Camera* camera, ObjectType type, bool useTexture, int textureIndex, bool colorCreation, Model* model, PBRMaterial material, bool usePBR);
+// The object addObject would create, without geometry, for the batch functions below
+SceneObject makeSceneObject(Camera* camera, ObjectType type, bool useTexture, int textureIndex, bool colorCreation, Model* model, PBRMaterial material, bool usePBR);
+void removeObject(ObjectHandle handle);
 void cleanupObjects();
+
+// Batches reserve room once and build one geometry per primitive type, shared
+// by every object of that type in the batch. Geometry in the given states is
+// ignored, so saved states (undo, clipboard) can be added again. Handles may
+// be NULL, failed entries get INVALID_OBJECT_HANDLE. Each returns how many
+// objects it added or removed.
+int addObjectsToManager(const SceneObject* objects, int count, ObjectHandle* handles);
+int spawnObjects(const SceneObject* templateObject, const ObjectTransform* transforms, int count, ObjectHandle* handles);
+// Stale handles are skipped
+int removeObjects(const ObjectHandle* handles, int count);
 void updateObjectInManager(SceneObject* updatedObject);
-void drawObject(const SceneObject* obj, const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix);
 
-#endif 
\ No newline at end of file
+// NULL or -1 once the object is gone
+SceneObject* getObject(ObjectHandle handle);
+int getObjectIndex(ObjectHandle handle);
+bool isObjectAlive(ObjectHandle handle);
+// Dense index of a pointer into the manager, -1 for anything else
+int getObjectSlot(const SceneObject* obj);
+bool hasObjectFlag(const SceneObject* obj, unsigned int flag);
+
+// INVALID_OBJECT_HANDLE detaches. Fails for links that would form a cycle
+bool setObjectParent(ObjectHandle child, ObjectHandle parent);
+ObjectHandle getObjectParent(ObjectHandle handle);
+
+// Transparency and render keys for this frame. Clears the claim flags, the
+// paths that claim objects set them again
+void updateObjectColumns(void);
+// Objects a tick moved are drawn at alpha between their previous and last
+// tick matrices. Snapping puts every one of them back on its last tick
+void snapObjectMatrices(void);
+void interpolateObjectMatrices(float alpha);
+
+void drawObject(SceneObject* obj, const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix);
+// World matrix as of the last published step for managed objects
+Matrix4x4 getObjectModelMatrix(const SceneObject* obj);
+
+#endif
@@ -6,6 +6,18 @@
 #include "materials.h"
 #include "Object3D.h"
 
+// Names an object across adds and removes, see ObjectManager.h
+typedef struct {
+    unsigned int index;       // Slot map entry
+    unsigned int generation;  // Bumped whenever the slot is freed, 0 is never live
+} ObjectHandle;
+
+// Names an entity in the ECS world, see ecs.h
+typedef struct {
+    unsigned int index;
+    unsigned int generation;
+} EntityId;
+
 typedef struct SceneObject {
     Object3D object;  // Base object
     Vector3 position; // Position of the object
@@ -13,7 +25,11 @@ typedef struct SceneObject {
     Vector3 scale;    // Scale of the object
     Vector4 color;    // Color of the object
     bool selected;    // Selection flag
+    bool isStatic;    // Merged into the static world batches, see static_batch.h
+    unsigned char lodLevels[4]; // Current detail level per LODViewSlot, see lod.h
     int id;           // Unique ID
+    ObjectHandle handle; // Set by the manager
+    EntityId entity;     // Transform, Renderable and Bounds, set by the manager
 } SceneObject;
 
 #endif 
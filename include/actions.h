@@ -1,40 +1,66 @@
 #ifndef ACTIONS_H
 #define ACTIONS_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include "SceneObject.h"
+#include "ObjectManager.h"
 
-#define MAX_ACTIONS 100
+// Undo journal. Entries are packed one after another in a growable arena:
+// field edits store only the fields that changed, before and after; parent
+// edits the old and new parent; adds and removes store the objects' states,
+// parent links and components beyond the render ones, a whole batch in one
+// entry, and a remove also the children it moves up a level. Entries
+// before the cursor are applied, the ones after it can be redone until the
+// next edit drops them. Edits to the same fields of the same object within
+// UNDO_COALESCE_SECONDS extend the previous entry, so a drag is one step.
+// When the arena outgrows the budget the oldest applied entries are dropped.
+//
+// Entries name objects by journal keys, which follow an object through the
+// new handles it gets when an undo or redo adds it back. Keys that no entry
+// names any more are reused.
 
-typedef enum {
-    ACTION_ADD,
-    ACTION_REMOVE,
-    ACTION_TRANSFORM,
-    ACTION_CHANGE_COLOR,
-    ACTION_TOGGLE_OPTION
-} ActionType;
+#define UNDO_DEFAULT_BUDGET (4u * 1024u * 1024u)  // Bytes
+#define UNDO_COALESCE_SECONDS 1.0
+
+// Fields a field edit can carry
+#define UNDO_FIELD_POSITION (1u << 0)
+#define UNDO_FIELD_ROTATION (1u << 1)
+#define UNDO_FIELD_SCALE    (1u << 2)
+#define UNDO_FIELD_COLOR    (1u << 3)
 
 typedef struct {
-    ActionType type;
-    SceneObject previousState;
-    SceneObject newState;
-    int objectIndex;
-    char description[256];
-} Action;
-
-extern Action actionHistory[MAX_ACTIONS];
-extern int historyCount;
-
-void pushUndoAction(Action action);
-Action popUndoAction();
-void pushRedoAction(Action action);
-Action popRedoAction();
-void addToHistory(Action action);
+    int entries;
+    int cursor;        // Entries below it are applied
+    size_t bytes;      // Arena in use
+    size_t budget;
+    int dropped;       // Oldest entries dropped for the budget
+    int coalesced;     // Edits merged into the previous entry
+    int keys;          // Object keys the entries name, the rest are reused
+} UndoStats;
+
 void undo_last_action();
 void redo_last_action();
+// Forgets every entry, for when the scene is replaced
+void clearUndoHistory(void);
+void setUndoBudget(size_t bytes);
+
 void addObjectWithAction(ObjectType type, bool useTextures, int textureID, bool useColors, Model* model, PBRMaterial material, bool usePBR);
-void removeObjectWithAction(int index);
-void transformObjectWithAction(int index, Vector3 position, Vector3 rotation, Vector3 scale);
-void changeColorWithAction(int index, Vector4 color);
+void removeObjectWithAction(ObjectHandle handle);
+// One entry for the whole batch
+int spawnObjectsWithAction(const SceneObject* templateObject, const ObjectTransform* transforms, int count);
+int removeObjectsWithAction(const ObjectHandle* handles, int count);
+void transformObjectWithAction(ObjectHandle handle, Vector3 position, Vector3 rotation, Vector3 scale);
+void changeColorWithAction(ObjectHandle handle, Vector4 color);
+// INVALID_OBJECT_HANDLE detaches. Fails like setObjectParent, recording nothing
+bool parentObjectWithAction(ObjectHandle child, ObjectHandle parent);
+// For edits made in place (inspector): records what differs from before
+void recordObjectEdit(const SceneObject* before, const SceneObject* after);
 void toggleOptionWithAction(const char* optionName, bool newValue);
 
-#endif 
+// History window, oldest first
+int getUndoEntryCount(void);
+void describeUndoEntry(int index, char* buffer, size_t size);
+const UndoStats* getUndoStats(void);
+
+#endif
@@ -6,6 +6,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "Vectors.h"
+#include "ecs.h"
 
 #define MAX_AUDIO_SOURCES 32
 #define MAX_AUDIO_BUFFERS 64
@@ -91,6 +92,12 @@ void setListenerPosition(Vector3* position);
 void setListenerVelocity(Vector3* velocity);
 void setListenerOrientation(Vector3* at, Vector3* up);
 
+// Scene emitters, entities with Transform and AudioEmitter (see ecs.h).
+// Starts autoplay emitters and moves sources whose transform changed
+void updateAudioEmitters(void);
+// Stops the emitter's source, call before destroying its entity
+void releaseAudioEmitter(EntityId entity);
+
 // Global audio settings
 void setMasterVolume(float volume);
 float getMasterVolume();
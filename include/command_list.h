@@ -0,0 +1,120 @@
+#ifndef COMMAND_LIST_H
+#define COMMAND_LIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "SceneObject.h"
+#include "Vectors.h"
+
+// Draw work recorded as plain data so it can be built off the render thread.
+// Worker threads fill one list per range of objects, the render thread then
+// replays the lists in order and only the replay touches the graphics API.
+// Handles are the backend's object names, kept opaque here.
+
+#define COMMAND_LIST_OBJECTS 64 // Objects one recording job handles
+
+typedef enum {
+    CMD_BIND,           // A texture on a unit
+    CMD_SET_CONSTANTS,  // Per-object constants of the object shader
+    CMD_DRAW,           // Indexed triangles from one vertex array
+    CMD_DRAW_INDIRECT,  // A model's visible meshlets, culled and drawn indirectly on replay
+    CMD_DRAW_INSTANCED  // One geometry for a run of objects that share bindings and flags
+} CommandType;
+
+typedef enum {
+    CMD_TEXTURE_2D,
+    CMD_TEXTURE_2D_ARRAY
+} CommandTextureTarget;
+
+typedef enum {
+    CMD_INDEX_UINT16,
+    CMD_INDEX_UINT32
+} CommandIndexType;
+
+typedef struct {
+    unsigned int unit;
+    CommandTextureTarget target;
+    unsigned int texture;
+} BindCommand;
+
+typedef struct {
+    Matrix4x4 model;
+    Vector4 color;
+    bool useTexture;
+    bool usePBR;
+    bool useColor;
+    bool useMaterialArrays;
+    int materialLayer;
+} ConstantsCommand;
+
+typedef struct {
+    unsigned int vertexArray;
+    unsigned int indexCount;
+    CommandIndexType indexType;
+    size_t indexOffset;          // In bytes
+    unsigned int fullIndexCount; // Level 0 cost, for the LOD stats
+} DrawCommand;
+
+typedef struct {
+    const SceneObject* object;   // Drawn with the model matrix of the last constants
+} DrawIndirectCommand;
+
+// Per-object data of an instanced draw, laid out as the instance buffer
+typedef struct {
+    Matrix4x4 model;
+    Vector4 color;
+    int materialLayer;
+} CommandInstance;
+
+typedef struct {
+    ConstantsCommand constants;  // Flags every instance shares, model, color and layer come from the instances
+    DrawCommand draw;
+    unsigned int texture;        // Bound to unit 0 by the first instance, 0 for none
+    int slab;                    // Material slab bound by the first instance, -1 for none
+    int firstInstance;           // Into the list's instances
+    int instanceCount;
+} DrawInstancedCommand;
+
+typedef struct {
+    CommandType type;
+    union {
+        BindCommand bind;
+        ConstantsCommand constants;
+        DrawCommand draw;
+        DrawIndirectCommand indirect;
+        DrawInstancedCommand instanced;
+    } data;
+} Command;
+
+typedef struct {
+    Command* commands;
+    int count;
+    int capacity;
+    CommandInstance* instances;
+    int instanceCount;
+    int instanceCapacity;
+} CommandList;
+
+void clearCommandList(CommandList* list);   // Keeps the storage
+void freeCommandList(CommandList* list);
+
+void recordBind(CommandList* list, unsigned int unit, CommandTextureTarget target, unsigned int texture);
+void recordConstants(CommandList* list, const ConstantsCommand* constants);
+void recordDraw(CommandList* list, const DrawCommand* draw);
+void recordDrawIndirect(CommandList* list, const SceneObject* object);
+
+// Objects drawn with a single geometry, whose only per-object state is the
+// model matrix, color and slab layer, are recorded as instanced draws.
+// joinInstancedDraw adds one to the instanced draw the list ends with if the
+// geometry, bindings and flags match. Otherwise the caller records its binds
+// and starts a new one with recordDrawInstanced
+bool joinInstancedDraw(CommandList* list, const ConstantsCommand* constants, const DrawCommand* draw, unsigned int texture, int slab);
+void recordDrawInstanced(CommandList* list, const ConstantsCommand* constants, const DrawCommand* draw, unsigned int texture, int slab);
+
+// Render thread only. The program must be the object shader with the pass's
+// camera uniforms set; view and projection drive the meshlet culling.
+void replayCommandList(const CommandList* list, unsigned int program, const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix);
+// Deletes the instance buffer the replays share
+void shutdownCommandLists(void);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <stdbool.h>
+#include "Vectors.h"
+#include "SceneObject.h"
+#include "lightshading.h"
+
+// Component types of the ECS world, see ecs.h. Components are plain data,
+// systems that read or write them live with the module that owns the data.
+
+typedef enum {
+    COMPONENT_TRANSFORM,
+    COMPONENT_RENDERABLE,
+    COMPONENT_LIGHT,
+    COMPONENT_AUDIO_EMITTER,
+    COMPONENT_RIGID_BODY,
+    COMPONENT_BOUNDS,
+    COMPONENT_COUNT
+} ComponentType;
+
+typedef unsigned int ComponentMask;
+
+#define COMPONENT_BIT(type) (1u << (type))
+
+typedef struct {
+    Vector3 position;
+    Vector3 rotation;  // Degrees, applied X then Y then Z like SceneObject
+    Vector3 scale;
+    Matrix4x4 world;   // Derived, written by updateWorldTransforms
+} Transform;
+
+// Geometry and material stay on the object record, the transform of a
+// renderable follows the record's edited transform, see syncRenderables
+typedef struct {
+    ObjectHandle object;
+} Renderable;
+
+// Light components are the Light struct, position comes from the Transform
+
+typedef struct {
+    char clip[128];    // Sound file, loaded when the emitter starts
+    float volume;
+    float pitch;
+    bool looping;
+    bool autoplay;
+    int sourceIndex;   // Runtime, -1 until the emitter plays
+} AudioEmitter;
+
+// Velocity integration only, nothing collides yet
+typedef struct {
+    Vector3 velocity;
+    Vector3 angularVelocity;  // Degrees per second
+    float mass;
+} RigidBody;
+
+typedef struct {
+    Vector4 sphere;    // World bounding sphere, center in xyz and radius in w
+} Bounds;
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef ECS_H
+#define ECS_H
+
+#include <stdbool.h>
+#include "components.h"
+
+// Archetype entity-component storage. Entities with the same set of
+// components share an archetype, whose rows live in fixed-size chunks with
+// one packed column per component, so a system asking for Transform and
+// Light walks only the light chunks and reads each column linearly. Adding
+// or removing components moves the entity to another archetype. Rows stay
+// dense: removing one moves the archetype's last row into the gap.
+//
+// Every chunk keeps a version per component, stamped when a column is
+// written through writeComponent or markChunkChanged and when rows move in
+// or out. A query with a changed mask skips chunks nothing changed in since
+// the system last ran, see beginSystemRun.
+//
+// Structural changes (create, destroy, add, remove) happen on the main thread
+// and never while a query iterates. parallelForChunks hands whole chunks to
+// the job system, so a callback may write any row of its own chunk.
+
+#define ECS_CHUNK_BYTES (16 * 1024)
+#define ECS_INITIAL_CAPACITY 256
+
+#define INVALID_ENTITY ((EntityId){ 0, 0 })
+
+typedef struct EcsChunk EcsChunk;
+
+typedef struct {
+    ComponentMask all;          // Chunks with every one of these
+    ComponentMask none;         // and none of these
+    ComponentMask changed;      // If set, only chunks where one of these changed
+    unsigned int changedSince;  // after this version
+} EntityQuery;
+
+typedef struct {
+    EcsChunk* chunk;
+    int count;
+    const EntityId* entities;
+} ChunkView;
+
+typedef void (*ChunkFunction)(const ChunkView* view, void* data, int workerIndex);
+
+typedef struct {
+    int entities;
+    int archetypes;
+    int chunks;
+    unsigned int chunksVisited;
+    unsigned int chunksSkipped;  // Matched a query but had no changes
+} EcsStats;
+
+void initEcs(void);
+void shutdownEcs(void);
+
+// Components start zeroed
+EntityId createEntity(ComponentMask components);
+void destroyEntity(EntityId entity);
+bool isEntityAlive(EntityId entity);
+bool addComponents(EntityId entity, ComponentMask components);
+bool removeComponents(EntityId entity, ComponentMask components);
+bool hasComponents(EntityId entity, ComponentMask components);
+
+// NULL if the entity is gone or lacks the component. Pointers last until the
+// next structural change. writeComponent stamps the chunk as changed
+const void* getComponent(EntityId entity, ComponentType type);
+void* writeComponent(EntityId entity, ComponentType type);
+
+// Column of a chunk, NULL if its archetype lacks the component
+void* getChunkColumn(const ChunkView* view, ComponentType type);
+void markChunkChanged(const ChunkView* view, ComponentType type);
+
+// Runs on the calling thread
+void forEachChunk(const EntityQuery* query, ChunkFunction function, void* data);
+// One job per chunk, returns once all ran. Not from inside a chunk callback
+void parallelForChunks(const EntityQuery* query, ChunkFunction function, void* data);
+int countEntities(const EntityQuery* query);
+
+// Returns the version to pass as changedSince and opens a new one, so writes
+// made from here on are seen by the system's next run
+unsigned int beginSystemRun(unsigned int* lastRun);
+
+void resetEcsStats(void);
+const EcsStats* getEcsStats(void);
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Per-frame render graph. Every pass declares the resources it reads and
+// writes, then compileFrameGraph culls the passes whose results nothing
+// consumes, places transient textures so resources with disjoint lifetimes
+// share one texture, and executeFrameGraph binds each pass's target only when
+// it differs from the previous pass's. Passes run in the order they were
+// added and must not leave a framebuffer bound; passes writing an external
+// resource may bind their own, the graph rebinds after them.
+
+#define FG_MAX_PASSES 32
+#define FG_MAX_RESOURCES 32
+#define FG_MAX_PASS_IO 8
+#define FG_MAX_POOL_TEXTURES 16
+#define FG_MAX_FRAMEBUFFERS 16
+#define FG_POOL_FRAMES 3           // Pooled textures unused this many frames are freed
+
+typedef int FGResource;            // -1 when invalid
+typedef void (*FGExecute)(void* data);
+
+typedef enum {
+    FG_RESOURCE_TARGET,     // Imported framebuffer, 0 for the window
+    FG_RESOURCE_EXTERNAL,   // Owned by its pass (shadow maps), only tracked for culling
+    FG_RESOURCE_TRANSIENT   // Texture from the graph's pool, valid for the frame
+} FGResourceType;
+
+typedef struct {
+    int width;
+    int height;
+    GLenum internalFormat;  // A depth format becomes the depth attachment
+} FGTextureDesc;
+
+typedef struct {
+    const char* name;
+    FGResourceType type;
+    bool persistent;        // Written results are kept even if no pass reads them
+    GLuint framebuffer;     // FG_RESOURCE_TARGET
+    FGTextureDesc desc;     // FG_RESOURCE_TARGET size, FG_RESOURCE_TRANSIENT texture
+    int poolIndex;          // FG_RESOURCE_TRANSIENT, set by compileFrameGraph
+    int readers;
+    int firstPass, lastPass;
+} FGResourceNode;
+
+typedef struct {
+    const char* name;
+    FGExecute execute;
+    void* data;
+    FGResource reads[FG_MAX_PASS_IO];
+    int readCount;
+    FGResource writes[FG_MAX_PASS_IO];
+    int writeCount;
+    int references;         // Outputs still needed while culling
+    bool culled;
+    GLuint framebuffer;     // Resolved by compileFrameGraph
+    int width, height;
+    bool bindsTarget;       // False for passes that only write external resources
+} FGPass;
+
+typedef struct {
+    GLuint texture;
+    FGTextureDesc desc;
+    bool inUse;
+    unsigned int lastFrame;
+} FGPoolTexture;
+
+typedef struct {
+    GLuint framebuffer;
+    GLuint attachments[FG_MAX_PASS_IO];
+    int attachmentCount;
+    unsigned int lastFrame;
+} FGFramebuffer;
+
+typedef struct {
+    int passes;
+    int culledPasses;
+    int transientResources;
+    int transientTextures;      // Pool textures backing them this frame
+    int framebufferBinds;
+    int viewportChanges;
+    size_t transientBytes;
+} FrameGraphStats;
+
+typedef struct {
+    FGPass passes[FG_MAX_PASSES];
+    int passCount;
+    FGResourceNode resources[FG_MAX_RESOURCES];
+    int resourceCount;
+
+    // Kept across frames
+    FGPoolTexture pool[FG_MAX_POOL_TEXTURES];
+    FGFramebuffer framebuffers[FG_MAX_FRAMEBUFFERS];
+    unsigned int frame;
+    bool compiled;
+
+    FrameGraphStats stats;
+} FrameGraph;
+
+// Starts a new frame, pooled textures and framebuffers are kept
+void resetFrameGraph(FrameGraph* graph);
+void destroyFrameGraph(FrameGraph* graph);
+
+FGResource importFrameGraphTarget(FrameGraph* graph, const char* name, GLuint framebuffer, int width, int height, bool persistent);
+FGResource importFrameGraphExternal(FrameGraph* graph, const char* name, bool persistent);
+FGResource createFrameGraphTexture(FrameGraph* graph, const char* name, FGTextureDesc desc);
+
+int addFrameGraphPass(FrameGraph* graph, const char* name, FGExecute execute, void* data);
+void readFrameGraphResource(FrameGraph* graph, int pass, FGResource resource);
+void writeFrameGraphResource(FrameGraph* graph, int pass, FGResource resource);
+
+void compileFrameGraph(FrameGraph* graph);
+void executeFrameGraph(FrameGraph* graph);
+
+// Texture behind a transient resource, only valid while the graph executes
+GLuint getFrameGraphTexture(const FrameGraph* graph, FGResource resource);
+bool isFrameGraphPassLive(const FrameGraph* graph, int pass);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef FRAME_TIMING_H
+#define FRAME_TIMING_H
+
+#include <stdbool.h>
+
+// Fixed-step simulation clock. Frame time goes into an accumulator that is
+// spent in ticks of 1 / tickRate seconds, so update() always sees the same
+// step whatever the frame rate. A slow frame runs at most maxCatchUpTicks
+// and drops the rest instead of spiralling. The camera position and the
+// objects a tick moved are drawn interpolated between the last two ticks,
+// see scene_systems.h for the objects. Vsync and the frame-rate cap only
+// pace rendering and never change the tick.
+
+#define DEFAULT_TICK_RATE 60
+#define DEFAULT_MAX_CATCH_UP_TICKS 5
+
+typedef struct {
+    int tickRate;           // Simulation ticks per second
+    int maxCatchUpTicks;    // Per frame
+    bool vsync;
+    int frameRateCap;       // Frames per second, 0 for none
+} FrameTimingSettings;
+
+typedef struct {
+    int ticks;              // Run this frame
+    double droppedTime;     // Seconds discarded by the catch-up cap, total
+    double frameTime;       // Last frame, seconds
+} FrameTimingStats;
+
+extern FrameTimingSettings frameTiming;
+
+// Adds a frame's time and returns how many ticks to run now
+int beginFrameTicks(double frameTime);
+double getTickLength(void);
+// How far the leftover time is toward the next tick, 0 to 1
+float getTickAlpha(void);
+// Around each tick's update, measures how far the camera moved
+void beginTick(void);
+void endTick(void);
+// A camera that jumped (scene load, direct edits) shouldn't glide there
+void snapCameraInterpolation(void);
+
+// Around render(): swaps in the interpolated camera position and back. With
+// the simulation thread, swaps in the published camera plus the input it
+// hasn't applied yet (applyUnsimulatedInput)
+void applyRenderCamera(void);
+// After input sampled inside render(), which the thread only queues
+void refreshRenderCamera(void);
+void restoreSimulatedCamera(void);
+
+// After swapping buffers: applies vsync changes and sleeps out the frame cap
+void paceFrame(void);
+
+// Runs ticks back to back without rendering or pacing, for repeatable benchmarks
+void runBatchTicks(int ticks);
+
+const FrameTimingStats* getFrameTimingStats(void);
+
+#endif
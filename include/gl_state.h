@@ -0,0 +1,45 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+
+// Shadow copy of the GL state the engine changes most often. Engine modules
+// call these instead of raw GL so a call that would set the value already in
+// place is dropped. Anything that changes this state behind the cache's back
+// (Nuklear's renderer) must be followed by invalidateGLState().
+
+#define GL_STATE_TEXTURE_UNITS 32   // Units past this are passed straight through
+
+typedef struct {
+    unsigned int issued;    // Calls that reached GL since the last reset
+    unsigned int filtered;  // Calls dropped because the state already matched
+} GLStateStats;
+
+void stateUseProgram(GLuint program);
+void stateBindVertexArray(GLuint vao);
+void stateActiveTexture(GLenum unit);
+// Binds on the active unit, caches GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY and GL_TEXTURE_CUBE_MAP
+void stateBindTexture(GLenum target, GLuint texture);
+// GL_FRAMEBUFFER sets both the draw and read binding
+void stateBindFramebuffer(GLenum target, GLuint framebuffer);
+void stateEnable(GLenum cap);
+void stateDisable(GLenum cap);
+void stateBlendFunc(GLenum sfactor, GLenum dfactor);
+void stateBlendFunci(GLuint buffer, GLenum sfactor, GLenum dfactor);
+void stateDepthFunc(GLenum func);
+void stateDepthMask(GLboolean flag);
+void stateViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+// Deleting a bound object reverts its binding to 0, these keep the cache in step
+void stateDeleteTextures(GLsizei count, const GLuint* textures);
+void stateDeleteVertexArrays(GLsizei count, const GLuint* arrays);
+void stateDeleteFramebuffers(GLsizei count, const GLuint* framebuffers);
+
+// Forgets every cached value, the next call of each kind always reaches GL
+void invalidateGLState(void);
+
+void resetGLStateStats(void);
+const GLStateStats* getGLStateStats(void);
+
+#endif
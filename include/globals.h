@@ -25,8 +25,6 @@ extern struct nk_context* ctx;
 #include "types.h"
 #include "gui.h"
 
-#define MAX_OBJECTS 1000
-
 // Screen and rendering
 extern Screen screen;
 extern unsigned int shaderProgram;
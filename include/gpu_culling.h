@@ -0,0 +1,44 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <stdbool.h>
+#include "SceneObject.h"
+#include "Vectors.h"
+
+// Optional GPU-driven path for plain primitives (no texture, no PBR, opaque,
+// not static). Their transforms and bounds live in a storage buffer that only
+// receives the records that changed. A compute shader tests every object
+// against the frustum and last frame's depth pyramid and appends the visible
+// ones as instances of their primitive; the draws are compacted on the GPU and
+// issued with one indirect call. Needs GL 4.3 compute shaders, uses
+// glMultiDrawElementsIndirectCount on GL 4.6 and the uncompacted commands
+// otherwise.
+
+#define GPU_CULL_PRIMITIVES 5 // OBJ_CUBE through OBJ_PLANE
+
+typedef struct {
+    int objects;         // Records in the object buffer
+    int updatedObjects;  // Records uploaded this frame
+    bool available;      // Compute shaders built
+    bool indirectCount;  // GL 4.6 draw count path in use
+    bool occlusion;      // A depth pyramid from the previous frame was used
+} GPUCullingStats;
+
+extern bool gpuCullingEnabled;
+extern bool gpuOcclusionEnabled;
+
+bool initGPUCulling(void);
+void shutdownGPUCulling(void);
+
+// Once per frame before drawing, syncs eligible objects into the object buffer
+void updateGPUCulling(void);
+// Culls and draws the GPU-driven objects, after the opaque objects' uniforms are set
+void drawGPUCulledObjects(const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix);
+// After all opaque geometry, so next frame can test against this frame's depth
+void buildDepthPyramid(const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix, int width, int height);
+
+// True when the object is drawn by drawGPUCulledObjects this frame
+bool isObjectGPUCulled(const SceneObject* obj);
+const GPUCullingStats* getGPUCullingStats(void);
+
+#endif
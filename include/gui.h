@@ -1,10 +1,6 @@
 #ifndef GUI_H
 #define GUI_H
 
-#ifndef MAX_OBJECTS
-#define MAX_OBJECTS 1000
-#endif
-
 #include "ObjectManager.h"
 
 #define GLFW_INCLUDE_NONE 
@@ -22,8 +18,6 @@
 #define MAX_VERTEX_BUFFER 1024 * 1024
 #define MAX_ELEMENT_BUFFER 1024 * 1024
 
-extern SceneObject scene_objects[MAX_OBJECTS];
-extern int num_scene_objects;
 extern GLuint textureColorbuffer;
 const char* objectTypeName(ObjectType type);
 
@@ -0,0 +1,59 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include "Vectors.h"
+
+// Low-latency presentation. Left alone the driver queues several frames
+// behind the one being recorded, and input waits in that queue before it
+// reaches the screen. Every present is followed by a fence; latency mode
+// waits on them before a frame polls input, so no more than framesInFlight
+// frames (counting the new one) are unfinished on the GPU. The cursor is read
+// again right before render() builds the view matrix (events are only pumped
+// at the top of the loop), and late reprojection
+// rotates the finished image by mouse look that arrived while it was drawn.
+// The fences also measure input-to-present latency: from a frame's last
+// input sample to when the CPU sees its fence signal, checked at the start
+// of each frame unless latency mode waits on it.
+
+#define MAX_FRAMES_IN_FLIGHT 3
+#define LATENCY_FENCE_QUEUE 8      // Fences kept without latency mode, the oldest is waited on when full
+#define REPROJECTION_FORMAT GL_RGBA8
+
+typedef struct {
+    bool enabled;
+    int framesInFlight;            // 1 to MAX_FRAMES_IN_FLIGHT
+    bool lateReprojection;
+} LatencySettings;
+
+typedef struct {
+    double inputToPresent;         // Last measured frame, milliseconds
+    double averageInputToPresent;
+    double fenceWait;              // This frame, milliseconds
+    int framesQueued;              // Unfinished on the GPU after the wait
+    float reprojectionDegrees;     // Rotation applied this frame
+} LatencyStats;
+
+extern LatencySettings latencyMode;
+
+bool initLatency(void);
+void shutdownLatency(void);
+
+// Start of the frame, before polling input
+void waitForFrameSlot(void);
+// After input went into the camera
+void markInputSampled(void);
+// After swapping buffers
+void markFramePresented(void);
+
+bool isReprojectionAvailable(void);
+// Rotation from the view the frame was drawn with to the latest camera,
+// returns false when there is nothing worth correcting
+bool prepareReprojection(const Matrix4x4 renderedView, const Matrix4x4 latestView);
+// Draws the copied frame, rotated, over the bound target
+void drawReprojection(GLuint frameTexture, const Matrix4x4 projection, int width, int height);
+
+const LatencyStats* getLatencyStats(void);
+
+#endif
@@ -24,11 +24,21 @@ typedef struct {
     float outerCutOff; // For spotlights
 } Light;
 
+// Lights are entities with LIGHT_COMPONENTS, see ecs.h. lights[] packs them
+// for the shaders and shadow maps, refreshed at once by the functions below.
+// updateLights runs in the simulation step and repacks into a staging copy
+// when a light component changed, publishLights takes it on the main thread
+#define LIGHT_COMPONENTS (COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_LIGHT))
+
 extern Light lights[MAX_LIGHTS];
 extern int lightCount;
 
 void initLightingSystem();
+void updateLights(void);
+void publishLights(void);
+void clearLights(void);
 void updateShaderLights();
+void setLightUniforms(unsigned int program);
 void addLight(Light newLight);
 void updateLight(int index, Light updatedLight);
 void removeLight(int index);
@@ -0,0 +1,63 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <stdbool.h>
+#include "SceneObject.h"
+#include "Vectors.h"
+#include "command_list.h"
+
+// Level of detail selection. Imported meshes carry up to MAX_LOD_LEVELS index
+// ranges built by simplifyMesh, spheres and cylinders switch to coarser shared
+// tessellations. Every view picks a level from the object's projected size,
+// with hysteresis so objects near a threshold don't flicker between levels.
+
+#define LOD_HYSTERESIS 0.15f // Fraction of a threshold an object must cross before switching back
+
+// Each view keeps its own level per object so shadow passes don't fight the camera
+typedef enum {
+    LOD_VIEW_CAMERA,
+    LOD_VIEW_DIRECTIONAL_SHADOW,
+    LOD_VIEW_SPOT_SHADOW,
+    LOD_VIEW_POINT_SHADOW,
+    LOD_VIEW_SLOTS
+} LODViewSlot;
+
+typedef struct {
+    Vector3 eye;
+    float projScale;   // Projection matrix [1][1], 2 / height for orthographic views
+    bool orthographic;
+    LODViewSlot slot;
+} LODView;
+
+typedef struct {
+    unsigned long long trianglesDrawn[LOD_VIEW_SLOTS];
+    unsigned long long trianglesFull[LOD_VIEW_SLOTS]; // What level 0 everywhere would have cost
+} LODStats;
+
+extern bool lodEnabled;
+
+void initPrimitiveLODs(void);
+void cleanupPrimitiveLODs(void);
+
+LODView makeLODView(Vector3 eye, float projScale, bool orthographic, LODViewSlot slot);
+LODView makeCameraLODView(const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix);
+
+// Bounding sphere of the object's geometry before its transform
+void getObjectLocalBounds(const SceneObject* obj, Vector3* center, float* radius);
+
+// Updates and returns the object's level for this view
+int selectObjectLOD(SceneObject* obj, const Matrix4x4* modelMatrix, const LODView* view);
+// Binds and draws the geometry of one level, the caller has set the uniforms
+void drawObjectLOD(const SceneObject* obj, int level, LODViewSlot slot);
+// Same geometry as draws on the list, safe off the render thread
+void recordObjectLOD(CommandList* list, const SceneObject* obj, int level);
+// The level's draw when it is a single one (primitives, one-mesh models),
+// which lets equal draws of several objects become one instanced draw
+bool getObjectLODDraw(const SceneObject* obj, int level, DrawCommand* draw);
+
+// For draws that bypass drawObjectLOD, counts are in indices
+void recordLODTriangles(LODViewSlot slot, unsigned int drawnIndices, unsigned int fullIndices);
+void resetLODStats(void);
+const LODStats* getLODStats(void);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdbool.h>
+
+// Leveled logging off the calling thread. LOG_* formats the message into a
+// slot of a lock-free ring and returns; a background thread writes the ring
+// to stdout (stderr for warnings and errors), so a slow console or log pipe
+// never stalls the frame. A full ring drops messages and reports how many.
+// Before initLogging and after shutdownLogging messages are written directly.
+//
+// Each module has its own minimum level, set with setLogLevel or the
+// CLUE_LOG environment variable, e.g. CLUE_LOG=scene=debug,render=warn.
+// Calls below LOG_COMPILE_LEVEL compile to nothing, debug calls are only
+// kept in builds without NDEBUG.
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_OFF   4
+
+#ifndef LOG_COMPILE_LEVEL
+    #ifdef NDEBUG
+        #define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+    #else
+        #define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+    #endif
+#endif
+
+#define LOG_RING_SIZE 1024     // Messages, a power of two
+#define LOG_MESSAGE_SIZE 240   // Longer messages are cut
+
+typedef enum {
+    LOG_CORE,     // Startup, threads, timing
+    LOG_SCENE,    // Objects, ECS, scene graph, undo
+    LOG_RENDER,   // Passes, shaders, lights, shadows
+    LOG_ASSETS,   // Textures, models, materials, project files
+    LOG_AUDIO,
+    LOG_UI,
+    LOG_MODULE_COUNT
+} LogModule;
+
+typedef struct {
+    unsigned int written;
+    unsigned int dropped;  // The ring was full
+} LogStats;
+
+void initLogging(void);
+void shutdownLogging(void);  // Writes what is still queued, then joins
+
+void setLogLevel(LogModule module, int level);
+int getLogLevel(LogModule module);
+
+void logMessage(int level, LogModule module, const char* format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((format(printf, 3, 4)))
+#endif
+    ;
+
+const LogStats* getLogStats(void);
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
+    #define LOG_DEBUG(module, ...) logMessage(LOG_LEVEL_DEBUG, module, __VA_ARGS__)
+#else
+    #define LOG_DEBUG(module, ...) ((void)0)
+#endif
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+    #define LOG_INFO(module, ...) logMessage(LOG_LEVEL_INFO, module, __VA_ARGS__)
+#else
+    #define LOG_INFO(module, ...) ((void)0)
+#endif
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARN
+    #define LOG_WARN(module, ...) logMessage(LOG_LEVEL_WARN, module, __VA_ARGS__)
+#else
+    #define LOG_WARN(module, ...) ((void)0)
+#endif
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_ERROR
+    #define LOG_ERROR(module, ...) logMessage(LOG_LEVEL_ERROR, module, __VA_ARGS__)
+#else
+    #define LOG_ERROR(module, ...) ((void)0)
+#endif
+
+#endif
@@ -9,14 +9,33 @@ typedef struct {
     GLuint metallicMap;
     GLuint roughnessMap;
     GLuint aoMap;
+    int arraySlab;   // Index into materialSlabs, -1 if the maps could not be packed
+    int arrayLayer;  // Layer of this material inside its slab
 } PBRMaterial;
 
 #define MAX_MATERIALS 50  
+#define PBR_MAP_COUNT 5
+#define MAX_MATERIAL_SLABS 8
+#define PBR_ARRAY_TEXTURE_UNIT 5 // Slab maps occupy units 5-9, shadow maps start at 10
+#define MATERIAL_LAYER_ATTRIB 3  // Per-object layer index, a constant attribute or per-instance data
+
+// Materials whose maps share resolution and format are packed into one
+// GL_TEXTURE_2D_ARRAY per map type, so switching material is a layer change
+typedef struct {
+    GLuint maps[PBR_MAP_COUNT];          // albedo, normal, metallic, roughness, ao
+    GLsizei width[PBR_MAP_COUNT];
+    GLsizei height[PBR_MAP_COUNT];
+    GLenum internalFormat[PBR_MAP_COUNT];
+    GLsizei levels;
+    int layerCount;
+} PBRMaterialSlab;
 
 // Material storage 
 extern PBRMaterial materials[MAX_MATERIALS];
 extern const char* materialNames[MAX_MATERIALS];
 extern int materialCount;
+extern PBRMaterialSlab materialSlabs[MAX_MATERIAL_SLABS];
+extern int materialSlabCount;
 
 
 PBRMaterial loadPBRMaterial(const char* albedo, const char* normal, const char* metallic, const char* roughness, const char* ao);
@@ -25,4 +44,11 @@ void cleanupPBRMaterial(PBRMaterial* material);
 void addMaterial(const char* name, PBRMaterial material);
 PBRMaterial* getMaterial(const char* name);
 
+// Texture array packing
+void buildPBRMaterialArrays();
+void bindPBRMaterialSlab(int slab);
+void resetPBRMaterialSlabBinding();
+void cleanupPBRMaterialArrays();
+void setPBRSamplerUniforms(GLuint shader);
+
 #endif 
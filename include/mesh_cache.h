@@ -0,0 +1,57 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "ModelLoad.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Binary mesh cache written next to imported models (<model path>.cemesh).
+// Layout: header, sub-mesh table, then each mesh's vertex, index and meshlet blobs.
+#define MESH_CACHE_MAGIC 0x434D4543u // "CEMC"
+#define MESH_CACHE_VERSION 4 // Bump whenever the vertex layout or optimizer output changes
+#define MESH_CACHE_EXTENSION ".cemesh"
+#define MESH_CACHE_ALIGNMENT 16
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t contentHash; // FNV-1a of the source model file
+    uint32_t meshCount;
+    uint32_t reserved;
+} MeshCacheHeader;
+
+typedef struct {
+    uint32_t numVertices;
+    uint32_t numIndices;
+    uint32_t vertexStride;
+    uint32_t indexType;   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    uint32_t lodCount;
+    uint32_t lodIndexCount[MAX_LOD_LEVELS]; // Sums to numIndices
+    uint32_t meshletCount;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t meshletOffset;
+} MeshCacheEntry;
+
+// Read-only memory mapping of a whole file
+typedef struct MappedFile {
+    const unsigned char* data;
+    size_t size;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+} MappedFile;
+
+bool mapFile(const char* path, MappedFile* file);
+void unmapFile(MappedFile* file);
+
+uint64_t hashMemory(const void* data, size_t size);
+bool hashFile(const char* path, uint64_t* hash);
+
+void getMeshCachePath(const char* modelPath, char* out, size_t outSize);
+bool mapMeshCache(const char* modelPath, uint64_t contentHash, ImportedModel* out);
+bool writeMeshCache(const char* modelPath, uint64_t contentHash, const MeshData* meshes, unsigned int meshCount);
+
+#endif
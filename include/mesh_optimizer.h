@@ -0,0 +1,61 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Import-time mesh optimization on 32-bit triangle lists. If a temporary
+// allocation fails the input is left untouched.
+
+#define VERTEX_CACHE_SIZE 32         // Post-transform cache modelled by the reorder
+#define OVERDRAW_CACHE_SIZE 16       // FIFO used to find cluster boundaries
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// A run of consecutive triangles in the index buffer with its culling bounds.
+// Stored as-is in the mesh cache.
+typedef struct {
+    float center[3];       // Bounding sphere
+    float radius;
+    float coneAxis[3];     // Average facing of the triangles
+    float coneCutoff;      // sin of the widest normal angle from the axis, 1 when the cone is useless
+    unsigned int firstIndex;
+    unsigned int indexCount;
+} Meshlet;
+
+// Merges bit-identical vertices in place. Returns the new vertex count.
+unsigned int weldVertices(void* vertices, unsigned int vertexCount, size_t vertexStride,
+                          unsigned int* indices, unsigned int indexCount);
+
+// Reorders triangles for post-transform vertex cache reuse (Forsyth)
+bool optimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount);
+
+// Sorts cache-friendly triangle clusters so outward-facing ones draw first
+bool optimizeOverdraw(unsigned int* indices, unsigned int indexCount,
+                      const float* positions, size_t positionStride, unsigned int vertexCount);
+
+// Reorders vertices into first-use order so fetches walk the buffer linearly.
+// Unreferenced vertices are dropped; returns the new vertex count.
+unsigned int optimizeVertexFetch(void* vertices, unsigned int vertexCount, size_t vertexStride,
+                                 unsigned int* indices, unsigned int indexCount);
+
+// Quadric error edge collapse onto existing vertices, so the result indexes the
+// same vertex buffer. Stops at targetIndexCount or once the error would exceed
+// targetError (relative to the mesh extent). Seams and borders are kept.
+// Returns the index count written to destination (room for indexCount).
+unsigned int simplifyMesh(unsigned int* destination, const unsigned int* indices, unsigned int indexCount,
+                          const float* positions, size_t positionStride, unsigned int vertexCount,
+                          unsigned int targetIndexCount, float targetError);
+
+// Splits the index buffer into meshlets of consecutive triangles without
+// reordering it, so run it after the cache and overdraw passes. destination
+// needs room for one meshlet per triangle. Returns the meshlet count.
+unsigned int buildMeshlets(Meshlet* destination, const unsigned int* indices, unsigned int indexCount,
+                           const float* positions, size_t positionStride, unsigned int vertexCount);
+
+// Quantization helpers for packed vertex attributes
+unsigned short floatToHalf(float value);
+float halfToFloat(unsigned short value);
+signed char floatToSnorm8(float value);
+
+#endif
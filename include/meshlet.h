@@ -0,0 +1,52 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include "SceneObject.h"
+#include "Vectors.h"
+
+// Imported meshes are split into meshlets at import time (buildMeshlets).
+// When the camera draws a model at full detail, every meshlet is tested
+// against the view frustum and its normal cone on the CPU, four at a time,
+// with large meshes spread over the thread pool. The surviving meshlets go
+// to the GPU in one glMultiDrawElementsIndirect per mesh.
+
+#define MESHLET_CULL_BATCH 256             // Meshlets per culling task
+#define MESHLET_MIN_COUNT 4                // Fewer than this draw in one call
+#define MESHLET_INDIRECT_CAPACITY 65536    // Commands in the streaming indirect buffer
+
+// Layout fixed by glMultiDrawElementsIndirect
+typedef struct {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLuint baseVertex;
+    GLuint baseInstance;
+} DrawElementsIndirectCommand;
+
+typedef struct {
+    int meshesCulled;
+    int meshletsTested;
+    int meshletsVisible;
+    int draws;               // Indirect commands after merging neighbours
+} MeshletStats;
+
+extern bool meshletCullingEnabled;
+
+void initMeshletCulling(void);
+void shutdownMeshletCulling(void);
+
+// Bounds repacked four meshlets at a time for the SIMD test, free() it
+float* createMeshletCullData(const Meshlet* meshlets, unsigned int count);
+
+// Draws level 0 of the object's model with only its visible meshlets. Returns
+// false when the object should be drawn the normal way.
+bool drawModelMeshlets(const SceneObject* obj, const Matrix4x4* modelMatrix, const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix);
+// Whether drawModelMeshlets would take the object, without touching GL
+bool canDrawModelMeshlets(const SceneObject* obj);
+
+void resetMeshletStats(void);
+const MeshletStats* getMeshletStats(void);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef MODEL_REGISTRY_H
+#define MODEL_REGISTRY_H
+
+#include "ModelLoad.h"
+#include <stdint.h>
+
+// Imported models are shared between SceneObjects. Each distinct file (by
+// canonical path or content hash) is imported once and its GPU buffers live
+// while at least one reference is held. Returned Model pointers stay valid
+// until cleanupModelRegistry, so undo history and the clipboard can keep them;
+// retaining a model whose buffers were released re-uploads it from the cache.
+//
+// Imports run on the thread pool and their buffers stream in through the
+// upload queue. A model has no meshes until all of them have landed, so
+// objects appear once their geometry is ready.
+
+typedef enum {
+    MODEL_UNLOADED,
+    MODEL_LOADING,
+    MODEL_RESIDENT,
+    MODEL_FAILED
+} ModelState;
+
+typedef struct {
+    Model model;          // Must stay first, releaseModel casts back from Model*
+    char canonicalPath[512];
+    uint64_t contentHash;
+    int refCount;
+    ModelState state;
+} ModelEntry;
+
+void initModelRegistry(void);
+void processModelImports(void);
+Model* acquireModel(const char* path);
+void retainModel(Model* model);
+void releaseModel(Model* model);
+void cleanupModelRegistry(void);
+
+int getRegisteredModelCount(void);
+int getResidentModelCount(void);
+int getPendingImportCount(void);
+uint64_t getModelContentHash(const Model* model);
+// Counts models whose geometry landed, bounds derived from a model go stale when it moves
+unsigned int getModelsLanded(void);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef OIT_H
+#define OIT_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+
+// Weighted blended order-independent transparency. Transparent objects are
+// drawn in any order into an accumulation target (weighted premultiplied
+// color) and a revealage target (product of 1 - alpha), tested against a copy
+// of the opaque depth, and a full screen pass blends the weighted average over
+// the frame. No per-frame sort, and intersecting surfaces blend per pixel.
+// The targets are transient frame graph textures in these formats.
+
+#define OIT_ACCUMULATION_FORMAT GL_RGBA16F
+#define OIT_REVEALAGE_FORMAT GL_R8
+#define OIT_DEPTH_FORMAT GL_DEPTH_COMPONENT24
+
+extern bool oitEnabled;
+
+bool initOIT(void);
+void shutdownOIT(void);
+bool isOITAvailable(void);
+
+// With the accumulation, revealage and depth targets bound: copies the opaque
+// depth from the window, clears the targets and sets up the blending
+void beginWeightedTransparency(GLuint depthTexture, int width, int height);
+// Restores the opaque depth and blend state
+void endWeightedTransparency(void);
+// Blends the weighted average over the bound target
+void compositeWeightedTransparency(GLuint accumulation, GLuint revealage);
+
+#endif
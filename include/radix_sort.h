@@ -0,0 +1,17 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <stdint.h>
+
+// Stable LSD radix sort of 32-bit keys, 8 bits per pass, carrying one value
+// per key. The scratch arrays hold count entries each. Passes where every key
+// has the same byte are skipped, so narrow key ranges sort in fewer passes.
+void radixSortKeys(uint32_t* keys, uint32_t* values, uint32_t* scratchKeys, uint32_t* scratchValues, int count);
+
+// Key for a non-negative float that sorts in the same order as the float
+static inline uint32_t radixKeyFromFloat(float value) {
+    union { float f; uint32_t u; } bits = { value };
+    return bits.u;
+}
+
+#endif
@@ -7,16 +7,23 @@
 #include "Vectors.h"
 #include "3DObjects.h"
 #include "ModelLoad.h"
+#include "SceneObject.h"
+#include "frame_graph.h"
 
 // Function prototypes
 void setup();
+// Main thread, before the simulation step starts: stats, model imports, uploads
+void prepareFrame(void);
+// Draws what the last step published, never touches the ECS or scene graph
 void render();
 double calculateDeltaTime();
 void update(double deltaTime);
-void handleMouseInput(GLFWwindow* window, Camera* camera);
+void handleMouseInput(GLFWwindow* window);
 void end();
 void loadResources(int stage, float* progress);
 void drawMesh(const Mesh* mesh);
+void setShaderUniforms(SceneObject* obj);
+const FrameGraphStats* getFrameGraphStats(void);
 
 // Input callbacks
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
@@ -0,0 +1,65 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <stdbool.h>
+#include "ecs.h"
+
+// Parent links between entities with a Transform. Transform components and
+// SceneObjects hold local values; world = parent world after local. Nodes
+// keep their local and world matrices in arrays sorted breadth-first, so
+// every parent precedes its children, siblings sit next to each other and
+// each depth is one contiguous range.
+//
+// Setting a local transform only flags its node. updateWorldTransforms walks
+// the levels top-down once, recomputing flagged nodes and everything below
+// them, so moving a root with thousands of descendants costs one pass over
+// that subtree. New world matrices are written back to the Transform
+// components, stamping their chunks for the change-filtered systems.
+// Structural edits (create, destroy, reparent) re-sort the arrays on the
+// next update.
+//
+// Each node also keeps the world it had before its last recompute and the
+// serial of that update, so a caller that runs one update per tick can tell
+// what the last tick moved and from where.
+//
+// Reparenting keeps the child's local transform. Children of a destroyed
+// node move up to its parent and take its local transform into their own,
+// so they stay where they were. Entities that mirror their local transform
+// elsewhere (SceneObjects) should detach their children first.
+
+#define SCENE_LEVEL_RANGE 256  // Nodes per parallelFor range within a level
+
+typedef struct {
+    int nodes;
+    int levels;
+    int updated;     // World matrices recomputed by the last update
+    bool reordered;  // The last update re-sorted the nodes
+} SceneGraphStats;
+
+void initSceneGraph(void);
+void shutdownSceneGraph(void);
+
+// Entities with a Transform go through these to get a node
+EntityId createSceneEntity(ComponentMask components);
+void destroySceneEntity(EntityId entity);
+
+// Safe from chunk jobs as long as each entity is set by one thread
+void setLocalTransform(EntityId entity, Vector3 position, Vector3 rotation, Vector3 scale);
+
+// Fails for dead entities and links that would form a cycle. INVALID_ENTITY detaches
+bool setParent(EntityId child, EntityId parent);
+EntityId getParent(EntityId entity);
+// Writes up to capacity children and returns how many there are
+int getChildren(EntityId entity, EntityId* children, int capacity);
+int getSceneDepth(EntityId entity);  // 0 for roots, -1 without a node
+
+void updateWorldTransforms(void);
+// Counts updateWorldTransforms calls
+unsigned int getWorldUpdateSerial(void);
+// World before the entity's last recompute. Returns the serial of the update
+// that recomputed it, 0 if none has or the entity has no node
+unsigned int getPreviousWorld(EntityId entity, Matrix4x4* previous);
+
+const SceneGraphStats* getSceneGraphStats(void);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SCENE_SYSTEMS_H
+#define SCENE_SYSTEMS_H
+
+#include <stdbool.h>
+
+// ECS systems over transforms. Every scene object owns an entity with
+// Transform, Renderable and Bounds. Its SceneObject keeps the edited local
+// transform (inspector, undo), syncRenderables copies it into the Transform
+// and flags the scene graph node of anything that moved. The scene graph
+// writes new world matrices back, which stamps those chunks, so bounds are
+// recomputed for them alone. They are staged rather than written into the
+// object manager's columns, which the renderer may be reading while a step
+// runs on the simulation thread, see simulation.h.
+//
+// Objects moved by a step's last tick are drawn interpolated: they keep the
+// world of the tick before and of the last tick, and publishScene blends the
+// two by how far the clock is toward the next tick. Edits snap. Bounds are
+// those of the last tick.
+
+// Step order: sync, updateWorldTransforms (scene_graph.h), bounds
+void syncRenderables(void);
+void updateRenderableBounds(void);
+
+// Once per tick. Renderables move through their SceneObject
+void integrateRigidBodies(double deltaTime);
+
+// One simulation step on whichever thread owns the scene: the ticks of rigid
+// body motion while running, then sync, world transforms, bounds and lights
+void stepScene(int ticks, double tickLength, bool running);
+// Main thread with no step running: the staged matrices and bounds go into
+// the object columns, the staged lights into lights[]. Alpha is the tick
+// fraction to draw interpolated objects at, see getTickAlpha
+void publishScene(float alpha);
+void shutdownSceneSystems(void);
+
+#endif
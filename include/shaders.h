@@ -2,6 +2,8 @@
 #include <GLFW/glfw3.h>
 #include <stdbool.h>
 unsigned int loadShader(const char* vertexPath, const char* fragmentPath);
+unsigned int loadComputeShader(const char* computePath);
 bool checkCompileErrors(unsigned int shader, const char* type);
 char* readFile(const char* filePath);
+char* readShaderSource(const char* filePath);
 
@@ -5,10 +5,12 @@
 #include <stdbool.h>
 #include "Vectors.h"
 #include "lightshading.h"
+#include "lod.h"
 
 #define MAX_SHADOW_MAPS 8
 #define SHADOW_MAP_SIZE 2048
 #define CUBE_SHADOW_MAP_SIZE 1024
+#define DIRECTIONAL_SHADOW_ORTHO_SIZE 10.0f // World units covered by a directional shadow map
 
 typedef enum {
     SHADOW_TYPE_DIRECTIONAL,
@@ -74,7 +76,7 @@ void destroyShadowMap(ShadowType type, int index);
 void renderDirectionalShadow(int shadowIndex);
 void renderPointShadow(int shadowIndex);
 void renderSpotShadow(int shadowIndex);
-void renderSceneToShadowMap(const Matrix4x4* lightSpaceMatrix);
+void renderSceneToShadowMap(const Matrix4x4* lightSpaceMatrix, const LODView* lodView);
 void renderSceneToCubeShadowMap(const Vector3* lightPos, float farPlane);
 
 // Shadow matrix calculations
@@ -0,0 +1,61 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <stdbool.h>
+#include "Camera.h"
+
+// Optional pipelined mode. A step advances the scene by the frame's fixed
+// ticks: rigid body motion, the renderable sync, world transforms, bounds
+// and light packing (stepScene, scene_systems.h), plus the camera from the
+// input the main thread sampled. While a step runs it owns the ECS and the
+// scene graph. The main thread owns them from finishSimulationStep to
+// startSimulationStep (events, ticks of update(), GUI edits, model imports)
+// and renders from what the last step published: the object manager's
+// matrix and bounds columns, lights[] and the camera.
+//
+// With the thread, the step started in frame N runs alongside rendering
+// frame N and shows in frame N+1. Without it the step runs inline and shows
+// at once. Camera input goes through the functions below, which apply it
+// directly when the thread isn't running.
+
+// Movement keys held this frame
+#define MOVE_FORWARD  (1u << 0)
+#define MOVE_BACKWARD (1u << 1)
+#define MOVE_LEFT     (1u << 2)
+#define MOVE_RIGHT    (1u << 3)
+#define MOVE_UP       (1u << 4)
+#define MOVE_DOWN     (1u << 5)
+
+typedef struct {
+    unsigned int steps;
+    double stepTime;       // Last step, seconds
+    double waitTime;       // Main thread blocked on the last step, seconds
+    bool threaded;
+} SimulationStats;
+
+extern bool pipelinedSimulation;   // Requested mode, applied by startSimulationStep
+
+// Camera input from callbacks and the update loop
+void moveCamera(unsigned int movementKeys, float deltaTime);
+void lookCamera(float xoffset, float yoffset);
+void panCamera(float xoffset, float yoffset);
+void zoomCamera(float yoffset);
+// After writing the global camera directly (settings, scene load)
+void cameraEdited(void);
+// With the thread, the global camera is the last published one: input given
+// to the step in flight and input sampled since is still missing. Applies it
+// to target, a render-only copy. Does nothing without the thread
+void applyUnsimulatedInput(Camera* target);
+
+// Top of the frame, before anything touches the scene: waits for the step
+// started last frame and publishes its results
+void finishSimulationStep(void);
+// Once the frame's edits are in: starts or stops the thread to match
+// pipelinedSimulation, then runs this frame's ticks on it or inline
+void startSimulationStep(int ticks);
+void shutdownSimulation(void);
+
+// Main thread, outside a step
+const SimulationStats* getSimulationStats(void);
+
+#endif
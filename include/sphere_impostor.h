@@ -0,0 +1,45 @@
+#ifndef SPHERE_IMPOSTOR_H
+#define SPHERE_IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include "SceneObject.h"
+#include "Vectors.h"
+
+// Spheres drawn as one camera-facing quad each. The fragment shader intersects
+// the view ray with the sphere, writes the true depth and shades the hit point
+// with the regular lighting, so the result matches a perfectly tessellated
+// sphere at four vertices per instance. Used automatically for every sphere
+// once a scene has many of them, and otherwise for spheres that are small on
+// screen. Spheres with non-uniform scale, transparency, static batching or
+// unpacked PBR materials keep their mesh.
+
+#define SPHERE_IMPOSTOR_AUTO_COUNT 256      // Spheres in view before all of them switch
+#define SPHERE_IMPOSTOR_MAX_PIXELS 48.0f    // Projected radius below which a single sphere switches
+#define SPHERE_IMPOSTOR_NEAR_MARGIN 0.5f    // Closer than this to the eye the mesh is used
+
+typedef struct {
+    int spheres;        // Eligible spheres this frame
+    int impostors;      // Drawn as impostors
+    int culled;         // Impostors outside the view frustum
+    int draws;          // Instanced draws, one per texture or material slab
+    bool countTriggered;
+} SphereImpostorStats;
+
+extern bool sphereImpostorsEnabled;
+extern bool sphereImpostorsForced;
+
+bool initSphereImpostors(void);
+void shutdownSphereImpostors(void);
+
+// Once per frame after the camera moved, decides which spheres are impostors
+void updateSphereImpostors(const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix, int viewportHeight);
+// Draws them, the caller has set the frame uniforms on getSphereImpostorProgram()
+void drawSphereImpostors(const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix);
+GLuint getSphereImpostorProgram(void);
+
+// True when the object is drawn by drawSphereImpostors this frame
+bool isSphereImpostor(const SceneObject* obj);
+const SphereImpostorStats* getSphereImpostorStats(void);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef STATIC_BATCH_H
+#define STATIC_BATCH_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include "SceneObject.h"
+#include "Vectors.h"
+
+// Objects marked static are pre-transformed into world space and merged into
+// combined vertex/index buffers, one set per grid chunk. Inside a chunk the
+// triangles are grouped by material so a chunk draws with one call per
+// material. Chunks are culled against the view frustum and only the chunks
+// whose objects changed are rebuilt.
+
+#define STATIC_CHUNK_SIZE 32.0f     // World units per grid cell
+#define STATIC_MAX_CHUNKS 256
+
+// Vertex layout of the merged buffers, attribute 3 and 4 are per vertex here
+typedef struct {
+    float position[3];
+    float texCoord[2];
+    float normal[3];
+    int materialLayer;
+    unsigned char color[4];
+} StaticVertex;
+
+typedef struct {
+    int chunks;
+    int batches;         // Draw calls if every chunk is visible
+    int objects;
+    int visibleChunks;   // Last drawStaticBatches call
+    int rebuiltChunks;   // Last updateStaticBatches call
+} StaticBatchStats;
+
+extern bool staticBatchingEnabled;
+
+// Once per frame before any pass draws, rebuilds the chunks that changed
+void updateStaticBatches(void);
+void drawStaticBatches(const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix);
+// Geometry only, for depth passes; the caller sets an identity model matrix
+void drawStaticBatchGeometry(void);
+void cleanupStaticBatches(void);
+
+// True when the object is drawn by its chunk and must be skipped elsewhere
+bool isObjectStaticBatched(const SceneObject* obj);
+const StaticBatchStats* getStaticBatchStats(void);
+
+// Object-space geometry of a primitive in the merged layout, the caller frees both arrays
+bool buildPrimitiveGeometry(ObjectType type, StaticVertex** vertices, unsigned int* vertexCount,
+                            unsigned int** indices, unsigned int* indexCount);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdbool.h>
+
+// Work-stealing job system shared by the whole engine. Each worker owns a
+// deque: it runs its newest job first and idle workers steal the oldest.
+// Threads outside the pool get a deque of their own the first time they
+// submit or wait. A thread waiting on a counter runs queued jobs instead of
+// blocking, so waits never stall while work is pending. Counters, queue
+// depth and stats are atomics; the pool lock is only taken to sleep and to
+// wake sleepers. Long background work (imports, decoding) goes through
+// submitTask, which only workers pick up once no jobs are queued.
+
+#define MAX_WORKER_THREADS 16
+#define MAX_HELPER_THREADS 4   // Threads outside the pool that may submit or wait on jobs
+#define MAX_JOB_THREADS (MAX_WORKER_THREADS + MAX_HELPER_THREADS)
+
+// Tasks receive the index of the thread running them, so callers can keep
+// per-thread state (importers, scratch buffers) in arrays of MAX_JOB_THREADS
+// without locking. Workers are 0 to getWorkerCount() - 1. A thread outside
+// the pool is given a free index from MAX_WORKER_THREADS on when it first
+// submits or waits, and keeps it until releaseJobThreadIndex. More than
+// MAX_HELPER_THREADS such threads at once is a fatal error.
+typedef void (*TaskFunction)(void* data, int workerIndex);
+// Runs items [begin, end) of a parallelFor
+typedef void (*RangeFunction)(void* data, int begin, int end, int workerIndex);
+
+// Jobs submitted against a counter and not yet finished, zero it before use
+typedef struct {
+    volatile unsigned int pending;
+} JobCounter;
+
+typedef struct {
+    unsigned int jobsRun;
+    unsigned int jobsStolen;   // Taken from another thread's deque
+    unsigned int jobsHelped;   // Run by a thread waiting on a counter
+} JobSystemStats;
+
+void initThreadPool(int workerCount); // 0 picks one worker per spare core
+void shutdownThreadPool(void);        // Finishes queued jobs and tasks, then joins
+
+// Background work, runs on a worker and never inside waitForJobs
+bool submitTask(TaskFunction function, void* data);
+int getPendingTaskCount(void);
+
+// Short work the caller will wait for, counter may be NULL
+void submitJob(TaskFunction function, void* data, JobCounter* counter);
+// Runs queued jobs until every job submitted against the counter finished
+void waitForJobs(JobCounter* counter);
+
+// Splits [0, count) into ranges of rangeSize items shared by the workers and
+// the calling thread, returns once every range has run
+void parallelFor(int count, int rangeSize, RangeFunction function, void* data);
+
+int getWorkerCount(void);
+// Index the calling thread runs jobs with, see above
+int getJobThreadIndex(void);
+// Threads outside the pool call this before exiting, once their jobs finished
+void releaseJobThreadIndex(void);
+void resetJobSystemStats(void);
+const JobSystemStats* getJobSystemStats(void);
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef THREADING_H
+#define THREADING_H
+
+#include <stdbool.h>
+
+// Thin portable wrappers over pthreads / Win32 threads
+
+#ifdef _WIN32
+    #include <windows.h>
+    typedef struct { HANDLE handle; } Thread;
+    typedef CRITICAL_SECTION Mutex;
+    typedef CONDITION_VARIABLE Condition;
+#else
+    #include <pthread.h>
+    typedef struct { pthread_t handle; } Thread;
+    typedef pthread_mutex_t Mutex;
+    typedef pthread_cond_t Condition;
+#endif
+
+#ifdef _MSC_VER
+    #define THREAD_LOCAL __declspec(thread)
+#else
+    #define THREAD_LOCAL _Thread_local
+#endif
+
+// Lock-free counters and flags, every operation is a full barrier so a
+// store-then-load handshake (sleeper count vs. work count) cannot miss
+#ifdef _WIN32
+    static inline unsigned int atomicLoad(volatile unsigned int* value) {
+        return (unsigned int)InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+    }
+    static inline void atomicStore(volatile unsigned int* value, unsigned int newValue) {
+        InterlockedExchange((volatile LONG*)value, (LONG)newValue);
+    }
+    static inline bool atomicCompareExchange(volatile unsigned int* value, unsigned int expected, unsigned int desired) {
+        return (unsigned int)InterlockedCompareExchange((volatile LONG*)value, (LONG)desired, (LONG)expected) == expected;
+    }
+    static inline unsigned int atomicIncrement(volatile unsigned int* value) {
+        return (unsigned int)InterlockedIncrement((volatile LONG*)value);
+    }
+    static inline unsigned int atomicDecrement(volatile unsigned int* value) {
+        return (unsigned int)InterlockedDecrement((volatile LONG*)value);
+    }
+#else
+    static inline unsigned int atomicLoad(volatile unsigned int* value) {
+        return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+    }
+    static inline void atomicStore(volatile unsigned int* value, unsigned int newValue) {
+        __atomic_store_n(value, newValue, __ATOMIC_SEQ_CST);
+    }
+    static inline bool atomicCompareExchange(volatile unsigned int* value, unsigned int expected, unsigned int desired) {
+        return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    }
+    static inline unsigned int atomicIncrement(volatile unsigned int* value) {
+        return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+    }
+    static inline unsigned int atomicDecrement(volatile unsigned int* value) {
+        return __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST);
+    }
+#endif
+
+typedef void (*ThreadFunction)(void* arg);
+
+bool createThread(Thread* thread, ThreadFunction function, void* arg);
+void joinThread(Thread* thread);
+
+void initMutex(Mutex* mutex);
+void destroyMutex(Mutex* mutex);
+void lockMutex(Mutex* mutex);
+void unlockMutex(Mutex* mutex);
+
+void initCondition(Condition* condition);
+void destroyCondition(Condition* condition);
+void waitCondition(Condition* condition, Mutex* mutex);
+void signalCondition(Condition* condition);
+void broadcastCondition(Condition* condition);
+
+int getProcessorCount(void);
+void sleepSeconds(double seconds);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef UPLOAD_QUEUE_H
+#define UPLOAD_QUEUE_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Streams textures and buffers to the GPU without stalling the render thread.
+// Images are decoded (and 2D textures DXT-compressed with their mip chain) on
+// the thread pool, then copied through a ring of fenced staging buffers (pixel
+// unpack PBOs / copy-read buffers) a bounded amount per frame. Texture ids are handed out immediately and become complete once
+// their data has landed.
+
+#define UPLOAD_BUDGET_MB 8           // Staged bytes per frame
+#define UPLOAD_BUDGET_MS 2.0         // Render thread time per frame
+#define UPLOAD_STAGING_SLOTS 4
+#define UPLOAD_STAGING_SIZE (4 * 1024 * 1024)
+
+typedef void (*TextureReadyCallback)(GLuint texture, bool success, void* user);
+typedef void (*BufferUploadCallback)(void* user);
+
+typedef struct {
+    int pendingDecodes;       // Images still being decoded on workers
+    int pendingUploads;       // Requests waiting for staging space
+    size_t bytesLastFrame;
+    double msLastFrame;
+    int stalledFrames;        // Frames that stopped early on a busy staging slot
+    size_t totalBytes;
+} UploadStats;
+
+void initUploadQueue(void);
+void shutdownUploadQueue(void);
+void processUploads(void);   // Once per frame on the render thread
+void flushUploads(void);     // Blocks until everything queued is resident (loading screen)
+
+GLuint requestTexture2D(const char* path, bool flipY, TextureReadyCallback done, void* user);
+GLuint requestCubemap(const char* faces[6], TextureReadyCallback done, void* user);
+
+// The destination buffer must already have storage. data must stay valid
+// until done is called.
+bool queueBufferUpload(GLuint buffer, const void* data, size_t size, BufferUploadCallback done, void* user);
+
+int getUploadQueueDepth(void);
+const UploadStats* getUploadStats(void);
+
+#endif
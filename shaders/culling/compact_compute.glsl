@@ -0,0 +1,31 @@
+#version 430 core
+
+// Packs the per-primitive commands that ended up with instances to the front
+// and writes how many there are for glMultiDrawElementsIndirectCount.
+
+layout (local_size_x = 1) in;
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    uint baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 1) readonly buffer Commands { DrawCommand commands[]; };
+layout (std430, binding = 3) writeonly buffer CompactedCommands { DrawCommand compacted[]; };
+layout (std430, binding = 4) writeonly buffer DrawCount { uint drawCount; };
+
+uniform uint commandCount;
+
+void main() {
+    uint written = 0u;
+    for (uint i = 0u; i < commandCount; i++) {
+        if (commands[i].instanceCount > 0u) {
+            compacted[written] = commands[i];
+            written++;
+        }
+    }
+    drawCount = written;
+}
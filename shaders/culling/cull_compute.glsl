@@ -0,0 +1,88 @@
+#version 430 core
+
+// One invocation per object: frustum test, then occlusion against last
+// frame's depth pyramid. Visible objects append their instance data to the
+// range of their primitive and bump that primitive's instance count.
+
+layout (local_size_x = 64) in;
+
+struct ObjectRecord {
+    mat4 model;
+    vec4 color;
+    vec4 sphere;    // World-space center and radius
+    uvec4 info;     // x = primitive
+};
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    uint baseVertex;
+    uint baseInstance;
+};
+
+struct Instance {
+    mat4 model;
+    vec4 color;
+};
+
+layout (std430, binding = 0) readonly buffer Objects { ObjectRecord objects[]; };
+layout (std430, binding = 1) buffer Commands { DrawCommand commands[]; };
+layout (std430, binding = 2) writeonly buffer Instances { Instance instances[]; };
+
+uniform uint objectCount;
+uniform vec4 frustumPlanes[6];   // Normalized, inside is positive
+
+uniform bool useOcclusion;
+uniform mat4 previousViewProj;   // The matrix the pyramid was rendered with
+uniform sampler2D depthPyramid;  // Farthest depth per texel, one level per halving
+uniform vec2 pyramidSize;
+uniform int pyramidLevels;
+
+bool isOccluded(vec3 center, float radius) {
+    // Screen rectangle and nearest depth of the sphere's bounding box
+    vec2 minUV = vec2(1.0);
+    vec2 maxUV = vec2(0.0);
+    float nearest = 1.0;
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = previousViewProj * vec4(corner, 1.0);
+        if (clip.w <= 0.0) return false; // Crosses the camera plane
+        vec3 ndc = clip.xyz / clip.w;
+        vec2 uv = ndc.xy * 0.5 + 0.5;
+        minUV = min(minUV, uv);
+        maxUV = max(maxUV, uv);
+        nearest = min(nearest, ndc.z * 0.5 + 0.5);
+    }
+    minUV = clamp(minUV, 0.0, 1.0);
+    maxUV = clamp(maxUV, 0.0, 1.0);
+
+    // The level where the rectangle covers at most 2x2 texels
+    vec2 extent = (maxUV - minUV) * pyramidSize;
+    int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, pyramidLevels - 1);
+    ivec2 levelSize = textureSize(depthPyramid, level);
+    ivec2 low = clamp(ivec2(minUV * vec2(levelSize)), ivec2(0), levelSize - 1);
+    ivec2 high = clamp(ivec2(maxUV * vec2(levelSize)), ivec2(0), levelSize - 1);
+
+    float farthest = max(max(texelFetch(depthPyramid, low, level).r, texelFetch(depthPyramid, ivec2(high.x, low.y), level).r),
+                         max(texelFetch(depthPyramid, ivec2(low.x, high.y), level).r, texelFetch(depthPyramid, high, level).r));
+    return nearest > farthest;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= objectCount) return;
+
+    vec3 center = objects[index].sphere.xyz;
+    float radius = objects[index].sphere.w;
+    for (int p = 0; p < 6; p++) {
+        if (dot(frustumPlanes[p].xyz, center) + frustumPlanes[p].w < -radius) return;
+    }
+    if (useOcclusion && isOccluded(center, radius)) return;
+
+    uint primitive = objects[index].info.x;
+    uint slot = atomicAdd(commands[primitive].instanceCount, 1u);
+    uint target = commands[primitive].baseInstance + slot;
+    instances[target].model = objects[index].model;
+    instances[target].color = objects[index].color;
+}
@@ -0,0 +1,34 @@
+#version 430 core
+
+// Builds one level of the depth pyramid, each texel keeps the farthest depth
+// of the texels it covers. Level 0 reads the copied depth buffer.
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (r32f, binding = 0) uniform writeonly image2D destination;
+uniform sampler2D source;
+uniform int sourceLevel;
+uniform ivec2 destinationSize;
+uniform bool copyLevel;
+
+void main() {
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (texel.x >= destinationSize.x || texel.y >= destinationSize.y) return;
+
+    if (copyLevel) {
+        imageStore(destination, texel, vec4(texelFetch(source, texel, 0).r));
+        return;
+    }
+
+    // Odd sizes fold the extra row and column into the last texel
+    ivec2 sourceSize = textureSize(source, sourceLevel);
+    ivec2 first = texel * 2;
+    ivec2 last = min(first + ivec2(1) + ivec2(equal(texel, destinationSize - 1)) * (sourceSize & 1), sourceSize - 1);
+    float farthest = 0.0;
+    for (int y = first.y; y <= last.y; y++) {
+        for (int x = first.x; x <= last.x; x++) {
+            farthest = max(farthest, texelFetch(source, ivec2(x, y), sourceLevel).r);
+        }
+    }
+    imageStore(destination, texel, vec4(farthest));
+}
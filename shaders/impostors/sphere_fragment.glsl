@@ -0,0 +1,77 @@
+#version 420 core
+
+// The surface is found per pixel, so the depth can only move away from the quad
+layout (depth_greater) out float gl_FragDepth;
+out vec4 FragColor;
+
+in vec3 QuadPos;
+flat in vec4 Sphere;
+flat in vec4 vertexColor;
+flat in mat3 Rotation;
+flat in int MaterialLayer;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+uniform bool useTexture;
+uniform bool useLighting;
+uniform bool noShading;
+uniform bool usePBR;       // Only packed materials reach the impostor path
+uniform sampler2D texture1;
+uniform sampler2DArray albedoArray;
+uniform sampler2DArray normalArray;
+uniform sampler2DArray metallicArray;
+uniform sampler2DArray roughnessArray;
+uniform sampler2DArray aoArray;
+
+#include "../common/lighting.glsl"
+
+const float PI = 3.14159265358979323846;
+
+void main() {
+    // Ray from the eye through this pixel against the sphere, nearest hit
+    vec3 rayDir = normalize(QuadPos - viewPos);
+    vec3 offset = viewPos - Sphere.xyz;
+    float b = dot(offset, rayDir);
+    float c = dot(offset, offset) - Sphere.w * Sphere.w;
+    float h = b * b - c;
+    if (h < 0.0) discard;
+
+    vec3 hit = viewPos + rayDir * (-b - sqrt(h));
+    vec3 normal = (hit - Sphere.xyz) / Sphere.w;
+
+    vec4 clipPos = projection * view * vec4(hit, 1.0);
+    gl_FragDepth = (clipPos.z / clipPos.w) * 0.5 + 0.5;
+
+    // Same mapping as generateSphereVertices: s around the object z axis, t from +z to -z
+    vec3 local = transpose(Rotation) * normal;
+    float u = atan(local.y, local.x) / (2.0 * PI);
+    vec2 texCoord = vec2(fract(u), acos(clamp(local.z, -1.0, 1.0)) / PI);
+    // Gradients from the unwrapped u as well so the seam doesn't drop to the smallest mip
+    vec2 dx = dFdx(texCoord), dy = dFdy(texCoord);
+    dx.x = abs(dx.x) < abs(dFdx(u)) ? dx.x : dFdx(u);
+    dy.x = abs(dy.x) < abs(dFdy(u)) ? dy.x : dFdy(u);
+
+    vec3 viewDir = normalize(viewPos - hit);
+    vec3 baseColor = vertexColor.rgb;
+
+    if (usePBR) {
+        vec3 layerCoord = vec3(texCoord, float(MaterialLayer));
+        baseColor = textureGrad(albedoArray, layerCoord, dx, dy).rgb;
+        vec3 norm = normalize(textureGrad(normalArray, layerCoord, dx, dy).rgb * 2.0 - 1.0);
+        float metallic = textureGrad(metallicArray, layerCoord, dx, dy).r;
+        float roughness = textureGrad(roughnessArray, layerCoord, dx, dy).r;
+        float ao = textureGrad(aoArray, layerCoord, dx, dy).r;
+        FragColor = vec4(calculateLighting(hit, norm, viewDir, baseColor, metallic, roughness, ao), 1.0);
+        return;
+    }
+
+    if (useTexture) {
+        baseColor = textureGrad(texture1, texCoord, dx, dy).rgb;
+    }
+    if (useLighting && !noShading) {
+        FragColor = vec4(calculateLighting(hit, normal, viewDir, baseColor, 0.0, 1.0, 1.0), vertexColor.a);
+    } else {
+        FragColor = vec4(baseColor, vertexColor.a);
+    }
+}
@@ -0,0 +1,42 @@
+#version 420 core
+
+// One camera-facing quad per sphere, expanded from gl_VertexID as a 4 vertex strip
+layout (location = 0) in vec4 aSphere;   // World center and radius
+layout (location = 1) in vec4 aColor;
+layout (location = 2) in mat3 aRotation; // Object to world rotation, locations 2 to 4
+layout (location = 5) in int aMaterialLayer;
+
+out vec3 QuadPos;
+flat out vec4 Sphere;
+flat out vec4 vertexColor;
+flat out mat3 Rotation;
+flat out int MaterialLayer;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+
+void main() {
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+
+    vec3 toEye = viewPos - aSphere.xyz;
+    float eyeDistance = length(toEye);
+    vec3 forward = toEye / eyeDistance;
+    vec3 up = abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 right = normalize(cross(up, forward));
+    up = cross(forward, right);
+
+    // The quad touches the front of the sphere and is just big enough to cover its
+    // silhouette cone, so the real surface is never nearer than the quad
+    float radius = aSphere.w;
+    float frontDistance = eyeDistance - radius;
+    float halfSize = frontDistance * radius / sqrt(max(eyeDistance * eyeDistance - radius * radius, 1e-6));
+    vec3 position = aSphere.xyz + forward * radius + (right * corner.x + up * corner.y) * halfSize;
+
+    QuadPos = position;
+    Sphere = aSphere;
+    vertexColor = aColor;
+    Rotation = aRotation;
+    MaterialLayer = aMaterialLayer;
+    gl_Position = projection * view * vec4(position, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+out vec4 FragColor;
+
+uniform sampler2D frame;       // The finished image
+uniform mat3 rotation;         // Latest view space to the view space it was drawn in
+uniform vec2 projectionScale;  // Projection [0][0] and [1][1]
+uniform vec2 screenSize;
+
+void main() {
+    vec2 ndc = gl_FragCoord.xy / screenSize * 2.0 - 1.0;
+    vec3 direction = rotation * vec3(ndc / projectionScale, -1.0);
+    // Behind the old camera, the frame has nothing to show
+    if (direction.z >= 0.0) {
+        FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    vec2 rendered = direction.xy * projectionScale / -direction.z;
+    // Edges the old frame didn't cover repeat its border
+    FragColor = vec4(texture(frame, clamp(rendered * 0.5 + 0.5, 0.0, 1.0)).rgb, 1.0);
+}
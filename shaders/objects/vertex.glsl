@@ -3,22 +3,30 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
 layout (location = 2) in vec3 aNormal;
+layout (location = 3) in int aMaterialLayer; // Constant per draw, or per instance when batched
+layout (location = 4) in vec4 aColor;        // Static batches bake the object color per vertex, instanced draws per instance
+layout (location = 5) in mat4 aInstanceModel; // Instanced draws: GPU-culled ones from the culling compute shader, merged ones from the command lists
 
 out vec3 FragPos;  
 out vec2 TexCoord;  
 out vec3 Normal;   
 out vec4 vertexColor;  
+flat out int MaterialLayer;
 
 uniform mat4 model;       
 uniform mat4 view;        
 uniform mat4 projection;  
 uniform vec4 inputColor;  
+uniform bool useVertexColor;
+uniform bool useInstanceData;
 
 void main() {
-    vec4 worldPosition = model * vec4(aPos, 1.0);
+    mat4 modelMatrix = useInstanceData ? aInstanceModel : model;
+    vec4 worldPosition = modelMatrix * vec4(aPos, 1.0);
     FragPos = vec3(worldPosition);  
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    Normal = mat3(transpose(inverse(modelMatrix))) * aNormal;  
     TexCoord = aTexCoord;
-    vertexColor = inputColor;  
+    vertexColor = (useVertexColor || useInstanceData) ? aColor : inputColor;
+    MaterialLayer = aMaterialLayer;
     gl_Position = projection * view * worldPosition;  
 }
@@ -0,0 +1,20 @@
+#version 330 core
+
+out vec4 FragColor;
+
+uniform sampler2D accumulation; // Sum of weighted premultiplied color, weighted alpha in a
+uniform sampler2D revealage;    // Product of (1 - alpha) over every transparent fragment
+
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    float reveal = texelFetch(revealage, coord, 0).r;
+    if (reveal >= 1.0) discard; // Nothing transparent covers this pixel
+
+    vec4 accum = texelFetch(accumulation, coord, 0);
+    // Half floats can overflow with many bright layers
+    if (isinf(max(max(abs(accum.r), abs(accum.g)), abs(accum.b)))) {
+        accum.rgb = vec3(accum.a);
+    }
+    vec3 averageColor = accum.rgb / max(accum.a, 1e-5);
+    FragColor = vec4(averageColor, 1.0 - reveal);
+}
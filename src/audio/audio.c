@@ -1,4 +1,5 @@
 #include "audio.h"
+#include "log.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -400,6 +401,65 @@ void resumeAllSounds() {
     }
 }
 
+// Emitters visited only when their transform or settings changed, OpenAL
+// keeps the position of a playing source
+static void updateEmitterChunk(const ChunkView* view, void* data, int workerIndex) {
+    (void)data;
+    (void)workerIndex;
+    const Transform* transforms = getChunkColumn(view, COMPONENT_TRANSFORM);
+    AudioEmitter* emitters = getChunkColumn(view, COMPONENT_AUDIO_EMITTER);
+
+    for (int i = 0; i < view->count; i++) {
+        AudioEmitter* emitter = &emitters[i];
+        const float* origin = transforms[i].world.data[3];
+        Vector3 position = vector(origin[0], origin[1], origin[2]);
+        if (!isSourceValid(emitter->sourceIndex)) {
+            emitter->sourceIndex = -1;
+            if (!emitter->autoplay || emitter->clip[0] == '\0') continue;
+
+            int bufferIndex = loadAudioBuffer(emitter->clip);
+            int sourceIndex = bufferIndex >= 0 ? createAudioSource() : -1;
+            if (sourceIndex < 0) {
+                LOG_WARN(LOG_AUDIO, "Failed to start audio emitter: %s", emitter->clip);
+                emitter->autoplay = false;
+                continue;
+            }
+            setSource3D(sourceIndex, true);
+            setSourcePosition(sourceIndex, &position);
+            setSourceLooping(sourceIndex, emitter->looping);
+            setSourceVolume(sourceIndex, emitter->volume);
+            setSourcePitch(sourceIndex, emitter->pitch);
+            playSoundSource(sourceIndex, bufferIndex);
+            emitter->sourceIndex = sourceIndex;
+            continue;
+        }
+
+        setSourcePosition(emitter->sourceIndex, &position);
+        setSourceLooping(emitter->sourceIndex, emitter->looping);
+        setSourceVolume(emitter->sourceIndex, emitter->volume);
+        setSourcePitch(emitter->sourceIndex, emitter->pitch);
+    }
+}
+
+void updateAudioEmitters(void) {
+    // Changes wait for the device, emitters start once it is up
+    if (!audioSystem || !audioSystem->isInitialized) return;
+
+    static unsigned int lastRun = 0;
+    ComponentMask components = COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_AUDIO_EMITTER);
+    EntityQuery query = { components, 0, components, 0 };
+    query.changedSince = beginSystemRun(&lastRun);
+    forEachChunk(&query, updateEmitterChunk, NULL);
+}
+
+void releaseAudioEmitter(EntityId entity) {
+    const AudioEmitter* emitter = getComponent(entity, COMPONENT_AUDIO_EMITTER);
+    if (emitter && isSourceValid(emitter->sourceIndex)) {
+        alSourceStop(audioSystem->sources[emitter->sourceIndex]->source);
+        destroyAudioSource(emitter->sourceIndex);
+    }
+}
+
 // Helper function for case-insensitive string comparison
 int strcasecmp(const char *s1, const char *s2) {
     while (*s1 && *s2) {
@@ -4,8 +4,11 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "Vectors.h"
 #include "Camera.h"
+#include "gl_state.h"
+#include "log.h"
 
 #define PI 3.14159265358979323846
 
@@ -78,7 +81,7 @@ Cube createCube(Vector3 position, Vector4 color, float size) {
     generateCubeVertices(vertices, indices, size);
 
     glGenVertexArrays(1, &cube.vao);
-    glBindVertexArray(cube.vao);
+    stateBindVertexArray(cube.vao);
 
     glGenBuffers(1, &cube.vbo);
     glBindBuffer(GL_ARRAY_BUFFER, cube.vbo);
@@ -96,7 +99,7 @@ Cube createCube(Vector3 position, Vector4 color, float size) {
     glEnableVertexAttribArray(1);
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    stateBindVertexArray(0);
 
     free(vertices);
     free(indices);
@@ -108,7 +111,7 @@ Cube createCube(Vector3 position, Vector4 color, float size) {
 
 
 void drawCube(const Cube* cube, Matrix4x4 viewMatrix, Matrix4x4 projMatrix) {
-    glUseProgram(shaderProgram);
+    stateUseProgram(shaderProgram);
 
     int modelLoc = glGetUniformLocation(shaderProgram, "model");
     int viewLoc = glGetUniformLocation(shaderProgram, "view");
@@ -126,15 +129,15 @@ void drawCube(const Cube* cube, Matrix4x4 viewMatrix, Matrix4x4 projMatrix) {
 
 
 
-    glBindVertexArray(cube->vao);
+    stateBindVertexArray(cube->vao);
     glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    stateBindVertexArray(0);
 }
 
 
 
 void destroyCube(Cube* cube) {
-    glDeleteVertexArrays(1, &cube->vao);
+    stateDeleteVertexArrays(1, &cube->vao);
     glDeleteBuffers(1, &cube->vbo);
     glDeleteBuffers(1, &cube->ebo);
 }
@@ -211,20 +214,20 @@ Sphere createSphere(float radius, int sectorCount, int stackCount, Vector3 posit
     int vertexCount = (stackCount + 1) * (sectorCount + 1);
     // 3 for position, 3 for normal, 2 for texture
     int numVertices = vertexCount * 8;
-    int indexCount = stackCount * sectorCount * 6;
+    int indexCount = (stackCount - 1) * sectorCount * 6; // The poles emit one triangle per sector
 
     float* vertices = (float*)malloc(numVertices * sizeof(float));
     unsigned int* indices = (unsigned int*)malloc(indexCount * sizeof(unsigned int));
 
     if (!vertices || !indices) {
-        fprintf(stderr, "Failed to allocate memory for sphere.\n");
+        LOG_ERROR(LOG_SCENE, "Failed to allocate memory for sphere.");
         exit(EXIT_FAILURE);
     }
 
     // Call the function to generate the vertices and indices for the sphere
     generateSphereVertices(vertices, indices, radius, sectorCount, stackCount);
     glGenVertexArrays(1, &sphere.vao);
-    glBindVertexArray(sphere.vao);
+    stateBindVertexArray(sphere.vao);
 
     glGenBuffers(1, &sphere.vbo);
     glBindBuffer(GL_ARRAY_BUFFER, sphere.vbo);
@@ -241,7 +244,7 @@ Sphere createSphere(float radius, int sectorCount, int stackCount, Vector3 posit
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
 
-    glBindVertexArray(0);
+    stateBindVertexArray(0);
 
     free(vertices);
     free(indices);
@@ -258,7 +261,7 @@ Sphere createSphere(float radius, int sectorCount, int stackCount, Vector3 posit
 
 // Function to draw a sphere
 void drawSphere(const Sphere* sphere, Matrix4x4 viewMatrix, Matrix4x4 projMatrix) {
-    glUseProgram(shaderProgram);
+    stateUseProgram(shaderProgram);
 
     int modelLoc = glGetUniformLocation(shaderProgram, "model");
     int viewLoc = glGetUniformLocation(shaderProgram, "view");
@@ -274,13 +277,13 @@ void drawSphere(const Sphere* sphere, Matrix4x4 viewMatrix, Matrix4x4 projMatrix
     GLint colorLoc = glGetUniformLocation(shaderProgram, "inputColor");
     glUniform4f(colorLoc, sphere->color.x, sphere->color.y, sphere->color.z, sphere->color.w);
 
-    glBindVertexArray(sphere->vao);
+    stateBindVertexArray(sphere->vao);
     glDrawElements(GL_TRIANGLES, sphere->numIndices, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    stateBindVertexArray(0);
 }
 
 void destroySphere(Sphere* sphere) {
-    glDeleteVertexArrays(1, &sphere->vao);
+    stateDeleteVertexArrays(1, &sphere->vao);
     glDeleteBuffers(1, &sphere->vbo);
     glDeleteBuffers(1, &sphere->ebo);
 }
@@ -341,7 +344,7 @@ Pyramid createPyramid(Vector3 position, Vector4 color, float baseSize, float hei
     generatePyramidVertices(vertices, indices, baseSize, height);
 
     glGenVertexArrays(1, &pyramid.vao);
-    glBindVertexArray(pyramid.vao);
+    stateBindVertexArray(pyramid.vao);
 
     glGenBuffers(1, &pyramid.vbo);
     glBindBuffer(GL_ARRAY_BUFFER, pyramid.vbo);
@@ -359,7 +362,7 @@ Pyramid createPyramid(Vector3 position, Vector4 color, float baseSize, float hei
     glEnableVertexAttribArray(1);
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    stateBindVertexArray(0);
 
     free(vertices);
     free(indices);
@@ -371,7 +374,7 @@ Pyramid createPyramid(Vector3 position, Vector4 color, float baseSize, float hei
 
 // Function to draw a pyramid
 void drawPyramid(const Pyramid* pyramid, Matrix4x4 viewMatrix, Matrix4x4 projMatrix) {
-    glUseProgram(shaderProgram);
+    stateUseProgram(shaderProgram);
 
     int modelLoc = glGetUniformLocation(shaderProgram, "model");
     int viewLoc = glGetUniformLocation(shaderProgram, "view");
@@ -393,14 +396,14 @@ void drawPyramid(const Pyramid* pyramid, Matrix4x4 viewMatrix, Matrix4x4 projMat
     GLint colorLoc = glGetUniformLocation(shaderProgram, "inputColor");
     glUniform4f(colorLoc, pyramid->color.x, pyramid->color.y, pyramid->color.z, pyramid->color.w);
 
-    glBindVertexArray(pyramid->vao);
+    stateBindVertexArray(pyramid->vao);
     glDrawElements(GL_TRIANGLES, 18, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    stateBindVertexArray(0);
 }
 
 
 void destroyPyramid(Pyramid* pyramid) {
-    glDeleteVertexArrays(1, &pyramid->vao);
+    stateDeleteVertexArrays(1, &pyramid->vao);
     glDeleteBuffers(1, &pyramid->vbo);
     glDeleteBuffers(1, &pyramid->ebo);
 
@@ -490,14 +493,14 @@ Cylinder createCylinder(float radius, float height, int sectorCount, Vector3 pos
     unsigned int* indices = (unsigned int*)malloc(indexCount * sizeof(unsigned int));
 
     if (!vertices || !indices) {
-        fprintf(stderr, "Failed to allocate memory for cylinder.\n");
+        LOG_ERROR(LOG_SCENE, "Failed to allocate memory for cylinder.");
         exit(EXIT_FAILURE);
     }
 
     generateCylinderVertices(vertices, indices, radius, height, sectorCount);
 
     glGenVertexArrays(1, &cylinder.vao);
-    glBindVertexArray(cylinder.vao);
+    stateBindVertexArray(cylinder.vao);
 
     glGenBuffers(1, &cylinder.vbo);
     glBindBuffer(GL_ARRAY_BUFFER, cylinder.vbo);
@@ -512,7 +515,7 @@ Cylinder createCylinder(float radius, float height, int sectorCount, Vector3 pos
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
 
-    glBindVertexArray(0);
+    stateBindVertexArray(0);
 
     // Cleanup
     free(vertices);
@@ -528,7 +531,7 @@ Cylinder createCylinder(float radius, float height, int sectorCount, Vector3 pos
 }
 
 void drawCylinder(const Cylinder* cylinder, Matrix4x4 viewMatrix, Matrix4x4 projMatrix) {
-    glUseProgram(shaderProgram);
+    stateUseProgram(shaderProgram);
 
     int modelLoc = glGetUniformLocation(shaderProgram, "model");
     int viewLoc = glGetUniformLocation(shaderProgram, "view");
@@ -544,37 +547,45 @@ void drawCylinder(const Cylinder* cylinder, Matrix4x4 viewMatrix, Matrix4x4 proj
     GLint colorLoc = glGetUniformLocation(shaderProgram, "inputColor");
     glUniform4f(colorLoc, cylinder->color.x, cylinder->color.y, cylinder->color.z, cylinder->color.w);
 
-    glBindVertexArray(cylinder->vao);
+    stateBindVertexArray(cylinder->vao);
     glDrawElements(GL_TRIANGLES, cylinder->sectorCount * 12, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    stateBindVertexArray(0);
 }
 
 void destroyCylinder(Cylinder* cylinder) {
-    glDeleteVertexArrays(1, &cylinder->vao);
+    stateDeleteVertexArrays(1, &cylinder->vao);
     glDeleteBuffers(1, &cylinder->vbo);
     glDeleteBuffers(1, &cylinder->ebo);
 }
 
 // PLANE 
 
-Plane createPlane(Vector3 position, Vector4 color) {
-    Plane plane;
+void generatePlaneVertices(float* vertices, unsigned int* indices) {
     float halfWidth = 150.0f;
     float halfHeight = 150.0f;
-    float vertices[] = {
+    const float planeVertices[] = {
         // Position                // Texture Coords
         -halfWidth, 0.0f,  halfHeight,  0.0f, 1.0f, // Top-left
          halfWidth, 0.0f,  halfHeight,  1.0f, 1.0f, // Top-right
          halfWidth, 0.0f, -halfHeight,  1.0f, 0.0f, // Bottom-right
         -halfWidth, 0.0f, -halfHeight,  0.0f, 0.0f  // Bottom-left
     };
-    unsigned int indices[] = {
+    const unsigned int planeIndices[] = {
         0, 1, 2, // First Triangle
         0, 2, 3  // Second Triangle
     };
+    memcpy(vertices, planeVertices, sizeof(planeVertices));
+    memcpy(indices, planeIndices, sizeof(planeIndices));
+}
+
+Plane createPlane(Vector3 position, Vector4 color) {
+    Plane plane;
+    float vertices[4 * 5];
+    unsigned int indices[6];
+    generatePlaneVertices(vertices, indices);
 
     glGenVertexArrays(1, &plane.vao);
-    glBindVertexArray(plane.vao);
+    stateBindVertexArray(plane.vao);
 
     glGenBuffers(1, &plane.vbo);
     glBindBuffer(GL_ARRAY_BUFFER, plane.vbo);
@@ -590,7 +601,7 @@ Plane createPlane(Vector3 position, Vector4 color) {
     glEnableVertexAttribArray(1);
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    stateBindVertexArray(0);
 
     plane.position = position;
     plane.color = color;
@@ -598,7 +609,7 @@ Plane createPlane(Vector3 position, Vector4 color) {
 }
 
 void drawPlane(const Plane* plane, Matrix4x4 viewMatrix, Matrix4x4 projMatrix) {
-    glUseProgram(shaderProgram);
+    stateUseProgram(shaderProgram);
 
     int modelLoc = glGetUniformLocation(shaderProgram, "model");
     int viewLoc = glGetUniformLocation(shaderProgram, "view");
@@ -614,13 +625,13 @@ void drawPlane(const Plane* plane, Matrix4x4 viewMatrix, Matrix4x4 projMatrix) {
     GLint colorLoc = glGetUniformLocation(shaderProgram, "inputColor");
     glUniform4f(colorLoc, plane->color.x, plane->color.y, plane->color.z, plane->color.w);
 
-    glBindVertexArray(plane->vao);
+    stateBindVertexArray(plane->vao);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    stateBindVertexArray(0);
 }
 
 void destroyPlane(Plane* plane) {
-    glDeleteVertexArrays(1, &plane->vao);
+    stateDeleteVertexArrays(1, &plane->vao);
     glDeleteBuffers(1, &plane->vbo);
     glDeleteBuffers(1, &plane->ebo);
 }
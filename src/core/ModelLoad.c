@@ -1,83 +1,342 @@
 #include "ModelLoad.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "meshlet.h"
+#include "gl_state.h"
+#include "log.h"
+#include <stddef.h>
+#include <string.h>
 
-Mesh processMesh(struct aiMesh* mesh, const struct aiScene* scene) {
+// Simplification error allowed per level, relative to the mesh extent
+static const float lodTargetErrors[MAX_LOD_LEVELS] = { 0.0f, 0.02f, 0.05f, 0.15f };
+
+// Flattens an assimp mesh into optimized, quantized upload-ready blobs
+static bool buildMeshData(const struct aiMesh* mesh, MeshData* data) {
+    memset(data, 0, sizeof(*data));
+    if (mesh->mNumVertices == 0 || mesh->mNumFaces == 0) return false;
+
+    PackedVertex* vertices = malloc(mesh->mNumVertices * sizeof(PackedVertex));
+    unsigned int* indices = malloc(mesh->mNumFaces * 3 * sizeof(unsigned int));
+    if (!vertices || !indices) {
+        LOG_ERROR(LOG_ASSETS, "Failed to allocate memory for mesh data.");
+        free(vertices);
+        free(indices);
+        return false;
+    }
+
+    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+        PackedVertex* v = &vertices[i];
+        v->position[0] = mesh->mVertices[i].x;
+        v->position[1] = mesh->mVertices[i].y;
+        v->position[2] = mesh->mVertices[i].z;
+
+        struct aiVector3D n = mesh->mNormals ? mesh->mNormals[i] : (struct aiVector3D){ 0.0f, 1.0f, 0.0f };
+        v->normal[0] = floatToSnorm8(n.x);
+        v->normal[1] = floatToSnorm8(n.y);
+        v->normal[2] = floatToSnorm8(n.z);
+        v->normal[3] = 0;
+
+        float u = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][i].x : 0.0f;
+        float t = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][i].y : 0.0f;
+        v->texCoords[0] = floatToHalf(u);
+        v->texCoords[1] = floatToHalf(t);
+    }
+
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+        // Triangulate leaves points and lines alone, skip them
+        if (mesh->mFaces[i].mNumIndices != 3) continue;
+        indices[count++] = mesh->mFaces[i].mIndices[0];
+        indices[count++] = mesh->mFaces[i].mIndices[1];
+        indices[count++] = mesh->mFaces[i].mIndices[2];
+    }
+    if (count == 0) {
+        // Only points or lines, nothing to draw or simplify
+        free(vertices);
+        free(indices);
+        return false;
+    }
+
+    // Weld after quantization so nearly identical corners collapse too
+    unsigned int vertexCount = weldVertices(vertices, mesh->mNumVertices, sizeof(PackedVertex), indices, count);
+    optimizeVertexCache(indices, count, vertexCount);
+    optimizeOverdraw(indices, count, vertices[0].position, sizeof(PackedVertex), vertexCount);
+    vertexCount = optimizeVertexFetch(vertices, vertexCount, sizeof(PackedVertex), indices, count);
+
+    data->vertices = vertices;
+    data->numVertices = vertexCount;
+    data->vertexStride = sizeof(PackedVertex);
+    data->indexType = GL_UNSIGNED_INT;
+    data->lodCount = 1;
+    data->lodIndexCount[0] = count;
+
+    // Clusters for culling, built before the coarser levels are appended
+    Meshlet* meshlets = malloc((size_t)(count / 3) * sizeof(Meshlet));
+    if (meshlets) {
+        data->meshletCount = buildMeshlets(meshlets, indices, count, vertices[0].position, sizeof(PackedVertex), vertexCount);
+        Meshlet* shrunk = data->meshletCount ? realloc(meshlets, data->meshletCount * sizeof(Meshlet)) : NULL;
+        if (!shrunk) {
+            free(meshlets);
+            data->meshletCount = 0;
+        }
+        data->meshlets = shrunk;
+    }
+
+    // A level keeps at most 3/4 of the previous one, so every level fits in three times the base count
+    unsigned int totalIndices = count;
+    unsigned int* grown = realloc(indices, (size_t)count * 3 * sizeof(unsigned int));
+    if (grown) {
+        indices = grown;
+        for (unsigned int level = 1; level < MAX_LOD_LEVELS; level++) {
+            unsigned int previousCount = data->lodIndexCount[level - 1];
+            unsigned int* previous = indices + totalIndices - previousCount;
+            unsigned int* simplified = indices + totalIndices;
+
+            unsigned int lodCount = simplifyMesh(simplified, previous, previousCount, vertices[0].position, sizeof(PackedVertex),
+                                                 vertexCount, previousCount / 6 * 3, lodTargetErrors[level]);
+            // Not worth a level when the error budget stops it early
+            if (lodCount == 0 || lodCount > previousCount * 3 / 4) break;
+
+            optimizeVertexCache(simplified, lodCount, vertexCount);
+            data->lodIndexCount[data->lodCount++] = lodCount;
+            totalIndices += lodCount;
+        }
+    }
+    data->indices = indices;
+    data->numIndices = totalIndices;
+
+    // Narrow to 16-bit indices in place when every vertex is addressable
+    if (vertexCount <= 0xffff) {
+        unsigned short* shortIndices = (unsigned short*)indices;
+        for (unsigned int i = 0; i < totalIndices; i++) shortIndices[i] = (unsigned short)indices[i];
+        data->indexType = GL_UNSIGNED_SHORT;
+    }
+
+    LOG_DEBUG(LOG_ASSETS, "Optimized mesh: %u -> %u vertices, %u triangles in %u meshlets, %u LODs down to %u triangles, %s indices",
+           mesh->mNumVertices, vertexCount, count / 3, data->meshletCount, data->lodCount,
+           data->lodIndexCount[data->lodCount - 1] / 3, data->indexType == GL_UNSIGNED_SHORT ? "16-bit" : "32-bit");
+    return true;
+}
+
+static void freeMeshData(MeshData* data) {
+    free((void*)data->vertices);
+    free((void*)data->indices);
+    free((void*)data->meshlets);
+    data->vertices = NULL;
+    data->indices = NULL;
+    data->meshlets = NULL;
+}
+
+// Creates the VAO and buffer storage for a mesh without filling it, so the
+// data can be streamed in later through the upload queue
+Mesh allocateMeshBuffers(const MeshData* data) {
     Mesh newMesh = { 0 };
-    if (!mesh) return newMesh;
+    if (!data || !data->vertices || !data->indices) return newMesh;
 
     glGenVertexArrays(1, &newMesh.VAO);
     glGenBuffers(1, &newMesh.VBO);
     glGenBuffers(1, &newMesh.EBO);
 
-    glBindVertexArray(newMesh.VAO);
+    stateBindVertexArray(newMesh.VAO);
 
     // Vertices
     glBindBuffer(GL_ARRAY_BUFFER, newMesh.VBO);
-    glBufferData(GL_ARRAY_BUFFER, mesh->mNumVertices * sizeof(struct aiVector3D), mesh->mVertices, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, getMeshVertexBytes(data), NULL, GL_STATIC_DRAW);
 
     // Indices
-    newMesh.indices = malloc(mesh->mNumFaces * 3 * sizeof(unsigned int));
-    if (!newMesh.indices) {
-        fprintf(stderr, "Failed to allocate memory for indices.\n");
-        glDeleteVertexArrays(1, &newMesh.VAO);
-        glDeleteBuffers(1, &newMesh.VBO);
-        glDeleteBuffers(1, &newMesh.EBO);
-        return newMesh;
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, newMesh.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, getMeshIndexBytes(data), NULL, GL_STATIC_DRAW);
+
+    // Matches the object shader: 0 = position, 1 = texcoord, 2 = normal
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, data->vertexStride, (void*)offsetof(PackedVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, data->vertexStride, (void*)offsetof(PackedVertex, texCoords));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 3, GL_BYTE, GL_TRUE, data->vertexStride, (void*)offsetof(PackedVertex, normal));
+    glEnableVertexAttribArray(2);
+
+    stateBindVertexArray(0);  // Unbind VAO
+
+    newMesh.numVertices = data->numVertices;
+    newMesh.indexType = data->indexType;
+
+    size_t indexSize = data->indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    size_t offset = 0;
+    newMesh.lodCount = data->lodCount;
+    for (unsigned int level = 0; level < data->lodCount; level++) {
+        newMesh.lodIndexCount[level] = data->lodIndexCount[level];
+        newMesh.lodIndexOffset[level] = offset;
+        offset += data->lodIndexCount[level] * indexSize;
     }
-    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-        for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++) {
-            newMesh.indices[i * mesh->mFaces[i].mNumIndices + j] = mesh->mFaces[i].mIndices[j];
+    newMesh.numIndices = data->lodIndexCount[0];
+
+    // The import blobs go away after upload, keep a copy of the clusters for culling
+    if (data->meshletCount > 0) {
+        newMesh.meshlets = (Meshlet*)malloc(data->meshletCount * sizeof(Meshlet));
+        if (newMesh.meshlets) {
+            memcpy(newMesh.meshlets, data->meshlets, data->meshletCount * sizeof(Meshlet));
+            newMesh.meshletCount = data->meshletCount;
+            newMesh.meshletCullData = createMeshletCullData(newMesh.meshlets, newMesh.meshletCount);
         }
     }
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, newMesh.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->mNumFaces * 3 * sizeof(unsigned int), newMesh.indices, GL_STATIC_DRAW);
+    return newMesh;
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(struct aiVector3D), (void*)0);
-    glEnableVertexAttribArray(0);
+Mesh uploadMeshData(const MeshData* data) {
+    Mesh newMesh = allocateMeshBuffers(data);
+    if (!newMesh.VAO) return newMesh;
 
-    glBindVertexArray(0);  // Unbind VAO
+    glBindBuffer(GL_ARRAY_BUFFER, newMesh.VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, getMeshVertexBytes(data), data->vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    newMesh.numVertices = mesh->mNumVertices;
-    newMesh.numIndices = mesh->mNumFaces * 3;
+    stateBindVertexArray(newMesh.VAO);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, getMeshIndexBytes(data), data->indices);
+    stateBindVertexArray(0);
     return newMesh;
 }
 
+size_t getMeshVertexBytes(const MeshData* data) {
+    return (size_t)data->numVertices * data->vertexStride;
+}
 
-Model* loadModel(const char* path) {
-    const struct aiScene* scene = aiImportFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
-    if (!scene) {
-        fprintf(stderr, "Failed to load model: %s\n", aiGetErrorString());
-        return NULL;
-    }
+size_t getMeshIndexBytes(const MeshData* data) {
+    return (size_t)data->numIndices * (data->indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int));
+}
 
-    if (scene->mNumMeshes == 0) {
-        fprintf(stderr, "No meshes found in the model.\n");
-        aiReleaseImport(scene);
-        return NULL;
-    }
+Mesh processMesh(struct aiMesh* mesh, const struct aiScene* scene) {
+    (void)scene;
+    Mesh newMesh = { 0 };
+    if (!mesh) return newMesh;
+
+    MeshData data;
+    if (!buildMeshData(mesh, &data)) return newMesh;
 
+    newMesh = uploadMeshData(&data);
+    freeMeshData(&data);
+    return newMesh;
+}
+
+Model* createModel(const char* path, unsigned int meshCount) {
     Model* model = (Model*)malloc(sizeof(Model));
     if (!model) {
-        fprintf(stderr, "Failed to allocate memory for the model.\n");
-        aiReleaseImport(scene);
+        LOG_ERROR(LOG_ASSETS, "Failed to allocate memory for the model.");
         return NULL;
     }
 
     strncpy(model->path, path, sizeof(model->path) - 1);
     model->path[sizeof(model->path) - 1] = '\0';
-    model->meshCount = scene->mNumMeshes;
-    model->meshes = (Mesh*)malloc(model->meshCount * sizeof(Mesh));
+    model->meshCount = meshCount;
+    model->meshes = (Mesh*)calloc(meshCount, sizeof(Mesh));
     if (!model->meshes) {
-        fprintf(stderr, "Failed to allocate memory for meshes.\n");
-        aiReleaseImport(scene);
+        LOG_ERROR(LOG_ASSETS, "Failed to allocate memory for meshes.");
         free(model);
         return NULL;
     }
+    return model;
+}
 
-    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
-        model->meshes[i] = processMesh(scene->mMeshes[i], scene);
+// CPU half of an import: map the mesh cache or parse and optimize the source.
+// Touches no GL state, so it can run on a worker thread.
+bool importModelData(const char* path, uint64_t contentHash, const struct aiPropertyStore* properties, ImportedModel* out) {
+    memset(out, 0, sizeof(*out));
+
+    // Use the binary cache when it was built from this exact file
+    if (mapMeshCache(path, contentHash, out)) return true;
+
+    const unsigned int flags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals;
+    const struct aiScene* scene = properties
+        ? aiImportFileExWithProperties(path, flags, NULL, properties)
+        : aiImportFile(path, flags);
+    if (!scene) {
+        LOG_ERROR(LOG_ASSETS, "Failed to load model: %s", aiGetErrorString());
+        return false;
+    }
+
+    if (scene->mNumMeshes == 0) {
+        LOG_ERROR(LOG_ASSETS, "No meshes found in the model.");
+        aiReleaseImport(scene);
+        return false;
+    }
+
+    out->meshes = (MeshData*)calloc(scene->mNumMeshes, sizeof(MeshData));
+    if (!out->meshes) {
+        LOG_ERROR(LOG_ASSETS, "Failed to allocate memory for meshes.");
+        aiReleaseImport(scene);
+        return false;
     }
+    out->meshCount = scene->mNumMeshes;
 
+    bool complete = true;
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        if (!buildMeshData(scene->mMeshes[i], &out->meshes[i])) complete = false;
+    }
     aiReleaseImport(scene);
+
+    if (complete) {
+        writeMeshCache(path, contentHash, out->meshes, out->meshCount);
+    }
+    return true;
+}
+
+void releaseImportedModel(ImportedModel* imported) {
+    if (imported->cacheFile) {
+        // Blobs point into the mapping, only the table was allocated
+        unmapFile(imported->cacheFile);
+        free(imported->cacheFile);
+    } else {
+        for (unsigned int i = 0; i < imported->meshCount; i++) {
+            freeMeshData(&imported->meshes[i]);
+        }
+    }
+    free(imported->meshes);
+    memset(imported, 0, sizeof(*imported));
+}
+
+void computeModelBounds(const ImportedModel* imported, Model* model) {
+    float minBound[3] = { 0.0f, 0.0f, 0.0f };
+    float maxBound[3] = { 0.0f, 0.0f, 0.0f };
+    bool first = true;
+
+    for (unsigned int i = 0; i < imported->meshCount; i++) {
+        const MeshData* data = &imported->meshes[i];
+        const PackedVertex* vertices = (const PackedVertex*)data->vertices;
+        for (unsigned int v = 0; vertices && v < data->numVertices; v++) {
+            for (int k = 0; k < 3; k++) {
+                float p = vertices[v].position[k];
+                if (first || p < minBound[k]) minBound[k] = p;
+                if (first || p > maxBound[k]) maxBound[k] = p;
+            }
+            first = false;
+        }
+    }
+
+    model->boundsCenter = vector((minBound[0] + maxBound[0]) * 0.5f, (minBound[1] + maxBound[1]) * 0.5f, (minBound[2] + maxBound[2]) * 0.5f);
+    model->boundsRadius = vector_length(vector(maxBound[0] - minBound[0], maxBound[1] - minBound[1], maxBound[2] - minBound[2])) * 0.5f;
+}
+
+Model* loadModel(const char* path) {
+    uint64_t contentHash = 0;
+    if (!hashFile(path, &contentHash)) {
+        LOG_ERROR(LOG_ASSETS, "Failed to read model file: %s", path);
+        return NULL;
+    }
+    return loadModelWithHash(path, contentHash);
+}
+
+Model* loadModelWithHash(const char* path, uint64_t contentHash) {
+    ImportedModel imported;
+    if (!importModelData(path, contentHash, NULL, &imported)) return NULL;
+
+    Model* model = createModel(path, imported.meshCount);
+    if (model) {
+        for (unsigned int i = 0; i < imported.meshCount; i++) {
+            model->meshes[i] = uploadMeshData(&imported.meshes[i]);
+        }
+        computeModelBounds(&imported, model);
+    }
+
+    releaseImportedModel(&imported);
     return model;
 }
 
@@ -89,7 +348,7 @@ void freeModel(Model* model) {
         Mesh* mesh = &model->meshes[i];
 
         if (mesh->VAO) {
-            glDeleteVertexArrays(1, &mesh->VAO);
+            stateDeleteVertexArrays(1, &mesh->VAO);
             mesh->VAO = 0;
         }
         if (mesh->VBO) {
@@ -104,6 +363,11 @@ void freeModel(Model* model) {
             free(mesh->indices);
             mesh->indices = NULL;
         }
+        free(mesh->meshlets);
+        free(mesh->meshletCullData);
+        mesh->meshlets = NULL;
+        mesh->meshletCullData = NULL;
+        mesh->meshletCount = 0;
     }
 
     if (model->meshes) {
@@ -111,4 +375,3 @@ void freeModel(Model* model) {
         model->meshes = NULL;
     }
 }
-
@@ -11,214 +11,586 @@
 #include "gui.h"
 #include "SceneObject.h"
 #include "Object3D.h"
+#include "model_registry.h"
+#include "static_batch.h"
+#include "lod.h"
+#include "meshlet.h"
+#include "gl_state.h"
+#include "thread_pool.h"
+#include "ecs.h"
+#include "scene_graph.h"
+#include "log.h"
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef AUDIO_ENABLED
+#include "audio.h"
+#endif
 
 ObjectManager objectManager;
 
+#define OBJECT_COLUMN_RANGE 256  // Objects per parallelFor range in updateObjectColumns
+
 void initObjectManager() {
-    objectManager.count = 0;
-    objectManager.capacity = MAX_OBJECTS;
-    for (int i = 0; i < MAX_OBJECTS; i++) {
-        objectManager.objects[i].id = -1; // Initialize object IDs to -1 to indicate they are not used
+    memset(&objectManager, 0, sizeof(objectManager));
+    objectManager.freeSlot = -1;
+}
+
+static bool growColumn(void** column, int capacity, size_t elementSize) {
+    void* grown = realloc(*column, (size_t)capacity * elementSize);
+    if (!grown) return false;
+    *column = grown;
+    return true;
+}
+
+// Every column is grown before capacity changes, one failing leaves the rest larger but valid
+static bool reserveObjects(int count) {
+    if (count <= objectManager.capacity) return true;
+
+    int capacity = objectManager.capacity ? objectManager.capacity : OBJECT_MANAGER_INITIAL_CAPACITY;
+    while (capacity < count) capacity *= 2;
+    if (!growColumn((void**)&objectManager.objects, capacity, sizeof(SceneObject)) ||
+        !growColumn((void**)&objectManager.modelMatrices, capacity, sizeof(Matrix4x4)) ||
+        !growColumn((void**)&objectManager.previousMatrices, capacity, sizeof(Matrix4x4)) ||
+        !growColumn((void**)&objectManager.tickMatrices, capacity, sizeof(Matrix4x4)) ||
+        !growColumn((void**)&objectManager.bounds, capacity, sizeof(Vector4)) ||
+        !growColumn((void**)&objectManager.flags, capacity, sizeof(unsigned int)) ||
+        !growColumn((void**)&objectManager.renderKeys, capacity, sizeof(int)) ||
+        !growColumn((void**)&objectManager.handles, capacity, sizeof(ObjectHandle))) {
+        LOG_ERROR(LOG_SCENE, "Out of memory growing the object manager to %d objects", capacity);
+        return false;
     }
+    objectManager.capacity = capacity;
+    return true;
 }
 
-void addObjectToManager(SceneObject newObject) {
-    static int currentID = 0; // Static variable to keep track of unique IDs
-    if (objectManager.count < MAX_OBJECTS) {
-        newObject.id = currentID++; // Assign a unique ID to the new object
-        objectManager.objects[objectManager.count++] = newObject;
+static int allocateSlot(void) {
+    if (objectManager.freeSlot >= 0) {
+        int index = objectManager.freeSlot;
+        objectManager.freeSlot = objectManager.slots[index].nextFree;
+        return index;
     }
+
+    if (objectManager.slotCount == objectManager.slotCapacity) {
+        int capacity = objectManager.slotCapacity ? objectManager.slotCapacity * 2 : OBJECT_MANAGER_INITIAL_CAPACITY;
+        if (!growColumn((void**)&objectManager.slots, capacity, sizeof(ObjectSlot))) return -1;
+        objectManager.slotCapacity = capacity;
+    }
+    ObjectSlot* slot = &objectManager.slots[objectManager.slotCount];
+    slot->generation = 1;
+    slot->denseIndex = -1;
+    slot->nextFree = -1;
+    return objectManager.slotCount++;
 }
 
-void addObject(Camera* camera, ObjectType type, bool useTexture, int textureIndex, bool colorCreation, Model* model, PBRMaterial material, bool usePBR) {
-    if (objectManager.count >= MAX_OBJECTS) return;
+int getObjectIndex(ObjectHandle handle) {
+    if (handle.generation == 0 || handle.index >= (unsigned int)objectManager.slotCount) return -1;
+    const ObjectSlot* slot = &objectManager.slots[handle.index];
+    return slot->generation == handle.generation ? slot->denseIndex : -1;
+}
 
-    SceneObject newObject;
-    newObject.object.type = type;
-    newObject.object.useTexture = useTexture;
-    newObject.object.textureID = textureIndex;
-    newObject.object.useColor = colorCreation;
-    newObject.object.useLighting = true;
-    newObject.object.usePBR = usePBR;
+SceneObject* getObject(ObjectHandle handle) {
+    int index = getObjectIndex(handle);
+    return index >= 0 ? &objectManager.objects[index] : NULL;
+}
 
-    if (!useTexture && !usePBR) {
-        newObject.object.useColor = true;
-    }
+bool isObjectAlive(ObjectHandle handle) {
+    return getObjectIndex(handle) >= 0;
+}
 
-    newObject.object.material = material;
-    newObject.object.textureID = useTexture ? getTexture(textureNames[textureIndex]) : 0;
+int getObjectSlot(const SceneObject* obj) {
+    if (!obj || !objectManager.objects) return -1;
+    ptrdiff_t index = obj - objectManager.objects;
+    return index >= 0 && index < objectManager.count ? (int)index : -1;
+}
 
-    newObject.position = vector_add(camera->Position, vector_scale(camera->Front, 5.0f)); // Position in front of the camera
-    newObject.rotation = (Vector3){ 0.0f, 0.0f, 0.0f };
-    newObject.scale = (Vector3){ 1.0f, 1.0f, 1.0f };
-    newObject.color = (Vector4){ 1.0f, 1.0f, 1.0f, 1.0f }; // Default to white color
-    newObject.selected = false;
+bool hasObjectFlag(const SceneObject* obj, unsigned int flag) {
+    int index = getObjectSlot(obj);
+    return index >= 0 && (objectManager.flags[index] & flag) != 0;
+}
+
+// Adds and removes move objects, selected_object follows its object by handle
+static ObjectHandle captureSelection(void) {
+    int index = getObjectSlot(selected_object);
+    return index >= 0 ? objectManager.handles[index] : INVALID_OBJECT_HANDLE;
+}
+
+static void restoreSelection(ObjectHandle selection) {
+    if (selection.generation != 0) selected_object = getObject(selection);
+}
+
+// Geometry built once by a batch and used by several objects
+typedef struct {
+    GLuint vao;
+    int users;
+} SharedGeometry;
+
+static SharedGeometry* sharedGeometry = NULL;
+static int sharedGeometryCount = 0;
+static int sharedGeometryCapacity = 0;
+
+#define PRIMITIVE_TYPES OBJ_MODEL  // OBJ_CUBE through OBJ_PLANE
 
-    switch (type) {
+// Primitives of one type have the same geometry, only their model matrix differs
+static void createPrimitiveGeometry(SceneObject* obj) {
+    switch (obj->object.type) {
     case OBJ_CUBE:
-        newObject.object.data.cube = createCube(newObject.position, newObject.color, 1.0f);
+        obj->object.data.cube = createCube(obj->position, obj->color, 1.0f);
         break;
     case OBJ_SPHERE:
-        newObject.object.data.sphere = createSphere(1.0f, 20, 20, newObject.position, newObject.color);
+        obj->object.data.sphere = createSphere(1.0f, 20, 20, obj->position, obj->color);
         break;
     case OBJ_PYRAMID:
-        newObject.object.data.pyramid = createPyramid(newObject.position, newObject.color, 1.0f, 1.0f);
+        obj->object.data.pyramid = createPyramid(obj->position, obj->color, 1.0f, 1.0f);
         break;
     case OBJ_CYLINDER:
-        newObject.object.data.cylinder = createCylinder(1.0f, 2.0f, 20, newObject.position, newObject.color);
+        obj->object.data.cylinder = createCylinder(1.0f, 2.0f, 20, obj->position, obj->color);
         break;
     case OBJ_PLANE:
-        newObject.object.data.plane = createPlane(newObject.position, newObject.color);
+        obj->object.data.plane = createPlane(obj->position, obj->color);
         break;
-    case OBJ_MODEL:
-        if (model) {
-            newObject.object.data.model = *model;
-            newObject.object.data.model.meshes = (Mesh*)malloc(model->meshCount * sizeof(Mesh));
-            for (unsigned int i = 0; i < model->meshCount; i++) {
-                newObject.object.data.model.meshes[i] = model->meshes[i];
-            }
-            newObject.object.data.model.meshCount = model->meshCount;
-        }
+    default:
         break;
     }
-
-    addObjectToManager(newObject);
 }
 
-void removeObject(int index) {
-    if (index < 0 || index >= objectManager.count) {
-        printf("Invalid index: %d\n", index);
-        return;
-    }
-
-    printf("Removing object at index: %d\n", index);
-
-    SceneObject* obj = &objectManager.objects[index];
-
+static void destroyPrimitiveGeometry(SceneObject* obj) {
     switch (obj->object.type) {
     case OBJ_CUBE:
-        printf("Destroying cube at index: %d\n", index);
         destroyCube(&obj->object.data.cube);
         break;
     case OBJ_SPHERE:
-        printf("Destroying sphere at index: %d\n", index);
         destroySphere(&obj->object.data.sphere);
         break;
     case OBJ_PYRAMID:
-        printf("Destroying pyramid at index: %d\n", index);
         destroyPyramid(&obj->object.data.pyramid);
         break;
     case OBJ_CYLINDER:
-        printf("Destroying cylinder at index: %d\n", index);
         destroyCylinder(&obj->object.data.cylinder);
         break;
     case OBJ_PLANE:
-        printf("Destroying plane at index: %d\n", index);
         destroyPlane(&obj->object.data.plane);
         break;
-    case OBJ_MODEL:
-        printf("Freeing model at index: %d\n", index);
-        freeModel(&obj->object.data.model);
-        break;
     default:
-        printf("Unknown object type at index: %d\n", index);
         break;
     }
+}
+
+static GLuint primitiveVao(const SceneObject* obj) {
+    switch (obj->object.type) {
+    case OBJ_CUBE: return obj->object.data.cube.vao;
+    case OBJ_SPHERE: return obj->object.data.sphere.vao;
+    case OBJ_PYRAMID: return obj->object.data.pyramid.vao;
+    case OBJ_CYLINDER: return obj->object.data.cylinder.vao;
+    case OBJ_PLANE: return obj->object.data.plane.vao;
+    default: return 0;
+    }
+}
+
+static SharedGeometry* findSharedGeometry(const SceneObject* obj) {
+    GLuint vao = primitiveVao(obj);
+    if (vao == 0) return NULL;
+    for (int i = 0; i < sharedGeometryCount; i++) {
+        if (sharedGeometry[i].vao == vao) return &sharedGeometry[i];
+    }
+    return NULL;
+}
+
+static bool shareGeometry(GLuint vao, int users) {
+    if (sharedGeometryCount == sharedGeometryCapacity) {
+        int capacity = sharedGeometryCapacity ? sharedGeometryCapacity * 2 : 16;
+        if (!growColumn((void**)&sharedGeometry, capacity, sizeof(SharedGeometry))) return false;
+        sharedGeometryCapacity = capacity;
+    }
+    sharedGeometry[sharedGeometryCount++] = (SharedGeometry){ vao, users };
+    return true;
+}
+
+// True while other objects still draw with the geometry
+static bool releaseSharedGeometry(const SceneObject* obj) {
+    SharedGeometry* shared = findSharedGeometry(obj);
+    if (!shared) return false;
+    if (--shared->users > 0) return true;
+    *shared = sharedGeometry[--sharedGeometryCount];
+    return false;
+}
+
+// Fills the columns of a new object, the caller has reserved room
+static ObjectHandle insertObject(const SceneObject* newObject) {
+    static int currentID = 0; // Static variable to keep track of unique IDs
+    EntityId entity = createSceneEntity(RENDERABLE_COMPONENTS);
+    if (entity.generation == 0) return INVALID_OBJECT_HANDLE;
+    int slotIndex = allocateSlot();
+    if (slotIndex < 0) {
+        destroySceneEntity(entity);
+        return INVALID_OBJECT_HANDLE;
+    }
+
+    ObjectSlot* slot = &objectManager.slots[slotIndex];
+    ObjectHandle handle = { (unsigned int)slotIndex, slot->generation };
+    int index = objectManager.count++;
+    slot->denseIndex = index;
+
+    SceneObject* obj = &objectManager.objects[index];
+    *obj = *newObject;
+    obj->id = currentID++; // Assign a unique ID to the new object
+    obj->handle = handle;
+    obj->entity = entity;
+    if (obj->object.type == OBJ_MODEL) {
+        retainModel(obj->object.data.model); // Every object in the manager holds a reference
+    }
+    objectManager.handles[index] = handle;
+    objectManager.modelMatrices[index] = composeTransform(obj->position, obj->rotation, obj->scale);
+    objectManager.previousMatrices[index] = objectManager.modelMatrices[index];
+    objectManager.tickMatrices[index] = objectManager.modelMatrices[index];
+    objectManager.bounds[index] = (Vector4){ obj->position.x, obj->position.y, obj->position.z, 0.0f };
+    objectManager.flags[index] = 0;
+    objectManager.renderKeys[index] = 0;
+
+    // Transform is filled by syncRenderables in the next step
+    Renderable* renderable = writeComponent(entity, COMPONENT_RENDERABLE);
+    renderable->object = handle;
+    return handle;
+}
+
+ObjectHandle addObjectToManager(SceneObject newObject) {
+    ObjectHandle selection = captureSelection();
+    if (!reserveObjects(objectManager.count + 1)) return INVALID_OBJECT_HANDLE;
+    restoreSelection(selection);
+    return insertObject(&newObject);
+}
+
+int addObjectsToManager(const SceneObject* objects, int count, ObjectHandle* handles) {
+    if (count <= 0) return 0;
+    ObjectHandle selection = captureSelection();
+    if (!reserveObjects(objectManager.count + count)) return 0;
+    restoreSelection(selection);
+
+    // One geometry upload per primitive type, every object of that type draws with it
+    SceneObject geometry[PRIMITIVE_TYPES];
+    int users[PRIMITIVE_TYPES] = { 0 };
+    bool built[PRIMITIVE_TYPES] = { false };
+    int added = 0;
+    for (int i = 0; i < count; i++) {
+        SceneObject newObject = objects[i];
+        ObjectType type = newObject.object.type;
+        if (type < PRIMITIVE_TYPES) {
+            if (!built[type]) {
+                geometry[type] = newObject;
+                createPrimitiveGeometry(&geometry[type]);
+                built[type] = true;
+            }
+            newObject.object.data = geometry[type].object.data;
+        }
 
-    // Shift objects down in the array to fill the gap
-    for (int i = index; i < objectManager.count - 1; ++i) {
-        objectManager.objects[i] = objectManager.objects[i + 1];
-        printf("Shifting object from index %d to %d\n", i + 1, i);
+        ObjectHandle handle = insertObject(&newObject);
+        if (handles) handles[i] = handle;
+        if (handle.generation == 0) continue;
+        if (type < PRIMITIVE_TYPES) users[type]++;
+        added++;
     }
 
-    // Decrement the count of objects after shifting
-    objectManager.count--;
+    for (int type = 0; type < PRIMITIVE_TYPES; type++) {
+        if (!built[type]) continue;
+        if (users[type] == 0) {
+            destroyPrimitiveGeometry(&geometry[type]);
+        }
+        else if (users[type] > 1 && !shareGeometry(primitiveVao(&geometry[type]), users[type])) {
+            // Untracked, the first removal would delete it under the others
+            LOG_WARN(LOG_SCENE, "Out of memory tracking shared geometry, it will not be released");
+        }
+    }
+    return added;
+}
 
-    // Clear the last object 
-    objectManager.objects[objectManager.count].id = -1;
-    printf("Object count after removal: %d\n", objectManager.count);
+int spawnObjects(const SceneObject* templateObject, const ObjectTransform* transforms, int count, ObjectHandle* handles) {
+    if (count <= 0) return 0;
+    SceneObject* objects = (SceneObject*)malloc((size_t)count * sizeof(SceneObject));
+    if (!objects) {
+        LOG_ERROR(LOG_SCENE, "Out of memory spawning %d objects", count);
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        objects[i] = *templateObject;
+        objects[i].position = transforms[i].position;
+        objects[i].rotation = transforms[i].rotation;
+        objects[i].scale = transforms[i].scale;
+        objects[i].selected = false;
+        memset(objects[i].lodLevels, 0, sizeof(objects[i].lodLevels));
+    }
+    int added = addObjectsToManager(objects, count, handles);
+    free(objects);
+    return added;
+}
 
-    // Update selected object if necessary
-    if (selected_object == obj) {
+SceneObject makeSceneObject(Camera* camera, ObjectType type, bool useTexture, int textureIndex, bool colorCreation, Model* model, PBRMaterial material, bool usePBR) {
+    SceneObject newObject;
+    memset(&newObject, 0, sizeof(newObject));
+    newObject.object.type = type;
+    newObject.object.useTexture = useTexture;
+    newObject.object.textureID = textureIndex;
+    newObject.object.useColor = colorCreation;
+    newObject.object.useLighting = true;
+    newObject.object.usePBR = usePBR;
+
+    if (!useTexture && !usePBR) {
+        newObject.object.useColor = true;
+    }
+
+    newObject.object.material = material;
+    newObject.object.textureID = useTexture ? getTexture(textureNames[textureIndex]) : 0;
+
+    newObject.position = vector_add(camera->Position, vector_scale(camera->Front, 5.0f)); // Position in front of the camera
+    newObject.rotation = (Vector3){ 0.0f, 0.0f, 0.0f };
+    newObject.scale = (Vector3){ 1.0f, 1.0f, 1.0f };
+    newObject.color = (Vector4){ 1.0f, 1.0f, 1.0f, 1.0f }; // Default to white color
+    newObject.selected = false;
+    newObject.isStatic = false;
+
+    if (type == OBJ_MODEL) {
+        newObject.object.data.model = model;
+    }
+    return newObject;
+}
+
+ObjectHandle addObject(Camera* camera, ObjectType type, bool useTexture, int textureIndex, bool colorCreation, Model* model, PBRMaterial material, bool usePBR) {
+    // Room first, so the geometry below is never created for nothing
+    ObjectHandle selection = captureSelection();
+    if (!reserveObjects(objectManager.count + 1)) return INVALID_OBJECT_HANDLE;
+    restoreSelection(selection);
+
+    SceneObject newObject = makeSceneObject(camera, type, useTexture, textureIndex, colorCreation, model, material, usePBR);
+    createPrimitiveGeometry(&newObject);
+    return insertObject(&newObject);
+}
+
+// Children move up to the object's parent, their local transform takes in
+// the object's so they stay where they were
+static void detachObjectChildren(const SceneObject* obj) {
+    EntityId inlineChildren[16];
+    EntityId* children = inlineChildren;
+    int count = getChildren(obj->entity, inlineChildren, 16);
+    if (count == 0) return;
+    if (count > 16) {
+        children = (EntityId*)malloc((size_t)count * sizeof(EntityId));
+        if (!children) {
+            // The scene graph still keeps their world, the SceneObjects fall behind
+            LOG_ERROR(LOG_SCENE, "Out of memory detaching %d children", count);
+            return;
+        }
+        getChildren(obj->entity, children, count);
+    }
+
+    Matrix4x4 local = composeTransform(obj->position, obj->rotation, obj->scale);
+    EntityId parent = getParent(obj->entity);
+    for (int i = 0; i < count; i++) {
+        const Renderable* renderable = getComponent(children[i], COMPONENT_RENDERABLE);
+        SceneObject* child = renderable ? getObject(renderable->object) : NULL;
+        if (!child) continue;
+        Matrix4x4 moved = matrixMultiply(composeTransform(child->position, child->rotation, child->scale), local);
+        decomposeTransform(moved, &child->position, &child->rotation, &child->scale);
+        setParent(children[i], parent);
+    }
+    if (children != inlineChildren) free(children);
+}
+
+// Releases everything the object holds and closes the gap, selection is the caller's
+static void destroyObjectAt(int index) {
+    SceneObject* obj = &objectManager.objects[index];
+    ObjectHandle handle = objectManager.handles[index];
+
+    if (obj->object.type == OBJ_MODEL) {
+        releaseModel(obj->object.data.model);
+    }
+    else if (!releaseSharedGeometry(obj)) {
+        destroyPrimitiveGeometry(obj);
+    }
+
+#ifdef AUDIO_ENABLED
+    releaseAudioEmitter(obj->entity);
+#endif
+    detachObjectChildren(obj);
+    destroySceneEntity(obj->entity);
+
+    // The last object moves into the gap, every column moves with it
+    int last = --objectManager.count;
+    if (index != last) {
+        objectManager.objects[index] = objectManager.objects[last];
+        objectManager.modelMatrices[index] = objectManager.modelMatrices[last];
+        objectManager.previousMatrices[index] = objectManager.previousMatrices[last];
+        objectManager.tickMatrices[index] = objectManager.tickMatrices[last];
+        objectManager.bounds[index] = objectManager.bounds[last];
+        objectManager.flags[index] = objectManager.flags[last];
+        objectManager.renderKeys[index] = objectManager.renderKeys[last];
+        objectManager.handles[index] = objectManager.handles[last];
+        objectManager.slots[objectManager.handles[index].index].denseIndex = index;
+    }
+
+    // Old handles to the slot stop resolving
+    ObjectSlot* slot = &objectManager.slots[handle.index];
+    slot->denseIndex = -1;
+    slot->generation = slot->generation == UINT_MAX ? 1 : slot->generation + 1;
+    slot->nextFree = objectManager.freeSlot;
+    objectManager.freeSlot = (int)handle.index;
+}
+
+void removeObject(ObjectHandle handle) {
+    int index = getObjectIndex(handle);
+    if (index < 0) {
+        LOG_DEBUG(LOG_SCENE, "Invalid object handle: %u/%u", handle.index, handle.generation);
+        return;
+    }
+
+    LOG_DEBUG(LOG_SCENE, "Removing object at index: %d", index);
+
+    ObjectHandle selection = captureSelection();
+    if (selected_object == &objectManager.objects[index]) {
+        selection = INVALID_OBJECT_HANDLE;
         selected_object = NULL;
-        printf("Selected object was removed. Clearing selection.\n");
+        LOG_DEBUG(LOG_SCENE, "Selected object was removed. Clearing selection.");
+    }
+    destroyObjectAt(index);
+    restoreSelection(selection);
+}
+
+int removeObjects(const ObjectHandle* handles, int count) {
+    ObjectHandle selection = captureSelection();
+    selected_object = NULL;
+
+    // Stale and repeated handles no longer resolve and are skipped
+    int removed = 0;
+    for (int i = 0; i < count; i++) {
+        int index = getObjectIndex(handles[i]);
+        if (index < 0) continue;
+        destroyObjectAt(index);
+        removed++;
     }
+
+    restoreSelection(selection);
+    return removed;
 }
+
 void cleanupObjects() {
-    for (int i = 0; i < objectManager.count; i++) {
-        removeObject(i);
+    // Removing from the end never moves anything
+    while (objectManager.count > 0) {
+        destroyObjectAt(objectManager.count - 1);
     }
-    objectManager.count = 0;
+    selected_object = NULL;
 }
 
 void updateObjectInManager(SceneObject* updatedObject) {
-    for (int i = 0; i < objectManager.count; i++) {
-        if (objectManager.objects[i].id == updatedObject->id) {
-            objectManager.objects[i] = *updatedObject;
+    SceneObject* target = getObject(updatedObject->handle);
+    if (!target) return;
+
+    // Edits through selected_object already landed in place
+    if (target != updatedObject) *target = *updatedObject;
+    LOG_DEBUG(LOG_SCENE, "Updated object in manager: ID=%d, Index=%d", target->id, (int)(target - objectManager.objects));
+}
+
+// Material group in the high bits: no PBR, each slab, then unpacked PBR.
+// The geometry below it puts objects that can share an instanced draw together
+static int computeRenderKey(const SceneObject* obj) {
+    int group = 0;
+    if (usePBR && obj->object.usePBR) {
+        group = 1 + (obj->object.material.arraySlab >= 0 ? obj->object.material.arraySlab : MAX_MATERIAL_SLABS);
+    }
+    DrawCommand draw;
+    unsigned int geometry = getObjectLODDraw(obj, 0, &draw) ? draw.vertexArray : 0;
+    return (group << RENDER_KEY_GEOMETRY_BITS) | (int)(geometry & ((1u << RENDER_KEY_GEOMETRY_BITS) - 1));
+}
 
+static void updateObjectRange(void* data, int begin, int end, int workerIndex) {
+    (void)data;
+    (void)workerIndex;
+    for (int i = begin; i < end; i++) {
+        const SceneObject* obj = &objectManager.objects[i];
+        unsigned int kept = objectManager.flags[i] & OBJECT_FLAG_INTERPOLATED;
+        objectManager.flags[i] = kept | (obj->color.w < 1.0f ? OBJECT_FLAG_TRANSPARENT : 0);
+        objectManager.renderKeys[i] = computeRenderKey(obj);
+    }
+}
 
-            printf("Updated object in manager: ID=%d, Index=%d\n", updatedObject->id, i);
+void updateObjectColumns(void) {
+    // Matrices and bounds came from the simulation step, see scene_systems.h
+    parallelFor(objectManager.count, OBJECT_COLUMN_RANGE, updateObjectRange, NULL);
+}
 
-            // Update the selected_object pointer if necessary
-            if (selected_object && selected_object->id == updatedObject->id) {
-                selected_object = &objectManager.objects[i];
+static void snapObjectRange(void* data, int begin, int end, int workerIndex) {
+    (void)data;
+    (void)workerIndex;
+    for (int i = begin; i < end; i++) {
+        if (!(objectManager.flags[i] & OBJECT_FLAG_INTERPOLATED)) continue;
+        objectManager.flags[i] &= ~OBJECT_FLAG_INTERPOLATED;
+        objectManager.modelMatrices[i] = objectManager.tickMatrices[i];
+    }
+}
+
+void snapObjectMatrices(void) {
+    parallelFor(objectManager.count, OBJECT_COLUMN_RANGE, snapObjectRange, NULL);
+}
+
+static void interpolateObjectRange(void* data, int begin, int end, int workerIndex) {
+    (void)workerIndex;
+    float alpha = *(const float*)data;
+    for (int i = begin; i < end; i++) {
+        if (!(objectManager.flags[i] & OBJECT_FLAG_INTERPOLATED)) continue;
+        // Component-wise, close enough to a proper blend for one tick of motion
+        const float (*from)[4] = objectManager.previousMatrices[i].data;
+        const float (*to)[4] = objectManager.tickMatrices[i].data;
+        float (*blended)[4] = objectManager.modelMatrices[i].data;
+        for (int row = 0; row < 4; row++) {
+            for (int col = 0; col < 4; col++) {
+                blended[row][col] = from[row][col] + (to[row][col] - from[row][col]) * alpha;
             }
-            break;
         }
     }
 }
 
-void drawObject(const SceneObject* obj, const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix) {
-    glUseProgram(shaderProgram);
+void interpolateObjectMatrices(float alpha) {
+    parallelFor(objectManager.count, OBJECT_COLUMN_RANGE, interpolateObjectRange, &alpha);
+}
 
-    int modelLoc = glGetUniformLocation(shaderProgram, "model");
-    int viewLoc = glGetUniformLocation(shaderProgram, "view");
-    int projLoc = glGetUniformLocation(shaderProgram, "projection");
+bool setObjectParent(ObjectHandle child, ObjectHandle parent) {
+    SceneObject* obj = getObject(child);
+    if (!obj) return false;
+    if (parent.generation == 0) return setParent(obj->entity, INVALID_ENTITY);
+    SceneObject* parentObj = getObject(parent);
+    return parentObj && setParent(obj->entity, parentObj->entity);
+}
 
-    Matrix4x4 modelMatrix = translateMatrix(obj->position);
-    modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.x, (Vector3) { 1.0f, 0.0f, 0.0f }));
-    modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.y, (Vector3) { 0.0f, 1.0f, 0.0f }));
-    modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.z, (Vector3) { 0.0f, 0.0f, 1.0f }));
-    modelMatrix = matrixMultiply(modelMatrix, scaleMatrix(obj->scale));
+ObjectHandle getObjectParent(ObjectHandle handle) {
+    SceneObject* obj = getObject(handle);
+    if (!obj) return INVALID_OBJECT_HANDLE;
+    EntityId parent = getParent(obj->entity);
+    const Renderable* renderable = getComponent(parent, COMPONENT_RENDERABLE);
+    return renderable ? renderable->object : INVALID_OBJECT_HANDLE;
+}
 
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &modelMatrix.data[0][0]);
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &viewMatrix.data[0][0]);
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, &projMatrix.data[0][0]);
+Matrix4x4 getObjectModelMatrix(const SceneObject* obj) {
+    // Managed objects may have a parent, their world matrix is in the column
+    int index = getObjectSlot(obj);
+    if (index >= 0) return objectManager.modelMatrices[index];
+    return composeTransform(obj->position, obj->rotation, obj->scale);
+}
 
-    GLint colorLoc = glGetUniformLocation(shaderProgram, "inputColor");
-    glUniform4f(colorLoc, obj->color.x, obj->color.y, obj->color.z, obj->color.w);
+void drawObject(SceneObject* obj, const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix) {
+    // Static objects are drawn with their chunk in drawStaticBatches
+    if (isObjectStaticBatched(obj)) return;
 
-    if (obj->object.useTexture) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, obj->object.textureID);
-    }
+    // View, projection, color and textures come from the pass and setShaderUniforms
+    stateUseProgram(shaderProgram);
 
-    switch (obj->object.type) {
-    case OBJ_CUBE:
-        glBindVertexArray(obj->object.data.cube.vao);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-        break;
-    case OBJ_SPHERE:
-        glBindVertexArray(obj->object.data.sphere.vao);
-        glDrawElements(GL_TRIANGLES, obj->object.data.sphere.numIndices, GL_UNSIGNED_INT, 0);
-        break;
-    case OBJ_PYRAMID:
-        glBindVertexArray(obj->object.data.pyramid.vao);
-        glDrawElements(GL_TRIANGLES, 18, GL_UNSIGNED_INT, 0);
-        break;
-    case OBJ_CYLINDER:
-        glBindVertexArray(obj->object.data.cylinder.vao);
-        glDrawElements(GL_TRIANGLES, obj->object.data.cylinder.sectorCount * 12, GL_UNSIGNED_INT, 0);
-        break;
-    case OBJ_PLANE:
-        glBindVertexArray(obj->object.data.plane.vao);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        break;
-    case OBJ_MODEL:
-        for (unsigned int i = 0; i < obj->object.data.model.meshCount; i++) {
-            drawMesh(&obj->object.data.model.meshes[i]);
-        }
-        break;
+    int modelLoc = glGetUniformLocation(shaderProgram, "model");
+    Matrix4x4 modelMatrix = getObjectModelMatrix(obj);
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &modelMatrix.data[0][0]);
+
+    LODView lodView = makeCameraLODView(viewMatrix, projMatrix);
+    int level = selectObjectLOD(obj, &modelMatrix, &lodView);
+    // Full-detail models submit only their visible meshlets
+    if (level > 0 || !drawModelMeshlets(obj, &modelMatrix, viewMatrix, projMatrix)) {
+        drawObjectLOD(obj, level, LOD_VIEW_CAMERA);
     }
-    glBindVertexArray(0);
 }
@@ -4,7 +4,9 @@
 #include "textures.h"
 #include "Camera.h"
 #include "background.h"
-#include "SOIL2/SOIL2.h"
+#include "upload_queue.h"
+#include "gl_state.h"
+#include "log.h"
 #include <stdio.h>
 GLuint skyboxVAO, skyboxVBO, skyboxShader, skyboxTexture;
 extern float skyboxVertices[108];
@@ -22,32 +24,41 @@ const char* backgroundNames[] = {
 
 // Define the number of backgrounds
 const int backgroundCount = sizeof(backgroundNames) / sizeof(backgroundNames[0]);
-GLuint loadCubemap(const char* faceFiles[6]) {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, channels;
-    for (int i = 0; i < 6; i++) {
-        unsigned char* data = SOIL_load_image(faceFiles[i], &width, &height, &channels, SOIL_LOAD_RGB);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            SOIL_free_image_data(data);
-        }
-        else {
-            fprintf(stderr, "Cubemap texture failed to load at path: %s\n", faceFiles[i]);
-        }
-    }
+// Faces are decoded on workers and uploaded by the upload queue; the cubemap
+// is complete once the callback fires
+static GLuint requestSkyboxCubemap(const char* faceFiles[6], TextureReadyCallback done) {
+    GLuint textureID = requestCubemap(faceFiles, done, NULL);
+    if (textureID == 0) return 0;
 
+    stateBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    stateBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 
     return textureID;
 }
 
+GLuint loadCubemap(const char* faceFiles[6]) {
+    return requestSkyboxCubemap(faceFiles, NULL);
+}
+
+// Keep showing the current background until the new one is fully uploaded
+static void onSkyboxReady(GLuint texture, bool success, void* user) {
+    (void)user;
+    if (!success) {
+        LOG_WARN(LOG_ASSETS, "Cubemap textures failed to load, keeping the current background");
+        stateDeleteTextures(1, &texture);
+        return;
+    }
+    if (skyboxTexture) {
+        stateDeleteTextures(1, &skyboxTexture);
+    }
+    skyboxTexture = texture;
+}
+
 float skyboxVertices[] = {
     // Vertices for a cube
     -1.0f,  1.0f, -1.0f,
@@ -95,21 +106,24 @@ float skyboxVertices[] = {
 
 void initSkybox(int backgroundIndex) {
     if (backgroundIndex < 1 || backgroundIndex > backgroundCount) {
-        fprintf(stderr, "Background index out of range. Please choose from 1 to %d.\n", backgroundCount);
+        LOG_ERROR(LOG_ASSETS, "Background index out of range. Please choose from 1 to %d.", backgroundCount);
         return;
     }
 
-    // Generate and bind the VAO and VBO
-    glGenVertexArrays(1, &skyboxVAO);
-    glBindVertexArray(skyboxVAO);
+    // Generate and bind the VAO and VBO once, switching backgrounds only swaps the cubemap
+    if (!skyboxVAO) {
+        glGenVertexArrays(1, &skyboxVAO);
+        stateBindVertexArray(skyboxVAO);
 
-    glGenBuffers(1, &skyboxVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), skyboxVertices, GL_STATIC_DRAW);
+        glGenBuffers(1, &skyboxVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), skyboxVertices, GL_STATIC_DRAW);
 
-    // Set up vertex attributes
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+        // Set up vertex attributes
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        stateBindVertexArray(0);
+    }
 
     // Format file paths dynamically based on the input index
     const char* directions[6] = { "right", "left", "top", "bottom", "front", "back" };
@@ -122,22 +136,23 @@ void initSkybox(int backgroundIndex) {
     }
 
     // Load textures and shaders
-    skyboxTexture = loadCubemap(faces);
-    if (skyboxTexture == 0) {
-        fprintf(stderr, "Failed to load skybox textures for background %d\n", backgroundIndex);
+    if (requestSkyboxCubemap(faces, onSkyboxReady) == 0) {
+        LOG_ERROR(LOG_ASSETS, "Failed to load skybox textures for background %d", backgroundIndex);
         return;
     }
 
-    skyboxShader = loadShader("shaders/skybox/skyboxVertex.glsl", "shaders/skybox/skyboxFragment.glsl");
-    if (skyboxShader == 0) {
-        fprintf(stderr, "Failed to load skybox shader\n");
-        return;
+    if (!skyboxShader) {
+        skyboxShader = loadShader("shaders/skybox/skyboxVertex.glsl", "shaders/skybox/skyboxFragment.glsl");
+        if (skyboxShader == 0) {
+            LOG_ERROR(LOG_ASSETS, "Failed to load skybox shader");
+            return;
+        }
     }
 }
 
 void drawSkybox(const Camera* camera, const Matrix4x4* projMatrix) {
-    glDepthMask(GL_FALSE); // Disable depth write
-    glUseProgram(skyboxShader);
+    stateDepthMask(GL_FALSE); // Disable depth write
+    stateUseProgram(skyboxShader);
 
     // Create a view matrix for the skybox (remove translation)
     Matrix4x4 viewMatrixSkybox = getViewMatrix(camera);
@@ -149,12 +164,12 @@ void drawSkybox(const Camera* camera, const Matrix4x4* projMatrix) {
     glUniformMatrix4fv(glGetUniformLocation(skyboxShader, "view"), 1, GL_FALSE, &viewMatrixSkybox.data[0][0]);
     glUniformMatrix4fv(glGetUniformLocation(skyboxShader, "projection"), 1, GL_FALSE, &projMatrix->data[0][0]);
 
-    glBindVertexArray(skyboxVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
+    stateBindVertexArray(skyboxVAO);
+    stateActiveTexture(GL_TEXTURE0);
+    stateBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
     glUniform1i(glGetUniformLocation(skyboxShader, "skybox"), 0);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-    glUseProgram(0);
-    glDepthMask(GL_TRUE); // Re-enable depth write
+    stateBindVertexArray(0);
+    stateUseProgram(0);
+    stateDepthMask(GL_TRUE); // Re-enable depth write
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "ObjectManager.h" 
 #include "Vectors.h"
 #include "materials.h" 
+#include "simulation.h"
 #include <math.h>
 #include <stdlib.h>
 
@@ -85,10 +86,10 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
         lastY = ypos;
 
         if (isPanning) {
-            processMousePan(&camera, (float)xoffset, (float)yoffset);
+            panCamera((float)xoffset, (float)yoffset);
         }
         else if (isDragging) {
-            processMouseMovement(&camera, (float)xoffset, (float)yoffset, true);
+            lookCamera((float)xoffset, (float)yoffset);
         }
     }
 }
@@ -96,7 +97,7 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
     (void)window;
     (void)xoffset; 
-    processMouseScroll(&camera, (float)yoffset);
+    zoomCamera((float)yoffset);
 }
 
 void processKeyboard(Camera* camera, int direction, float deltaTime) {
@@ -189,6 +190,69 @@ Matrix4x4 scaleMatrix(Vector3 scale) {
     return mat;
 }
 
+// Translation, then rotation about X, Y and Z in degrees, then scale
+Matrix4x4 composeTransform(Vector3 position, Vector3 rotation, Vector3 scale) {
+    Matrix4x4 model = translateMatrix(position);
+    model = matrixMultiply(model, rotateMatrix(rotation.x, (Vector3) { 1.0f, 0.0f, 0.0f }));
+    model = matrixMultiply(model, rotateMatrix(rotation.y, (Vector3) { 0.0f, 1.0f, 0.0f }));
+    model = matrixMultiply(model, rotateMatrix(rotation.z, (Vector3) { 0.0f, 0.0f, 1.0f }));
+    return matrixMultiply(model, scaleMatrix(scale));
+}
+
+void decomposeTransform(Matrix4x4 model, Vector3* position, Vector3* rotation, Vector3* scale) {
+    const float (*m)[4] = model.data;
+    // The 3x3 part is rotation times scale, each column scaled by one axis.
+    // Under shear the columns aren't square to each other, so they are
+    // straightened (Gram-Schmidt) and the translation goes through the result
+    float s[3];
+    float r[3][3];
+    for (int col = 0; col < 3; col++) {
+        float v[3] = { m[0][col], m[1][col], m[2][col] };
+        for (int prev = 0; prev < col; prev++) {
+            float d = v[0] * r[0][prev] + v[1] * r[1][prev] + v[2] * r[2][prev];
+            for (int row = 0; row < 3; row++) v[row] -= d * r[row][prev];
+        }
+        s[col] = sqrtf(m[0][col] * m[0][col] + m[1][col] * m[1][col] + m[2][col] * m[2][col]);
+        float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        float inverse = length > 1e-8f ? 1.0f / length : 0.0f;
+        for (int row = 0; row < 3; row++) r[row][col] = v[row] * inverse;
+    }
+    // A mirrored basis keeps a proper rotation and flips the last scale
+    float det = r[0][0] * (r[1][1] * r[2][2] - r[1][2] * r[2][1]) -
+        r[0][1] * (r[1][0] * r[2][2] - r[1][2] * r[2][0]) +
+        r[0][2] * (r[1][0] * r[2][1] - r[1][1] * r[2][0]);
+    if (det < 0.0f) {
+        s[2] = -s[2];
+        for (int row = 0; row < 3; row++) r[row][2] = -r[row][2];
+    }
+    *scale = (Vector3){ s[0], s[1], s[2] };
+
+    // Rotation about X, then Y, then Z: the Y angle is in r[0][2]
+    float toDegrees = 180.0f / (float)M_PI;
+    float sinY = fmaxf(-1.0f, fminf(1.0f, r[0][2]));
+    float y = asinf(sinY);
+    float x, z;
+    if (fabsf(sinY) < 0.9999f) {
+        x = atan2f(-r[1][2], r[2][2]);
+        z = atan2f(-r[0][1], r[0][0]);
+    }
+    else {
+        // Gimbal lock, X and Z turn about the same axis
+        x = atan2f(r[2][1], r[1][1]);
+        z = 0.0f;
+    }
+    *rotation = (Vector3){ x * toDegrees, y * toDegrees, z * toDegrees };
+
+    // The translation row went through the rotation and scale, undo both
+    float t[3];
+    for (int col = 0; col < 3; col++) t[col] = fabsf(s[col]) > 1e-8f ? m[3][col] / s[col] : 0.0f;
+    *position = (Vector3){
+        t[0] * r[0][0] + t[1] * r[0][1] + t[2] * r[0][2],
+        t[0] * r[1][0] + t[1] * r[1][1] + t[2] * r[1][2],
+        t[0] * r[2][0] + t[1] * r[2][1] + t[2] * r[2][2]
+    };
+}
+
 Matrix4x4 matrixMultiply(Matrix4x4 a, Matrix4x4 b) {
     Matrix4x4 result = { 0 };
     for (int i = 0; i < 4; i++) {
@@ -0,0 +1,437 @@
+#include "ecs.h"
+#include "thread_pool.h"
+#include "log.h"
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COLUMN_ALIGNMENT 16
+
+static const size_t componentSizes[COMPONENT_COUNT] = {
+    [COMPONENT_TRANSFORM] = sizeof(Transform),
+    [COMPONENT_RENDERABLE] = sizeof(Renderable),
+    [COMPONENT_LIGHT] = sizeof(Light),
+    [COMPONENT_AUDIO_EMITTER] = sizeof(AudioEmitter),
+    [COMPONENT_RIGID_BODY] = sizeof(RigidBody),
+    [COMPONENT_BOUNDS] = sizeof(Bounds),
+};
+
+struct EcsChunk {
+    unsigned char* memory;  // Entity ids, then one column per component
+    int count;
+    int archetype;
+    unsigned int versions[COMPONENT_COUNT];
+};
+
+typedef struct {
+    ComponentMask mask;
+    int offsets[COMPONENT_COUNT];  // Column offsets in chunk memory, -1 if absent
+    int chunkCapacity;             // Rows per chunk
+    EcsChunk** chunks;             // Every chunk but the last is full
+    int chunkCount;
+    int chunkSlots;
+} Archetype;
+
+typedef struct {
+    unsigned int generation;
+    int archetype;     // -1 while free
+    EcsChunk* chunk;
+    int row;
+    int nextFree;
+} EntityRecord;
+
+static struct {
+    Archetype* archetypes;
+    int archetypeCount;
+    int archetypeCapacity;
+
+    EntityRecord* records;
+    int recordCount;
+    int recordCapacity;
+    int freeRecord;
+
+    unsigned int version;
+
+    EcsChunk** matched;  // parallelForChunks scratch
+    int matchedCapacity;
+} world;
+
+static EcsStats stats;
+
+void initEcs(void) {
+    memset(&world, 0, sizeof(world));
+    world.freeRecord = -1;
+    world.version = 1;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void shutdownEcs(void) {
+    for (int a = 0; a < world.archetypeCount; a++) {
+        Archetype* archetype = &world.archetypes[a];
+        for (int c = 0; c < archetype->chunkCount; c++) {
+            free(archetype->chunks[c]->memory);
+            free(archetype->chunks[c]);
+        }
+        free(archetype->chunks);
+    }
+    free(world.archetypes);
+    free(world.records);
+    free(world.matched);
+    initEcs();
+}
+
+static bool growArray(void** array, int* capacity, int needed, size_t elementSize) {
+    if (needed <= *capacity) return true;
+    int grown = *capacity ? *capacity : ECS_INITIAL_CAPACITY;
+    while (grown < needed) grown *= 2;
+    void* memory = realloc(*array, (size_t)grown * elementSize);
+    if (!memory) return false;
+    *array = memory;
+    *capacity = grown;
+    return true;
+}
+
+static int findArchetype(ComponentMask mask) {
+    for (int a = 0; a < world.archetypeCount; a++) {
+        if (world.archetypes[a].mask == mask) return a;
+    }
+
+    if (!growArray((void**)&world.archetypes, &world.archetypeCapacity, world.archetypeCount + 1, sizeof(Archetype))) {
+        LOG_ERROR(LOG_SCENE, "Out of memory adding an ECS archetype");
+        return -1;
+    }
+
+    Archetype* archetype = &world.archetypes[world.archetypeCount];
+    memset(archetype, 0, sizeof(*archetype));
+    archetype->mask = mask;
+
+    // Rows that fit once every column is padded to its alignment
+    size_t rowBytes = sizeof(EntityId);
+    for (int c = 0; c < COMPONENT_COUNT; c++) {
+        if (mask & COMPONENT_BIT(c)) rowBytes += componentSizes[c];
+    }
+    int capacity = (int)((ECS_CHUNK_BYTES - COMPONENT_COUNT * COLUMN_ALIGNMENT) / rowBytes);
+    archetype->chunkCapacity = capacity > 0 ? capacity : 1;
+
+    size_t offset = (size_t)archetype->chunkCapacity * sizeof(EntityId);
+    for (int c = 0; c < COMPONENT_COUNT; c++) {
+        archetype->offsets[c] = -1;
+        if (!(mask & COMPONENT_BIT(c))) continue;
+        offset = (offset + COLUMN_ALIGNMENT - 1) & ~(size_t)(COLUMN_ALIGNMENT - 1);
+        archetype->offsets[c] = (int)offset;
+        offset += (size_t)archetype->chunkCapacity * componentSizes[c];
+    }
+    return world.archetypeCount++;
+}
+
+static void stampChunk(EcsChunk* chunk) {
+    for (int c = 0; c < COMPONENT_COUNT; c++) {
+        chunk->versions[c] = world.version;
+    }
+}
+
+static size_t chunkMemorySize(const Archetype* archetype) {
+    // A single huge component can overrun ECS_CHUNK_BYTES with one row
+    size_t size = ECS_CHUNK_BYTES;
+    for (int c = 0; c < COMPONENT_COUNT; c++) {
+        if (archetype->offsets[c] < 0) continue;
+        size_t end = (size_t)archetype->offsets[c] + archetype->chunkCapacity * componentSizes[c];
+        if (end > size) size = end;
+    }
+    return size;
+}
+
+static unsigned char* rowComponent(const Archetype* archetype, EcsChunk* chunk, int row, int type) {
+    return chunk->memory + archetype->offsets[type] + (size_t)row * componentSizes[type];
+}
+
+static EntityId* rowEntity(EcsChunk* chunk, int row) {
+    return (EntityId*)chunk->memory + row;
+}
+
+// Appends a zeroed row, returns NULL when out of memory
+static EcsChunk* allocateRow(int archetypeIndex, int* row) {
+    Archetype* archetype = &world.archetypes[archetypeIndex];
+    EcsChunk* chunk = archetype->chunkCount > 0 ? archetype->chunks[archetype->chunkCount - 1] : NULL;
+
+    if (!chunk || chunk->count == archetype->chunkCapacity) {
+        if (!growArray((void**)&archetype->chunks, &archetype->chunkSlots, archetype->chunkCount + 1, sizeof(EcsChunk*))) {
+            LOG_ERROR(LOG_SCENE, "Out of memory growing an ECS archetype");
+            return NULL;
+        }
+        chunk = malloc(sizeof(EcsChunk));
+        unsigned char* memory = chunk ? malloc(chunkMemorySize(archetype)) : NULL;
+        if (!memory) {
+            LOG_ERROR(LOG_SCENE, "Out of memory allocating an ECS chunk");
+            free(chunk);
+            return NULL;
+        }
+        chunk->memory = memory;
+        chunk->count = 0;
+        chunk->archetype = archetypeIndex;
+        archetype->chunks[archetype->chunkCount++] = chunk;
+    }
+
+    *row = chunk->count++;
+    for (int c = 0; c < COMPONENT_COUNT; c++) {
+        if (archetype->offsets[c] >= 0) memset(rowComponent(archetype, chunk, *row, c), 0, componentSizes[c]);
+    }
+    stampChunk(chunk);
+    return chunk;
+}
+
+// The archetype's last row moves into the gap, an emptied chunk is freed
+static void removeRow(EcsChunk* chunk, int row) {
+    Archetype* archetype = &world.archetypes[chunk->archetype];
+    EcsChunk* last = archetype->chunks[archetype->chunkCount - 1];
+    int lastRow = last->count - 1;
+
+    if (chunk != last || row != lastRow) {
+        EntityId moved = *rowEntity(last, lastRow);
+        *rowEntity(chunk, row) = moved;
+        for (int c = 0; c < COMPONENT_COUNT; c++) {
+            if (archetype->offsets[c] < 0) continue;
+            memcpy(rowComponent(archetype, chunk, row, c), rowComponent(archetype, last, lastRow, c), componentSizes[c]);
+        }
+        world.records[moved.index].chunk = chunk;
+        world.records[moved.index].row = row;
+    }
+
+    stampChunk(chunk);
+    stampChunk(last);
+    if (--last->count == 0) {
+        free(last->memory);
+        free(last);
+        archetype->chunkCount--;
+    }
+}
+
+static EntityRecord* findRecord(EntityId entity) {
+    if (entity.generation == 0 || entity.index >= (unsigned int)world.recordCount) return NULL;
+    EntityRecord* record = &world.records[entity.index];
+    return record->generation == entity.generation && record->archetype >= 0 ? record : NULL;
+}
+
+EntityId createEntity(ComponentMask components) {
+    int archetype = findArchetype(components);
+    if (archetype < 0) return INVALID_ENTITY;
+
+    int index = world.freeRecord;
+    if (index < 0) {
+        if (!growArray((void**)&world.records, &world.recordCapacity, world.recordCount + 1, sizeof(EntityRecord))) {
+            LOG_ERROR(LOG_SCENE, "Out of memory growing the ECS entity table");
+            return INVALID_ENTITY;
+        }
+        index = world.recordCount;
+        world.records[index].generation = 1;
+    }
+
+    int row;
+    EcsChunk* chunk = allocateRow(archetype, &row);
+    if (!chunk) return INVALID_ENTITY;
+
+    // Only taken once the row exists, a failure above leaves the tables as they were
+    if (index == world.freeRecord) world.freeRecord = world.records[index].nextFree;
+    else world.recordCount++;
+
+    EntityRecord* record = &world.records[index];
+    record->archetype = archetype;
+    record->chunk = chunk;
+    record->row = row;
+    record->nextFree = -1;
+
+    EntityId entity = { (unsigned int)index, record->generation };
+    *rowEntity(chunk, row) = entity;
+    stats.entities++;
+    return entity;
+}
+
+void destroyEntity(EntityId entity) {
+    EntityRecord* record = findRecord(entity);
+    if (!record) return;
+
+    removeRow(record->chunk, record->row);
+    record->archetype = -1;
+    record->chunk = NULL;
+    record->generation = record->generation == UINT_MAX ? 1 : record->generation + 1;
+    record->nextFree = world.freeRecord;
+    world.freeRecord = (int)entity.index;
+    stats.entities--;
+}
+
+bool isEntityAlive(EntityId entity) {
+    return findRecord(entity) != NULL;
+}
+
+// Shared components are copied, new ones start zeroed
+static bool moveEntity(EntityRecord* record, ComponentMask mask) {
+    int target = findArchetype(mask);
+    if (target < 0) return false;
+
+    int row;
+    EcsChunk* chunk = allocateRow(target, &row);
+    if (!chunk) return false;
+
+    // findArchetype may have moved the archetype array
+    const Archetype* from = &world.archetypes[record->archetype];
+    const Archetype* to = &world.archetypes[target];
+    *rowEntity(chunk, row) = *rowEntity(record->chunk, record->row);
+    for (int c = 0; c < COMPONENT_COUNT; c++) {
+        if (from->offsets[c] < 0 || to->offsets[c] < 0) continue;
+        memcpy(rowComponent(to, chunk, row, c), rowComponent(from, record->chunk, record->row, c), componentSizes[c]);
+    }
+
+    removeRow(record->chunk, record->row);
+    record->archetype = target;
+    record->chunk = chunk;
+    record->row = row;
+    return true;
+}
+
+bool addComponents(EntityId entity, ComponentMask components) {
+    EntityRecord* record = findRecord(entity);
+    if (!record) return false;
+    ComponentMask mask = world.archetypes[record->archetype].mask;
+    return (mask | components) == mask || moveEntity(record, mask | components);
+}
+
+bool removeComponents(EntityId entity, ComponentMask components) {
+    EntityRecord* record = findRecord(entity);
+    if (!record) return false;
+    ComponentMask mask = world.archetypes[record->archetype].mask;
+    return (mask & ~components) == mask || moveEntity(record, mask & ~components);
+}
+
+bool hasComponents(EntityId entity, ComponentMask components) {
+    EntityRecord* record = findRecord(entity);
+    return record && (world.archetypes[record->archetype].mask & components) == components;
+}
+
+const void* getComponent(EntityId entity, ComponentType type) {
+    EntityRecord* record = findRecord(entity);
+    if (!record) return NULL;
+    const Archetype* archetype = &world.archetypes[record->archetype];
+    return archetype->offsets[type] >= 0 ? rowComponent(archetype, record->chunk, record->row, type) : NULL;
+}
+
+void* writeComponent(EntityId entity, ComponentType type) {
+    EntityRecord* record = findRecord(entity);
+    if (!record) return NULL;
+    const Archetype* archetype = &world.archetypes[record->archetype];
+    if (archetype->offsets[type] < 0) return NULL;
+    record->chunk->versions[type] = world.version;
+    return rowComponent(archetype, record->chunk, record->row, type);
+}
+
+void* getChunkColumn(const ChunkView* view, ComponentType type) {
+    const Archetype* archetype = &world.archetypes[view->chunk->archetype];
+    return archetype->offsets[type] >= 0 ? view->chunk->memory + archetype->offsets[type] : NULL;
+}
+
+void markChunkChanged(const ChunkView* view, ComponentType type) {
+    view->chunk->versions[type] = world.version;
+}
+
+static bool matchesArchetype(const EntityQuery* query, const Archetype* archetype) {
+    return (archetype->mask & query->all) == query->all && (archetype->mask & query->none) == 0;
+}
+
+static bool chunkChanged(const EntityQuery* query, const EcsChunk* chunk) {
+    if (!query->changed) return true;
+    for (int c = 0; c < COMPONENT_COUNT; c++) {
+        if ((query->changed & COMPONENT_BIT(c)) && chunk->versions[c] > query->changedSince) return true;
+    }
+    return false;
+}
+
+static ChunkView makeView(EcsChunk* chunk) {
+    ChunkView view = { chunk, chunk->count, (const EntityId*)chunk->memory };
+    return view;
+}
+
+void forEachChunk(const EntityQuery* query, ChunkFunction function, void* data) {
+    int workerIndex = getJobThreadIndex();
+    for (int a = 0; a < world.archetypeCount; a++) {
+        const Archetype* archetype = &world.archetypes[a];
+        if (!matchesArchetype(query, archetype)) continue;
+        for (int c = 0; c < archetype->chunkCount; c++) {
+            EcsChunk* chunk = archetype->chunks[c];
+            if (!chunkChanged(query, chunk)) {
+                stats.chunksSkipped++;
+                continue;
+            }
+            stats.chunksVisited++;
+            ChunkView view = makeView(chunk);
+            function(&view, data, workerIndex);
+        }
+    }
+}
+
+typedef struct {
+    ChunkFunction function;
+    void* data;
+} ChunkJob;
+
+static void runChunkRange(void* data, int begin, int end, int workerIndex) {
+    const ChunkJob* job = data;
+    for (int i = begin; i < end; i++) {
+        ChunkView view = makeView(world.matched[i]);
+        job->function(&view, job->data, workerIndex);
+    }
+}
+
+void parallelForChunks(const EntityQuery* query, ChunkFunction function, void* data) {
+    int matched = 0;
+    for (int a = 0; a < world.archetypeCount; a++) {
+        const Archetype* archetype = &world.archetypes[a];
+        if (!matchesArchetype(query, archetype)) continue;
+        if (!growArray((void**)&world.matched, &world.matchedCapacity, matched + archetype->chunkCount, sizeof(EcsChunk*))) {
+            LOG_WARN(LOG_SCENE, "Out of memory gathering ECS chunks, running the query serially");
+            forEachChunk(query, function, data);
+            return;
+        }
+        for (int c = 0; c < archetype->chunkCount; c++) {
+            EcsChunk* chunk = archetype->chunks[c];
+            if (chunkChanged(query, chunk)) world.matched[matched++] = chunk;
+            else stats.chunksSkipped++;
+        }
+    }
+    stats.chunksVisited += matched;
+
+    ChunkJob job = { function, data };
+    parallelFor(matched, 1, runChunkRange, &job);
+}
+
+int countEntities(const EntityQuery* query) {
+    int count = 0;
+    for (int a = 0; a < world.archetypeCount; a++) {
+        const Archetype* archetype = &world.archetypes[a];
+        if (!matchesArchetype(query, archetype)) continue;
+        for (int c = 0; c < archetype->chunkCount; c++) {
+            if (chunkChanged(query, archetype->chunks[c])) count += archetype->chunks[c]->count;
+        }
+    }
+    return count;
+}
+
+unsigned int beginSystemRun(unsigned int* lastRun) {
+    unsigned int since = *lastRun;
+    *lastRun = world.version++;
+    return since;
+}
+
+void resetEcsStats(void) {
+    stats.chunksVisited = 0;
+    stats.chunksSkipped = 0;
+}
+
+const EcsStats* getEcsStats(void) {
+    stats.archetypes = world.archetypeCount;
+    stats.chunks = 0;
+    for (int a = 0; a < world.archetypeCount; a++) {
+        stats.chunks += world.archetypes[a].chunkCount;
+    }
+    return &stats;
+}
@@ -5,16 +5,19 @@
 #include "ObjectManager.h"
 #include "lightshading.h"
 #include "SceneObject.h"
+#include "model_registry.h"
+#include "simulation.h"
+#include "ecs.h"
+#include "actions.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "file_operations/tinyfiledialogs.h"
 #include "cJSON/cJSON.h"
+#include "log.h"
 
 extern Camera camera;
 extern ObjectManager objectManager;
-extern Light lights[MAX_LIGHTS];
-extern int lightCount;
 
 const char* getMaterialName(PBRMaterial* material) {
     for (int i = 0; i < materialCount; i++) {
@@ -37,6 +40,105 @@ const char* object_type_to_string(ObjectType type) {
     }
 }
 
+static double jsonNumber(const cJSON* object, const char* key, double fallback) {
+    const cJSON* item = cJSON_GetObjectItem(object, key);
+    return cJSON_IsNumber(item) ? item->valuedouble : fallback;
+}
+
+static void addVectorToObject(cJSON* object, const char* prefix, Vector3 value) {
+    char key[64];
+    snprintf(key, sizeof(key), "%sX", prefix);
+    cJSON_AddNumberToObject(object, key, value.x);
+    snprintf(key, sizeof(key), "%sY", prefix);
+    cJSON_AddNumberToObject(object, key, value.y);
+    snprintf(key, sizeof(key), "%sZ", prefix);
+    cJSON_AddNumberToObject(object, key, value.z);
+}
+
+static Vector3 getVectorFromObject(const cJSON* object, const char* prefix) {
+    char keyX[64], keyY[64], keyZ[64];
+    snprintf(keyX, sizeof(keyX), "%sX", prefix);
+    snprintf(keyY, sizeof(keyY), "%sY", prefix);
+    snprintf(keyZ, sizeof(keyZ), "%sZ", prefix);
+    return vector((float)jsonNumber(object, keyX, 0.0), (float)jsonNumber(object, keyY, 0.0), (float)jsonNumber(object, keyZ, 0.0));
+}
+
+// Components beyond Transform, Renderable and Bounds
+static void saveObjectComponents(cJSON* jsonObject, const SceneObject* obj) {
+    const RigidBody* body = getComponent(obj->entity, COMPONENT_RIGID_BODY);
+    if (body) {
+        cJSON* jsonBody = cJSON_AddObjectToObject(jsonObject, "rigidBody");
+        addVectorToObject(jsonBody, "velocity", body->velocity);
+        addVectorToObject(jsonBody, "angularVelocity", body->angularVelocity);
+        cJSON_AddNumberToObject(jsonBody, "mass", body->mass);
+    }
+
+    const AudioEmitter* emitter = getComponent(obj->entity, COMPONENT_AUDIO_EMITTER);
+    if (emitter) {
+        cJSON* jsonEmitter = cJSON_AddObjectToObject(jsonObject, "audioEmitter");
+        cJSON_AddStringToObject(jsonEmitter, "clip", emitter->clip);
+        cJSON_AddNumberToObject(jsonEmitter, "volume", emitter->volume);
+        cJSON_AddNumberToObject(jsonEmitter, "pitch", emitter->pitch);
+        cJSON_AddBoolToObject(jsonEmitter, "looping", emitter->looping);
+        cJSON_AddBoolToObject(jsonEmitter, "autoplay", emitter->autoplay);
+    }
+}
+
+static void loadObjectComponents(const cJSON* jsonObject, const SceneObject* obj) {
+    const cJSON* jsonBody = cJSON_GetObjectItem(jsonObject, "rigidBody");
+    if (cJSON_IsObject(jsonBody) && addComponents(obj->entity, COMPONENT_BIT(COMPONENT_RIGID_BODY))) {
+        RigidBody* body = writeComponent(obj->entity, COMPONENT_RIGID_BODY);
+        body->velocity = getVectorFromObject(jsonBody, "velocity");
+        body->angularVelocity = getVectorFromObject(jsonBody, "angularVelocity");
+        body->mass = (float)jsonNumber(jsonBody, "mass", 1.0);
+    }
+
+    const cJSON* jsonEmitter = cJSON_GetObjectItem(jsonObject, "audioEmitter");
+    if (cJSON_IsObject(jsonEmitter) && addComponents(obj->entity, COMPONENT_BIT(COMPONENT_AUDIO_EMITTER))) {
+        AudioEmitter* emitter = writeComponent(obj->entity, COMPONENT_AUDIO_EMITTER);
+        const cJSON* clip = cJSON_GetObjectItem(jsonEmitter, "clip");
+        if (cJSON_IsString(clip)) {
+            strncpy(emitter->clip, clip->valuestring, sizeof(emitter->clip) - 1);
+        }
+        emitter->volume = (float)jsonNumber(jsonEmitter, "volume", 1.0);
+        emitter->pitch = (float)jsonNumber(jsonEmitter, "pitch", 1.0);
+        emitter->looping = cJSON_IsTrue(cJSON_GetObjectItem(jsonEmitter, "looping"));
+        emitter->autoplay = cJSON_IsTrue(cJSON_GetObjectItem(jsonEmitter, "autoplay"));
+        emitter->sourceIndex = -1;
+    }
+}
+
+static void saveLightChunk(const ChunkView* view, void* data, int workerIndex) {
+    (void)workerIndex;
+    cJSON* lightsArray = data;
+    const Transform* transforms = getChunkColumn(view, COMPONENT_TRANSFORM);
+    const Light* chunkLights = getChunkColumn(view, COMPONENT_LIGHT);
+
+    for (int i = 0; i < view->count; i++) {
+        const Light* light = &chunkLights[i];
+        cJSON* jsonLight = cJSON_CreateObject();
+
+        cJSON_AddNumberToObject(jsonLight, "type", light->type);
+        cJSON_AddNumberToObject(jsonLight, "positionX", transforms[i].position.x);
+        cJSON_AddNumberToObject(jsonLight, "positionY", transforms[i].position.y);
+        cJSON_AddNumberToObject(jsonLight, "positionZ", transforms[i].position.z);
+        cJSON_AddNumberToObject(jsonLight, "directionX", light->direction.x);
+        cJSON_AddNumberToObject(jsonLight, "directionY", light->direction.y);
+        cJSON_AddNumberToObject(jsonLight, "directionZ", light->direction.z);
+        cJSON_AddNumberToObject(jsonLight, "colorR", light->color.x);
+        cJSON_AddNumberToObject(jsonLight, "colorG", light->color.y);
+        cJSON_AddNumberToObject(jsonLight, "colorB", light->color.z);
+        cJSON_AddNumberToObject(jsonLight, "intensity", light->intensity);
+        cJSON_AddNumberToObject(jsonLight, "constant", light->constant);
+        cJSON_AddNumberToObject(jsonLight, "linear", light->linear);
+        cJSON_AddNumberToObject(jsonLight, "quadratic", light->quadratic);
+        cJSON_AddNumberToObject(jsonLight, "cutOff", light->cutOff);
+        cJSON_AddNumberToObject(jsonLight, "outerCutOff", light->outerCutOff);
+
+        cJSON_AddItemToArray(lightsArray, jsonLight);
+    }
+}
+
 ObjectType string_to_object_type(const char* type) {
     if (strcmp(type, "cube") == 0) return OBJ_CUBE;
     if (strcmp(type, "sphere") == 0) return OBJ_SPHERE;
@@ -58,7 +160,7 @@ void save_project() {
     );
 
     if (!savePath) {
-        fprintf(stderr, "Save operation cancelled or failed to get a valid path.\n");
+        LOG_ERROR(LOG_ASSETS, "Save operation cancelled or failed to get a valid path.");
         return;
     }
 
@@ -89,39 +191,24 @@ void save_project() {
         cJSON_AddNumberToObject(jsonObject, "textureID", obj->object.textureID);
         cJSON_AddNumberToObject(jsonObject, "usePBR", obj->object.usePBR);
         cJSON_AddStringToObject(jsonObject, "materialName", getMaterialName(&obj->object.material));
+        cJSON_AddNumberToObject(jsonObject, "isStatic", obj->isStatic);
 
         if (obj->object.type == OBJ_MODEL) {
-            cJSON_AddStringToObject(jsonObject, "modelPath", obj->object.data.model.path);
+            cJSON_AddStringToObject(jsonObject, "modelPath", obj->object.data.model ? obj->object.data.model->path : "");
         }
+        saveObjectComponents(jsonObject, obj);
+
+        // Objects are saved in dense order, so the parent is its index in this array
+        int parentIndex = getObjectIndex(getObjectParent(obj->handle));
+        if (parentIndex >= 0) cJSON_AddNumberToObject(jsonObject, "parent", parentIndex);
 
         cJSON_AddItemToArray(objectsArray, jsonObject);
     }
 
     // Save Lights
     cJSON* lightsArray = cJSON_AddArrayToObject(root, "lights");
-    for (int i = 0; i < lightCount; i++) {
-        Light* light = &lights[i];
-        cJSON* jsonLight = cJSON_CreateObject();
-
-        cJSON_AddNumberToObject(jsonLight, "type", light->type);
-        cJSON_AddNumberToObject(jsonLight, "positionX", light->position.x);
-        cJSON_AddNumberToObject(jsonLight, "positionY", light->position.y);
-        cJSON_AddNumberToObject(jsonLight, "positionZ", light->position.z);
-        cJSON_AddNumberToObject(jsonLight, "directionX", light->direction.x);
-        cJSON_AddNumberToObject(jsonLight, "directionY", light->direction.y);
-        cJSON_AddNumberToObject(jsonLight, "directionZ", light->direction.z);
-        cJSON_AddNumberToObject(jsonLight, "colorR", light->color.x);
-        cJSON_AddNumberToObject(jsonLight, "colorG", light->color.y);
-        cJSON_AddNumberToObject(jsonLight, "colorB", light->color.z);
-        cJSON_AddNumberToObject(jsonLight, "intensity", light->intensity);
-        cJSON_AddNumberToObject(jsonLight, "constant", light->constant);
-        cJSON_AddNumberToObject(jsonLight, "linear", light->linear);
-        cJSON_AddNumberToObject(jsonLight, "quadratic", light->quadratic);
-        cJSON_AddNumberToObject(jsonLight, "cutOff", light->cutOff);
-        cJSON_AddNumberToObject(jsonLight, "outerCutOff", light->outerCutOff);
-
-        cJSON_AddItemToArray(lightsArray, jsonLight);
-    }
+    EntityQuery lightQuery = { LIGHT_COMPONENTS, 0, 0, 0 };
+    forEachChunk(&lightQuery, saveLightChunk, lightsArray);
 
     // Save Camera
     cJSON* cameraObject = cJSON_AddObjectToObject(root, "camera");
@@ -183,13 +270,13 @@ void load_project() {
     );
 
     if (!loadPath) {
-        fprintf(stderr, "Load operation cancelled or failed to get a valid path.\n");
+        LOG_ERROR(LOG_ASSETS, "Load operation cancelled or failed to get a valid path.");
         return;
     }
 
     FILE* file = fopen(loadPath, "r");
     if (!file) {
-        fprintf(stderr, "Failed to open file.\n");
+        LOG_ERROR(LOG_ASSETS, "Failed to open file.");
         return;
     }
 
@@ -199,7 +286,7 @@ void load_project() {
 
     char* jsonString = malloc(length + 1);
     if (!jsonString) {
-        fprintf(stderr, "Failed to allocate memory for JSON string.\n");
+        LOG_ERROR(LOG_ASSETS, "Failed to allocate memory for JSON string.");
         fclose(file);
         return;
     }
@@ -210,21 +297,32 @@ void load_project() {
 
     cJSON* root = cJSON_Parse(jsonString);
     if (!root) {
-        fprintf(stderr, "Failed to parse JSON file.\n");
+        LOG_ERROR(LOG_ASSETS, "Failed to parse JSON file.");
         free(jsonString);
         return;
     }
 
-    // Clear current objects and lights
+    // Clear current objects and lights, undo entries name objects that are gone
     cleanupObjects();
-    lightCount = 0;
+    clearLights();
+    clearUndoHistory();
 
     // Load Objects
     cJSON* objectsArray = cJSON_GetObjectItem(root, "objects");
     if (objectsArray) {
         int arraySize = cJSON_GetArraySize(objectsArray);
+        SceneObject* states = arraySize > 0 ? (SceneObject*)malloc(arraySize * sizeof(SceneObject)) : NULL;
+        ObjectHandle* loadedHandles = arraySize > 0 ? (ObjectHandle*)calloc(arraySize, sizeof(ObjectHandle)) : NULL;
+        int* stateOf = arraySize > 0 ? (int*)malloc(arraySize * sizeof(int)) : NULL;  // Array index to state, -1 when skipped
+        if (arraySize > 0 && (!states || !loadedHandles || !stateOf)) {
+            LOG_ERROR(LOG_ASSETS, "Out of memory loading %d objects", arraySize);
+            arraySize = 0;
+        }
+
+        int stateCount = 0;
         for (int i = 0; i < arraySize; i++) {
             cJSON* jsonObject = cJSON_GetArrayItem(objectsArray, i);
+            stateOf[i] = -1;
 
             ObjectType type = string_to_object_type(cJSON_GetObjectItem(jsonObject, "type")->valuestring);
             Vector3 position = {
@@ -255,30 +353,57 @@ void load_project() {
 
             PBRMaterial* material = getMaterial(materialName);
             if (!material) {
-                printf("Warning: Material '%s' not found. Using default material 'peacockOre'.\n", materialName);
+                LOG_WARN(LOG_ASSETS, "Material '%s' not found. Using default material 'peacockOre'.", materialName);
                 material = getMaterial("peacockOre");
             }
 
+            Model* model = NULL;
             if (type == OBJ_MODEL) {
                 const char* modelPath = cJSON_GetObjectItem(jsonObject, "modelPath")->valuestring;
-                Model* model = loadModel(modelPath);
-                if (model) {
-                    addObject(&camera, type, useTexture, textureID, true, model, *material, usePBR);
-                }
-                else {
-                    printf("Error: Failed to load model from path: %s\n", modelPath);
+                // Objects sharing a model path reuse one import
+                model = acquireModel(modelPath);
+                if (!model) {
+                    LOG_ERROR(LOG_ASSETS, "Failed to load model from path: %s", modelPath);
+                    continue;
                 }
             }
-            else {
-                addObject(&camera, type, useTexture, textureID, true, NULL, *material, usePBR);
-            }
 
-            SceneObject* newObj = &objectManager.objects[objectManager.count - 1];
-            newObj->position = position;
-            newObj->rotation = rotation;
-            newObj->scale = scale;
-            newObj->color = color;
+            SceneObject state = makeSceneObject(&camera, type, useTexture, textureID, true, model, *material, usePBR);
+            state.position = position;
+            state.rotation = rotation;
+            state.scale = scale;
+            state.color = color;
+
+            // Older projects have no static flag
+            cJSON* isStaticItem = cJSON_GetObjectItem(jsonObject, "isStatic");
+            state.isStatic = isStaticItem && isStaticItem->valueint;
+            stateOf[i] = stateCount;
+            states[stateCount++] = state;
+        }
+
+        // One batch, so each primitive type uploads its geometry once
+        addObjectsToManager(states, stateCount, loadedHandles);
+        for (int i = 0; i < stateCount; i++) {
+            // The objects hold their own references now
+            if (states[i].object.type == OBJ_MODEL) releaseModel(states[i].object.data.model);
+        }
+
+        for (int i = 0; i < arraySize; i++) {
+            SceneObject* newObj = stateOf[i] >= 0 ? getObject(loadedHandles[stateOf[i]]) : NULL;
+            if (newObj) loadObjectComponents(cJSON_GetArrayItem(objectsArray, i), newObj);
+        }
+
+        // Parents may come later in the array, so links go in once every object exists
+        for (int i = 0; i < arraySize; i++) {
+            int parentIndex = (int)jsonNumber(cJSON_GetArrayItem(objectsArray, i), "parent", -1.0);
+            if (stateOf[i] < 0 || parentIndex < 0 || parentIndex >= arraySize || stateOf[parentIndex] < 0) continue;
+            if (!setObjectParent(loadedHandles[stateOf[i]], loadedHandles[stateOf[parentIndex]])) {
+                LOG_WARN(LOG_ASSETS, "Object %d could not be attached to object %d.", i, parentIndex);
+            }
         }
+        free(states);
+        free(loadedHandles);
+        free(stateOf);
     }
 
     // Load Lights
@@ -334,6 +459,7 @@ void load_project() {
         camera.MouseSensitivity = cJSON_GetObjectItem(cameraObject, "mouseSensitivity")->valuedouble;
         camera.Zoom = cJSON_GetObjectItem(cameraObject, "zoom")->valuedouble;
         camera.invertY = cJSON_GetObjectItem(cameraObject, "invertY")->valueint;
+        cameraEdited();
     }
 
     cJSON_Delete(root);
@@ -343,7 +469,8 @@ void load_project() {
 
 void new_project() {
     cleanupObjects();
-    lightCount = 0;
+    clearLights();
+    clearUndoHistory();
     selected_object = NULL; // Reset the selected object
 
     // Optionally reset other state variables as needed
@@ -359,6 +486,7 @@ void new_project() {
     camera.Zoom = 45.0f;
     camera.invertY = false;
     camera.mode = CAMERA_MODE_ORBIT;
+    cameraEdited();
 
     backgroundEnabled = true;
     isRunning = false; // Start paused
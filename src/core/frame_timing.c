@@ -0,0 +1,155 @@
+#include "frame_timing.h"
+#include "simulation.h"
+#include "threading.h"
+#include "Camera.h"
+#include "rendering.h"
+#include "globals.h"
+#include "log.h"
+#include <stdio.h>
+
+#define CAP_SPIN_SECONDS 0.002 // Sleep granularity, the last stretch before the deadline is spun
+
+FrameTimingSettings frameTiming = { DEFAULT_TICK_RATE, DEFAULT_MAX_CATCH_UP_TICKS, true, 0 };
+
+static FrameTimingStats stats;
+static double accumulator = 0.0;
+static Vector3 previousPosition;
+static Vector3 tickMovement;      // Of the last tick
+static Vector3 simulatedPosition;
+static Vector3 renderedPosition;
+static bool interpolating = false;
+static Camera simulatedCamera;    // Put back after a threaded render
+static bool drawingAhead = false; // The global camera holds a render-only copy
+static int appliedVsync = -1;
+static double nextFrameDeadline = 0.0;
+
+double getTickLength(void) {
+    int rate = frameTiming.tickRate > 0 ? frameTiming.tickRate : DEFAULT_TICK_RATE;
+    return 1.0 / rate;
+}
+
+int beginFrameTicks(double frameTime) {
+    double tick = getTickLength();
+    int maxTicks = frameTiming.maxCatchUpTicks > 0 ? frameTiming.maxCatchUpTicks : 1;
+
+    stats.frameTime = frameTime;
+    accumulator += frameTime > 0.0 ? frameTime : 0.0;
+    int ticks = (int)(accumulator / tick);
+    if (ticks > maxTicks) {
+        // Keep the fraction toward the next tick, drop whole ticks we can't afford
+        double kept = accumulator - ticks * tick;
+        stats.droppedTime += (ticks - maxTicks) * tick;
+        ticks = maxTicks;
+        accumulator = ticks * tick + kept;
+    }
+    accumulator -= ticks * tick;
+    stats.ticks = ticks;
+    return ticks;
+}
+
+float getTickAlpha(void) {
+    float alpha = (float)(accumulator / getTickLength());
+    return alpha > 1.0f ? 1.0f : alpha;
+}
+
+void beginTick(void) {
+    previousPosition = camera.Position;
+    interpolating = true;
+}
+
+void endTick(void) {
+    tickMovement = vector_sub(camera.Position, previousPosition);
+}
+
+void snapCameraInterpolation(void) {
+    interpolating = false;
+}
+
+void applyRenderCamera(void) {
+    simulatedPosition = camera.Position;
+    renderedPosition = camera.Position;
+    // The simulation thread publishes its camera in whole ticks and a step
+    // behind the input, so it is drawn with that input applied instead
+    drawingAhead = getSimulationStats()->threaded;
+    if (drawingAhead) {
+        simulatedCamera = camera;
+        applyUnsimulatedInput(&camera);
+        return;
+    }
+    if (!interpolating) return;
+
+    // Back off the part of the last tick's movement not yet due, so mouse
+    // pans applied since the tick still show in full
+    float alpha = getTickAlpha();
+    camera.Position = vector_sub(simulatedPosition, vector_scale(tickMovement, 1.0f - alpha));
+    renderedPosition = camera.Position;
+}
+
+void refreshRenderCamera(void) {
+    if (!drawingAhead) return;
+    camera = simulatedCamera;
+    applyUnsimulatedInput(&camera);
+}
+
+void restoreSimulatedCamera(void) {
+    // The step applies the input itself, the copy goes
+    if (drawingAhead) {
+        camera = simulatedCamera;
+        drawingAhead = false;
+        return;
+    }
+    // Keeps input applied during render(), latency mode samples the mouse there
+    camera.Position = vector_add(simulatedPosition, vector_sub(camera.Position, renderedPosition));
+}
+
+void paceFrame(void) {
+    int vsync = frameTiming.vsync ? 1 : 0;
+    if (vsync != appliedVsync) {
+        glfwSwapInterval(vsync);
+        appliedVsync = vsync;
+    }
+
+    if (frameTiming.frameRateCap <= 0) {
+        nextFrameDeadline = 0.0;
+        return;
+    }
+
+    double interval = 1.0 / frameTiming.frameRateCap;
+    double now = glfwGetTime();
+    // Start over after a hitch rather than rushing frames out to catch up
+    if (nextFrameDeadline <= 0.0 || now - nextFrameDeadline > interval) {
+        nextFrameDeadline = now;
+    }
+    nextFrameDeadline += interval;
+
+    double remaining = nextFrameDeadline - now;
+    if (remaining > CAP_SPIN_SECONDS) sleepSeconds(remaining - CAP_SPIN_SECONDS);
+    while (glfwGetTime() < nextFrameDeadline) {
+        // Spin the last stretch, sleeps overshoot by about a millisecond
+    }
+}
+
+void runBatchTicks(int ticks) {
+    double tick = getTickLength();
+    bool wasRunning = isRunning;
+    isRunning = true;
+
+    double start = glfwGetTime();
+    for (int i = 0; i < ticks; i++) {
+        beginTick();
+        update(tick);
+        endTick();
+        startSimulationStep(1);
+        finishSimulationStep();
+    }
+    double elapsed = glfwGetTime() - start;
+    isRunning = wasRunning;
+
+    double simulated = ticks * tick;
+    LOG_INFO(LOG_CORE, "Batch: %d ticks, %.2f s simulated in %.3f s (%.1fx real time)",
+        ticks, simulated, elapsed, elapsed > 0.0 ? simulated / elapsed : 0.0);
+}
+
+const FrameTimingStats* getFrameTimingStats(void) {
+    return &stats;
+}
@@ -1,6 +1,11 @@
 #include "gui.h"
 #include "rendering.h"
 #include "globals.h"
+#include "simulation.h"
+#include "frame_timing.h"
+#include "latency.h"
+#include "log.h"
+#include <stdlib.h>
 
 // AUDIO SYSTEM INTEGRATION
 #ifdef AUDIO_ENABLED
@@ -13,10 +18,20 @@ int main(void) {
         ShowWindow(GetConsoleWindow(), SW_HIDE);  // Hide console only on Windows
     #endif
 
-    printf("=== ClueEngine v1.1.0 Starting ===\n");
+    initLogging();  // First, so setup's messages already go through the log thread
+    LOG_INFO(LOG_CORE, "=== ClueEngine v1.1.0 Starting ===");
     
     setup();  // Set up OpenGL context, load shaders, and other resources
 
+    // Batch mode: CLUE_BATCH_TICKS=N runs N ticks back to back without rendering and exits
+    const char* batchTicks = getenv("CLUE_BATCH_TICKS");
+    if (batchTicks && atoi(batchTicks) > 0) {
+        runBatchTicks(atoi(batchTicks));
+        end();
+        shutdownLogging();
+        return 0;
+    }
+
     initLoadingScreen(screen.window);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  // Clear buffers to set initial background
     glfwSwapBuffers(screen.window);  // Display the initial cleared screen
@@ -24,36 +39,53 @@ int main(void) {
     glfwSetKeyCallback(screen.window, key_callback);  // Set key callbacks for user input
     glfwSetFramebufferSizeCallback(screen.window, framebuffer_size_callback); // Handle window resizing
 
-    printf("Engine initialization complete!\n");
+    LOG_INFO(LOG_CORE, "Engine initialization complete!");
     
     #ifdef AUDIO_ENABLED
-    printf("Audio system: ENABLED\n");
+    LOG_INFO(LOG_CORE, "Audio system: ENABLED");
     #else
-    printf("Audio system: DISABLED\n");
+    LOG_INFO(LOG_CORE, "Audio system: DISABLED");
     #endif
 
     while (!glfwWindowShouldClose(screen.window)) {
+        waitForFrameSlot();  // Latency mode keeps the GPU queue short before input is read
+        finishSimulationStep();  // The scene is ours again, last frame's step is published
         glfwPollEvents();  // Handle GLFW events such as input and window actions
+        markInputSampled();
 
         generate_new_frame();
 
-        if (isRunning) {
-            update(calculateDeltaTime());  // Update game logic only if the simulation is running
+        // Spend the frame's time in fixed ticks so game logic doesn't depend on the frame rate
+        int ticks = beginFrameTicks(calculateDeltaTime());
+        for (int i = 0; i < ticks; i++) {
+            beginTick();
+            if (isRunning) {
+                update(getTickLength());  // Update game logic only if the simulation is running
+            }
+            endTick();
         }
 
-        handleMouseInput(screen.window, &camera);  // Manage mouse input for camera control
+        handleMouseInput(screen.window);  // Manage mouse input for camera control
+        main_gui();  // Update the GUI elements, its edits go into this frame's step
+        prepareFrame();  // Model imports and uploads land before the step reads their bounds
+        startSimulationStep(ticks);  // On the simulation thread it runs alongside rendering
+
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  // Clear the screen each frame
+        applyRenderCamera();  // Draw the camera between the last two ticks
         render();  // Render the scene, including the loaded model if any
+        restoreSimulatedCamera();
 
-        main_gui();  // Update the GUI elements
         render_nuklear();  // Render the GUI to the screen
 
         glfwSwapBuffers(screen.window);  // Swap the front and back buffers
+        markFramePresented();  // Fence for frames in flight and latency measurement
+        paceFrame();  // Vsync changes and the frame-rate cap
     }
 
-    printf("Shutting down ClueEngine...\n");
+    LOG_INFO(LOG_CORE, "Shutting down ClueEngine...");
     teardown_nuklear();  // Clean up Nuklear GUI resources
     end();  // Clean up OpenGL and other resources
-    printf("ClueEngine shutdown complete.\n");
+    LOG_INFO(LOG_CORE, "ClueEngine shutdown complete.");
+    shutdownLogging();  // Writes whatever is still queued
     return 0;
 }
\ No newline at end of file
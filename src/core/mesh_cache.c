@@ -0,0 +1,285 @@
+#include "mesh_cache.h"
+#include "log.h"
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+bool mapFile(const char* path, MappedFile* file) {
+    memset(file, 0, sizeof(*file));
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+        CloseHandle(handle);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(handle);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(handle);
+        return false;
+    }
+
+    file->data = (const unsigned char*)view;
+    file->size = (size_t)size.QuadPart;
+    file->fileHandle = handle;
+    file->mappingHandle = mapping;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping stays valid after the descriptor is closed
+    if (view == MAP_FAILED) return false;
+
+    file->data = (const unsigned char*)view;
+    file->size = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+void unmapFile(MappedFile* file) {
+    if (!file->data) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile((void*)file->data);
+    CloseHandle((HANDLE)file->mappingHandle);
+    CloseHandle((HANDLE)file->fileHandle);
+#else
+    munmap((void*)file->data, file->size);
+#endif
+    memset(file, 0, sizeof(*file));
+}
+
+uint64_t hashMemory(const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+bool hashFile(const char* path, uint64_t* hash) {
+    MappedFile file;
+    if (!mapFile(path, &file)) return false;
+
+    *hash = hashMemory(file.data, file.size);
+    unmapFile(&file);
+    return true;
+}
+
+void getMeshCachePath(const char* modelPath, char* out, size_t outSize) {
+    snprintf(out, outSize, "%s%s", modelPath, MESH_CACHE_EXTENSION);
+}
+
+static size_t alignOffset(size_t offset) {
+    return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(size_t)(MESH_CACHE_ALIGNMENT - 1);
+}
+
+static unsigned int indexSize(GLenum indexType) {
+    return indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+// Rejects truncated or corrupt caches before any blob is handed to GL
+static bool validateEntry(const MeshCacheEntry* entry, const unsigned char* fileData, size_t fileSize) {
+    if (entry->indexType != GL_UNSIGNED_SHORT && entry->indexType != GL_UNSIGNED_INT) return false;
+    if (entry->vertexStride != sizeof(PackedVertex)) return false;
+    if (entry->lodCount == 0 || entry->lodCount > MAX_LOD_LEVELS) return false;
+
+    uint64_t lodIndices = 0;
+    for (uint32_t level = 0; level < entry->lodCount; level++) lodIndices += entry->lodIndexCount[level];
+    if (lodIndices != entry->numIndices) return false;
+
+    uint64_t vertexBytes = (uint64_t)entry->numVertices * entry->vertexStride;
+    uint64_t indexBytes = (uint64_t)entry->numIndices * indexSize(entry->indexType);
+    uint64_t meshletBytes = (uint64_t)entry->meshletCount * sizeof(Meshlet);
+    if (entry->vertexOffset > fileSize || vertexBytes > fileSize - entry->vertexOffset ||
+        entry->indexOffset > fileSize || indexBytes > fileSize - entry->indexOffset ||
+        entry->meshletOffset > fileSize || meshletBytes > fileSize - entry->meshletOffset) {
+        return false;
+    }
+
+    // Meshlets must stay inside level 0
+    const Meshlet* meshlets = (const Meshlet*)(fileData + entry->meshletOffset);
+    for (uint32_t i = 0; i < entry->meshletCount; i++) {
+        if (meshlets[i].firstIndex > entry->lodIndexCount[0] ||
+            meshlets[i].indexCount > entry->lodIndexCount[0] - meshlets[i].firstIndex) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Maps a matching cache and points the MeshData blobs straight into it
+bool mapMeshCache(const char* modelPath, uint64_t contentHash, ImportedModel* out) {
+    char cachePath[512];
+    getMeshCachePath(modelPath, cachePath, sizeof(cachePath));
+
+    MappedFile file;
+    if (!mapFile(cachePath, &file)) return false;
+
+    const MeshCacheHeader* header = (const MeshCacheHeader*)file.data;
+    if (file.size < sizeof(MeshCacheHeader) ||
+        header->magic != MESH_CACHE_MAGIC ||
+        header->version != MESH_CACHE_VERSION ||
+        header->contentHash != contentHash ||
+        header->meshCount == 0 ||
+        (file.size - sizeof(MeshCacheHeader)) / sizeof(MeshCacheEntry) < header->meshCount) {
+        unmapFile(&file);
+        return false;
+    }
+
+    const MeshCacheEntry* entries = (const MeshCacheEntry*)(file.data + sizeof(MeshCacheHeader));
+    for (uint32_t i = 0; i < header->meshCount; i++) {
+        if (!validateEntry(&entries[i], file.data, file.size)) {
+            LOG_WARN(LOG_ASSETS, "Mesh cache %s is corrupt, re-importing", cachePath);
+            unmapFile(&file);
+            return false;
+        }
+    }
+
+    out->meshes = (MeshData*)calloc(header->meshCount, sizeof(MeshData));
+    out->cacheFile = (MappedFile*)malloc(sizeof(MappedFile));
+    if (!out->meshes || !out->cacheFile) {
+        free(out->meshes);
+        free(out->cacheFile);
+        out->meshes = NULL;
+        out->cacheFile = NULL;
+        unmapFile(&file);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header->meshCount; i++) {
+        MeshData* data = &out->meshes[i];
+        data->vertices = file.data + entries[i].vertexOffset;
+        data->indices = file.data + entries[i].indexOffset;
+        data->numVertices = entries[i].numVertices;
+        data->numIndices = entries[i].numIndices;
+        data->vertexStride = entries[i].vertexStride;
+        data->indexType = (GLenum)entries[i].indexType;
+        data->lodCount = entries[i].lodCount;
+        memcpy(data->lodIndexCount, entries[i].lodIndexCount, sizeof(data->lodIndexCount));
+        data->meshlets = (const Meshlet*)(file.data + entries[i].meshletOffset);
+        data->meshletCount = entries[i].meshletCount;
+    }
+    out->meshCount = header->meshCount;
+    *out->cacheFile = file;
+
+    LOG_DEBUG(LOG_ASSETS, "Mapped %u meshes from cache %s", out->meshCount, cachePath);
+    return true;
+}
+
+static bool writePadding(FILE* file, size_t* offset) {
+    static const unsigned char zeros[MESH_CACHE_ALIGNMENT] = { 0 };
+    size_t aligned = alignOffset(*offset);
+    if (aligned != *offset && fwrite(zeros, 1, aligned - *offset, file) != aligned - *offset) return false;
+    *offset = aligned;
+    return true;
+}
+
+bool writeMeshCache(const char* modelPath, uint64_t contentHash, const MeshData* meshes, unsigned int meshCount) {
+    if (!meshes || meshCount == 0) return false;
+
+    MeshCacheEntry* entries = (MeshCacheEntry*)calloc(meshCount, sizeof(MeshCacheEntry));
+    if (!entries) return false;
+
+    // Lay out the blobs after the table, each one aligned
+    size_t offset = sizeof(MeshCacheHeader) + meshCount * sizeof(MeshCacheEntry);
+    for (unsigned int i = 0; i < meshCount; i++) {
+        entries[i].numVertices = meshes[i].numVertices;
+        entries[i].numIndices = meshes[i].numIndices;
+        entries[i].vertexStride = meshes[i].vertexStride;
+        entries[i].indexType = meshes[i].indexType;
+        entries[i].lodCount = meshes[i].lodCount;
+        memcpy(entries[i].lodIndexCount, meshes[i].lodIndexCount, sizeof(entries[i].lodIndexCount));
+        entries[i].meshletCount = meshes[i].meshletCount;
+
+        offset = alignOffset(offset);
+        entries[i].vertexOffset = offset;
+        offset += (size_t)meshes[i].numVertices * meshes[i].vertexStride;
+
+        offset = alignOffset(offset);
+        entries[i].indexOffset = offset;
+        offset += (size_t)meshes[i].numIndices * indexSize(meshes[i].indexType);
+
+        offset = alignOffset(offset);
+        entries[i].meshletOffset = offset;
+        offset += (size_t)meshes[i].meshletCount * sizeof(Meshlet);
+    }
+
+    // Write to a temporary file first so a crash never leaves a half-written cache
+    char cachePath[512];
+    char tempPath[520];
+    getMeshCachePath(modelPath, cachePath, sizeof(cachePath));
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", cachePath);
+
+    FILE* file = fopen(tempPath, "wb");
+    if (!file) {
+        LOG_ERROR(LOG_ASSETS, "Failed to create mesh cache %s", tempPath);
+        free(entries);
+        return false;
+    }
+
+    MeshCacheHeader header = { MESH_CACHE_MAGIC, MESH_CACHE_VERSION, contentHash, meshCount, 0 };
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(entries, sizeof(MeshCacheEntry), meshCount, file) == meshCount;
+
+    offset = sizeof(MeshCacheHeader) + meshCount * sizeof(MeshCacheEntry);
+    for (unsigned int i = 0; ok && i < meshCount; i++) {
+        size_t vertexBytes = (size_t)meshes[i].numVertices * meshes[i].vertexStride;
+        size_t indexBytes = (size_t)meshes[i].numIndices * indexSize(meshes[i].indexType);
+        size_t meshletBytes = (size_t)meshes[i].meshletCount * sizeof(Meshlet);
+
+        ok = writePadding(file, &offset) && fwrite(meshes[i].vertices, 1, vertexBytes, file) == vertexBytes;
+        offset += vertexBytes;
+        ok = ok && writePadding(file, &offset) && fwrite(meshes[i].indices, 1, indexBytes, file) == indexBytes;
+        offset += indexBytes;
+        ok = ok && writePadding(file, &offset) &&
+             (meshletBytes == 0 || fwrite(meshes[i].meshlets, 1, meshletBytes, file) == meshletBytes);
+        offset += meshletBytes;
+    }
+
+    ok = (fclose(file) == 0) && ok;
+    free(entries);
+
+    if (ok) {
+        remove(cachePath);
+        ok = rename(tempPath, cachePath) == 0;
+    }
+    if (!ok) {
+        LOG_ERROR(LOG_ASSETS, "Failed to write mesh cache %s", cachePath);
+        remove(tempPath);
+        return false;
+    }
+
+    LOG_DEBUG(LOG_ASSETS, "Wrote mesh cache %s", cachePath);
+    return true;
+}
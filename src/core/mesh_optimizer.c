@@ -0,0 +1,798 @@
+#include "mesh_optimizer.h"
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INVALID_INDEX UINT_MAX
+
+static uint32_t hashVertex(const unsigned char* bytes, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+unsigned int weldVertices(void* vertices, unsigned int vertexCount, size_t vertexStride,
+                          unsigned int* indices, unsigned int indexCount) {
+    if (vertexCount == 0) return 0;
+
+    size_t tableSize = 1;
+    while (tableSize < (size_t)vertexCount * 2) tableSize <<= 1;
+
+    unsigned int* table = malloc(tableSize * sizeof(unsigned int));
+    unsigned int* remap = malloc(vertexCount * sizeof(unsigned int));
+    if (!table || !remap) {
+        free(table);
+        free(remap);
+        return vertexCount;
+    }
+    memset(table, 0xff, tableSize * sizeof(unsigned int));
+
+    // Open addressing over the already compacted vertices
+    unsigned char* data = (unsigned char*)vertices;
+    unsigned int unique = 0;
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        const unsigned char* vertex = data + v * vertexStride;
+        size_t slot = hashVertex(vertex, vertexStride) & (tableSize - 1);
+        while (table[slot] != INVALID_INDEX && memcmp(data + table[slot] * vertexStride, vertex, vertexStride) != 0) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+
+        if (table[slot] == INVALID_INDEX) {
+            if (unique != v) memmove(data + unique * vertexStride, vertex, vertexStride);
+            table[slot] = unique;
+            remap[v] = unique++;
+        } else {
+            remap[v] = table[slot];
+        }
+    }
+
+    for (unsigned int i = 0; i < indexCount; i++) {
+        indices[i] = remap[indices[i]];
+    }
+
+    free(table);
+    free(remap);
+    return unique;
+}
+
+// Forsyth's scoring: recently used vertices and vertices with few remaining
+// triangles are preferred
+static float vertexScore(int cachePosition, unsigned int remainingTriangles) {
+    if (remainingTriangles == 0) return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            score = 0.75f;
+        } else {
+            score = powf(1.0f - (float)(cachePosition - 3) / (VERTEX_CACHE_SIZE - 3), 1.5f);
+        }
+    }
+    return score + 2.0f / sqrtf((float)remainingTriangles);
+}
+
+bool optimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount) {
+    unsigned int triangleCount = indexCount / 3;
+    if (triangleCount < 2) return true;
+
+    unsigned int* adjacencyOffset = calloc(vertexCount + 1, sizeof(unsigned int));
+    unsigned int* remaining = calloc(vertexCount, sizeof(unsigned int));
+    unsigned int* adjacency = malloc(triangleCount * 3 * sizeof(unsigned int));
+    int* cachePosition = malloc(vertexCount * sizeof(int));
+    float* score = malloc(vertexCount * sizeof(float));
+    float* triangleScore = malloc(triangleCount * sizeof(float));
+    bool* emitted = calloc(triangleCount, sizeof(bool));
+    unsigned int* output = malloc(triangleCount * 3 * sizeof(unsigned int));
+    bool ok = adjacencyOffset && remaining && adjacency && cachePosition && score && triangleScore && emitted && output;
+
+    if (ok) {
+        // Vertex -> triangle adjacency
+        for (unsigned int i = 0; i < triangleCount * 3; i++) remaining[indices[i]]++;
+        for (unsigned int v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+        for (unsigned int i = 0; i < triangleCount * 3; i++) adjacency[adjacencyOffset[indices[i]]++] = i / 3;
+        for (unsigned int v = vertexCount; v > 0; v--) adjacencyOffset[v] = adjacencyOffset[v - 1];
+        adjacencyOffset[0] = 0;
+
+        for (unsigned int v = 0; v < vertexCount; v++) {
+            cachePosition[v] = -1;
+            score[v] = vertexScore(-1, remaining[v]);
+        }
+
+        int bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (unsigned int t = 0; t < triangleCount; t++) {
+            triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+            if (triangleScore[t] > bestScore) {
+                bestScore = triangleScore[t];
+                bestTriangle = (int)t;
+            }
+        }
+
+        unsigned int cache[VERTEX_CACHE_SIZE + 3];
+        unsigned int cacheCount = 0;
+        unsigned int emittedCount = 0;
+        unsigned int scan = 0;
+
+        while (emittedCount < triangleCount) {
+            // Nothing adjacent to the cache, continue from the next unemitted triangle
+            if (bestTriangle < 0) {
+                while (scan < triangleCount && emitted[scan]) scan++;
+                if (scan == triangleCount) break;
+                bestTriangle = (int)scan;
+            }
+
+            const unsigned int* tri = &indices[bestTriangle * 3];
+            memcpy(&output[emittedCount * 3], tri, 3 * sizeof(unsigned int));
+            emitted[bestTriangle] = true;
+            emittedCount++;
+
+            // Drop the triangle from its vertices' adjacency lists
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = tri[k];
+                unsigned int* list = &adjacency[adjacencyOffset[v]];
+                for (unsigned int j = 0; j < remaining[v]; j++) {
+                    if (list[j] == (unsigned int)bestTriangle) {
+                        list[j] = list[remaining[v] - 1];
+                        break;
+                    }
+                }
+                remaining[v]--;
+            }
+
+            // Move the triangle's vertices to the front of the LRU cache
+            unsigned int newCache[VERTEX_CACHE_SIZE + 3];
+            unsigned int newCount = 0;
+            newCache[newCount++] = tri[0];
+            newCache[newCount++] = tri[1];
+            newCache[newCount++] = tri[2];
+            for (unsigned int i = 0; i < cacheCount; i++) {
+                unsigned int v = cache[i];
+                if (v != tri[0] && v != tri[1] && v != tri[2]) newCache[newCount++] = v;
+            }
+
+            // Rescore everything that moved, including vertices that fell out
+            for (unsigned int i = 0; i < newCount; i++) {
+                unsigned int v = newCache[i];
+                cachePosition[v] = i < VERTEX_CACHE_SIZE ? (int)i : -1;
+
+                float newScore = vertexScore(cachePosition[v], remaining[v]);
+                float delta = newScore - score[v];
+                score[v] = newScore;
+
+                for (unsigned int j = 0; j < remaining[v]; j++) {
+                    triangleScore[adjacency[adjacencyOffset[v] + j]] += delta;
+                }
+            }
+
+            cacheCount = newCount < VERTEX_CACHE_SIZE ? newCount : VERTEX_CACHE_SIZE;
+            memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+
+            // The next triangle is almost always adjacent to something cached
+            bestTriangle = -1;
+            bestScore = -1.0f;
+            for (unsigned int i = 0; i < cacheCount; i++) {
+                unsigned int v = cache[i];
+                for (unsigned int j = 0; j < remaining[v]; j++) {
+                    unsigned int t = adjacency[adjacencyOffset[v] + j];
+                    if (triangleScore[t] > bestScore) {
+                        bestScore = triangleScore[t];
+                        bestTriangle = (int)t;
+                    }
+                }
+            }
+        }
+
+        memcpy(indices, output, triangleCount * 3 * sizeof(unsigned int));
+    }
+
+    free(adjacencyOffset);
+    free(remaining);
+    free(adjacency);
+    free(cachePosition);
+    free(score);
+    free(triangleScore);
+    free(emitted);
+    free(output);
+    return ok;
+}
+
+typedef struct {
+    float key;
+    unsigned int cluster;
+} ClusterKey;
+
+static int compareClusterKeys(const void* a, const void* b) {
+    float ka = ((const ClusterKey*)a)->key;
+    float kb = ((const ClusterKey*)b)->key;
+    return (ka < kb) - (ka > kb); // Descending
+}
+
+static const float* vertexPosition(const float* positions, size_t stride, unsigned int v) {
+    return (const float*)((const unsigned char*)positions + v * stride);
+}
+
+bool optimizeOverdraw(unsigned int* indices, unsigned int indexCount,
+                      const float* positions, size_t positionStride, unsigned int vertexCount) {
+    unsigned int triangleCount = indexCount / 3;
+    if (triangleCount < 2 || vertexCount == 0) return true;
+
+    unsigned int* cacheTime = calloc(vertexCount, sizeof(unsigned int));
+    unsigned int* clusterStart = malloc((triangleCount + 1) * sizeof(unsigned int));
+    ClusterKey* keys = NULL;
+    unsigned int* output = NULL;
+    bool ok = cacheTime && clusterStart;
+
+    if (ok) {
+        // A triangle that misses the cache on all three vertices starts a new
+        // cluster, so reordering clusters keeps the vertex cache order intact
+        unsigned int timestamp = OVERDRAW_CACHE_SIZE + 1;
+        unsigned int clusterCount = 0;
+        for (unsigned int t = 0; t < triangleCount; t++) {
+            int misses = 0;
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = indices[t * 3 + k];
+                if (timestamp - cacheTime[v] > OVERDRAW_CACHE_SIZE) {
+                    cacheTime[v] = timestamp++;
+                    misses++;
+                }
+            }
+            if (t == 0 || misses == 3) clusterStart[clusterCount++] = t;
+        }
+        clusterStart[clusterCount] = triangleCount;
+
+        if (clusterCount > 1) {
+            keys = malloc(clusterCount * sizeof(ClusterKey));
+            output = malloc(indexCount * sizeof(unsigned int));
+            ok = keys && output;
+        }
+
+        if (ok && clusterCount > 1) {
+            float meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+            for (unsigned int v = 0; v < vertexCount; v++) {
+                const float* p = vertexPosition(positions, positionStride, v);
+                meshCenter[0] += p[0];
+                meshCenter[1] += p[1];
+                meshCenter[2] += p[2];
+            }
+            for (int k = 0; k < 3; k++) meshCenter[k] /= (float)vertexCount;
+
+            // Clusters facing away from the mesh center are drawn first so they
+            // occlude the inner/back-facing ones
+            for (unsigned int c = 0; c < clusterCount; c++) {
+                float center[3] = { 0.0f, 0.0f, 0.0f };
+                float normal[3] = { 0.0f, 0.0f, 0.0f };
+                float area = 0.0f;
+
+                for (unsigned int t = clusterStart[c]; t < clusterStart[c + 1]; t++) {
+                    const float* a = vertexPosition(positions, positionStride, indices[t * 3]);
+                    const float* b = vertexPosition(positions, positionStride, indices[t * 3 + 1]);
+                    const float* d = vertexPosition(positions, positionStride, indices[t * 3 + 2]);
+
+                    float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                    float e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+                    float n[3] = {
+                        e1[1] * e2[2] - e1[2] * e2[1],
+                        e1[2] * e2[0] - e1[0] * e2[2],
+                        e1[0] * e2[1] - e1[1] * e2[0]
+                    };
+                    float triangleArea = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+                    for (int k = 0; k < 3; k++) {
+                        normal[k] += n[k];
+                        center[k] += (a[k] + b[k] + d[k]) * (triangleArea / 3.0f);
+                    }
+                    area += triangleArea;
+                }
+
+                float key = 0.0f;
+                float normalLength = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                if (area > 0.0f && normalLength > 0.0f) {
+                    for (int k = 0; k < 3; k++) {
+                        key += (center[k] / area - meshCenter[k]) * (normal[k] / normalLength);
+                    }
+                }
+                keys[c].key = key;
+                keys[c].cluster = c;
+            }
+
+            qsort(keys, clusterCount, sizeof(ClusterKey), compareClusterKeys);
+
+            unsigned int written = 0;
+            for (unsigned int c = 0; c < clusterCount; c++) {
+                unsigned int start = clusterStart[keys[c].cluster];
+                unsigned int count = clusterStart[keys[c].cluster + 1] - start;
+                memcpy(&output[written], &indices[start * 3], count * 3 * sizeof(unsigned int));
+                written += count * 3;
+            }
+            memcpy(indices, output, triangleCount * 3 * sizeof(unsigned int));
+        }
+    }
+
+    free(cacheTime);
+    free(clusterStart);
+    free(keys);
+    free(output);
+    return ok;
+}
+
+unsigned int optimizeVertexFetch(void* vertices, unsigned int vertexCount, size_t vertexStride,
+                                 unsigned int* indices, unsigned int indexCount) {
+    unsigned int* remap = malloc(vertexCount * sizeof(unsigned int));
+    unsigned char* reordered = malloc(vertexCount * vertexStride);
+    if (!remap || !reordered) {
+        free(remap);
+        free(reordered);
+        return vertexCount;
+    }
+    memset(remap, 0xff, vertexCount * sizeof(unsigned int));
+
+    const unsigned char* data = (const unsigned char*)vertices;
+    unsigned int next = 0;
+    for (unsigned int i = 0; i < indexCount; i++) {
+        unsigned int v = indices[i];
+        if (remap[v] == INVALID_INDEX) {
+            remap[v] = next;
+            memcpy(reordered + next * vertexStride, data + v * vertexStride, vertexStride);
+            next++;
+        }
+        indices[i] = remap[v];
+    }
+
+    memcpy(vertices, reordered, next * vertexStride);
+    free(remap);
+    free(reordered);
+    return next;
+}
+
+// Symmetric 4x4 quadric stored as its upper triangle
+typedef struct {
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+} Quadric;
+
+typedef struct {
+    unsigned int from;
+    unsigned int to;
+    double cost;
+} Collapse;
+
+static void addPlaneQuadric(Quadric* q, double a, double b, double c, double d) {
+    q->a2 += a * a; q->ab += a * b; q->ac += a * c; q->ad += a * d;
+    q->b2 += b * b; q->bc += b * c; q->bd += b * d;
+    q->c2 += c * c; q->cd += c * d;
+    q->d2 += d * d;
+}
+
+static void addQuadric(Quadric* q, const Quadric* other) {
+    q->a2 += other->a2; q->ab += other->ab; q->ac += other->ac; q->ad += other->ad;
+    q->b2 += other->b2; q->bc += other->bc; q->bd += other->bd;
+    q->c2 += other->c2; q->cd += other->cd;
+    q->d2 += other->d2;
+}
+
+// Sum of squared distances from p to the planes accumulated in q
+static double quadricError(const Quadric* q, const float* p) {
+    double x = p[0], y = p[1], z = p[2];
+    return q->a2 * x * x + 2.0 * q->ab * x * y + 2.0 * q->ac * x * z + 2.0 * q->ad * x
+         + q->b2 * y * y + 2.0 * q->bc * y * z + 2.0 * q->bd * y
+         + q->c2 * z * z + 2.0 * q->cd * z
+         + q->d2;
+}
+
+static int compareCollapses(const void* a, const void* b) {
+    double costA = ((const Collapse*)a)->cost;
+    double costB = ((const Collapse*)b)->cost;
+    return (costA > costB) - (costA < costB);
+}
+
+static void triangleNormal(const float* p0, const float* p1, const float* p2, double* n) {
+    double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static uint64_t edgeKey(unsigned int a, unsigned int b) {
+    return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+// Counts how many triangles use each position-welded edge
+static unsigned int* countEdges(const unsigned int* canonical, const unsigned int* indices, unsigned int indexCount,
+                                uint64_t** keysOut, size_t* tableSizeOut) {
+    size_t tableSize = 1;
+    while (tableSize < (size_t)indexCount * 2) tableSize <<= 1;
+
+    uint64_t* keys = malloc(tableSize * sizeof(uint64_t));
+    unsigned int* counts = calloc(tableSize, sizeof(unsigned int));
+    if (!keys || !counts) {
+        free(keys);
+        free(counts);
+        return NULL;
+    }
+
+    for (unsigned int i = 0; i < indexCount; i += 3) {
+        for (int e = 0; e < 3; e++) {
+            uint64_t key = edgeKey(canonical[indices[i + e]], canonical[indices[i + (e + 1) % 3]]);
+            size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (tableSize - 1);
+            while (counts[slot] && keys[slot] != key) slot = (slot + 1) & (tableSize - 1);
+            keys[slot] = key;
+            counts[slot]++;
+        }
+    }
+
+    *keysOut = keys;
+    *tableSizeOut = tableSize;
+    return counts;
+}
+
+typedef struct {
+    unsigned int* table;
+    unsigned int* canonical;      // First vertex with the same position
+    unsigned int* copies;
+    unsigned char* locked;
+    unsigned char* touched;
+    unsigned int* remap;
+    unsigned int* adjacencyStart; // Triangles around each vertex, CSR layout
+    unsigned int* adjacency;
+    Quadric* quadrics;
+    Collapse* collapses;
+} SimplifyBuffers;
+
+static unsigned int collapseEdges(const SimplifyBuffers* buffers, unsigned int* destination, unsigned int count,
+                                  const float* positions, size_t positionStride, unsigned int vertexCount,
+                                  unsigned int targetIndexCount, float targetError) {
+    unsigned int* canonical = buffers->canonical;
+    unsigned char* locked = buffers->locked;
+    unsigned char* touched = buffers->touched;
+    unsigned int* remap = buffers->remap;
+    unsigned int* adjacencyStart = buffers->adjacencyStart;
+    unsigned int* adjacency = buffers->adjacency;
+    Quadric* quadrics = buffers->quadrics;
+    Collapse* collapses = buffers->collapses;
+
+    // Vertices split only by normal or uv share a position; collapses work on positions
+    size_t tableSize = 1;
+    while (tableSize < (size_t)vertexCount * 2) tableSize <<= 1;
+    memset(buffers->table, 0xff, tableSize * sizeof(unsigned int));
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        const float* p = vertexPosition(positions, positionStride, v);
+        size_t slot = hashVertex((const unsigned char*)p, 3 * sizeof(float)) & (tableSize - 1);
+        while (buffers->table[slot] != INVALID_INDEX && memcmp(vertexPosition(positions, positionStride, buffers->table[slot]), p, 3 * sizeof(float)) != 0) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (buffers->table[slot] == INVALID_INDEX) buffers->table[slot] = v;
+        canonical[v] = buffers->table[slot];
+        buffers->copies[buffers->table[slot]]++;
+    }
+
+    // Attribute seams and open borders stay where they are
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        if (buffers->copies[canonical[v]] > 1) locked[canonical[v]] = 1;
+    }
+    uint64_t* edgeKeys = NULL;
+    size_t edgeTableSize = 0;
+    unsigned int* edgeCounts = countEdges(canonical, destination, count, &edgeKeys, &edgeTableSize);
+    if (!edgeCounts) return count;
+    for (size_t slot = 0; slot < edgeTableSize; slot++) {
+        if (edgeCounts[slot] == 1) {
+            locked[edgeKeys[slot] >> 32] = 1;
+            locked[edgeKeys[slot] & 0xffffffffu] = 1;
+        }
+    }
+    free(edgeKeys);
+    free(edgeCounts);
+
+    for (unsigned int i = 0; i < count; i += 3) {
+        const float* p0 = vertexPosition(positions, positionStride, destination[i]);
+        const float* p1 = vertexPosition(positions, positionStride, destination[i + 1]);
+        const float* p2 = vertexPosition(positions, positionStride, destination[i + 2]);
+        double n[3];
+        triangleNormal(p0, p1, p2, n);
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length <= 0.0) continue;
+        n[0] /= length; n[1] /= length; n[2] /= length;
+        double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        for (int k = 0; k < 3; k++) addPlaneQuadric(&quadrics[canonical[destination[i + k]]], n[0], n[1], n[2], d);
+    }
+
+    // Error limit is relative to the mesh extent
+    float minBound[3], maxBound[3];
+    memcpy(minBound, vertexPosition(positions, positionStride, 0), sizeof(minBound));
+    memcpy(maxBound, minBound, sizeof(maxBound));
+    for (unsigned int v = 1; v < vertexCount; v++) {
+        const float* p = vertexPosition(positions, positionStride, v);
+        for (int k = 0; k < 3; k++) {
+            if (p[k] < minBound[k]) minBound[k] = p[k];
+            if (p[k] > maxBound[k]) maxBound[k] = p[k];
+        }
+    }
+    double extent = fmax(maxBound[0] - minBound[0], fmax(maxBound[1] - minBound[1], maxBound[2] - minBound[2]));
+    double maxError = (targetError * extent) * (targetError * extent);
+
+    // Each pass collapses a set of independent edges, cheapest first
+    while (count > targetIndexCount) {
+        memset(adjacencyStart, 0, (vertexCount + 1) * sizeof(unsigned int));
+        for (unsigned int i = 0; i < count; i++) adjacencyStart[destination[i] + 1]++;
+        for (unsigned int v = 0; v < vertexCount; v++) adjacencyStart[v + 1] += adjacencyStart[v];
+        for (unsigned int v = 0; v < vertexCount; v++) remap[v] = adjacencyStart[v];
+        for (unsigned int i = 0; i < count; i++) adjacency[remap[destination[i]]++] = i / 3;
+
+        size_t collapseCount = 0;
+        for (unsigned int i = 0; i < count; i += 3) {
+            for (int e = 0; e < 3; e++) {
+                unsigned int a = destination[i + e], b = destination[i + (e + 1) % 3];
+                unsigned int ca = canonical[a], cb = canonical[b];
+                if (ca == cb) continue;
+                if (!locked[ca]) {
+                    Quadric q = quadrics[ca];
+                    addQuadric(&q, &quadrics[cb]);
+                    collapses[collapseCount++] = (Collapse){ a, b, quadricError(&q, vertexPosition(positions, positionStride, b)) };
+                }
+                if (!locked[cb]) {
+                    Quadric q = quadrics[cb];
+                    addQuadric(&q, &quadrics[ca]);
+                    collapses[collapseCount++] = (Collapse){ b, a, quadricError(&q, vertexPosition(positions, positionStride, a)) };
+                }
+            }
+        }
+        qsort(collapses, collapseCount, sizeof(Collapse), compareCollapses);
+
+        memset(touched, 0, vertexCount);
+        for (unsigned int v = 0; v < vertexCount; v++) remap[v] = v;
+
+        unsigned int triangles = count / 3;
+        unsigned int removed = 0;
+        unsigned int applied = 0;
+        for (size_t c = 0; c < collapseCount; c++) {
+            const Collapse* collapse = &collapses[c];
+            if (collapse->cost > maxError) break;
+            if ((triangles - removed) * 3 <= targetIndexCount) break;
+
+            unsigned int u = collapse->from, v = collapse->to;
+            if (touched[canonical[u]] || touched[canonical[v]]) continue;
+
+            // Reject collapses that would flip a surviving triangle
+            const float* target = vertexPosition(positions, positionStride, v);
+            unsigned int shared = 0;
+            bool flips = false;
+            for (unsigned int t = adjacencyStart[u]; t < adjacencyStart[u + 1] && !flips; t++) {
+                const unsigned int* tri = &destination[adjacency[t] * 3];
+                if (canonical[tri[0]] == canonical[v] || canonical[tri[1]] == canonical[v] || canonical[tri[2]] == canonical[v]) {
+                    shared++;
+                    continue;
+                }
+                const float* p[3];
+                const float* moved[3];
+                for (int k = 0; k < 3; k++) {
+                    p[k] = vertexPosition(positions, positionStride, tri[k]);
+                    moved[k] = tri[k] == u ? target : p[k];
+                }
+                double before[3], after[3];
+                triangleNormal(p[0], p[1], p[2], before);
+                triangleNormal(moved[0], moved[1], moved[2], after);
+                flips = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0;
+            }
+            if (flips) continue;
+
+            remap[u] = v;
+            addQuadric(&quadrics[canonical[v]], &quadrics[canonical[u]]);
+            removed += shared;
+            applied++;
+
+            // Neighbours keep their shape for the rest of the pass so the flip test stays valid
+            for (unsigned int t = adjacencyStart[u]; t < adjacencyStart[u + 1]; t++) {
+                const unsigned int* tri = &destination[adjacency[t] * 3];
+                for (int k = 0; k < 3; k++) touched[canonical[tri[k]]] = 1;
+            }
+        }
+        if (applied == 0) break;
+
+        unsigned int written = 0;
+        for (unsigned int i = 0; i < count; i += 3) {
+            unsigned int a = remap[destination[i]], b = remap[destination[i + 1]], c = remap[destination[i + 2]];
+            if (canonical[a] == canonical[b] || canonical[b] == canonical[c] || canonical[a] == canonical[c]) continue;
+            destination[written++] = a;
+            destination[written++] = b;
+            destination[written++] = c;
+        }
+        count = written;
+    }
+
+    return count;
+}
+
+unsigned int simplifyMesh(unsigned int* destination, const unsigned int* indices, unsigned int indexCount,
+                          const float* positions, size_t positionStride, unsigned int vertexCount,
+                          unsigned int targetIndexCount, float targetError) {
+    memcpy(destination, indices, indexCount * sizeof(unsigned int));
+    if (indexCount <= targetIndexCount || vertexCount == 0) return indexCount;
+
+    size_t tableSize = 1;
+    while (tableSize < (size_t)vertexCount * 2) tableSize <<= 1;
+
+    SimplifyBuffers buffers;
+    buffers.table = malloc(tableSize * sizeof(unsigned int));
+    buffers.canonical = malloc(vertexCount * sizeof(unsigned int));
+    buffers.copies = calloc(vertexCount, sizeof(unsigned int));
+    buffers.locked = calloc(vertexCount, 1);
+    buffers.touched = malloc(vertexCount);
+    buffers.remap = malloc(vertexCount * sizeof(unsigned int));
+    buffers.adjacencyStart = malloc((vertexCount + 1) * sizeof(unsigned int));
+    buffers.adjacency = malloc(indexCount * sizeof(unsigned int));
+    buffers.quadrics = calloc(vertexCount, sizeof(Quadric));
+    buffers.collapses = malloc((size_t)indexCount * 2 * sizeof(Collapse));
+
+    unsigned int count = indexCount;
+    if (buffers.table && buffers.canonical && buffers.copies && buffers.locked && buffers.touched && buffers.remap &&
+        buffers.adjacencyStart && buffers.adjacency && buffers.quadrics && buffers.collapses) {
+        count = collapseEdges(&buffers, destination, indexCount, positions, positionStride, vertexCount, targetIndexCount, targetError);
+    }
+
+    free(buffers.table);
+    free(buffers.canonical);
+    free(buffers.copies);
+    free(buffers.locked);
+    free(buffers.touched);
+    free(buffers.remap);
+    free(buffers.adjacencyStart);
+    free(buffers.adjacency);
+    free(buffers.quadrics);
+    free(buffers.collapses);
+    return count;
+}
+
+// Bounding sphere and normal cone of one meshlet
+static void computeMeshletBounds(Meshlet* meshlet, const unsigned int* indices, const float* positions, size_t positionStride) {
+    const unsigned int* triangles = indices + meshlet->firstIndex;
+    unsigned int triangleCount = meshlet->indexCount / 3;
+
+    // Sphere around the box center, tight enough for culling
+    float minBound[3] = { INFINITY, INFINITY, INFINITY };
+    float maxBound[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (unsigned int i = 0; i < meshlet->indexCount; i++) {
+        const float* p = vertexPosition(positions, positionStride, triangles[i]);
+        for (int k = 0; k < 3; k++) {
+            if (p[k] < minBound[k]) minBound[k] = p[k];
+            if (p[k] > maxBound[k]) maxBound[k] = p[k];
+        }
+    }
+    float radiusSquared = 0.0f;
+    for (int k = 0; k < 3; k++) meshlet->center[k] = (minBound[k] + maxBound[k]) * 0.5f;
+    for (unsigned int i = 0; i < meshlet->indexCount; i++) {
+        const float* p = vertexPosition(positions, positionStride, triangles[i]);
+        float dx = p[0] - meshlet->center[0], dy = p[1] - meshlet->center[1], dz = p[2] - meshlet->center[2];
+        float d = dx * dx + dy * dy + dz * dz;
+        if (d > radiusSquared) radiusSquared = d;
+    }
+    meshlet->radius = sqrtf(radiusSquared);
+
+    // Axis is the mean of the unit face normals, the cutoff covers the widest one
+    double normals[MESHLET_MAX_TRIANGLES][3];
+    double axis[3] = { 0.0, 0.0, 0.0 };
+    unsigned int normalCount = 0;
+    for (unsigned int t = 0; t < triangleCount; t++) {
+        double n[3];
+        triangleNormal(vertexPosition(positions, positionStride, triangles[t * 3]),
+                       vertexPosition(positions, positionStride, triangles[t * 3 + 1]),
+                       vertexPosition(positions, positionStride, triangles[t * 3 + 2]), n);
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length <= 0.0) continue; // Degenerate triangles face nowhere
+        for (int k = 0; k < 3; k++) {
+            normals[normalCount][k] = n[k] / length;
+            axis[k] += normals[normalCount][k];
+        }
+        normalCount++;
+    }
+
+    double axisLength = sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    double minDot = 1.0;
+    if (axisLength > 0.0) {
+        for (int k = 0; k < 3; k++) axis[k] /= axisLength;
+        for (unsigned int t = 0; t < normalCount; t++) {
+            double d = normals[t][0] * axis[0] + normals[t][1] * axis[1] + normals[t][2] * axis[2];
+            if (d < minDot) minDot = d;
+        }
+    }
+
+    for (int k = 0; k < 3; k++) meshlet->coneAxis[k] = (float)axis[k];
+    // Normals spread over more than about 84 degrees can't be rejected as a group
+    meshlet->coneCutoff = (normalCount == 0 || minDot <= 0.1) ? 1.0f : (float)sqrt(1.0 - minDot * minDot);
+}
+
+unsigned int buildMeshlets(Meshlet* destination, const unsigned int* indices, unsigned int indexCount,
+                           const float* positions, size_t positionStride, unsigned int vertexCount) {
+    // Stamp of the last meshlet each vertex was added to
+    unsigned int* stamps = (unsigned int*)malloc((size_t)vertexCount * sizeof(unsigned int));
+    if (!stamps) return 0;
+    memset(stamps, 0xff, (size_t)vertexCount * sizeof(unsigned int));
+
+    unsigned int meshletCount = 0;
+    unsigned int meshletVertices = 0;
+    Meshlet* current = NULL;
+
+    for (unsigned int i = 0; i + 2 < indexCount; i += 3) {
+        unsigned int newVertices = 0;
+        for (int k = 0; k < 3; k++) {
+            if (current && stamps[indices[i + k]] == meshletCount - 1) continue;
+            // Repeated corners of a degenerate triangle count once
+            bool repeated = false;
+            for (int j = 0; j < k; j++) repeated = repeated || indices[i + j] == indices[i + k];
+            if (!repeated) newVertices++;
+        }
+
+        if (!current || meshletVertices + newVertices > MESHLET_MAX_VERTICES ||
+            current->indexCount / 3 + 1 > MESHLET_MAX_TRIANGLES) {
+            if (current) computeMeshletBounds(current, indices, positions, positionStride);
+            current = &destination[meshletCount++];
+            memset(current, 0, sizeof(*current));
+            current->firstIndex = i;
+            meshletVertices = 0;
+            newVertices = 0;
+            for (int k = 0; k < 3; k++) {
+                if (stamps[indices[i + k]] != meshletCount - 1) newVertices++;
+                stamps[indices[i + k]] = meshletCount - 1;
+            }
+        }
+
+        for (int k = 0; k < 3; k++) stamps[indices[i + k]] = meshletCount - 1;
+        meshletVertices += newVertices;
+        current->indexCount += 3;
+    }
+    if (current) computeMeshletBounds(current, indices, positions, positionStride);
+
+    free(stamps);
+    return meshletCount;
+}
+
+unsigned short floatToHalf(float value) {
+    union { float f; uint32_t u; } bits;
+    bits.f = value;
+
+    uint32_t sign = (bits.u >> 16) & 0x8000;
+    uint32_t rawExponent = (bits.u >> 23) & 0xff;
+    uint32_t mantissa = bits.u & 0x7fffff;
+    int exponent = (int)rawExponent - 127 + 15;
+
+    if (rawExponent == 0xff) return (unsigned short)(sign | 0x7c00 | (mantissa ? 0x200 : 0)); // Inf/NaN
+    if (exponent >= 31) return (unsigned short)(sign | 0x7c00);                             // Overflow
+    if (exponent <= 0) {                                                                     // Subnormal
+        if (exponent < -10) return (unsigned short)sign;
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1) half++;
+        return (unsigned short)(sign | half);
+    }
+
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) half++; // Round to nearest, carry into the exponent is correct
+    return (unsigned short)half;
+}
+
+float halfToFloat(unsigned short value) {
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+    union { float f; uint32_t u; } bits;
+
+    if (exponent == 0x1f) {                 // Inf/NaN
+        bits.u = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent == 0) {             // Zero and subnormals
+        bits.f = ldexpf((float)mantissa, -24);
+        bits.u |= sign;
+    } else {
+        bits.u = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+    return bits.f;
+}
+
+signed char floatToSnorm8(float value) {
+    if (value > 1.0f) value = 1.0f;
+    if (value < -1.0f) value = -1.0f;
+    return (signed char)lroundf(value * 127.0f);
+}
@@ -0,0 +1,368 @@
+#include "model_registry.h"
+#include "mesh_cache.h"
+#include "thread_pool.h"
+#include "threading.h"
+#include "upload_queue.h"
+#include "log.h"
+#include <limits.h>
+#include <string.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// One import in flight: parsed on a worker, then streamed in by the upload queue
+typedef struct ImportJob {
+    ModelEntry* entry;
+    char path[256];
+    uint64_t contentHash;
+    bool succeeded;
+    ImportedModel imported;
+    Mesh* meshes;
+    int pendingUploads;
+    struct ImportJob* next;
+} ImportJob;
+
+static ModelEntry** entries = NULL;
+static int entryCount = 0;
+static int entryCapacity = 0;
+
+// Shared with the workers, guarded by importMutex
+static Mutex importMutex;
+static Condition importCondition;
+static ImportJob* completedHead = NULL;
+static ImportJob* completedTail = NULL;
+static int importsInFlight = 0;
+static bool importsCancelled = false;
+static bool registryInitialized = false;
+
+// Render thread only: imports whose buffers are still being streamed
+static ImportJob* uploadHead = NULL;
+static unsigned int modelsLanded = 0;
+
+// Each thread keeps its own assimp configuration, nothing is shared between imports
+static struct aiPropertyStore* workerProperties[MAX_JOB_THREADS];
+
+void initModelRegistry(void) {
+    if (registryInitialized) return;
+    initMutex(&importMutex);
+    initCondition(&importCondition);
+    importsCancelled = false;
+    registryInitialized = true;
+}
+
+static void canonicalizePath(const char* path, char* out, size_t outSize) {
+#ifdef _WIN32
+    if (_fullpath(out, path, outSize)) {
+        // Windows paths are case-insensitive
+        for (char* c = out; *c; c++) {
+            if (*c == '\\') *c = '/';
+            else if (*c >= 'A' && *c <= 'Z') *c = (char)(*c - 'A' + 'a');
+        }
+        return;
+    }
+#else
+    char resolved[PATH_MAX];
+    if (realpath(path, resolved)) {
+        snprintf(out, outSize, "%s", resolved);
+        return;
+    }
+#endif
+    snprintf(out, outSize, "%s", path);
+}
+
+static ModelEntry* findEntryByPath(const char* canonicalPath) {
+    for (int i = 0; i < entryCount; i++) {
+        if (strcmp(entries[i]->canonicalPath, canonicalPath) == 0) return entries[i];
+    }
+    return NULL;
+}
+
+static ModelEntry* findEntryByHash(uint64_t contentHash) {
+    for (int i = 0; i < entryCount; i++) {
+        if (entries[i]->contentHash == contentHash) return entries[i];
+    }
+    return NULL;
+}
+
+static void importTask(void* data, int workerIndex) {
+    ImportJob* job = (ImportJob*)data;
+
+    lockMutex(&importMutex);
+    bool cancelled = importsCancelled;
+    unlockMutex(&importMutex);
+
+    if (!cancelled) {
+        if (!workerProperties[workerIndex]) {
+            workerProperties[workerIndex] = aiCreatePropertyStore();
+        }
+        job->succeeded = importModelData(job->path, job->contentHash, workerProperties[workerIndex], &job->imported);
+    }
+
+    lockMutex(&importMutex);
+    if (completedTail) completedTail->next = job;
+    else completedHead = job;
+    completedTail = job;
+    importsInFlight--;
+    broadcastCondition(&importCondition);
+    unlockMutex(&importMutex);
+}
+
+static void queueImport(ModelEntry* entry) {
+    ImportJob* job = (ImportJob*)calloc(1, sizeof(ImportJob));
+    if (!job) {
+        entry->state = MODEL_FAILED;
+        return;
+    }
+
+    job->entry = entry;
+    strncpy(job->path, entry->model.path, sizeof(job->path) - 1);
+    job->contentHash = entry->contentHash;
+    entry->state = MODEL_LOADING;
+
+    lockMutex(&importMutex);
+    importsInFlight++;
+    unlockMutex(&importMutex);
+
+    if (!submitTask(importTask, job)) {
+        lockMutex(&importMutex);
+        importsInFlight--;
+        unlockMutex(&importMutex);
+        free(job);
+        entry->state = MODEL_FAILED;
+    }
+}
+
+static void discardJob(ImportJob* job) {
+    if (job->meshes) {
+        Model partial = { .meshes = job->meshes, .meshCount = job->imported.meshCount };
+        freeModel(&partial);
+    }
+    releaseImportedModel(&job->imported);
+    free(job);
+}
+
+static void onMeshBufferUploaded(void* user) {
+    ImportJob* job = (ImportJob*)user;
+    job->pendingUploads--;
+}
+
+// Allocates the buffers and hands the mapped or imported blobs to the upload queue
+static bool startJobUploads(ImportJob* job) {
+    job->meshes = (Mesh*)calloc(job->imported.meshCount, sizeof(Mesh));
+    if (!job->meshes) return false;
+
+    for (unsigned int i = 0; i < job->imported.meshCount; i++) {
+        const MeshData* data = &job->imported.meshes[i];
+        job->meshes[i] = allocateMeshBuffers(data);
+        if (!job->meshes[i].VAO) continue;
+
+        job->pendingUploads += 2;
+        queueBufferUpload(job->meshes[i].VBO, data->vertices, getMeshVertexBytes(data), onMeshBufferUploaded, job);
+        queueBufferUpload(job->meshes[i].EBO, data->indices, getMeshIndexBytes(data), onMeshBufferUploaded, job);
+    }
+    return true;
+}
+
+static void finishJob(ImportJob* job) {
+    ModelEntry* entry = job->entry;
+
+    if (entry->refCount > 0) {
+        entry->model.meshes = job->meshes;
+        entry->model.meshCount = job->imported.meshCount;
+        computeModelBounds(&job->imported, &entry->model);
+        entry->state = MODEL_RESIDENT;
+        job->meshes = NULL;
+        modelsLanded++;
+        LOG_DEBUG(LOG_ASSETS, "Model registry: %s ready (%u meshes)", entry->canonicalPath, entry->model.meshCount);
+    } else {
+        entry->state = MODEL_UNLOADED; // Every user went away while it was loading
+    }
+    discardJob(job);
+}
+
+void processModelImports(void) {
+    if (!registryInitialized) return;
+
+    // Models whose buffers have all landed become visible
+    ImportJob** link = &uploadHead;
+    while (*link) {
+        ImportJob* job = *link;
+        if (job->pendingUploads == 0) {
+            *link = job->next;
+            finishJob(job);
+        } else {
+            link = &job->next;
+        }
+    }
+
+    // Take everything the workers finished since last frame
+    lockMutex(&importMutex);
+    ImportJob* completed = completedHead;
+    completedHead = completedTail = NULL;
+    unlockMutex(&importMutex);
+
+    while (completed) {
+        ImportJob* job = completed;
+        ModelEntry* entry = job->entry;
+        completed = job->next;
+
+        if (job->succeeded && entry->refCount > 0 && startJobUploads(job)) {
+            job->next = uploadHead;
+            uploadHead = job;
+            continue;
+        }
+
+        if (job->succeeded || entry->refCount == 0) {
+            entry->state = MODEL_UNLOADED;
+        } else {
+            entry->state = MODEL_FAILED;
+            LOG_ERROR(LOG_ASSETS, "Model registry: failed to import %s", entry->canonicalPath);
+        }
+        discardJob(job);
+    }
+}
+
+static ModelEntry* createEntry(const char* path, const char* canonicalPath, uint64_t contentHash) {
+    if (entryCount == entryCapacity) {
+        int newCapacity = entryCapacity ? entryCapacity * 2 : 16;
+        ModelEntry** grown = (ModelEntry**)realloc(entries, newCapacity * sizeof(ModelEntry*));
+        if (!grown) return NULL;
+        entries = grown;
+        entryCapacity = newCapacity;
+    }
+
+    ModelEntry* entry = (ModelEntry*)calloc(1, sizeof(ModelEntry));
+    if (!entry) return NULL;
+
+    strncpy(entry->model.path, path, sizeof(entry->model.path) - 1);
+    snprintf(entry->canonicalPath, sizeof(entry->canonicalPath), "%s", canonicalPath);
+    entry->contentHash = contentHash;
+    entry->state = MODEL_UNLOADED;
+
+    entries[entryCount++] = entry;
+    return entry;
+}
+
+Model* acquireModel(const char* path) {
+    if (!path || !path[0]) return NULL;
+    initModelRegistry();
+
+    char canonicalPath[512];
+    canonicalizePath(path, canonicalPath, sizeof(canonicalPath));
+
+    ModelEntry* entry = findEntryByPath(canonicalPath);
+    if (!entry) {
+        // A different path to identical content shares the same buffers
+        uint64_t contentHash;
+        if (!hashFile(canonicalPath, &contentHash)) {
+            LOG_ERROR(LOG_ASSETS, "Model registry: cannot read %s", path);
+            return NULL;
+        }
+
+        entry = findEntryByHash(contentHash);
+        if (!entry) {
+            entry = createEntry(path, canonicalPath, contentHash);
+            if (!entry) return NULL;
+        }
+    }
+
+    retainModel(&entry->model);
+    return &entry->model;
+}
+
+void retainModel(Model* model) {
+    if (!model) return;
+    ModelEntry* entry = (ModelEntry*)model;
+
+    if (entry->refCount++ == 0 && entry->state == MODEL_UNLOADED) {
+        queueImport(entry);
+    }
+}
+
+void releaseModel(Model* model) {
+    if (!model) return;
+    ModelEntry* entry = (ModelEntry*)model;
+    if (entry->refCount <= 0) return;
+
+    // Last reference gone, drop the GPU buffers but keep the entry for re-use.
+    // A model still loading is discarded when its import completes.
+    if (--entry->refCount == 0 && entry->state == MODEL_RESIDENT) {
+        freeModel(&entry->model);
+        entry->model.meshCount = 0;
+        entry->state = MODEL_UNLOADED;
+    }
+}
+
+void cleanupModelRegistry(void) {
+    if (registryInitialized) {
+        // Queued imports bail out early, wait for the ones already running
+        lockMutex(&importMutex);
+        importsCancelled = true;
+        while (importsInFlight > 0) {
+            waitCondition(&importCondition, &importMutex);
+        }
+        while (completedHead) {
+            ImportJob* job = completedHead;
+            completedHead = job->next;
+            discardJob(job);
+        }
+        completedTail = NULL;
+        unlockMutex(&importMutex);
+
+        // The upload queue is shut down first, so nothing references these any more
+        while (uploadHead) {
+            ImportJob* job = uploadHead;
+            uploadHead = job->next;
+            discardJob(job);
+        }
+
+        for (int i = 0; i < MAX_JOB_THREADS; i++) {
+            if (workerProperties[i]) {
+                aiReleasePropertyStore(workerProperties[i]);
+                workerProperties[i] = NULL;
+            }
+        }
+
+        destroyCondition(&importCondition);
+        destroyMutex(&importMutex);
+        registryInitialized = false;
+    }
+
+    for (int i = 0; i < entryCount; i++) {
+        freeModel(&entries[i]->model);
+        free(entries[i]);
+    }
+    free(entries);
+    entries = NULL;
+    entryCount = 0;
+    entryCapacity = 0;
+}
+
+int getRegisteredModelCount(void) {
+    return entryCount;
+}
+
+int getResidentModelCount(void) {
+    int resident = 0;
+    for (int i = 0; i < entryCount; i++) {
+        if (entries[i]->state == MODEL_RESIDENT) resident++;
+    }
+    return resident;
+}
+
+int getPendingImportCount(void) {
+    int pending = 0;
+    for (int i = 0; i < entryCount; i++) {
+        if (entries[i]->state == MODEL_LOADING) pending++;
+    }
+    return pending;
+}
+
+unsigned int getModelsLanded(void) {
+    return modelsLanded;
+}
+
+uint64_t getModelContentHash(const Model* model) {
+    return model ? ((const ModelEntry*)model)->contentHash : 0;
+}
@@ -1,14 +1,15 @@
 #include "resource_loader.h"
 #include "textures.h"
 #include "materials.h"
+#include "log.h"
 #include <stdio.h>
 
 void load_material() {
-    printf("Loading material...\n");
+    LOG_INFO(LOG_ASSETS, "Loading material...");
     loadPBRTextures(); 
 }
 
 void load_texture() {
-    printf("Loading texture...\n");
+    LOG_INFO(LOG_ASSETS, "Loading texture...");
     loadAllTextures();  
 }
\ No newline at end of file
@@ -0,0 +1,393 @@
+#include "scene_graph.h"
+#include "thread_pool.h"
+#include "Camera.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCENE_GRAPH_INITIAL_CAPACITY 256
+
+// One array per field, indexed by node
+typedef struct {
+    EntityId* entities;
+    EntityId* parentEntities;  // Survives re-sorting, parents[] is derived from it
+    int* parents;              // Node index, -1 for roots, valid once sorted
+    int* childCounts;
+    Matrix4x4* locals;
+    Matrix4x4* worlds;
+    Matrix4x4* previous;       // World before the last recompute
+    unsigned int* serials;     // Update that last recomputed the world, 0 for none
+    unsigned char* dirty;      // Local changed since the last update
+    unsigned char* updated;    // World recomputed by the last update
+} NodeArrays;
+
+static NodeArrays nodes;
+static NodeArrays sorted;      // Re-sorting fills this and swaps it in
+static int nodeCount = 0;
+static int nodeCapacity = 0;
+static bool needsSort = false;
+
+static int* nodeOf = NULL;     // Entity index to node, -1 without one
+static int nodeOfCapacity = 0;
+
+static int* levelStarts = NULL; // levelCount + 1 entries
+static int levelCount = 0;
+static int levelCapacity = 0;
+
+static int* scratch = NULL;
+static int scratchCapacity = 0;
+
+static SceneGraphStats stats;
+static unsigned int updateSerial = 0;
+
+static void freeNodeArrays(NodeArrays* arrays) {
+    free(arrays->entities);
+    free(arrays->parentEntities);
+    free(arrays->parents);
+    free(arrays->childCounts);
+    free(arrays->locals);
+    free(arrays->worlds);
+    free(arrays->previous);
+    free(arrays->serials);
+    free(arrays->dirty);
+    free(arrays->updated);
+    memset(arrays, 0, sizeof(*arrays));
+}
+
+void initSceneGraph(void) {
+    memset(&nodes, 0, sizeof(nodes));
+    memset(&sorted, 0, sizeof(sorted));
+    nodeCount = nodeCapacity = 0;
+    nodeOf = NULL;
+    nodeOfCapacity = 0;
+    levelStarts = NULL;
+    levelCount = levelCapacity = 0;
+    scratch = NULL;
+    scratchCapacity = 0;
+    needsSort = false;
+    updateSerial = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void shutdownSceneGraph(void) {
+    freeNodeArrays(&nodes);
+    freeNodeArrays(&sorted);
+    free(nodeOf);
+    free(levelStarts);
+    free(scratch);
+    initSceneGraph();
+}
+
+static bool growArray(void** array, int capacity, size_t elementSize) {
+    void* grown = realloc(*array, (size_t)capacity * elementSize);
+    if (!grown) return false;
+    *array = grown;
+    return true;
+}
+
+static bool growNodeArrays(NodeArrays* arrays, int capacity) {
+    return growArray((void**)&arrays->entities, capacity, sizeof(EntityId)) &&
+        growArray((void**)&arrays->parentEntities, capacity, sizeof(EntityId)) &&
+        growArray((void**)&arrays->parents, capacity, sizeof(int)) &&
+        growArray((void**)&arrays->childCounts, capacity, sizeof(int)) &&
+        growArray((void**)&arrays->locals, capacity, sizeof(Matrix4x4)) &&
+        growArray((void**)&arrays->worlds, capacity, sizeof(Matrix4x4)) &&
+        growArray((void**)&arrays->previous, capacity, sizeof(Matrix4x4)) &&
+        growArray((void**)&arrays->serials, capacity, sizeof(unsigned int)) &&
+        growArray((void**)&arrays->dirty, capacity, 1) &&
+        growArray((void**)&arrays->updated, capacity, 1);
+}
+
+static bool reserveNodes(int count) {
+    if (count <= nodeCapacity) return true;
+    int capacity = nodeCapacity ? nodeCapacity : SCENE_GRAPH_INITIAL_CAPACITY;
+    while (capacity < count) capacity *= 2;
+    if (!growNodeArrays(&nodes, capacity) || !growNodeArrays(&sorted, capacity)) {
+        LOG_ERROR(LOG_SCENE, "Out of memory growing the scene graph to %d nodes", capacity);
+        return false;
+    }
+    nodeCapacity = capacity;
+    return true;
+}
+
+static bool reserveNodeOf(unsigned int entityIndex) {
+    if ((int)entityIndex < nodeOfCapacity) return true;
+    int capacity = nodeOfCapacity ? nodeOfCapacity : SCENE_GRAPH_INITIAL_CAPACITY;
+    while (capacity <= (int)entityIndex) capacity *= 2;
+    if (!growArray((void**)&nodeOf, capacity, sizeof(int))) return false;
+    for (int i = nodeOfCapacity; i < capacity; i++) nodeOf[i] = -1;
+    nodeOfCapacity = capacity;
+    return true;
+}
+
+static bool sameEntity(EntityId a, EntityId b) {
+    return a.index == b.index && a.generation == b.generation;
+}
+
+static int findNode(EntityId entity) {
+    if (entity.generation == 0 || (int)entity.index >= nodeOfCapacity) return -1;
+    int node = nodeOf[entity.index];
+    return node >= 0 && sameEntity(nodes.entities[node], entity) ? node : -1;
+}
+
+EntityId createSceneEntity(ComponentMask components) {
+    EntityId entity = createEntity(components | COMPONENT_BIT(COMPONENT_TRANSFORM));
+    if (entity.generation == 0) return entity;
+    if (!reserveNodes(nodeCount + 1) || !reserveNodeOf(entity.index)) {
+        destroyEntity(entity);
+        return INVALID_ENTITY;
+    }
+
+    int node = nodeCount++;
+    nodes.entities[node] = entity;
+    nodes.parentEntities[node] = INVALID_ENTITY;
+    nodes.parents[node] = -1;
+    nodes.childCounts[node] = 0;
+    nodes.locals[node] = identityMatrix();
+    nodes.worlds[node] = identityMatrix();
+    nodes.previous[node] = identityMatrix();
+    nodes.serials[node] = 0;
+    nodes.dirty[node] = 1;
+    nodes.updated[node] = 0;
+    nodeOf[entity.index] = node;
+    needsSort = true;
+    return entity;
+}
+
+static void moveNode(int from, int to) {
+    nodes.entities[to] = nodes.entities[from];
+    nodes.parentEntities[to] = nodes.parentEntities[from];
+    nodes.childCounts[to] = nodes.childCounts[from];
+    nodes.locals[to] = nodes.locals[from];
+    nodes.worlds[to] = nodes.worlds[from];
+    nodes.previous[to] = nodes.previous[from];
+    nodes.serials[to] = nodes.serials[from];
+    nodes.dirty[to] = nodes.dirty[from];
+    nodes.updated[to] = nodes.updated[from];
+    nodeOf[nodes.entities[to].index] = to;
+}
+
+void destroySceneEntity(EntityId entity) {
+    int node = findNode(entity);
+    if (node >= 0) {
+        EntityId parent = nodes.parentEntities[node];
+        int parentNode = findNode(parent);
+
+        // Leaves skip the scan, which keeps clearing a large scene linear
+        if (nodes.childCounts[node] > 0) {
+            for (int i = 0; i < nodeCount; i++) {
+                if (!sameEntity(nodes.parentEntities[i], entity)) continue;
+                // The removed local moves into the child, so its world stays put
+                nodes.locals[i] = matrixMultiply(nodes.locals[i], nodes.locals[node]);
+                nodes.parentEntities[i] = parent;
+                nodes.dirty[i] = 1;
+                if (parentNode >= 0) nodes.childCounts[parentNode]++;
+            }
+        }
+        if (parentNode >= 0) nodes.childCounts[parentNode]--;
+
+        nodeOf[entity.index] = -1;
+        int last = --nodeCount;
+        if (node != last) moveNode(last, node);
+        needsSort = true;
+    }
+    destroyEntity(entity);
+}
+
+void setLocalTransform(EntityId entity, Vector3 position, Vector3 rotation, Vector3 scale) {
+    int node = findNode(entity);
+    if (node < 0) return;
+    nodes.locals[node] = composeTransform(position, rotation, scale);
+    nodes.dirty[node] = 1;
+}
+
+bool setParent(EntityId child, EntityId parent) {
+    int node = findNode(child);
+    if (node < 0) return false;
+
+    int parentNode = -1;
+    if (parent.generation != 0) {
+        parentNode = findNode(parent);
+        if (parentNode < 0) return false;
+        // The new parent must not sit below the child
+        for (int up = parentNode; up >= 0; up = findNode(nodes.parentEntities[up])) {
+            if (up == node) return false;
+        }
+    }
+
+    int oldParent = findNode(nodes.parentEntities[node]);
+    if (oldParent == parentNode) return true;
+    if (oldParent >= 0) nodes.childCounts[oldParent]--;
+    if (parentNode >= 0) nodes.childCounts[parentNode]++;
+    nodes.parentEntities[node] = parentNode >= 0 ? parent : INVALID_ENTITY;
+    nodes.dirty[node] = 1;
+    needsSort = true;
+    return true;
+}
+
+EntityId getParent(EntityId entity) {
+    int node = findNode(entity);
+    if (node < 0 || findNode(nodes.parentEntities[node]) < 0) return INVALID_ENTITY;
+    return nodes.parentEntities[node];
+}
+
+int getChildren(EntityId entity, EntityId* children, int capacity) {
+    int node = findNode(entity);
+    if (node < 0 || nodes.childCounts[node] == 0) return 0;
+    int count = 0;
+    for (int i = 0; i < nodeCount; i++) {
+        if (!sameEntity(nodes.parentEntities[i], entity)) continue;
+        if (count < capacity) children[count] = nodes.entities[i];
+        count++;
+    }
+    return count;
+}
+
+int getSceneDepth(EntityId entity) {
+    int node = findNode(entity);
+    if (node < 0) return -1;
+    int depth = 0;
+    for (int up = findNode(nodes.parentEntities[node]); up >= 0; up = findNode(nodes.parentEntities[up])) {
+        depth++;
+    }
+    return depth;
+}
+
+static bool reserveLevels(int count) {
+    if (count <= levelCapacity) return true;
+    int capacity = levelCapacity ? levelCapacity * 2 : 16;
+    while (capacity < count) capacity *= 2;
+    if (!growArray((void**)&levelStarts, capacity, sizeof(int))) return false;
+    levelCapacity = capacity;
+    return true;
+}
+
+// Breadth-first order from the parent links, O(nodes)
+static bool sortNodes(void) {
+    int n = nodeCount;
+    if (n + 1 > scratchCapacity) {
+        int capacity = scratchCapacity ? scratchCapacity : SCENE_GRAPH_INITIAL_CAPACITY;
+        while (capacity < n + 1) capacity *= 2;
+        if (!growArray((void**)&scratch, capacity * 4, sizeof(int))) {
+            LOG_ERROR(LOG_SCENE, "Out of memory sorting the scene graph");
+            return false;
+        }
+        scratchCapacity = capacity;
+    }
+    int* parentOf = scratch;
+    int* childStarts = parentOf + scratchCapacity;  // n + 1 entries
+    int* children = childStarts + scratchCapacity;
+    int* order = children + scratchCapacity;
+
+    // Children grouped by parent, counting sort
+    memset(childStarts, 0, (size_t)(n + 1) * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        parentOf[i] = findNode(nodes.parentEntities[i]);
+        if (parentOf[i] >= 0) childStarts[parentOf[i] + 1]++;
+    }
+    for (int i = 1; i <= n; i++) childStarts[i] += childStarts[i - 1];
+    memcpy(order, childStarts, (size_t)n * sizeof(int));  // Fill cursors until the walk below
+    for (int i = 0; i < n; i++) {
+        if (parentOf[i] >= 0) children[order[parentOf[i]]++] = i;
+    }
+
+    // Roots, then one level at a time
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        if (parentOf[i] < 0) order[count++] = i;
+    }
+    levelCount = 0;
+    if (!reserveLevels(1)) return false;
+    levelStarts[0] = 0;
+    int levelBegin = 0;
+    while (levelBegin < count) {
+        int levelEnd = count;
+        if (!reserveLevels(levelCount + 2)) return false;
+        levelStarts[++levelCount] = levelEnd;
+        for (int h = levelBegin; h < levelEnd; h++) {
+            int node = order[h];
+            for (int c = childStarts[node]; c < childStarts[node + 1]; c++) {
+                order[count++] = children[c];
+            }
+        }
+        levelBegin = levelEnd;
+    }
+
+    // Old index to new, children[] is free again
+    int* newIndex = children;
+    for (int k = 0; k < n; k++) newIndex[order[k]] = k;
+    for (int k = 0; k < n; k++) {
+        int from = order[k];
+        sorted.entities[k] = nodes.entities[from];
+        sorted.parentEntities[k] = nodes.parentEntities[from];
+        sorted.parents[k] = parentOf[from] >= 0 ? newIndex[parentOf[from]] : -1;
+        sorted.childCounts[k] = nodes.childCounts[from];
+        sorted.locals[k] = nodes.locals[from];
+        sorted.worlds[k] = nodes.worlds[from];
+        sorted.previous[k] = nodes.previous[from];
+        sorted.serials[k] = nodes.serials[from];
+        sorted.dirty[k] = nodes.dirty[from];
+        sorted.updated[k] = 0;
+        nodeOf[sorted.entities[k].index] = k;
+    }
+
+    NodeArrays swap = nodes;
+    nodes = sorted;
+    sorted = swap;
+    needsSort = false;
+    return true;
+}
+
+static void updateLevelRange(void* data, int begin, int end, int workerIndex) {
+    (void)workerIndex;
+    int first = *(const int*)data;
+    for (int i = first + begin; i < first + end; i++) {
+        int parent = nodes.parents[i];
+        bool changed = nodes.dirty[i] || (parent >= 0 && nodes.updated[parent]);
+        nodes.updated[i] = changed;
+        if (!changed) continue;
+        nodes.dirty[i] = 0;
+        nodes.previous[i] = nodes.worlds[i];
+        nodes.serials[i] = updateSerial;
+        // matrixMultiply(a, b) applies a first, so the parent goes second
+        nodes.worlds[i] = parent >= 0 ? matrixMultiply(nodes.locals[i], nodes.worlds[parent]) : nodes.locals[i];
+    }
+}
+
+void updateWorldTransforms(void) {
+    stats.reordered = needsSort;
+    if (needsSort && !sortNodes()) return;
+    updateSerial++;
+
+    // A level only reads the one above, which is finished
+    for (int level = 0; level < levelCount; level++) {
+        int first = levelStarts[level];
+        parallelFor(levelStarts[level + 1] - first, SCENE_LEVEL_RANGE, updateLevelRange, &first);
+    }
+
+    stats.updated = 0;
+    for (int i = 0; i < nodeCount; i++) {
+        if (!nodes.updated[i]) continue;
+        Transform* transform = writeComponent(nodes.entities[i], COMPONENT_TRANSFORM);
+        if (transform) transform->world = nodes.worlds[i];
+        stats.updated++;
+    }
+    stats.nodes = nodeCount;
+    stats.levels = levelCount;
+}
+
+unsigned int getWorldUpdateSerial(void) {
+    return updateSerial;
+}
+
+unsigned int getPreviousWorld(EntityId entity, Matrix4x4* previous) {
+    int node = findNode(entity);
+    if (node < 0) return 0;
+    *previous = nodes.previous[node];
+    return nodes.serials[node];
+}
+
+const SceneGraphStats* getSceneGraphStats(void) {
+    return &stats;
+}
@@ -0,0 +1,225 @@
+#include "scene_systems.h"
+#include "ecs.h"
+#include "scene_graph.h"
+#include "ObjectManager.h"
+#include "model_registry.h"
+#include "lod.h"
+#include "Camera.h"
+#include "lightshading.h"
+#include "threading.h"
+#include "log.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// How a staged object's matrices change when published
+typedef enum {
+    STAGED_BOUNDS_ONLY,    // Not moved by the step, a model import changed its bounds
+    STAGED_SNAP,           // Edited or moved before the last tick, drawn where it is
+    STAGED_INTERPOLATE     // Moved by the last tick, drawn between previous and world
+} StagedMotion;
+
+// Bounds the last step recomputed, by dense index. The step only writes
+// here, publishScene copies them into the object manager's columns
+typedef struct {
+    int index;
+    StagedMotion motion;
+    Vector4 sphere;
+    Matrix4x4 world;
+    Matrix4x4 previous;
+} StagedBounds;
+
+static StagedBounds* staged = NULL;
+static volatile unsigned int stagedCount = 0;
+static int stagedCapacity = 0;
+static bool stagedTicks = false;  // Interpolation restarts from the step's last tick
+
+// World update serials of the running step, see getPreviousWorld
+static unsigned int stepStartSerial = 0;
+static unsigned int lastTickSerial = 0;   // 0 when the step ran no tick
+
+static bool sameVector(Vector3 a, Vector3 b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+static void syncRenderableChunk(const ChunkView* view, void* data, int workerIndex) {
+    (void)data;
+    (void)workerIndex;
+    Transform* transforms = getChunkColumn(view, COMPONENT_TRANSFORM);
+    const Renderable* renderables = getChunkColumn(view, COMPONENT_RENDERABLE);
+
+    for (int i = 0; i < view->count; i++) {
+        const SceneObject* obj = getObject(renderables[i].object);
+        if (!obj) continue;
+        Transform* transform = &transforms[i];
+        if (sameVector(transform->position, obj->position) &&
+            sameVector(transform->rotation, obj->rotation) &&
+            sameVector(transform->scale, obj->scale)) continue;
+        transform->position = obj->position;
+        transform->rotation = obj->rotation;
+        transform->scale = obj->scale;
+        setLocalTransform(view->entities[i], obj->position, obj->rotation, obj->scale);
+    }
+}
+
+void syncRenderables(void) {
+    EntityQuery query = { COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_RENDERABLE), 0, 0, 0 };
+    parallelForChunks(&query, syncRenderableChunk, NULL);
+}
+
+static void updateBoundsChunk(const ChunkView* view, void* data, int workerIndex) {
+    (void)data;
+    (void)workerIndex;
+    const Transform* transforms = getChunkColumn(view, COMPONENT_TRANSFORM);
+    const Renderable* renderables = getChunkColumn(view, COMPONENT_RENDERABLE);
+    Bounds* bounds = getChunkColumn(view, COMPONENT_BOUNDS);
+
+    for (int i = 0; i < view->count; i++) {
+        int index = getObjectIndex(renderables[i].object);
+        if (index < 0) continue;
+
+        Vector3 localCenter;
+        float radius;
+        getObjectLocalBounds(&objectManager.objects[index], &localCenter, &radius);
+        const Transform* transform = &transforms[i];
+        const float (*m)[4] = transform->world.data;
+        // Axis lengths of the world matrix, so parent scale counts too
+        float maxScale = 0.0f;
+        for (int axis = 0; axis < 3; axis++) {
+            maxScale = fmaxf(maxScale, sqrtf(m[axis][0] * m[axis][0] + m[axis][1] * m[axis][1] + m[axis][2] * m[axis][2]));
+        }
+        bounds[i].sphere = (Vector4){
+            m[0][0] * localCenter.x + m[1][0] * localCenter.y + m[2][0] * localCenter.z + m[3][0],
+            m[0][1] * localCenter.x + m[1][1] * localCenter.y + m[2][1] * localCenter.z + m[3][1],
+            m[0][2] * localCenter.x + m[1][2] * localCenter.y + m[2][2] * localCenter.z + m[3][2],
+            radius * maxScale
+        };
+
+        StagedBounds* entry = &staged[atomicIncrement(&stagedCount) - 1];
+        entry->index = index;
+        entry->sphere = bounds[i].sphere;
+        entry->world = transform->world;
+        unsigned int moved = getPreviousWorld(view->entities[i], &entry->previous);
+        if (lastTickSerial != 0 && moved == lastTickSerial) entry->motion = STAGED_INTERPOLATE;
+        else if (moved > stepStartSerial) entry->motion = STAGED_SNAP;
+        else entry->motion = STAGED_BOUNDS_ONLY;
+    }
+    markChunkChanged(view, COMPONENT_BOUNDS);
+}
+
+void updateRenderableBounds(void) {
+    static unsigned int lastRun = 0;
+    static unsigned int modelsSeen = 0;
+    EntityQuery query = {
+        COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_RENDERABLE) | COMPONENT_BIT(COMPONENT_BOUNDS),
+        0, COMPONENT_BIT(COMPONENT_TRANSFORM), 0
+    };
+    // One entry per object at most. Dense indices hold until publishScene,
+    // structural changes wait for the step to finish
+    int needed = (int)stagedCount + objectManager.count;
+    if (needed > stagedCapacity) {
+        StagedBounds* grown = (StagedBounds*)realloc(staged, (size_t)needed * sizeof(StagedBounds));
+        if (!grown) {
+            LOG_ERROR(LOG_SCENE, "Out of memory staging bounds for %d objects", objectManager.count);
+            return;
+        }
+        staged = grown;
+        stagedCapacity = needed;
+    }
+    query.changedSince = beginSystemRun(&lastRun);
+
+    // A model that finished importing changes the bounds of everything using it
+    if (getModelsLanded() != modelsSeen) {
+        modelsSeen = getModelsLanded();
+        query.changed = 0;
+    }
+    parallelForChunks(&query, updateBoundsChunk, NULL);
+}
+
+typedef struct {
+    float deltaTime;
+} RigidBodyStep;
+
+static void integrateChunk(const ChunkView* view, void* data, int workerIndex) {
+    (void)workerIndex;
+    const RigidBodyStep* step = data;
+    Transform* transforms = getChunkColumn(view, COMPONENT_TRANSFORM);
+    const RigidBody* bodies = getChunkColumn(view, COMPONENT_RIGID_BODY);
+    const Renderable* renderables = getChunkColumn(view, COMPONENT_RENDERABLE);
+
+    for (int i = 0; i < view->count; i++) {
+        // Renderables start from their object record, the editor may have moved it since the last sync
+        SceneObject* obj = renderables ? getObject(renderables[i].object) : NULL;
+        Transform* transform = &transforms[i];
+        Vector3 position = obj ? obj->position : transform->position;
+        Vector3 rotation = obj ? obj->rotation : transform->rotation;
+        transform->position = vector_add(position, vector_scale(bodies[i].velocity, step->deltaTime));
+        transform->rotation = vector_add(rotation, vector_scale(bodies[i].angularVelocity, step->deltaTime));
+        if (obj) {
+            obj->position = transform->position;
+            obj->rotation = transform->rotation;
+        }
+        setLocalTransform(view->entities[i], transform->position, transform->rotation, transform->scale);
+    }
+}
+
+void integrateRigidBodies(double deltaTime) {
+    RigidBodyStep step = { (float)deltaTime };
+    EntityQuery query = { COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_RIGID_BODY), 0, 0, 0 };
+    parallelForChunks(&query, integrateChunk, &step);
+}
+
+void stepScene(int ticks, double tickLength, bool running) {
+    int moving = running ? ticks : 0;
+    stepStartSerial = getWorldUpdateSerial();
+    lastTickSerial = 0;
+
+    // Edits and every tick but the last land in one update and snap
+    syncRenderables();
+    for (int i = 0; i < moving - 1; i++) {
+        integrateRigidBodies(tickLength);
+    }
+    updateWorldTransforms();
+
+    // The last tick gets its own update, so its nodes keep the world they came from
+    if (moving > 0) {
+        integrateRigidBodies(tickLength);
+        updateWorldTransforms();
+        lastTickSerial = getWorldUpdateSerial();
+    }
+    updateRenderableBounds();
+    updateLights();
+    // Paused objects settle too, rather than hang between two ticks
+    stagedTicks = ticks > 0 || !running;
+}
+
+void publishScene(float alpha) {
+    if (stagedTicks) snapObjectMatrices();
+    for (unsigned int i = 0; i < stagedCount; i++) {
+        const StagedBounds* entry = &staged[i];
+        int index = entry->index;
+        objectManager.bounds[index] = entry->sphere;
+        if (entry->motion == STAGED_BOUNDS_ONLY) continue;
+
+        objectManager.tickMatrices[index] = entry->world;
+        if (entry->motion == STAGED_INTERPOLATE) {
+            objectManager.previousMatrices[index] = entry->previous;
+            objectManager.flags[index] |= OBJECT_FLAG_INTERPOLATED;
+        }
+        else {
+            objectManager.modelMatrices[index] = entry->world;
+            objectManager.flags[index] &= ~OBJECT_FLAG_INTERPOLATED;
+        }
+    }
+    stagedCount = 0;
+    stagedTicks = false;
+    interpolateObjectMatrices(alpha);
+    publishLights();
+}
+
+void shutdownSceneSystems(void) {
+    free(staged);
+    staged = NULL;
+    stagedCount = 0;
+    stagedCapacity = 0;
+}
@@ -0,0 +1,251 @@
+#include "simulation.h"
+#include "threading.h"
+#include "thread_pool.h"
+#include "frame_timing.h"
+#include "scene_systems.h"
+#include "globals.h"
+#include "log.h"
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MOVE_DIRECTIONS 6
+
+// Camera input gathered since the last step, and the step's ticks
+typedef struct {
+    float moveSeconds[MOVE_DIRECTIONS];  // How long each movement key was held
+    float lookX, lookY;
+    float panX, panY;
+    float zoom;
+    bool replaceCamera;
+    Camera camera;                       // With replaceCamera
+    int ticks;
+    double tickLength;
+    bool running;
+} SimulationInput;
+
+bool pipelinedSimulation = false;
+
+static const int moveDirections[MOVE_DIRECTIONS] = { FORWARD, BACKWARD, LEFT, RIGHT, SPACE, SHIFT };
+
+// Main thread only
+static SimulationInput pending;
+static bool threadRunning = false;
+static bool stepInFlight = false;
+static float stepAlpha = 0.0f;     // Tick fraction when the step in flight started
+static SimulationInput inFlight;   // What the step in flight was given
+
+// Simulation thread only while a step runs, the main thread's in between
+static Camera simCamera;
+static SimulationStats stats;
+
+// Shared, guarded by simMutex
+static Thread simThread;
+static Mutex simMutex;
+static Condition inputCondition;
+static Condition doneCondition;
+static SimulationInput mailbox;
+static bool inputReady = false;
+static bool stepDone = false;
+static bool stopRequested = false;
+
+static void clearInput(SimulationInput* input) {
+    memset(input, 0, sizeof(*input));
+}
+
+static void applyInput(Camera* target, const SimulationInput* input) {
+    if (input->replaceCamera) *target = input->camera;
+    if (input->lookX != 0.0f || input->lookY != 0.0f) processMouseMovement(target, input->lookX, input->lookY, true);
+    if (input->panX != 0.0f || input->panY != 0.0f) processMousePan(target, input->panX, input->panY);
+    if (input->zoom != 0.0f) processMouseScroll(target, input->zoom);
+    for (int d = 0; d < MOVE_DIRECTIONS; d++) {
+        if (input->moveSeconds[d] > 0.0f) processKeyboard(target, moveDirections[d], input->moveSeconds[d]);
+    }
+}
+
+static void runStep(const SimulationInput* input) {
+    double start = glfwGetTime();
+    stepScene(input->ticks, input->tickLength, input->running);
+    stats.stepTime = glfwGetTime() - start;
+    stats.steps++;
+}
+
+static void simulationMain(void* arg) {
+    (void)arg;
+    for (;;) {
+        lockMutex(&simMutex);
+        while (!inputReady && !stopRequested) {
+            waitCondition(&inputCondition, &simMutex);
+        }
+        if (!inputReady) {
+            unlockMutex(&simMutex);
+            break;
+        }
+        SimulationInput input = mailbox;
+        inputReady = false;
+        unlockMutex(&simMutex);
+
+        applyInput(&simCamera, &input);
+        runStep(&input);
+
+        lockMutex(&simMutex);
+        stepDone = true;
+        signalCondition(&doneCondition);
+        unlockMutex(&simMutex);
+    }
+    // The steps helped with their own parallelFor jobs
+    releaseJobThreadIndex();
+}
+
+static void startSimulationThread(void) {
+    initMutex(&simMutex);
+    initCondition(&inputCondition);
+    initCondition(&doneCondition);
+    simCamera = camera;
+    inputReady = false;
+    stepDone = false;
+    stopRequested = false;
+
+    if (!createThread(&simThread, simulationMain, NULL)) {
+        LOG_WARN(LOG_CORE, "Failed to start the simulation thread, staying single-threaded");
+        destroyCondition(&doneCondition);
+        destroyCondition(&inputCondition);
+        destroyMutex(&simMutex);
+        pipelinedSimulation = false;
+        return;
+    }
+    threadRunning = true;
+    stats.threaded = true;
+}
+
+// Only between steps, the last one has been published
+static void stopSimulationThread(void) {
+    lockMutex(&simMutex);
+    stopRequested = true;
+    signalCondition(&inputCondition);
+    unlockMutex(&simMutex);
+    joinThread(&simThread);
+    destroyCondition(&doneCondition);
+    destroyCondition(&inputCondition);
+    destroyMutex(&simMutex);
+    threadRunning = false;
+    stats.threaded = false;
+
+    // Input sampled since the last step goes to the camera directly from now on
+    applyInput(&camera, &pending);
+    clearInput(&pending);
+}
+
+void moveCamera(unsigned int movementKeys, float deltaTime) {
+    SimulationInput input;
+    clearInput(&input);
+    for (int d = 0; d < MOVE_DIRECTIONS; d++) {
+        if (movementKeys & (1u << d)) input.moveSeconds[d] = deltaTime;
+    }
+    if (threadRunning) {
+        for (int d = 0; d < MOVE_DIRECTIONS; d++) pending.moveSeconds[d] += input.moveSeconds[d];
+    }
+    else {
+        applyInput(&camera, &input);
+    }
+}
+
+void lookCamera(float xoffset, float yoffset) {
+    if (threadRunning) {
+        pending.lookX += xoffset;
+        pending.lookY += yoffset;
+    }
+    else {
+        processMouseMovement(&camera, xoffset, yoffset, true);
+    }
+}
+
+void panCamera(float xoffset, float yoffset) {
+    if (threadRunning) {
+        pending.panX += xoffset;
+        pending.panY += yoffset;
+    }
+    else {
+        processMousePan(&camera, xoffset, yoffset);
+    }
+}
+
+void zoomCamera(float yoffset) {
+    if (threadRunning) pending.zoom += yoffset;
+    else processMouseScroll(&camera, yoffset);
+}
+
+void cameraEdited(void) {
+    snapCameraInterpolation();
+    if (threadRunning) pending.replaceCamera = true;
+}
+
+void applyUnsimulatedInput(Camera* target) {
+    if (!threadRunning) return;
+    // A replaced camera is already the global one, only the deltas are missing
+    SimulationInput input;
+    if (stepInFlight) {
+        input = inFlight;
+        input.replaceCamera = false;
+        applyInput(target, &input);
+    }
+    input = pending;
+    input.replaceCamera = false;
+    applyInput(target, &input);
+}
+
+void finishSimulationStep(void) {
+    if (!stepInFlight) return;
+
+    double start = glfwGetTime();
+    lockMutex(&simMutex);
+    while (!stepDone) {
+        waitCondition(&doneCondition, &simMutex);
+    }
+    stepDone = false;
+    unlockMutex(&simMutex);
+    stats.waitTime = glfwGetTime() - start;
+    stepInFlight = false;
+
+    // A direct edit since the step started wins over its camera
+    if (!pending.replaceCamera) camera = simCamera;
+    publishScene(stepAlpha);
+}
+
+void startSimulationStep(int ticks) {
+    if (pipelinedSimulation && !threadRunning) startSimulationThread();
+    else if (!pipelinedSimulation && threadRunning) stopSimulationThread();
+
+    SimulationInput input = pending;
+    input.ticks = ticks;
+    input.tickLength = getTickLength();
+    input.running = isRunning;
+
+    if (!threadRunning) {
+        stats.waitTime = 0.0;
+        runStep(&input);
+        publishScene(getTickAlpha());
+        return;
+    }
+
+    if (input.replaceCamera) input.camera = camera;
+    lockMutex(&simMutex);
+    mailbox = input;
+    inputReady = true;
+    signalCondition(&inputCondition);
+    unlockMutex(&simMutex);
+    clearInput(&pending);
+    inFlight = input;
+    stepAlpha = getTickAlpha();
+    stepInFlight = true;
+}
+
+void shutdownSimulation(void) {
+    finishSimulationStep();
+    pipelinedSimulation = false;
+    if (threadRunning) stopSimulationThread();
+}
+
+const SimulationStats* getSimulationStats(void) {
+    return &stats;
+}
@@ -0,0 +1,265 @@
+#include "command_list.h"
+#include "materials.h"
+#include "meshlet.h"
+#include "lod.h"
+#include "gl_state.h"
+#include "log.h"
+#include <glad/glad.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define INSTANCE_COLOR_ATTRIB 4  // See shaders/objects/vertex.glsl
+#define INSTANCE_MODEL_ATTRIB 5  // mat4, locations 5 to 8
+
+static GLuint instanceBuffer = 0;  // Refilled by each list that merged draws
+
+static Command* appendCommand(CommandList* list, CommandType type) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 256;
+        Command* grown = (Command*)realloc(list->commands, capacity * sizeof(Command));
+        if (!grown) {
+            LOG_ERROR(LOG_RENDER, "Failed to grow command list to %d commands", capacity);
+            return NULL;
+        }
+        list->commands = grown;
+        list->capacity = capacity;
+    }
+    Command* command = &list->commands[list->count++];
+    command->type = type;
+    return command;
+}
+
+void clearCommandList(CommandList* list) {
+    list->count = 0;
+    list->instanceCount = 0;
+}
+
+void freeCommandList(CommandList* list) {
+    free(list->commands);
+    free(list->instances);
+    list->commands = NULL;
+    list->count = 0;
+    list->capacity = 0;
+    list->instances = NULL;
+    list->instanceCount = 0;
+    list->instanceCapacity = 0;
+}
+
+void recordBind(CommandList* list, unsigned int unit, CommandTextureTarget target, unsigned int texture) {
+    Command* command = appendCommand(list, CMD_BIND);
+    if (!command) return;
+    command->data.bind.unit = unit;
+    command->data.bind.target = target;
+    command->data.bind.texture = texture;
+}
+
+void recordConstants(CommandList* list, const ConstantsCommand* constants) {
+    Command* command = appendCommand(list, CMD_SET_CONSTANTS);
+    if (command) command->data.constants = *constants;
+}
+
+void recordDraw(CommandList* list, const DrawCommand* draw) {
+    Command* command = appendCommand(list, CMD_DRAW);
+    if (command) command->data.draw = *draw;
+}
+
+void recordDrawIndirect(CommandList* list, const SceneObject* object) {
+    Command* command = appendCommand(list, CMD_DRAW_INDIRECT);
+    if (command) command->data.indirect.object = object;
+}
+
+static bool appendInstance(CommandList* list, const ConstantsCommand* constants) {
+    if (list->instanceCount == list->instanceCapacity) {
+        int capacity = list->instanceCapacity ? list->instanceCapacity * 2 : 64;
+        CommandInstance* grown = (CommandInstance*)realloc(list->instances, capacity * sizeof(CommandInstance));
+        if (!grown) {
+            LOG_ERROR(LOG_RENDER, "Failed to grow command list to %d instances", capacity);
+            return false;
+        }
+        list->instances = grown;
+        list->instanceCapacity = capacity;
+    }
+    CommandInstance* instance = &list->instances[list->instanceCount++];
+    instance->model = constants->model;
+    instance->color = constants->color;
+    instance->materialLayer = constants->materialLayer;
+    return true;
+}
+
+static bool sameFlags(const ConstantsCommand* a, const ConstantsCommand* b) {
+    return a->useTexture == b->useTexture && a->usePBR == b->usePBR &&
+        a->useColor == b->useColor && a->useMaterialArrays == b->useMaterialArrays;
+}
+
+static bool sameDraw(const DrawCommand* a, const DrawCommand* b) {
+    return a->vertexArray == b->vertexArray && a->indexCount == b->indexCount &&
+        a->indexType == b->indexType && a->indexOffset == b->indexOffset;
+}
+
+bool joinInstancedDraw(CommandList* list, const ConstantsCommand* constants, const DrawCommand* draw, unsigned int texture, int slab) {
+    // Only while nothing was recorded after it, so its binds are still the current ones
+    if (list->count == 0 || list->commands[list->count - 1].type != CMD_DRAW_INSTANCED) return false;
+    DrawInstancedCommand* batch = &list->commands[list->count - 1].data.instanced;
+    if (batch->texture != texture || batch->slab != slab ||
+        !sameFlags(&batch->constants, constants) || !sameDraw(&batch->draw, draw)) return false;
+
+    if (!appendInstance(list, constants)) return false;
+    batch->instanceCount++;
+    return true;
+}
+
+void recordDrawInstanced(CommandList* list, const ConstantsCommand* constants, const DrawCommand* draw, unsigned int texture, int slab) {
+    int firstInstance = list->instanceCount;
+    if (!appendInstance(list, constants)) return;
+    Command* command = appendCommand(list, CMD_DRAW_INSTANCED);
+    if (!command) {
+        list->instanceCount--;
+        return;
+    }
+    DrawInstancedCommand* batch = &command->data.instanced;
+    batch->constants = *constants;
+    batch->draw = *draw;
+    batch->texture = texture;
+    batch->slab = slab;
+    batch->firstInstance = firstInstance;
+    batch->instanceCount = 1;
+}
+
+typedef struct {
+    GLint model;
+    GLint color;
+    GLint useTexture;
+    GLint usePBR;
+    GLint useColor;
+    GLint useMaterialArrays;
+    GLint useInstanceData;
+} ObjectUniforms;
+
+static void setConstantFlags(const ObjectUniforms* uniforms, const ConstantsCommand* constants) {
+    glUniform1i(uniforms->useTexture, constants->useTexture);
+    glUniform1i(uniforms->usePBR, constants->usePBR);
+    glUniform1i(uniforms->useColor, constants->useColor);
+    glUniform1i(uniforms->useMaterialArrays, constants->useMaterialArrays);
+}
+
+static void setInstanceConstants(const ObjectUniforms* uniforms, const Matrix4x4* model, const Vector4* color, bool useMaterialArrays, int materialLayer) {
+    glUniformMatrix4fv(uniforms->model, 1, GL_FALSE, &model->data[0][0]);
+    glUniform4f(uniforms->color, color->x, color->y, color->z, color->w);
+    if (useMaterialArrays) {
+        glVertexAttribI1i(MATERIAL_LAYER_ATTRIB, materialLayer);
+    }
+}
+
+static void uploadInstances(const CommandList* list) {
+    if (!instanceBuffer) glGenBuffers(1, &instanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    // Orphaned each time, draws of the previous list may still be reading it
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)list->instanceCount * sizeof(CommandInstance), list->instances, GL_STREAM_DRAW);
+}
+
+// The instance attributes go on the mesh's own vertex array for this draw only
+static void drawInstances(const DrawInstancedCommand* batch, GLint useInstanceDataLoc) {
+    const char* base = (const char*)((size_t)batch->firstInstance * sizeof(CommandInstance));
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glEnableVertexAttribArray(MATERIAL_LAYER_ATTRIB);
+    glVertexAttribIPointer(MATERIAL_LAYER_ATTRIB, 1, GL_INT, sizeof(CommandInstance), base + offsetof(CommandInstance, materialLayer));
+    glVertexAttribDivisor(MATERIAL_LAYER_ATTRIB, 1);
+    glEnableVertexAttribArray(INSTANCE_COLOR_ATTRIB);
+    glVertexAttribPointer(INSTANCE_COLOR_ATTRIB, 4, GL_FLOAT, GL_FALSE, sizeof(CommandInstance), base + offsetof(CommandInstance, color));
+    glVertexAttribDivisor(INSTANCE_COLOR_ATTRIB, 1);
+    for (int column = 0; column < 4; column++) {
+        glEnableVertexAttribArray(INSTANCE_MODEL_ATTRIB + column);
+        glVertexAttribPointer(INSTANCE_MODEL_ATTRIB + column, 4, GL_FLOAT, GL_FALSE, sizeof(CommandInstance),
+                              base + offsetof(CommandInstance, model) + column * 4 * sizeof(float));
+        glVertexAttribDivisor(INSTANCE_MODEL_ATTRIB + column, 1);
+    }
+
+    glUniform1i(useInstanceDataLoc, 1);
+    glDrawElementsInstanced(GL_TRIANGLES, batch->draw.indexCount, batch->draw.indexType == CMD_INDEX_UINT16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                            (const void*)batch->draw.indexOffset, batch->instanceCount);
+    glUniform1i(useInstanceDataLoc, 0);
+
+    // Per-object draws of the same mesh read these as constant attributes
+    for (int attribute = MATERIAL_LAYER_ATTRIB; attribute < INSTANCE_MODEL_ATTRIB + 4; attribute++) {
+        glDisableVertexAttribArray(attribute);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void replayCommandList(const CommandList* list, unsigned int program, const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix) {
+    if (list->count == 0) return;
+
+    stateUseProgram(program);
+    ObjectUniforms uniforms;
+    uniforms.model = glGetUniformLocation(program, "model");
+    uniforms.color = glGetUniformLocation(program, "inputColor");
+    uniforms.useTexture = glGetUniformLocation(program, "useTexture");
+    uniforms.usePBR = glGetUniformLocation(program, "usePBR");
+    uniforms.useColor = glGetUniformLocation(program, "useColor");
+    uniforms.useMaterialArrays = glGetUniformLocation(program, "useMaterialArrays");
+    uniforms.useInstanceData = glGetUniformLocation(program, "useInstanceData");
+
+    const ConstantsCommand* constants = NULL;
+    bool instancesUploaded = false;
+    for (int i = 0; i < list->count; i++) {
+        const Command* command = &list->commands[i];
+        switch (command->type) {
+        case CMD_BIND: {
+            const BindCommand* bind = &command->data.bind;
+            stateActiveTexture(GL_TEXTURE0 + bind->unit);
+            stateBindTexture(bind->target == CMD_TEXTURE_2D_ARRAY ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D, bind->texture);
+            break;
+        }
+        case CMD_SET_CONSTANTS:
+            constants = &command->data.constants;
+            setConstantFlags(&uniforms, constants);
+            setInstanceConstants(&uniforms, &constants->model, &constants->color, constants->useMaterialArrays, constants->materialLayer);
+            break;
+        case CMD_DRAW: {
+            const DrawCommand* draw = &command->data.draw;
+            stateBindVertexArray(draw->vertexArray);
+            glDrawElements(GL_TRIANGLES, draw->indexCount, draw->indexType == CMD_INDEX_UINT16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                           (const void*)draw->indexOffset);
+            recordLODTriangles(LOD_VIEW_CAMERA, draw->indexCount, draw->fullIndexCount);
+            break;
+        }
+        case CMD_DRAW_INDIRECT:
+            if (constants) {
+                drawModelMeshlets(command->data.indirect.object, &constants->model, viewMatrix, projMatrix);
+            }
+            break;
+        case CMD_DRAW_INSTANCED: {
+            const DrawInstancedCommand* batch = &command->data.instanced;
+            setConstantFlags(&uniforms, &batch->constants);
+            stateBindVertexArray(batch->draw.vertexArray);
+            if (batch->instanceCount == 1) {
+                // Alone it is cheaper as a plain draw
+                const CommandInstance* instance = &list->instances[batch->firstInstance];
+                setInstanceConstants(&uniforms, &instance->model, &instance->color, batch->constants.useMaterialArrays, instance->materialLayer);
+                glDrawElements(GL_TRIANGLES, batch->draw.indexCount, batch->draw.indexType == CMD_INDEX_UINT16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                               (const void*)batch->draw.indexOffset);
+            }
+            else {
+                if (!instancesUploaded) {
+                    uploadInstances(list);
+                    instancesUploaded = true;
+                }
+                drawInstances(batch, uniforms.useInstanceData);
+            }
+            recordLODTriangles(LOD_VIEW_CAMERA, batch->draw.indexCount * batch->instanceCount, batch->draw.fullIndexCount * batch->instanceCount);
+            break;
+        }
+        }
+    }
+
+    // Units 0-4 and the slab units were bound behind the material module's back
+    stateActiveTexture(GL_TEXTURE0);
+    stateBindVertexArray(0);
+    resetPBRMaterialSlabBinding();
+}
+
+void shutdownCommandLists(void) {
+    if (instanceBuffer) glDeleteBuffers(1, &instanceBuffer);
+    instanceBuffer = 0;
+}
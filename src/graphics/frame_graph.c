@@ -0,0 +1,394 @@
+#include "frame_graph.h"
+#include "gl_state.h"
+#include "log.h"
+#include <stdio.h>
+#include <string.h>
+
+static bool isDepthFormat(GLenum internalFormat) {
+    switch (internalFormat) {
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8:
+    case GL_DEPTH32F_STENCIL8:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static size_t getBytesPerPixel(GLenum internalFormat) {
+    switch (internalFormat) {
+    case GL_R8: return 1;
+    case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: return 2;
+    case GL_RGBA16F: return 8;
+    case GL_RGBA32F: return 16;
+    case GL_DEPTH32F_STENCIL8: return 8;
+    default: return 4;
+    }
+}
+
+static bool sameDesc(const FGTextureDesc* a, const FGTextureDesc* b) {
+    return a->width == b->width && a->height == b->height && a->internalFormat == b->internalFormat;
+}
+
+void resetFrameGraph(FrameGraph* graph) {
+    graph->passCount = 0;
+    graph->resourceCount = 0;
+    graph->compiled = false;
+    graph->frame++;
+    memset(&graph->stats, 0, sizeof(graph->stats));
+}
+
+void destroyFrameGraph(FrameGraph* graph) {
+    for (int i = 0; i < FG_MAX_FRAMEBUFFERS; i++) {
+        if (graph->framebuffers[i].framebuffer) stateDeleteFramebuffers(1, &graph->framebuffers[i].framebuffer);
+    }
+    for (int i = 0; i < FG_MAX_POOL_TEXTURES; i++) {
+        if (graph->pool[i].texture) stateDeleteTextures(1, &graph->pool[i].texture);
+    }
+    memset(graph, 0, sizeof(*graph));
+}
+
+static FGResource addResource(FrameGraph* graph, const char* name, FGResourceType type, bool persistent) {
+    if (graph->resourceCount >= FG_MAX_RESOURCES) {
+        LOG_WARN(LOG_RENDER, "Frame graph: too many resources, dropping %s", name);
+        return -1;
+    }
+    FGResourceNode* node = &graph->resources[graph->resourceCount];
+    memset(node, 0, sizeof(*node));
+    node->name = name;
+    node->type = type;
+    node->persistent = persistent;
+    node->poolIndex = -1;
+    node->firstPass = -1;
+    node->lastPass = -1;
+    return graph->resourceCount++;
+}
+
+FGResource importFrameGraphTarget(FrameGraph* graph, const char* name, GLuint framebuffer, int width, int height, bool persistent) {
+    FGResource resource = addResource(graph, name, FG_RESOURCE_TARGET, persistent);
+    if (resource >= 0) {
+        graph->resources[resource].framebuffer = framebuffer;
+        graph->resources[resource].desc.width = width;
+        graph->resources[resource].desc.height = height;
+    }
+    return resource;
+}
+
+FGResource importFrameGraphExternal(FrameGraph* graph, const char* name, bool persistent) {
+    return addResource(graph, name, FG_RESOURCE_EXTERNAL, persistent);
+}
+
+FGResource createFrameGraphTexture(FrameGraph* graph, const char* name, FGTextureDesc desc) {
+    FGResource resource = addResource(graph, name, FG_RESOURCE_TRANSIENT, false);
+    if (resource >= 0) graph->resources[resource].desc = desc;
+    return resource;
+}
+
+int addFrameGraphPass(FrameGraph* graph, const char* name, FGExecute execute, void* data) {
+    if (graph->passCount >= FG_MAX_PASSES) {
+        LOG_WARN(LOG_RENDER, "Frame graph: too many passes, dropping %s", name);
+        return -1;
+    }
+    FGPass* pass = &graph->passes[graph->passCount];
+    memset(pass, 0, sizeof(*pass));
+    pass->name = name;
+    pass->execute = execute;
+    pass->data = data;
+    return graph->passCount++;
+}
+
+void readFrameGraphResource(FrameGraph* graph, int pass, FGResource resource) {
+    if (pass < 0 || resource < 0) return;
+    FGPass* node = &graph->passes[pass];
+    if (node->readCount < FG_MAX_PASS_IO) node->reads[node->readCount++] = resource;
+}
+
+void writeFrameGraphResource(FrameGraph* graph, int pass, FGResource resource) {
+    if (pass < 0 || resource < 0) return;
+    FGPass* node = &graph->passes[pass];
+    if (node->writeCount < FG_MAX_PASS_IO) node->writes[node->writeCount++] = resource;
+}
+
+// Passes are culled from the outputs nobody reads back towards the inputs
+static void cullPasses(FrameGraph* graph) {
+    FGResource stack[FG_MAX_RESOURCES];
+    int stackSize = 0;
+
+    for (int r = 0; r < graph->resourceCount; r++) graph->resources[r].readers = 0;
+    for (int p = 0; p < graph->passCount; p++) {
+        FGPass* pass = &graph->passes[p];
+        pass->references = pass->writeCount;
+        pass->culled = false;
+        for (int i = 0; i < pass->readCount; i++) graph->resources[pass->reads[i]].readers++;
+    }
+    for (int r = 0; r < graph->resourceCount; r++) {
+        if (graph->resources[r].readers == 0 && !graph->resources[r].persistent) stack[stackSize++] = r;
+    }
+    for (int p = 0; p < graph->passCount; p++) {
+        if (graph->passes[p].references == 0) graph->passes[p].culled = true; // Writes nothing
+    }
+
+    while (stackSize > 0) {
+        FGResource resource = stack[--stackSize];
+        for (int p = 0; p < graph->passCount; p++) {
+            FGPass* pass = &graph->passes[p];
+            if (pass->culled) continue;
+            for (int i = 0; i < pass->writeCount; i++) {
+                if (pass->writes[i] != resource) continue;
+                if (--pass->references > 0) continue;
+
+                pass->culled = true;
+                for (int j = 0; j < pass->readCount; j++) {
+                    FGResourceNode* input = &graph->resources[pass->reads[j]];
+                    if (--input->readers == 0 && !input->persistent) stack[stackSize++] = pass->reads[j];
+                }
+                break;
+            }
+        }
+    }
+}
+
+static int acquirePoolTexture(FrameGraph* graph, const FGTextureDesc* desc) {
+    int freeSlot = -1;
+    for (int i = 0; i < FG_MAX_POOL_TEXTURES; i++) {
+        FGPoolTexture* entry = &graph->pool[i];
+        if (entry->texture && !entry->inUse && sameDesc(&entry->desc, desc)) {
+            entry->inUse = true;
+            entry->lastFrame = graph->frame;
+            return i;
+        }
+        if (!entry->texture && freeSlot < 0) freeSlot = i;
+    }
+    if (freeSlot < 0) {
+        LOG_WARN(LOG_RENDER, "Frame graph: transient texture pool is full");
+        return -1;
+    }
+
+    FGPoolTexture* entry = &graph->pool[freeSlot];
+    glGenTextures(1, &entry->texture);
+    stateBindTexture(GL_TEXTURE_2D, entry->texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, desc->internalFormat, desc->width, desc->height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    stateBindTexture(GL_TEXTURE_2D, 0);
+    entry->desc = *desc;
+    entry->inUse = true;
+    entry->lastFrame = graph->frame;
+    return freeSlot;
+}
+
+// Transient textures are taken from the pool at their first use and returned
+// after their last, so a later resource with the same description reuses them
+static void placeTransients(FrameGraph* graph) {
+    for (int i = 0; i < FG_MAX_POOL_TEXTURES; i++) graph->pool[i].inUse = false;
+
+    for (int p = 0; p < graph->passCount; p++) {
+        FGPass* pass = &graph->passes[p];
+        if (pass->culled) continue;
+        FGResource used[FG_MAX_PASS_IO * 2];
+        int usedCount = 0;
+        for (int i = 0; i < pass->readCount; i++) used[usedCount++] = pass->reads[i];
+        for (int i = 0; i < pass->writeCount; i++) used[usedCount++] = pass->writes[i];
+        for (int i = 0; i < usedCount; i++) {
+            FGResourceNode* node = &graph->resources[used[i]];
+            if (node->firstPass < 0) node->firstPass = p;
+            node->lastPass = p;
+        }
+    }
+
+    for (int p = 0; p < graph->passCount; p++) {
+        if (graph->passes[p].culled) continue;
+        for (int r = 0; r < graph->resourceCount; r++) {
+            FGResourceNode* node = &graph->resources[r];
+            if (node->type == FG_RESOURCE_TRANSIENT && node->firstPass == p) {
+                node->poolIndex = acquirePoolTexture(graph, &node->desc);
+                graph->stats.transientResources++;
+                graph->stats.transientBytes += (size_t)node->desc.width * node->desc.height * getBytesPerPixel(node->desc.internalFormat);
+            }
+        }
+        for (int r = 0; r < graph->resourceCount; r++) {
+            FGResourceNode* node = &graph->resources[r];
+            if (node->type == FG_RESOURCE_TRANSIENT && node->lastPass == p && node->poolIndex >= 0) {
+                graph->pool[node->poolIndex].inUse = false;
+            }
+        }
+    }
+
+    for (int i = 0; i < FG_MAX_POOL_TEXTURES; i++) {
+        if (graph->pool[i].texture && graph->pool[i].lastFrame == graph->frame) graph->stats.transientTextures++;
+    }
+}
+
+static GLuint getFramebuffer(FrameGraph* graph, const GLuint* attachments, const bool* depth, int count) {
+    for (int i = 0; i < FG_MAX_FRAMEBUFFERS; i++) {
+        FGFramebuffer* entry = &graph->framebuffers[i];
+        if (entry->framebuffer && entry->attachmentCount == count &&
+            memcmp(entry->attachments, attachments, count * sizeof(GLuint)) == 0) {
+            entry->lastFrame = graph->frame;
+            return entry->framebuffer;
+        }
+    }
+
+    int slot = -1;
+    for (int i = 0; i < FG_MAX_FRAMEBUFFERS && slot < 0; i++) {
+        if (!graph->framebuffers[i].framebuffer) slot = i;
+    }
+    if (slot < 0) {
+        LOG_WARN(LOG_RENDER, "Frame graph: framebuffer cache is full");
+        return 0;
+    }
+
+    FGFramebuffer* entry = &graph->framebuffers[slot];
+    glGenFramebuffers(1, &entry->framebuffer);
+    stateBindFramebuffer(GL_FRAMEBUFFER, entry->framebuffer);
+    GLenum drawBuffers[FG_MAX_PASS_IO];
+    int colorCount = 0;
+    for (int i = 0; i < count; i++) {
+        GLenum attachment = depth[i] ? GL_DEPTH_ATTACHMENT : GL_COLOR_ATTACHMENT0 + colorCount;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, attachments[i], 0);
+        if (!depth[i]) {
+            drawBuffers[colorCount] = GL_COLOR_ATTACHMENT0 + colorCount;
+            colorCount++;
+        }
+    }
+    if (colorCount > 0) glDrawBuffers(colorCount, drawBuffers);
+    else glDrawBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOG_ERROR(LOG_RENDER, "Frame graph: incomplete framebuffer");
+    }
+    stateBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    memcpy(entry->attachments, attachments, count * sizeof(GLuint));
+    entry->attachmentCount = count;
+    entry->lastFrame = graph->frame;
+    return entry->framebuffer;
+}
+
+static void resolveTargets(FrameGraph* graph) {
+    for (int p = 0; p < graph->passCount; p++) {
+        FGPass* pass = &graph->passes[p];
+        pass->bindsTarget = false;
+        if (pass->culled) continue;
+
+        GLuint attachments[FG_MAX_PASS_IO];
+        bool depth[FG_MAX_PASS_IO];
+        int attachmentCount = 0;
+        for (int i = 0; i < pass->writeCount; i++) {
+            const FGResourceNode* node = &graph->resources[pass->writes[i]];
+            if (node->type == FG_RESOURCE_TARGET) {
+                pass->framebuffer = node->framebuffer;
+                pass->width = node->desc.width;
+                pass->height = node->desc.height;
+                pass->bindsTarget = true;
+            }
+            else if (node->type == FG_RESOURCE_TRANSIENT && node->poolIndex >= 0) {
+                attachments[attachmentCount] = graph->pool[node->poolIndex].texture;
+                depth[attachmentCount] = isDepthFormat(node->desc.internalFormat);
+                attachmentCount++;
+                pass->width = node->desc.width;
+                pass->height = node->desc.height;
+            }
+        }
+        if (attachmentCount > 0) {
+            if (pass->bindsTarget) {
+                LOG_ERROR(LOG_RENDER, "Frame graph: %s writes both an imported target and textures", pass->name);
+            }
+            pass->framebuffer = getFramebuffer(graph, attachments, depth, attachmentCount);
+            pass->bindsTarget = true;
+        }
+    }
+}
+
+// Pool textures idle for a few frames (a resize, OIT switched off) are freed with their framebuffers
+static void trimPool(FrameGraph* graph) {
+    for (int i = 0; i < FG_MAX_POOL_TEXTURES; i++) {
+        FGPoolTexture* entry = &graph->pool[i];
+        if (!entry->texture || graph->frame - entry->lastFrame < FG_POOL_FRAMES) continue;
+
+        for (int f = 0; f < FG_MAX_FRAMEBUFFERS; f++) {
+            FGFramebuffer* framebuffer = &graph->framebuffers[f];
+            for (int a = 0; a < framebuffer->attachmentCount && framebuffer->framebuffer; a++) {
+                if (framebuffer->attachments[a] == entry->texture) {
+                    stateDeleteFramebuffers(1, &framebuffer->framebuffer);
+                    memset(framebuffer, 0, sizeof(*framebuffer));
+                }
+            }
+        }
+        stateDeleteTextures(1, &entry->texture);
+        memset(entry, 0, sizeof(*entry));
+    }
+}
+
+void compileFrameGraph(FrameGraph* graph) {
+    cullPasses(graph);
+    placeTransients(graph);
+    resolveTargets(graph);
+    trimPool(graph);
+
+    for (int p = 0; p < graph->passCount; p++) {
+        if (graph->passes[p].culled) graph->stats.culledPasses++;
+        else graph->stats.passes++;
+    }
+    graph->compiled = true;
+}
+
+void executeFrameGraph(FrameGraph* graph) {
+    if (!graph->compiled) compileFrameGraph(graph);
+
+    bool targetKnown = false;
+    GLuint currentFramebuffer = 0;
+    int viewportWidth = -1, viewportHeight = -1;
+    for (int p = 0; p < graph->passCount; p++) {
+        FGPass* pass = &graph->passes[p];
+        if (pass->culled) continue;
+
+        if (pass->bindsTarget) {
+            if (!targetKnown || currentFramebuffer != pass->framebuffer) {
+                stateBindFramebuffer(GL_DRAW_FRAMEBUFFER, pass->framebuffer);
+                currentFramebuffer = pass->framebuffer;
+                targetKnown = true;
+                graph->stats.framebufferBinds++;
+            }
+            if (viewportWidth != pass->width || viewportHeight != pass->height) {
+                stateViewport(0, 0, pass->width, pass->height);
+                viewportWidth = pass->width;
+                viewportHeight = pass->height;
+                graph->stats.viewportChanges++;
+            }
+        }
+
+        pass->execute(pass->data);
+
+        if (!pass->bindsTarget) {
+            // The pass bound its own framebuffers and viewports
+            targetKnown = false;
+            viewportWidth = viewportHeight = -1;
+        }
+    }
+
+    // Leave the window bound for whatever draws after the graph
+    for (int r = 0; r < graph->resourceCount; r++) {
+        const FGResourceNode* node = &graph->resources[r];
+        if (node->type != FG_RESOURCE_TARGET || node->framebuffer != 0) continue;
+        if (!targetKnown || currentFramebuffer != 0) stateBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (viewportWidth != node->desc.width || viewportHeight != node->desc.height) {
+            stateViewport(0, 0, node->desc.width, node->desc.height);
+        }
+        break;
+    }
+}
+
+GLuint getFrameGraphTexture(const FrameGraph* graph, FGResource resource) {
+    if (resource < 0 || resource >= graph->resourceCount) return 0;
+    const FGResourceNode* node = &graph->resources[resource];
+    if (node->type != FG_RESOURCE_TRANSIENT || node->poolIndex < 0) return 0;
+    return graph->pool[node->poolIndex].texture;
+}
+
+bool isFrameGraphPassLive(const FrameGraph* graph, int pass) {
+    return graph->compiled && pass >= 0 && pass < graph->passCount && !graph->passes[pass].culled;
+}
@@ -0,0 +1,200 @@
+#include "gl_state.h"
+
+#define STATE_UNKNOWN 0xFFFFFFFFu
+#define TEXTURE_TARGETS 3
+#define CACHED_CAPS 5
+
+static const GLenum textureTargets[TEXTURE_TARGETS] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP };
+static const GLenum cachedCaps[CACHED_CAPS] = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_SCISSOR_TEST, GL_STENCIL_TEST };
+
+static struct {
+    GLuint program;
+    GLuint vertexArray;
+    GLuint activeUnit;                  // Index from GL_TEXTURE0
+    GLuint textures[GL_STATE_TEXTURE_UNITS][TEXTURE_TARGETS];
+    GLuint drawFramebuffer;
+    GLuint readFramebuffer;
+    int caps[CACHED_CAPS];              // -1 unknown, 0 disabled, 1 enabled
+    GLenum blendSrc, blendDst;
+    GLenum depthFunc;
+    int depthMask;                      // -1 unknown
+    GLint viewport[4];
+    bool viewportKnown;
+} cache;
+
+static GLStateStats stats;
+static bool cacheReady = false;
+
+// Every call goes through here: true when it still has to reach GL
+static bool changed(bool differs) {
+    if (!cacheReady) invalidateGLState();
+    if (differs) stats.issued++;
+    else stats.filtered++;
+    return differs;
+}
+
+static int textureTargetIndex(GLenum target) {
+    for (int i = 0; i < TEXTURE_TARGETS; i++) {
+        if (textureTargets[i] == target) return i;
+    }
+    return -1;
+}
+
+static int capIndex(GLenum cap) {
+    for (int i = 0; i < CACHED_CAPS; i++) {
+        if (cachedCaps[i] == cap) return i;
+    }
+    return -1;
+}
+
+void invalidateGLState(void) {
+    cache.program = STATE_UNKNOWN;
+    cache.vertexArray = STATE_UNKNOWN;
+    cache.activeUnit = STATE_UNKNOWN;
+    for (int u = 0; u < GL_STATE_TEXTURE_UNITS; u++) {
+        for (int t = 0; t < TEXTURE_TARGETS; t++) cache.textures[u][t] = STATE_UNKNOWN;
+    }
+    cache.drawFramebuffer = STATE_UNKNOWN;
+    cache.readFramebuffer = STATE_UNKNOWN;
+    for (int i = 0; i < CACHED_CAPS; i++) cache.caps[i] = -1;
+    cache.blendSrc = cache.blendDst = STATE_UNKNOWN;
+    cache.depthFunc = STATE_UNKNOWN;
+    cache.depthMask = -1;
+    cache.viewportKnown = false;
+    cacheReady = true;
+}
+
+void stateUseProgram(GLuint program) {
+    if (!changed(cache.program != program)) return;
+    glUseProgram(program);
+    cache.program = program;
+}
+
+void stateBindVertexArray(GLuint vao) {
+    if (!changed(cache.vertexArray != vao)) return;
+    glBindVertexArray(vao);
+    cache.vertexArray = vao;
+}
+
+void stateActiveTexture(GLenum unit) {
+    GLuint index = unit - GL_TEXTURE0;
+    if (!changed(cache.activeUnit != index)) return;
+    glActiveTexture(unit);
+    cache.activeUnit = index;
+}
+
+void stateBindTexture(GLenum target, GLuint texture) {
+    int t = textureTargetIndex(target);
+    GLuint unit = cache.activeUnit;
+    // Unknown unit or target: bind without caching
+    if (t < 0 || unit >= GL_STATE_TEXTURE_UNITS) {
+        changed(true);
+        glBindTexture(target, texture);
+        return;
+    }
+    if (!changed(cache.textures[unit][t] != texture)) return;
+    glBindTexture(target, texture);
+    cache.textures[unit][t] = texture;
+}
+
+void stateBindFramebuffer(GLenum target, GLuint framebuffer) {
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    bool differs = (draw && cache.drawFramebuffer != framebuffer) || (read && cache.readFramebuffer != framebuffer);
+    if (!changed(differs)) return;
+    glBindFramebuffer(target, framebuffer);
+    if (draw) cache.drawFramebuffer = framebuffer;
+    if (read) cache.readFramebuffer = framebuffer;
+}
+
+static void setCap(GLenum cap, int enabled) {
+    int i = capIndex(cap);
+    if (!changed(i < 0 || cache.caps[i] != enabled)) return;
+    if (enabled) glEnable(cap);
+    else glDisable(cap);
+    if (i >= 0) cache.caps[i] = enabled;
+}
+
+void stateEnable(GLenum cap) {
+    setCap(cap, 1);
+}
+
+void stateDisable(GLenum cap) {
+    setCap(cap, 0);
+}
+
+void stateBlendFunc(GLenum sfactor, GLenum dfactor) {
+    if (!changed(cache.blendSrc != sfactor || cache.blendDst != dfactor)) return;
+    glBlendFunc(sfactor, dfactor);
+    cache.blendSrc = sfactor;
+    cache.blendDst = dfactor;
+}
+
+void stateBlendFunci(GLuint buffer, GLenum sfactor, GLenum dfactor) {
+    // Per-buffer factors aren't tracked, the shared value is no longer known
+    changed(true);
+    glBlendFunci(buffer, sfactor, dfactor);
+    cache.blendSrc = cache.blendDst = STATE_UNKNOWN;
+}
+
+void stateDepthFunc(GLenum func) {
+    if (!changed(cache.depthFunc != func)) return;
+    glDepthFunc(func);
+    cache.depthFunc = func;
+}
+
+void stateDepthMask(GLboolean flag) {
+    int mask = flag ? 1 : 0;
+    if (!changed(cache.depthMask != mask)) return;
+    glDepthMask(flag);
+    cache.depthMask = mask;
+}
+
+void stateViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    bool same = cache.viewportKnown && cache.viewport[0] == x && cache.viewport[1] == y
+        && cache.viewport[2] == width && cache.viewport[3] == height;
+    if (!changed(!same)) return;
+    glViewport(x, y, width, height);
+    cache.viewport[0] = x;
+    cache.viewport[1] = y;
+    cache.viewport[2] = width;
+    cache.viewport[3] = height;
+    cache.viewportKnown = true;
+}
+
+void stateDeleteTextures(GLsizei count, const GLuint* textures) {
+    glDeleteTextures(count, textures);
+    for (GLsizei i = 0; i < count; i++) {
+        if (textures[i] == 0) continue;
+        for (int u = 0; u < GL_STATE_TEXTURE_UNITS; u++) {
+            for (int t = 0; t < TEXTURE_TARGETS; t++) {
+                if (cache.textures[u][t] == textures[i]) cache.textures[u][t] = 0;
+            }
+        }
+    }
+}
+
+void stateDeleteVertexArrays(GLsizei count, const GLuint* arrays) {
+    glDeleteVertexArrays(count, arrays);
+    for (GLsizei i = 0; i < count; i++) {
+        if (arrays[i] != 0 && cache.vertexArray == arrays[i]) cache.vertexArray = 0;
+    }
+}
+
+void stateDeleteFramebuffers(GLsizei count, const GLuint* framebuffers) {
+    glDeleteFramebuffers(count, framebuffers);
+    for (GLsizei i = 0; i < count; i++) {
+        if (framebuffers[i] == 0) continue;
+        if (cache.drawFramebuffer == framebuffers[i]) cache.drawFramebuffer = 0;
+        if (cache.readFramebuffer == framebuffers[i]) cache.readFramebuffer = 0;
+    }
+}
+
+void resetGLStateStats(void) {
+    stats.issued = 0;
+    stats.filtered = 0;
+}
+
+const GLStateStats* getGLStateStats(void) {
+    return &stats;
+}
@@ -0,0 +1,474 @@
+#include "gpu_culling.h"
+#include "ObjectManager.h"
+#include "static_batch.h"
+#include "meshlet.h"
+#include "sphere_impostor.h"
+#include "shaders.h"
+#include "globals.h"
+#include "gl_state.h"
+#include "log.h"
+#include <limits.h>
+#include <stddef.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GPU_CULL_GROUP_SIZE 64       // local_size_x of cull_compute.glsl
+#define GPU_CULL_TEXTURE_UNIT 31     // Out of the way of the object shader's samplers
+#define INSTANCE_MODEL_ATTRIB 5      // mat4, locations 5 to 8
+
+// Matches ObjectRecord in cull_compute.glsl (std430)
+typedef struct {
+    float model[16];
+    float color[4];
+    float sphere[4];
+    unsigned int info[4];
+} GPUObjectRecord;
+
+// Matches Instance in cull_compute.glsl, read back as instanced vertex attributes
+typedef struct {
+    float model[16];
+    float color[4];
+} GPUInstance;
+
+typedef struct {
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLuint baseVertex;
+    float center[3];   // Local bounding sphere
+    float radius;
+} PrimitiveRange;
+
+bool gpuCullingEnabled = false;
+bool gpuOcclusionEnabled = true;
+
+static GLuint cullProgram = 0;
+static GLuint compactProgram = 0;
+static GLuint pyramidProgram = 0;
+
+// All five primitives in one vertex and index buffer
+static GLuint geometryVAO = 0, geometryVBO = 0, geometryEBO = 0;
+static PrimitiveRange primitives[GPU_CULL_PRIMITIVES];
+
+static GLuint objectBuffer = 0;
+static GLuint instanceBuffer = 0;
+static GLuint commandBuffer = 0;
+static GLuint compactedBuffer = 0;
+static GLuint drawCountBuffer = 0;
+static unsigned int objectCapacity = 0;
+
+// CPU mirror of the object buffer, only records that differ are uploaded
+static GPUObjectRecord* records = NULL;
+static unsigned int recordCount = 0;
+
+static GLuint depthTexture = 0;
+static GLuint pyramidTexture = 0;
+static int pyramidWidth = 0, pyramidHeight = 0, pyramidLevels = 0;
+static bool pyramidValid = false;
+static Matrix4x4 pyramidViewProj;
+
+static GPUCullingStats stats;
+
+static bool buildPrimitiveBuffers(void) {
+    StaticVertex* vertices = NULL;
+    unsigned int* indices = NULL;
+    unsigned int vertexCount = 0, indexCount = 0;
+    bool ok = true;
+
+    for (int type = 0; type < GPU_CULL_PRIMITIVES && ok; type++) {
+        StaticVertex* primitiveVertices;
+        unsigned int* primitiveIndices;
+        unsigned int primitiveVertexCount, primitiveIndexCount;
+        if (!buildPrimitiveGeometry((ObjectType)type, &primitiveVertices, &primitiveVertexCount, &primitiveIndices, &primitiveIndexCount)) {
+            ok = false;
+            break;
+        }
+
+        StaticVertex* grownVertices = (StaticVertex*)realloc(vertices, (vertexCount + primitiveVertexCount) * sizeof(StaticVertex));
+        if (grownVertices) vertices = grownVertices;
+        unsigned int* grownIndices = (unsigned int*)realloc(indices, (indexCount + primitiveIndexCount) * sizeof(unsigned int));
+        if (grownIndices) indices = grownIndices;
+        ok = grownVertices && grownIndices;
+
+        if (ok) {
+            // Bounding sphere around the box center, the pyramid sits on its base
+            float minBound[3] = { INFINITY, INFINITY, INFINITY }, maxBound[3] = { -INFINITY, -INFINITY, -INFINITY };
+            for (unsigned int v = 0; v < primitiveVertexCount; v++) {
+                for (int k = 0; k < 3; k++) {
+                    minBound[k] = fminf(minBound[k], primitiveVertices[v].position[k]);
+                    maxBound[k] = fmaxf(maxBound[k], primitiveVertices[v].position[k]);
+                }
+            }
+            PrimitiveRange* range = &primitives[type];
+            for (int k = 0; k < 3; k++) range->center[k] = (minBound[k] + maxBound[k]) * 0.5f;
+            range->radius = 0.0f;
+            for (unsigned int v = 0; v < primitiveVertexCount; v++) {
+                Vector3 d = vector(primitiveVertices[v].position[0] - range->center[0], primitiveVertices[v].position[1] - range->center[1],
+                                   primitiveVertices[v].position[2] - range->center[2]);
+                range->radius = fmaxf(range->radius, vector_length(d));
+            }
+
+            range->firstIndex = indexCount;
+            range->indexCount = primitiveIndexCount;
+            range->baseVertex = vertexCount;
+            memcpy(vertices + vertexCount, primitiveVertices, primitiveVertexCount * sizeof(StaticVertex));
+            memcpy(indices + indexCount, primitiveIndices, primitiveIndexCount * sizeof(unsigned int));
+            vertexCount += primitiveVertexCount;
+            indexCount += primitiveIndexCount;
+        }
+        free(primitiveVertices);
+        free(primitiveIndices);
+    }
+
+    if (ok) {
+        glGenVertexArrays(1, &geometryVAO);
+        glGenBuffers(1, &geometryVBO);
+        glGenBuffers(1, &geometryEBO);
+        glGenBuffers(1, &instanceBuffer);
+
+        stateBindVertexArray(geometryVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, geometryVBO);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCount * sizeof(StaticVertex), vertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometryEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, texCoord));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, normal));
+        glEnableVertexAttribArray(MATERIAL_LAYER_ATTRIB);
+        glVertexAttribIPointer(MATERIAL_LAYER_ATTRIB, 1, GL_INT, sizeof(StaticVertex), (void*)offsetof(StaticVertex, materialLayer));
+
+        // Per instance: color, then the model matrix one column per location
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(GPUInstance), (void*)offsetof(GPUInstance, color));
+        glVertexAttribDivisor(4, 1);
+        for (int column = 0; column < 4; column++) {
+            glEnableVertexAttribArray(INSTANCE_MODEL_ATTRIB + column);
+            glVertexAttribPointer(INSTANCE_MODEL_ATTRIB + column, 4, GL_FLOAT, GL_FALSE, sizeof(GPUInstance),
+                                  (void*)(offsetof(GPUInstance, model) + column * 4 * sizeof(float)));
+            glVertexAttribDivisor(INSTANCE_MODEL_ATTRIB + column, 1);
+        }
+        stateBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    free(vertices);
+    free(indices);
+    return ok;
+}
+
+bool initGPUCulling(void) {
+    memset(&stats, 0, sizeof(stats));
+    if (!GLAD_GL_VERSION_4_3) {
+        LOG_INFO(LOG_RENDER, "GPU culling unavailable: compute shaders need OpenGL 4.3");
+        return false;
+    }
+
+    cullProgram = loadComputeShader("shaders/culling/cull_compute.glsl");
+    compactProgram = loadComputeShader("shaders/culling/compact_compute.glsl");
+    pyramidProgram = loadComputeShader("shaders/culling/depth_pyramid_compute.glsl");
+    if (!cullProgram || !compactProgram || !pyramidProgram || !buildPrimitiveBuffers()) {
+        LOG_WARN(LOG_RENDER, "GPU culling unavailable: failed to build its shaders or geometry");
+        shutdownGPUCulling();
+        return false;
+    }
+
+    glGenBuffers(1, &objectBuffer);
+    glGenBuffers(1, &commandBuffer);
+    glGenBuffers(1, &compactedBuffer);
+    glGenBuffers(1, &drawCountBuffer);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, GPU_CULL_PRIMITIVES * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, compactedBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, GPU_CULL_PRIMITIVES * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawCountBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    stats.available = true;
+    stats.indirectCount = GLAD_GL_VERSION_4_6 != 0;
+    LOG_INFO(LOG_RENDER, "GPU culling ready (%s)", stats.indirectCount ? "indirect count draws" : "fixed indirect draws");
+    return true;
+}
+
+static void destroyDepthPyramid(void) {
+    if (depthTexture) stateDeleteTextures(1, &depthTexture);
+    if (pyramidTexture) stateDeleteTextures(1, &pyramidTexture);
+    depthTexture = pyramidTexture = 0;
+    pyramidWidth = pyramidHeight = pyramidLevels = 0;
+    pyramidValid = false;
+}
+
+void shutdownGPUCulling(void) {
+    if (cullProgram) glDeleteProgram(cullProgram);
+    if (compactProgram) glDeleteProgram(compactProgram);
+    if (pyramidProgram) glDeleteProgram(pyramidProgram);
+    cullProgram = compactProgram = pyramidProgram = 0;
+
+    GLuint buffers[] = { geometryVBO, geometryEBO, objectBuffer, instanceBuffer, commandBuffer, compactedBuffer, drawCountBuffer };
+    for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+        if (buffers[i]) glDeleteBuffers(1, &buffers[i]);
+    }
+    if (geometryVAO) stateDeleteVertexArrays(1, &geometryVAO);
+    geometryVAO = geometryVBO = geometryEBO = 0;
+    objectBuffer = instanceBuffer = commandBuffer = compactedBuffer = drawCountBuffer = 0;
+    destroyDepthPyramid();
+
+    free(records);
+    records = NULL;
+    recordCount = 0;
+    objectCapacity = 0;
+    stats.available = false;
+}
+
+static bool isGPUCullEligible(const SceneObject* obj) {
+    // Anything needing its own textures or material uniforms stays on the CPU path
+    if (obj->object.type == OBJ_MODEL || obj->color.w < 1.0f) return false;
+    if (obj->object.useTexture || obj->object.usePBR || !obj->object.useColor) return false;
+    return !isObjectStaticBatched(obj) && !isSphereImpostor(obj);
+}
+
+static void buildRecord(int slot, GPUObjectRecord* record) {
+    const SceneObject* obj = &objectManager.objects[slot];
+    memset(record, 0, sizeof(*record));
+    Matrix4x4 model = objectManager.modelMatrices[slot];
+    memcpy(record->model, &model.data[0][0], sizeof(record->model));
+
+    record->color[0] = obj->color.x;
+    record->color[1] = obj->color.y;
+    record->color[2] = obj->color.z;
+    record->color[3] = obj->color.w;
+
+    const PrimitiveRange* range = &primitives[obj->object.type];
+    for (int j = 0; j < 3; j++) {
+        record->sphere[j] = model.data[0][j] * range->center[0] + model.data[1][j] * range->center[1] +
+                            model.data[2][j] * range->center[2] + model.data[3][j];
+    }
+    float maxScale = fmaxf(fabsf(obj->scale.x), fmaxf(fabsf(obj->scale.y), fabsf(obj->scale.z)));
+    record->sphere[3] = range->radius * maxScale;
+    record->info[0] = (unsigned int)obj->object.type;
+}
+
+static bool reserveObjects(unsigned int count) {
+    if (count <= objectCapacity) return true;
+
+    unsigned int capacity = objectCapacity ? objectCapacity : 256;
+    while (capacity < count) capacity *= 2;
+    GPUObjectRecord* grown = (GPUObjectRecord*)realloc(records, capacity * sizeof(GPUObjectRecord));
+    if (!grown) return false;
+    records = grown;
+
+    // New storage starts empty, every record is uploaded again
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)capacity * sizeof(GPUObjectRecord), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * GPU_CULL_PRIMITIVES * sizeof(GPUInstance), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    objectCapacity = capacity;
+    recordCount = 0;
+    return true;
+}
+
+void updateGPUCulling(void) {
+    stats.objects = 0;
+    stats.updatedObjects = 0;
+    if (!gpuCullingEnabled || !stats.available) return;
+
+    // Records are compacted in manager order; an edit or removal only dirties the records after it
+    unsigned int count = 0;
+    unsigned int dirtyFirst = UINT_MAX, dirtyLast = 0;
+    for (int i = 0; i < objectManager.count; i++) {
+        const SceneObject* obj = &objectManager.objects[i];
+        if (!isGPUCullEligible(obj)) continue;
+        unsigned int previousCapacity = objectCapacity;
+        if (!reserveObjects(count + 1)) break;
+        if (objectCapacity != previousCapacity) dirtyFirst = 0; // Records already placed this frame were lost too
+
+        GPUObjectRecord record;
+        buildRecord(i, &record);
+        if (count >= recordCount || memcmp(&records[count], &record, sizeof(record)) != 0) {
+            records[count] = record;
+            if (count < dirtyFirst) dirtyFirst = count;
+            dirtyLast = count;
+        }
+        objectManager.flags[i] |= OBJECT_FLAG_GPU_CULLED;
+        count++;
+    }
+    recordCount = count;
+
+    if (dirtyFirst <= dirtyLast && dirtyFirst < count) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)dirtyFirst * sizeof(GPUObjectRecord),
+                        (GLsizeiptr)(dirtyLast - dirtyFirst + 1) * sizeof(GPUObjectRecord), &records[dirtyFirst]);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        stats.updatedObjects = (int)(dirtyLast - dirtyFirst + 1);
+    }
+    stats.objects = (int)recordCount;
+}
+
+void drawGPUCulledObjects(const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix) {
+    stats.occlusion = false;
+    if (!gpuCullingEnabled || !stats.available || recordCount == 0) return;
+
+    // Every frame starts from empty instance counts, each primitive owns one instance range
+    DrawElementsIndirectCommand commands[GPU_CULL_PRIMITIVES];
+    for (int type = 0; type < GPU_CULL_PRIMITIVES; type++) {
+        DrawElementsIndirectCommand command = { primitives[type].indexCount, 0, primitives[type].firstIndex,
+                                                primitives[type].baseVertex, type * objectCapacity };
+        commands[type] = command;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(commands), commands);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // Normalized frustum planes from the rows of projection * view
+    Matrix4x4 viewProj = matrixMultiply(viewMatrix, projMatrix);
+    float planes[6][4];
+    for (int p = 0; p < 6; p++) {
+        int row = p / 2;
+        float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+        for (int c = 0; c < 4; c++) planes[p][c] = viewProj.data[c][3] + sign * viewProj.data[c][row];
+        float length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        if (length > 0.0f) {
+            for (int c = 0; c < 4; c++) planes[p][c] /= length;
+        }
+    }
+
+    stateUseProgram(cullProgram);
+    glUniform1ui(glGetUniformLocation(cullProgram, "objectCount"), recordCount);
+    glUniform4fv(glGetUniformLocation(cullProgram, "frustumPlanes"), 6, &planes[0][0]);
+
+    stats.occlusion = gpuOcclusionEnabled && pyramidValid;
+    glUniform1i(glGetUniformLocation(cullProgram, "useOcclusion"), stats.occlusion);
+    if (stats.occlusion) {
+        stateActiveTexture(GL_TEXTURE0 + GPU_CULL_TEXTURE_UNIT);
+        stateBindTexture(GL_TEXTURE_2D, pyramidTexture);
+        stateActiveTexture(GL_TEXTURE0);
+        glUniform1i(glGetUniformLocation(cullProgram, "depthPyramid"), GPU_CULL_TEXTURE_UNIT);
+        glUniformMatrix4fv(glGetUniformLocation(cullProgram, "previousViewProj"), 1, GL_FALSE, &pyramidViewProj.data[0][0]);
+        glUniform2f(glGetUniformLocation(cullProgram, "pyramidSize"), (float)pyramidWidth, (float)pyramidHeight);
+        glUniform1i(glGetUniformLocation(cullProgram, "pyramidLevels"), pyramidLevels);
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, instanceBuffer);
+    glDispatchCompute((recordCount + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE, 1, 1);
+
+    if (stats.indirectCount) {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        stateUseProgram(compactProgram);
+        glUniform1ui(glGetUniformLocation(compactProgram, "commandCount"), GPU_CULL_PRIMITIVES);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, compactedBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, drawCountBuffer);
+        glDispatchCompute(1, 1, 1);
+    }
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    // Same shader state setShaderUniforms gives a plain colored object
+    stateUseProgram(shaderProgram);
+    Matrix4x4 identity = identityMatrix();
+    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, &identity.data[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, &viewMatrix.data[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, &projMatrix.data[0][0]);
+    glUniform1i(glGetUniformLocation(shaderProgram, "useTexture"), 0);
+    glUniform1i(glGetUniformLocation(shaderProgram, "usePBR"), 0);
+    glUniform1i(glGetUniformLocation(shaderProgram, "useMaterialArrays"), 0);
+    glUniform1i(glGetUniformLocation(shaderProgram, "useColor"), colorsEnabled);
+    glUniform1i(glGetUniformLocation(shaderProgram, "useInstanceData"), 1);
+
+    stateBindVertexArray(geometryVAO);
+    if (stats.indirectCount) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, compactedBuffer);
+        glBindBuffer(GL_PARAMETER_BUFFER, drawCountBuffer);
+        glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, 0, 0, GPU_CULL_PRIMITIVES, 0);
+        glBindBuffer(GL_PARAMETER_BUFFER, 0);
+    } else {
+        // Commands without instances draw nothing
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, GPU_CULL_PRIMITIVES, 0);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    stateBindVertexArray(0);
+    glUniform1i(glGetUniformLocation(shaderProgram, "useInstanceData"), 0);
+}
+
+static bool ensurePyramid(int width, int height) {
+    if (depthTexture && width == pyramidWidth && height == pyramidHeight) return true;
+    destroyDepthPyramid();
+    if (width <= 0 || height <= 0) return false;
+
+    glGenTextures(1, &depthTexture);
+    stateBindTexture(GL_TEXTURE_2D, depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+    int levels = 1;
+    while ((width >> levels) > 0 || (height >> levels) > 0) levels++;
+    glGenTextures(1, &pyramidTexture);
+    stateBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_R32F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    stateBindTexture(GL_TEXTURE_2D, 0);
+
+    pyramidWidth = width;
+    pyramidHeight = height;
+    pyramidLevels = levels;
+    return true;
+}
+
+void buildDepthPyramid(const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix, int width, int height) {
+    if (!gpuCullingEnabled || !gpuOcclusionEnabled || !stats.available || recordCount == 0) {
+        pyramidValid = false;
+        return;
+    }
+    if (!ensurePyramid(width, height)) return;
+
+    // The default framebuffer's depth can't be sampled, copy it out first
+    stateActiveTexture(GL_TEXTURE0 + GPU_CULL_TEXTURE_UNIT);
+    stateBindTexture(GL_TEXTURE_2D, depthTexture);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+    stateUseProgram(pyramidProgram);
+    glUniform1i(glGetUniformLocation(pyramidProgram, "source"), GPU_CULL_TEXTURE_UNIT);
+    GLint copyLoc = glGetUniformLocation(pyramidProgram, "copyLevel");
+    GLint levelLoc = glGetUniformLocation(pyramidProgram, "sourceLevel");
+    GLint sizeLoc = glGetUniformLocation(pyramidProgram, "destinationSize");
+
+    for (int level = 0; level < pyramidLevels; level++) {
+        int levelWidth = width >> level > 0 ? width >> level : 1;
+        int levelHeight = height >> level > 0 ? height >> level : 1;
+
+        if (level == 1) stateBindTexture(GL_TEXTURE_2D, pyramidTexture);
+        glUniform1i(copyLoc, level == 0);
+        glUniform1i(levelLoc, level > 0 ? level - 1 : 0);
+        glUniform2i(sizeLoc, levelWidth, levelHeight);
+        glBindImageTexture(0, pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    stateBindTexture(GL_TEXTURE_2D, 0);
+    stateActiveTexture(GL_TEXTURE0);
+    pyramidViewProj = matrixMultiply(viewMatrix, projMatrix);
+    pyramidValid = true;
+}
+
+bool isObjectGPUCulled(const SceneObject* obj) {
+    return hasObjectFlag(obj, OBJECT_FLAG_GPU_CULLED);
+}
+
+const GPUCullingStats* getGPUCullingStats(void) {
+    return &stats;
+}
@@ -0,0 +1,184 @@
+#include "latency.h"
+#include "shaders.h"
+#include "gl_state.h"
+#include "log.h"
+#include <GLFW/glfw3.h>
+#include <math.h>
+#include <stdio.h>
+
+#define FENCE_WAIT_NANOSECONDS 100000000ull  // Per glClientWaitSync call, retried until signaled
+#define MIN_REPROJECTION_DEGREES 0.01f
+#define LATENCY_AVERAGE_WEIGHT 0.1
+
+LatencySettings latencyMode = { false, 1, false };
+
+typedef struct {
+    GLsync fence;
+    double inputTime;
+} PresentedFrame;
+
+static PresentedFrame queue[LATENCY_FENCE_QUEUE];
+static int queueFront = 0;
+static int queueCount = 0;
+static double lastInputTime = 0.0;
+
+static GLuint reprojectProgram = 0;
+static GLuint reprojectVAO = 0;
+static GLuint reprojectSampler = 0;
+static GLint rotationLoc = -1;
+static GLint projectionScaleLoc = -1;
+static GLint screenSizeLoc = -1;
+static GLfloat rotation[9];
+
+static LatencyStats stats;
+
+bool initLatency(void) {
+    reprojectProgram = loadShader("shaders/latency/reproject_vertex.glsl", "shaders/latency/reproject_fragment.glsl");
+    if (!reprojectProgram) {
+        LOG_WARN(LOG_RENDER, "Late reprojection unavailable: failed to build the reprojection shader");
+        return false;
+    }
+    stateUseProgram(reprojectProgram);
+    glUniform1i(glGetUniformLocation(reprojectProgram, "frame"), 0);
+    rotationLoc = glGetUniformLocation(reprojectProgram, "rotation");
+    projectionScaleLoc = glGetUniformLocation(reprojectProgram, "projectionScale");
+    screenSizeLoc = glGetUniformLocation(reprojectProgram, "screenSize");
+    stateUseProgram(0);
+
+    // Pool textures filter nearest, a small rotation needs linear
+    glGenSamplers(1, &reprojectSampler);
+    glSamplerParameteri(reprojectSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glSamplerParameteri(reprojectSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(reprojectSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(reprojectSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenVertexArrays(1, &reprojectVAO);
+    return true;
+}
+
+void shutdownLatency(void) {
+    while (queueCount > 0) {
+        glDeleteSync(queue[queueFront].fence);
+        queueFront = (queueFront + 1) % LATENCY_FENCE_QUEUE;
+        queueCount--;
+    }
+    if (reprojectProgram) glDeleteProgram(reprojectProgram);
+    if (reprojectSampler) glDeleteSamplers(1, &reprojectSampler);
+    if (reprojectVAO) stateDeleteVertexArrays(1, &reprojectVAO);
+    reprojectProgram = reprojectSampler = reprojectVAO = 0;
+}
+
+// A failed wait counts as finished, a lost context must not hang the loop
+static bool isOldestFrameDone(GLuint64 timeout) {
+    GLenum result = glClientWaitSync(queue[queueFront].fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if (result == GL_WAIT_FAILED) {
+        LOG_ERROR(LOG_RENDER, "Frame fence wait failed");
+        return true;
+    }
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+static void retireOldestFrame(void) {
+    PresentedFrame* frame = &queue[queueFront];
+    double latency = (glfwGetTime() - frame->inputTime) * 1000.0;
+    stats.inputToPresent = latency;
+    stats.averageInputToPresent = stats.averageInputToPresent > 0.0
+        ? stats.averageInputToPresent + (latency - stats.averageInputToPresent) * LATENCY_AVERAGE_WEIGHT
+        : latency;
+
+    glDeleteSync(frame->fence);
+    queueFront = (queueFront + 1) % LATENCY_FENCE_QUEUE;
+    queueCount--;
+}
+
+static void waitForOldestFrame(void) {
+    while (!isOldestFrameDone(FENCE_WAIT_NANOSECONDS)) {
+        // Keep waiting, a frame only takes this long behind a very slow GPU
+    }
+    retireOldestFrame();
+}
+
+void waitForFrameSlot(void) {
+    double start = glfwGetTime();
+
+    // Frames the GPU already finished
+    while (queueCount > 0 && isOldestFrameDone(0)) {
+        retireOldestFrame();
+    }
+
+    // framesInFlight counts the frame about to start
+    if (latencyMode.enabled) {
+        int allowed = latencyMode.framesInFlight;
+        if (allowed < 1) allowed = 1;
+        if (allowed > MAX_FRAMES_IN_FLIGHT) allowed = MAX_FRAMES_IN_FLIGHT;
+        while (queueCount >= allowed) {
+            waitForOldestFrame();
+        }
+    }
+
+    stats.fenceWait = (glfwGetTime() - start) * 1000.0;
+    stats.framesQueued = queueCount;
+    stats.reprojectionDegrees = 0.0f;
+}
+
+void markInputSampled(void) {
+    lastInputTime = glfwGetTime();
+}
+
+void markFramePresented(void) {
+    if (queueCount == LATENCY_FENCE_QUEUE) waitForOldestFrame();
+
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (!fence) return;
+    PresentedFrame* frame = &queue[(queueFront + queueCount) % LATENCY_FENCE_QUEUE];
+    frame->fence = fence;
+    frame->inputTime = lastInputTime;
+    queueCount++;
+}
+
+bool isReprojectionAvailable(void) {
+    return reprojectProgram != 0;
+}
+
+bool prepareReprojection(const Matrix4x4 renderedView, const Matrix4x4 latestView) {
+    // Rotation parts only, rendered * latest^T. View rows are data[col][row]
+    float trace = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 3; k++) {
+                sum += renderedView.data[k][i] * latestView.data[k][j];
+            }
+            rotation[j * 3 + i] = sum;  // Column-major for the shader
+            if (i == j) trace += sum;
+        }
+    }
+
+    float cosine = (trace - 1.0f) * 0.5f;
+    if (cosine > 1.0f) cosine = 1.0f;
+    if (cosine < -1.0f) cosine = -1.0f;
+    stats.reprojectionDegrees = acosf(cosine) * 180.0f / 3.14159265f;
+    return stats.reprojectionDegrees >= MIN_REPROJECTION_DEGREES;
+}
+
+void drawReprojection(GLuint frameTexture, const Matrix4x4 projection, int width, int height) {
+    stateDisable(GL_DEPTH_TEST);
+    stateDisable(GL_BLEND);
+    stateUseProgram(reprojectProgram);
+    glUniformMatrix3fv(rotationLoc, 1, GL_FALSE, rotation);
+    glUniform2f(projectionScaleLoc, projection.data[0][0], projection.data[1][1]);
+    glUniform2f(screenSizeLoc, (float)width, (float)height);
+    stateActiveTexture(GL_TEXTURE0);
+    stateBindTexture(GL_TEXTURE_2D, frameTexture);
+    glBindSampler(0, reprojectSampler);
+    stateBindVertexArray(reprojectVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    stateBindVertexArray(0);
+    glBindSampler(0, 0);
+    stateBindTexture(GL_TEXTURE_2D, 0);
+    stateEnable(GL_DEPTH_TEST);
+}
+
+const LatencyStats* getLatencyStats(void) {
+    return &stats;
+}
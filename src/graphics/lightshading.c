@@ -1,7 +1,12 @@
 #include "lightshading.h"
+#include "ecs.h"
+#include "scene_graph.h"
+#include "Camera.h"
+#include "log.h"
 #include <glad/glad.h>  
 #include <GLFW/glfw3.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <stdio.h>
 
@@ -15,42 +20,111 @@ float clamp(float x, float lower, float upper) {
     return fmax(lower, fmin(x, upper));
 }
 
-void updateShaderLights() {
+// Any program that includes shaders/common/lighting.glsl
+void setLightUniforms(unsigned int program) {
     char uniformBuffer[128];
-    GLint lightCountLoc = glGetUniformLocation(shaderProgram, "lightCount");
+    GLint lightCountLoc = glGetUniformLocation(program, "lightCount");
     glUniform1i(lightCountLoc, lightCount);
 
     for (int i = 0; i < lightCount; i++) {
         sprintf(uniformBuffer, "lights[%d].position", i);
-        glUniform3fv(glGetUniformLocation(shaderProgram, uniformBuffer), 1, (const GLfloat*)&lights[i].position);
+        glUniform3fv(glGetUniformLocation(program, uniformBuffer), 1, (const GLfloat*)&lights[i].position);
 
         sprintf(uniformBuffer, "lights[%d].color", i);
-        glUniform3fv(glGetUniformLocation(shaderProgram, uniformBuffer), 1, (const GLfloat*)&lights[i].color);
+        glUniform3fv(glGetUniformLocation(program, uniformBuffer), 1, (const GLfloat*)&lights[i].color);
 
         sprintf(uniformBuffer, "lights[%d].intensity", i);
-        glUniform1f(glGetUniformLocation(shaderProgram, uniformBuffer), lights[i].intensity);
+        glUniform1f(glGetUniformLocation(program, uniformBuffer), lights[i].intensity);
 
         if (lights[i].type == LIGHT_DIRECTIONAL) {
             sprintf(uniformBuffer, "lights[%d].direction", i);
-            glUniform3fv(glGetUniformLocation(shaderProgram, uniformBuffer), 1, (const GLfloat*)&lights[i].direction);
+            glUniform3fv(glGetUniformLocation(program, uniformBuffer), 1, (const GLfloat*)&lights[i].direction);
         }
         else if (lights[i].type == LIGHT_SPOT) {
             sprintf(uniformBuffer, "lights[%d].cutOff", i);
-            glUniform1f(glGetUniformLocation(shaderProgram, uniformBuffer), lights[i].cutOff);
+            glUniform1f(glGetUniformLocation(program, uniformBuffer), lights[i].cutOff);
             sprintf(uniformBuffer, "lights[%d].outerCutOff", i);
-            glUniform1f(glGetUniformLocation(shaderProgram, uniformBuffer), lights[i].outerCutOff);
+            glUniform1f(glGetUniformLocation(program, uniformBuffer), lights[i].outerCutOff);
         }
     }
 }
 
-void initLightingSystem() {
-    lightCount = 0;
+void updateShaderLights() {
+    setLightUniforms(shaderProgram);
+}
+
+// Packed view of the light entities for the shaders, shadow maps and GUI
+static EntityId lightEntities[MAX_LIGHTS];
+
+// What updateLights packed during a step, applied by publishLights
+static Light stagedLights[MAX_LIGHTS];
+static EntityId stagedEntities[MAX_LIGHTS];
+static int stagedCount = 0;
+static bool lightsStaged = false;
+
+typedef struct {
+    Light* lights;
+    EntityId* entities;
+    int count;
+} LightPacking;
+
+static void packLightChunk(const ChunkView* view, void* data, int workerIndex) {
+    (void)workerIndex;
+    LightPacking* packing = data;
+    const Transform* transforms = getChunkColumn(view, COMPONENT_TRANSFORM);
+    const Light* chunkLights = getChunkColumn(view, COMPONENT_LIGHT);
+    for (int i = 0; i < view->count && packing->count < MAX_LIGHTS; i++) {
+        packing->lights[packing->count] = chunkLights[i];
+        const float* origin = transforms[i].world.data[3];
+        packing->lights[packing->count].position = vector(origin[0], origin[1], origin[2]);
+        packing->entities[packing->count] = view->entities[i];
+        packing->count++;
+    }
 }
 
+static int packLightsInto(Light* target, EntityId* entities) {
+    EntityQuery query = { LIGHT_COMPONENTS, 0, 0, 0 };
+    LightPacking packing = { target, entities, 0 };
+    forEachChunk(&query, packLightChunk, &packing);
+    return packing.count;
+}
+
+// Edits on the main thread show at once
+static void packLights(void) {
+    lightCount = packLightsInto(lights, lightEntities);
+}
+
+void updateLights(void) {
+    static unsigned int lastRun = 0;
+    EntityQuery changed = { LIGHT_COMPONENTS, 0, LIGHT_COMPONENTS, 0 };
+    changed.changedSince = beginSystemRun(&lastRun);
+    if (countEntities(&changed) == 0) return;
+    stagedCount = packLightsInto(stagedLights, stagedEntities);
+    lightsStaged = true;
+}
+
+void publishLights(void) {
+    if (!lightsStaged) return;
+    memcpy(lights, stagedLights, sizeof(lights));
+    memcpy(lightEntities, stagedEntities, sizeof(lightEntities));
+    lightCount = stagedCount;
+    lightsStaged = false;
+}
+
+void clearLights(void) {
+    for (int i = 0; i < lightCount; i++) {
+        destroySceneEntity(lightEntities[i]);
+    }
+    packLights();
+}
+
+void initLightingSystem() {
+    clearLights();
+}
 
 void createLight(Vector3 position, Vector3 direction, Vector3 color, float intensity, LightType type) {
     if (lightCount >= MAX_LIGHTS) {
-        printf("Failed to create light: Maximum number of lights reached.\n");
+        LOG_WARN(LOG_RENDER, "Failed to create light: Maximum number of lights reached.");
         return;
     }
 
@@ -71,29 +145,41 @@ void createLight(Vector3 position, Vector3 direction, Vector3 color, float inten
         newLight.outerCutOff = cos(DEG_TO_RAD(15.0f));
     }
 
-    lights[lightCount++] = newLight;
-    printf("Light created at [%f, %f, %f] with intensity %f\n", position.x, position.y, position.z, intensity);
+    addLight(newLight);
+    LOG_DEBUG(LOG_RENDER, "Light created at [%f, %f, %f] with intensity %f", position.x, position.y, position.z, intensity);
 }
 
+static void writeLight(EntityId entity, const Light* light) {
+    Vector3 rotation = vector(0.0f, 0.0f, 0.0f);
+    Vector3 scale = vector(1.0f, 1.0f, 1.0f);
+    Transform* transform = writeComponent(entity, COMPONENT_TRANSFORM);
+    transform->position = light->position;
+    transform->scale = scale;
+    // Lights are roots, so the world matrix is known before the scene graph runs
+    transform->world = composeTransform(light->position, rotation, scale);
+    setLocalTransform(entity, light->position, rotation, scale);
+    *(Light*)writeComponent(entity, COMPONENT_LIGHT) = *light;
+}
 
 void addLight(Light newLight) {
-    if (lightCount < MAX_LIGHTS) {
-        lights[lightCount++] = newLight;
-    }
+    if (lightCount >= MAX_LIGHTS) return;
+    EntityId entity = createSceneEntity(LIGHT_COMPONENTS);
+    if (entity.generation == 0) return;
+    writeLight(entity, &newLight);
+    packLights();
 }
 
 void updateLight(int index, Light updatedLight) {
     if (index >= 0 && index < lightCount) {
-        lights[index] = updatedLight;
+        writeLight(lightEntities[index], &updatedLight);
+        packLights();
     }
 }
 
 void removeLight(int index) {
     if (index >= 0 && index < lightCount) {
-        for (int i = index; i < lightCount - 1; i++) {
-            lights[i] = lights[i + 1];
-        }
-        lightCount--;
+        destroySceneEntity(lightEntities[index]);
+        packLights();
     }
 }
 
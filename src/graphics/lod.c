@@ -0,0 +1,236 @@
+#include "lod.h"
+#include "gl_state.h"
+#include <glad/glad.h>
+#include <string.h>
+
+// Projected size (bounding diameter over view height) below which each level is used
+static const float lodThresholds[MAX_LOD_LEVELS - 1] = { 0.25f, 0.10f, 0.04f };
+
+// Sphere sectors/stacks and cylinder sectors per level, level 0 matches addObject
+static const int sphereTessellation[MAX_LOD_LEVELS] = { 20, 12, 8, 5 };
+static const int cylinderTessellation[MAX_LOD_LEVELS] = { 20, 12, 8, 5 };
+
+bool lodEnabled = true;
+
+// Coarser primitives shared by every sphere and cylinder, index 0 is unused
+static Sphere sphereLODs[MAX_LOD_LEVELS];
+static Cylinder cylinderLODs[MAX_LOD_LEVELS];
+static bool primitiveLODsReady = false;
+
+static LODStats stats;
+
+void initPrimitiveLODs(void) {
+    if (primitiveLODsReady) return;
+
+    Vector3 origin = vector(0.0f, 0.0f, 0.0f);
+    Vector4 white = vector4(1.0f, 1.0f, 1.0f, 1.0f);
+    for (int level = 1; level < MAX_LOD_LEVELS; level++) {
+        sphereLODs[level] = createSphere(1.0f, sphereTessellation[level], sphereTessellation[level], origin, white);
+        cylinderLODs[level] = createCylinder(1.0f, 2.0f, cylinderTessellation[level], origin, white);
+    }
+    primitiveLODsReady = true;
+}
+
+void cleanupPrimitiveLODs(void) {
+    if (!primitiveLODsReady) return;
+
+    for (int level = 1; level < MAX_LOD_LEVELS; level++) {
+        destroySphere(&sphereLODs[level]);
+        destroyCylinder(&cylinderLODs[level]);
+    }
+    primitiveLODsReady = false;
+}
+
+LODView makeLODView(Vector3 eye, float projScale, bool orthographic, LODViewSlot slot) {
+    LODView view = { eye, projScale, orthographic, slot };
+    return view;
+}
+
+LODView makeCameraLODView(const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix) {
+    // The view matrix is a rigid transform, the eye is -R^T * t
+    Vector3 eye;
+    float* e = &eye.x;
+    for (int c = 0; c < 3; c++) {
+        e[c] = -(viewMatrix.data[c][0] * viewMatrix.data[3][0] +
+                 viewMatrix.data[c][1] * viewMatrix.data[3][1] +
+                 viewMatrix.data[c][2] * viewMatrix.data[3][2]);
+    }
+    return makeLODView(eye, projMatrix.data[1][1], projMatrix.data[3][3] == 1.0f, LOD_VIEW_CAMERA);
+}
+
+static int getObjectLODCount(const SceneObject* obj) {
+    switch (obj->object.type) {
+    case OBJ_SPHERE:
+    case OBJ_CYLINDER:
+        return primitiveLODsReady ? MAX_LOD_LEVELS : 1;
+    case OBJ_MODEL: {
+        const Model* model = obj->object.data.model;
+        int count = 1;
+        for (unsigned int i = 0; model && i < model->meshCount; i++) {
+            if ((int)model->meshes[i].lodCount > count) count = (int)model->meshes[i].lodCount;
+        }
+        return count;
+    }
+    default:
+        return 1; // Cubes, pyramids and planes are already minimal
+    }
+}
+
+void getObjectLocalBounds(const SceneObject* obj, Vector3* center, float* radius) {
+    *center = vector(0.0f, 0.0f, 0.0f);
+    switch (obj->object.type) {
+    case OBJ_CYLINDER:
+        *radius = 1.41421356f; // Radius 1, height 2
+        break;
+    case OBJ_MODEL:
+        *center = obj->object.data.model->boundsCenter;
+        *radius = obj->object.data.model->boundsRadius;
+        break;
+    default:
+        *radius = 1.0f;
+        break;
+    }
+}
+
+int selectObjectLOD(SceneObject* obj, const Matrix4x4* modelMatrix, const LODView* view) {
+    int lodCount = getObjectLODCount(obj);
+    if (!lodEnabled || lodCount <= 1) {
+        obj->lodLevels[view->slot] = 0;
+        return 0;
+    }
+
+    Vector3 localCenter;
+    float radius;
+    getObjectLocalBounds(obj, &localCenter, &radius);
+
+    // World-space bounding sphere
+    const float (*m)[4] = modelMatrix->data;
+    Vector3 center = vector(
+        m[0][0] * localCenter.x + m[1][0] * localCenter.y + m[2][0] * localCenter.z + m[3][0],
+        m[0][1] * localCenter.x + m[1][1] * localCenter.y + m[2][1] * localCenter.z + m[3][1],
+        m[0][2] * localCenter.x + m[1][2] * localCenter.y + m[2][2] * localCenter.z + m[3][2]);
+    // Axis lengths of the world matrix, obj->scale is local and misses the parents'
+    float maxScale = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        maxScale = fmaxf(maxScale, sqrtf(m[axis][0] * m[axis][0] + m[axis][1] * m[axis][1] + m[axis][2] * m[axis][2]));
+    }
+    radius *= maxScale;
+
+    float size;
+    if (view->orthographic) {
+        size = radius * view->projScale;
+    } else {
+        float distance = vector_length(vector_sub(center, view->eye));
+        size = distance > radius ? radius * view->projScale / distance : 1.0f;
+    }
+
+    // Only leave the current level once the size is clearly past its threshold
+    int level = obj->lodLevels[view->slot];
+    if (level >= lodCount) level = lodCount - 1;
+    while (level < lodCount - 1 && size < lodThresholds[level] * (1.0f - LOD_HYSTERESIS)) level++;
+    while (level > 0 && size > lodThresholds[level - 1] * (1.0f + LOD_HYSTERESIS)) level--;
+
+    obj->lodLevels[view->slot] = (unsigned char)level;
+    return level;
+}
+
+static DrawCommand makeDraw(GLuint vao, unsigned int indexCount, GLenum indexType, size_t offset, unsigned int fullIndexCount) {
+    DrawCommand draw = { vao, indexCount, indexType == GL_UNSIGNED_SHORT ? CMD_INDEX_UINT16 : CMD_INDEX_UINT32, offset, fullIndexCount };
+    return draw;
+}
+
+// Calls visit with the geometry of one level, shared by drawing and recording
+typedef void (*LODDrawVisitor)(void* context, const DrawCommand* draw);
+
+static void visitObjectLOD(const SceneObject* obj, int level, LODDrawVisitor visit, void* context) {
+    DrawCommand draw;
+    switch (obj->object.type) {
+    case OBJ_CUBE:
+        draw = makeDraw(obj->object.data.cube.vao, 36, GL_UNSIGNED_INT, 0, 36);
+        visit(context, &draw);
+        break;
+    case OBJ_SPHERE: {
+        const Sphere* sphere = level > 0 && primitiveLODsReady ? &sphereLODs[level] : &obj->object.data.sphere;
+        draw = makeDraw(sphere->vao, sphere->numIndices, GL_UNSIGNED_INT, 0, obj->object.data.sphere.numIndices);
+        visit(context, &draw);
+        break;
+    }
+    case OBJ_PYRAMID:
+        draw = makeDraw(obj->object.data.pyramid.vao, 18, GL_UNSIGNED_INT, 0, 18);
+        visit(context, &draw);
+        break;
+    case OBJ_CYLINDER: {
+        const Cylinder* cylinder = level > 0 && primitiveLODsReady ? &cylinderLODs[level] : &obj->object.data.cylinder;
+        draw = makeDraw(cylinder->vao, cylinder->sectorCount * 12, GL_UNSIGNED_INT, 0, obj->object.data.cylinder.sectorCount * 12);
+        visit(context, &draw);
+        break;
+    }
+    case OBJ_PLANE:
+        draw = makeDraw(obj->object.data.plane.vao, 6, GL_UNSIGNED_INT, 0, 6);
+        visit(context, &draw);
+        break;
+    case OBJ_MODEL:
+        if (!obj->object.data.model) break;
+        for (unsigned int i = 0; i < obj->object.data.model->meshCount; i++) {
+            const Mesh* mesh = &obj->object.data.model->meshes[i];
+            // Meshes too small to simplify stop at their last level
+            int meshLevel = level < (int)mesh->lodCount ? level : (int)mesh->lodCount - 1;
+            unsigned int indexCount = meshLevel > 0 ? mesh->lodIndexCount[meshLevel] : mesh->numIndices;
+            size_t offset = meshLevel > 0 ? mesh->lodIndexOffset[meshLevel] : 0;
+            draw = makeDraw(mesh->VAO, indexCount, mesh->indexType, offset, mesh->numIndices);
+            visit(context, &draw);
+        }
+        break;
+    }
+}
+
+static void drawTriangles(void* context, const DrawCommand* draw) {
+    LODViewSlot slot = *(const LODViewSlot*)context;
+    stateBindVertexArray(draw->vertexArray);
+    glDrawElements(GL_TRIANGLES, draw->indexCount, draw->indexType == CMD_INDEX_UINT16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)draw->indexOffset);
+    recordLODTriangles(slot, draw->indexCount, draw->fullIndexCount);
+}
+
+void drawObjectLOD(const SceneObject* obj, int level, LODViewSlot slot) {
+    visitObjectLOD(obj, level, drawTriangles, &slot);
+    stateBindVertexArray(0);
+}
+
+static void recordTriangles(void* context, const DrawCommand* draw) {
+    recordDraw((CommandList*)context, draw);
+}
+
+void recordObjectLOD(CommandList* list, const SceneObject* obj, int level) {
+    visitObjectLOD(obj, level, recordTriangles, list);
+}
+
+typedef struct {
+    DrawCommand draw;
+    int count;
+} SingleDraw;
+
+static void captureDraw(void* context, const DrawCommand* draw) {
+    SingleDraw* single = (SingleDraw*)context;
+    if (single->count++ == 0) single->draw = *draw;
+}
+
+bool getObjectLODDraw(const SceneObject* obj, int level, DrawCommand* draw) {
+    SingleDraw single = { .count = 0 };
+    visitObjectLOD(obj, level, captureDraw, &single);
+    if (single.count != 1) return false;
+    *draw = single.draw;
+    return true;
+}
+
+void recordLODTriangles(LODViewSlot slot, unsigned int drawnIndices, unsigned int fullIndices) {
+    stats.trianglesDrawn[slot] += drawnIndices / 3;
+    stats.trianglesFull[slot] += fullIndices / 3;
+}
+
+void resetLODStats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+const LODStats* getLODStats(void) {
+    return &stats;
+}
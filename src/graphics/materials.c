@@ -1,7 +1,10 @@
 #include "materials.h"
 #include "textures.h"  
+#include "gl_state.h"
+#include "log.h"
 #include <stdio.h>
 #include <string.h>
+#include <stdbool.h>
 
 PBRMaterial materials[MAX_MATERIALS];
 const char* materialNames[MAX_MATERIALS] = { 
@@ -10,6 +13,9 @@ const char* materialNames[MAX_MATERIALS] = {
     "chunkyRockface",
     "stainlessSteel", };
 int materialCount = 0;
+PBRMaterialSlab materialSlabs[MAX_MATERIAL_SLABS];
+int materialSlabCount = 0;
+static int boundSlab = -1;
 
 // Load textures and create a PBR material
 PBRMaterial loadPBRMaterial(const char* albedo, const char* normal, const char* metallic, const char* roughness, const char* ao) {
@@ -20,38 +26,223 @@ PBRMaterial loadPBRMaterial(const char* albedo, const char* normal, const char*
     material.metallicMap = loadTexture(metallic);
     material.roughnessMap = loadTexture(roughness);
     material.aoMap = loadTexture(ao);
+    material.arraySlab = -1;
+    material.arrayLayer = 0;
 
     if (material.albedoMap == 0 || material.normalMap == 0 || material.metallicMap == 0 ||
         material.roughnessMap == 0 || material.aoMap == 0) {
-        fprintf(stderr, "Failed to load one or more textures for PBR material\n");
+        LOG_ERROR(LOG_ASSETS, "Failed to load one or more textures for PBR material");
     }
     else {
-        printf("PBR Material loaded successfully.\n");
+        LOG_INFO(LOG_ASSETS, "PBR Material loaded successfully.");
     }
 
     return material;
 }
 
 void bindPBRMaterial(PBRMaterial material) {
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, material.albedoMap);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, material.normalMap);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, material.metallicMap);
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, material.roughnessMap);
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_2D, material.aoMap);
+    stateActiveTexture(GL_TEXTURE0);
+    stateBindTexture(GL_TEXTURE_2D, material.albedoMap);
+    stateActiveTexture(GL_TEXTURE1);
+    stateBindTexture(GL_TEXTURE_2D, material.normalMap);
+    stateActiveTexture(GL_TEXTURE2);
+    stateBindTexture(GL_TEXTURE_2D, material.metallicMap);
+    stateActiveTexture(GL_TEXTURE3);
+    stateBindTexture(GL_TEXTURE_2D, material.roughnessMap);
+    stateActiveTexture(GL_TEXTURE4);
+    stateBindTexture(GL_TEXTURE_2D, material.aoMap);
+    stateActiveTexture(GL_TEXTURE0);
+    boundSlab = -1; // Units 0-4 no longer match whatever slab was bound for the fallback path
+}
+
+static GLuint getMaterialMap(const PBRMaterial* material, int map) {
+    switch (map) {
+    case 0: return material->albedoMap;
+    case 1: return material->normalMap;
+    case 2: return material->metallicMap;
+    case 3: return material->roughnessMap;
+    case 4: return material->aoMap;
+    default: return 0;
+    }
+}
+
+// Reads back the size, format and mip count of a 2D texture. Compressed
+// textures only count the levels glCopyImageSubData can copy
+static bool queryMapLayout(GLuint texture, GLsizei* width, GLsizei* height, GLenum* format, GLsizei* levels) {
+    if (texture == 0) return false;
+
+    GLint w = 0, h = 0, f = 0, compressed = GL_FALSE;
+    stateBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &f);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+    if (w <= 0 || h <= 0) return false;
+    // Block-compressed images copy in whole 4x4 blocks, smaller levels can't be copied
+    if (compressed && (w < 4 || h < 4)) return false;
+
+    GLsizei count = 1;
+    while (count < 16) {
+        GLint levelWidth = 0, levelHeight = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, count, GL_TEXTURE_WIDTH, &levelWidth);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, count, GL_TEXTURE_HEIGHT, &levelHeight);
+        if (levelWidth <= 0) break;
+        // The slab stops at the last full block, sampling clamps to it
+        if (compressed && (levelWidth < 4 || levelHeight < 4)) break;
+        count++;
+    }
+
+    *width = w;
+    *height = h;
+    *format = (GLenum)f;
+    *levels = count;
+    return true;
+}
+
+static int findOrCreateSlab(const GLsizei* width, const GLsizei* height, const GLenum* format) {
+    for (int s = 0; s < materialSlabCount; s++) {
+        bool matches = true;
+        for (int m = 0; m < PBR_MAP_COUNT && matches; m++) {
+            matches = materialSlabs[s].width[m] == width[m] &&
+                      materialSlabs[s].height[m] == height[m] &&
+                      materialSlabs[s].internalFormat[m] == format[m];
+        }
+        if (matches) return s;
+    }
+
+    if (materialSlabCount >= MAX_MATERIAL_SLABS) return -1;
+
+    PBRMaterialSlab* slab = &materialSlabs[materialSlabCount];
+    memset(slab, 0, sizeof(*slab));
+    for (int m = 0; m < PBR_MAP_COUNT; m++) {
+        slab->width[m] = width[m];
+        slab->height[m] = height[m];
+        slab->internalFormat[m] = format[m];
+    }
+    slab->levels = 16;
+    return materialSlabCount++;
+}
+
+void buildPBRMaterialArrays() {
+    cleanupPBRMaterialArrays();
+
+    // Immutable array storage and GPU-side image copies need GL 4.3
+    if (!GLAD_GL_VERSION_4_3) {
+        LOG_WARN(LOG_ASSETS, "Texture arrays unavailable, PBR materials will be bound individually.");
+        return;
+    }
+
+    // Group materials by the layout of all five maps
+    for (int i = 0; i < materialCount; i++) {
+        PBRMaterial* material = &materials[i];
+        GLsizei width[PBR_MAP_COUNT], height[PBR_MAP_COUNT], levels[PBR_MAP_COUNT];
+        GLenum format[PBR_MAP_COUNT];
+        bool complete = true;
+
+        material->arraySlab = -1;
+        for (int m = 0; m < PBR_MAP_COUNT && complete; m++) {
+            complete = queryMapLayout(getMaterialMap(material, m), &width[m], &height[m], &format[m], &levels[m]);
+        }
+        if (!complete) {
+            LOG_WARN(LOG_ASSETS, "Material %s has missing maps, keeping it out of the texture arrays.", materialNames[i]);
+            continue;
+        }
+
+        int slab = findOrCreateSlab(width, height, format);
+        if (slab < 0) {
+            LOG_WARN(LOG_ASSETS, "Material slab limit reached, %s stays unpacked.", materialNames[i]);
+            continue;
+        }
+
+        for (int m = 0; m < PBR_MAP_COUNT; m++) {
+            if (levels[m] < materialSlabs[slab].levels) {
+                materialSlabs[slab].levels = levels[m];
+            }
+        }
+        material->arraySlab = slab;
+        material->arrayLayer = materialSlabs[slab].layerCount++;
+    }
+
+    // Allocate one array per map type and copy every layer on the GPU
+    for (int s = 0; s < materialSlabCount; s++) {
+        PBRMaterialSlab* slab = &materialSlabs[s];
+        glGenTextures(PBR_MAP_COUNT, slab->maps);
+        for (int m = 0; m < PBR_MAP_COUNT; m++) {
+            stateBindTexture(GL_TEXTURE_2D_ARRAY, slab->maps[m]);
+            glTexStorage3D(GL_TEXTURE_2D_ARRAY, slab->levels, slab->internalFormat[m], slab->width[m], slab->height[m], slab->layerCount);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+    }
+
+    for (int i = 0; i < materialCount; i++) {
+        PBRMaterial* material = &materials[i];
+        if (material->arraySlab < 0) continue;
+
+        PBRMaterialSlab* slab = &materialSlabs[material->arraySlab];
+        for (int m = 0; m < PBR_MAP_COUNT; m++) {
+            for (GLsizei level = 0; level < slab->levels; level++) {
+                GLsizei levelWidth = slab->width[m] >> level;
+                GLsizei levelHeight = slab->height[m] >> level;
+                glCopyImageSubData(getMaterialMap(material, m), GL_TEXTURE_2D, level, 0, 0, 0,
+                                   slab->maps[m], GL_TEXTURE_2D_ARRAY, level, 0, 0, material->arrayLayer,
+                                   levelWidth > 0 ? levelWidth : 1, levelHeight > 0 ? levelHeight : 1, 1);
+            }
+        }
+    }
+
+    stateBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    stateBindTexture(GL_TEXTURE_2D, 0);
+    LOG_INFO(LOG_ASSETS, "Packed %d materials into %d texture array slabs.", materialCount, materialSlabCount);
+}
+
+void bindPBRMaterialSlab(int slab) {
+    if (slab < 0 || slab >= materialSlabCount || slab == boundSlab) return;
+
+    for (int m = 0; m < PBR_MAP_COUNT; m++) {
+        stateActiveTexture(GL_TEXTURE0 + PBR_ARRAY_TEXTURE_UNIT + m);
+        stateBindTexture(GL_TEXTURE_2D_ARRAY, materialSlabs[slab].maps[m]);
+    }
+    stateActiveTexture(GL_TEXTURE0);
+    boundSlab = slab;
+}
+
+void resetPBRMaterialSlabBinding() {
+    boundSlab = -1;
+}
+
+void cleanupPBRMaterialArrays() {
+    for (int s = 0; s < materialSlabCount; s++) {
+        stateDeleteTextures(PBR_MAP_COUNT, materialSlabs[s].maps);
+    }
+    for (int i = 0; i < materialCount; i++) {
+        materials[i].arraySlab = -1;
+    }
+    materialSlabCount = 0;
+    boundSlab = -1;
+}
+
+void setPBRSamplerUniforms(GLuint shader) {
+    static const char* mapSamplers[PBR_MAP_COUNT] = { "albedoMap", "normalMap", "metallicMap", "roughnessMap", "aoMap" };
+    static const char* arraySamplers[PBR_MAP_COUNT] = { "albedoArray", "normalArray", "metallicArray", "roughnessArray", "aoArray" };
+
+    stateUseProgram(shader);
+    glUniform1i(glGetUniformLocation(shader, "texture1"), 0);
+    for (int m = 0; m < PBR_MAP_COUNT; m++) {
+        glUniform1i(glGetUniformLocation(shader, mapSamplers[m]), m);
+        glUniform1i(glGetUniformLocation(shader, arraySamplers[m]), PBR_ARRAY_TEXTURE_UNIT + m);
+    }
 }
 
 void cleanupPBRMaterial(PBRMaterial* material) {
-    glDeleteTextures(1, &material->albedoMap);
-    glDeleteTextures(1, &material->normalMap);
-    glDeleteTextures(1, &material->metallicMap);
-    glDeleteTextures(1, &material->roughnessMap);
-    glDeleteTextures(1, &material->aoMap);
-    printf("PBR Material resources cleaned up.\n");
+    stateDeleteTextures(1, &material->albedoMap);
+    stateDeleteTextures(1, &material->normalMap);
+    stateDeleteTextures(1, &material->metallicMap);
+    stateDeleteTextures(1, &material->roughnessMap);
+    stateDeleteTextures(1, &material->aoMap);
+    LOG_INFO(LOG_ASSETS, "PBR Material resources cleaned up.");
 }
 
 void loadPBRTextures() {
@@ -95,13 +286,13 @@ void loadPBRTextures() {
 
 void addMaterial(const char* name, PBRMaterial material) {
     if (materialCount >= MAX_MATERIALS) {
-        fprintf(stderr, "Max materials limit reached.\n");
+        LOG_ERROR(LOG_ASSETS, "Max materials limit reached.");
         return;
     }
     materialNames[materialCount] = strdup(name);  
     materials[materialCount] = material;
     materialCount++;
-    printf("Material %s added successfully.\n", name);
+    LOG_DEBUG(LOG_ASSETS, "Material %s added successfully.", name);
 }
 
 
@@ -111,7 +302,7 @@ PBRMaterial* getMaterial(const char* name) {
             return &materials[i];
         }
     }
-    fprintf(stderr, "Material %s not found. Using default material 'peacockOre'.\n", name);
+    LOG_WARN(LOG_ASSETS, "Material %s not found. Using default material 'peacockOre'.", name);
 
     for (int i = 0; i < materialCount; i++) {
         if (strcmp(materialNames[i], "peacockOre") == 0) {
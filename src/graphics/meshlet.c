@@ -0,0 +1,328 @@
+#include "meshlet.h"
+#include "Camera.h"
+#include "lod.h"
+#include "thread_pool.h"
+#include "gl_state.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define MESHLET_SIMD 1
+#endif
+
+// createMeshletCullData layout: per group of four meshlets, eight fields of four lanes
+enum { CULL_CX, CULL_CY, CULL_CZ, CULL_RADIUS, CULL_AX, CULL_AY, CULL_AZ, CULL_CUTOFF, CULL_FIELDS };
+#define CULL_GROUP_FLOATS (CULL_FIELDS * 4)
+
+bool meshletCullingEnabled = true;
+
+// One mesh being culled. Ranges of MESHLET_CULL_BATCH meshlets run in a
+// parallelFor; each writes its commands at its own offset and is compacted afterwards.
+typedef struct {
+    const Mesh* mesh;
+    float planes[6][4];        // Object space, normalized
+    float eye[3];              // Object space
+    bool coneCulling;
+    DrawElementsIndirectCommand* commands;
+    unsigned int* rangeCommands;
+    unsigned int* rangeVisible;
+} CullJob;
+
+static CullJob job;
+static unsigned int commandCapacity = 0;
+static unsigned int rangeCapacity = 0;
+
+static GLuint indirectBuffer = 0;
+static unsigned int indirectOffset = 0; // In commands
+static bool cullingInitialized = false;
+
+static MeshletStats stats;
+
+void initMeshletCulling(void) {
+    if (cullingInitialized) return;
+
+    glGenBuffers(1, &indirectBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, MESHLET_INDIRECT_CAPACITY * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    indirectOffset = 0;
+    cullingInitialized = true;
+}
+
+void shutdownMeshletCulling(void) {
+    if (!cullingInitialized) return;
+
+    glDeleteBuffers(1, &indirectBuffer);
+    indirectBuffer = 0;
+    free(job.commands);
+    free(job.rangeCommands);
+    free(job.rangeVisible);
+    memset(&job, 0, sizeof(job));
+    commandCapacity = 0;
+    rangeCapacity = 0;
+    cullingInitialized = false;
+}
+
+float* createMeshletCullData(const Meshlet* meshlets, unsigned int count) {
+    unsigned int groups = (count + 3) / 4;
+    float* data = (float*)calloc((size_t)groups * CULL_GROUP_FLOATS, sizeof(float));
+    if (!data) return NULL;
+
+    for (unsigned int i = 0; i < count; i++) {
+        float* group = data + (i / 4) * CULL_GROUP_FLOATS;
+        unsigned int lane = i % 4;
+        group[CULL_CX * 4 + lane] = meshlets[i].center[0];
+        group[CULL_CY * 4 + lane] = meshlets[i].center[1];
+        group[CULL_CZ * 4 + lane] = meshlets[i].center[2];
+        group[CULL_RADIUS * 4 + lane] = meshlets[i].radius;
+        group[CULL_AX * 4 + lane] = meshlets[i].coneAxis[0];
+        group[CULL_AY * 4 + lane] = meshlets[i].coneAxis[1];
+        group[CULL_AZ * 4 + lane] = meshlets[i].coneAxis[2];
+        group[CULL_CUTOFF * 4 + lane] = meshlets[i].coneCutoff;
+    }
+    return data;
+}
+
+// Visibility bits of the four meshlets in one group
+#ifdef MESHLET_SIMD
+static int cullGroup(const float* group, const CullJob* cull) {
+    __m128 cx = _mm_loadu_ps(group + CULL_CX * 4);
+    __m128 cy = _mm_loadu_ps(group + CULL_CY * 4);
+    __m128 cz = _mm_loadu_ps(group + CULL_CZ * 4);
+    __m128 radius = _mm_loadu_ps(group + CULL_RADIUS * 4);
+    __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+    __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < 6; p++) {
+        __m128 distance = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(cull->planes[p][0])), _mm_mul_ps(cy, _mm_set1_ps(cull->planes[p][1]))),
+            _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(cull->planes[p][2])), _mm_set1_ps(cull->planes[p][3])));
+        visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, negRadius));
+    }
+
+    if (cull->coneCulling) {
+        // Every triangle faces away when the eye lies inside the widened back cone
+        __m128 vx = _mm_sub_ps(cx, _mm_set1_ps(cull->eye[0]));
+        __m128 vy = _mm_sub_ps(cy, _mm_set1_ps(cull->eye[1]));
+        __m128 vz = _mm_sub_ps(cz, _mm_set1_ps(cull->eye[2]));
+        __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(group + CULL_AX * 4)),
+                                             _mm_mul_ps(vy, _mm_loadu_ps(group + CULL_AY * 4))),
+                                  _mm_mul_ps(vz, _mm_loadu_ps(group + CULL_AZ * 4)));
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+        __m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(group + CULL_CUTOFF * 4), length), radius);
+        visible = _mm_andnot_ps(_mm_cmpge_ps(along, limit), visible);
+    }
+    return _mm_movemask_ps(visible);
+}
+#else
+static int cullGroup(const float* group, const CullJob* cull) {
+    int mask = 0;
+    for (int lane = 0; lane < 4; lane++) {
+        float cx = group[CULL_CX * 4 + lane], cy = group[CULL_CY * 4 + lane], cz = group[CULL_CZ * 4 + lane];
+        float radius = group[CULL_RADIUS * 4 + lane];
+
+        bool visible = true;
+        for (int p = 0; p < 6 && visible; p++) {
+            visible = cx * cull->planes[p][0] + cy * cull->planes[p][1] + cz * cull->planes[p][2] + cull->planes[p][3] >= -radius;
+        }
+
+        if (visible && cull->coneCulling) {
+            float vx = cx - cull->eye[0], vy = cy - cull->eye[1], vz = cz - cull->eye[2];
+            float along = vx * group[CULL_AX * 4 + lane] + vy * group[CULL_AY * 4 + lane] + vz * group[CULL_AZ * 4 + lane];
+            visible = along < group[CULL_CUTOFF * 4 + lane] * sqrtf(vx * vx + vy * vy + vz * vz) + radius;
+        }
+        if (visible) mask |= 1 << lane;
+    }
+    return mask;
+}
+#endif
+
+// Culls one range and writes its commands, merging meshlets that touch in the index buffer
+static void cullRange(unsigned int range) {
+    const Mesh* mesh = job.mesh;
+    unsigned int first = range * MESHLET_CULL_BATCH;
+    unsigned int last = first + MESHLET_CULL_BATCH < mesh->meshletCount ? first + MESHLET_CULL_BATCH : mesh->meshletCount;
+
+    DrawElementsIndirectCommand* commands = job.commands + first;
+    unsigned int commandCount = 0;
+    unsigned int visibleCount = 0;
+
+    // Ranges are multiples of four, so groups never straddle two of them
+    for (unsigned int group = first / 4; group * 4 < last; group++) {
+        int mask = cullGroup(mesh->meshletCullData + (size_t)group * CULL_GROUP_FLOATS, &job);
+        for (unsigned int lane = 0; lane < 4; lane++) {
+            unsigned int i = group * 4 + lane;
+            if (i >= last || !(mask & (1 << lane))) continue;
+
+            const Meshlet* meshlet = &mesh->meshlets[i];
+            visibleCount++;
+            if (commandCount > 0 &&
+                commands[commandCount - 1].firstIndex + commands[commandCount - 1].count == meshlet->firstIndex) {
+                commands[commandCount - 1].count += meshlet->indexCount;
+            } else {
+                DrawElementsIndirectCommand command = { meshlet->indexCount, 1, meshlet->firstIndex, 0, 0 };
+                commands[commandCount++] = command;
+            }
+        }
+    }
+
+    job.rangeCommands[range] = commandCount;
+    job.rangeVisible[range] = visibleCount;
+}
+
+static void cullRanges(void* data, int begin, int end, int workerIndex) {
+    (void)data;
+    (void)workerIndex;
+    for (int range = begin; range < end; range++) {
+        cullRange((unsigned int)range);
+    }
+}
+
+static bool reserveScratch(unsigned int meshletCount, unsigned int rangeCount) {
+    if (meshletCount > commandCapacity) {
+        DrawElementsIndirectCommand* grown = (DrawElementsIndirectCommand*)realloc(job.commands, meshletCount * sizeof(DrawElementsIndirectCommand));
+        if (!grown) return false;
+        job.commands = grown;
+        commandCapacity = meshletCount;
+    }
+    if (rangeCount > rangeCapacity) {
+        unsigned int* commands = (unsigned int*)realloc(job.rangeCommands, rangeCount * sizeof(unsigned int));
+        if (commands) job.rangeCommands = commands;
+        unsigned int* visible = (unsigned int*)realloc(job.rangeVisible, rangeCount * sizeof(unsigned int));
+        if (visible) job.rangeVisible = visible;
+        if (!commands || !visible) return false;
+        rangeCapacity = rangeCount;
+    }
+    return true;
+}
+
+// Culls every meshlet of the mesh and returns the compacted command count
+static unsigned int cullMesh(const Mesh* mesh, unsigned int* visibleMeshlets) {
+    unsigned int rangeCount = (mesh->meshletCount + MESHLET_CULL_BATCH - 1) / MESHLET_CULL_BATCH;
+    if (!reserveScratch(mesh->meshletCount, rangeCount)) return 0;
+
+    // Small meshes stay on the calling thread, one range needs no helpers
+    job.mesh = mesh;
+    parallelFor((int)rangeCount, 1, cullRanges, NULL);
+
+    unsigned int total = 0;
+    *visibleMeshlets = 0;
+    for (unsigned int r = 0; r < rangeCount; r++) {
+        if (total != r * MESHLET_CULL_BATCH) {
+            memmove(job.commands + total, job.commands + r * MESHLET_CULL_BATCH, job.rangeCommands[r] * sizeof(DrawElementsIndirectCommand));
+        }
+        total += job.rangeCommands[r];
+        *visibleMeshlets += job.rangeVisible[r];
+    }
+    return total;
+}
+
+// Eye position in the object's local space, inverting the affine model matrix
+static bool objectSpaceEye(const Matrix4x4* model, Vector3 eye, float out[3]) {
+    const float (*m)[4] = model->data;
+    // a[r][c] is the upper 3x3 in row-major order
+    float a[3][3] = {
+        { m[0][0], m[1][0], m[2][0] },
+        { m[0][1], m[1][1], m[2][1] },
+        { m[0][2], m[1][2], m[2][2] }
+    };
+    float cofactor[3][3];
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            int r1 = (r + 1) % 3, r2 = (r + 2) % 3, c1 = (c + 1) % 3, c2 = (c + 2) % 3;
+            cofactor[r][c] = a[r1][c1] * a[r2][c2] - a[r1][c2] * a[r2][c1];
+        }
+    }
+    float determinant = a[0][0] * cofactor[0][0] + a[0][1] * cofactor[0][1] + a[0][2] * cofactor[0][2];
+    if (fabsf(determinant) < 1e-12f) return false;
+
+    float d[3] = { eye.x - m[3][0], eye.y - m[3][1], eye.z - m[3][2] };
+    for (int r = 0; r < 3; r++) {
+        // The inverse is the transposed cofactor matrix over the determinant
+        out[r] = (cofactor[0][r] * d[0] + cofactor[1][r] * d[1] + cofactor[2][r] * d[2]) / determinant;
+    }
+    return true;
+}
+
+bool canDrawModelMeshlets(const SceneObject* obj) {
+    if (!meshletCullingEnabled || !cullingInitialized) return false;
+    if (obj->object.type != OBJ_MODEL || !obj->object.data.model) return false;
+
+    const Model* model = obj->object.data.model;
+    for (unsigned int i = 0; i < model->meshCount; i++) {
+        if (model->meshes[i].meshletCount >= MESHLET_MIN_COUNT && model->meshes[i].meshletCullData) return true;
+    }
+    return false;
+}
+
+bool drawModelMeshlets(const SceneObject* obj, const Matrix4x4* modelMatrix, const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix) {
+    if (!canDrawModelMeshlets(obj)) return false;
+
+    const Model* model = obj->object.data.model;
+
+    // Rows of projection * view * model are the frustum planes in object space
+    Matrix4x4 mvp = matrixMultiply(*modelMatrix, matrixMultiply(viewMatrix, projMatrix));
+    for (int p = 0; p < 6; p++) {
+        int row = p / 2;
+        float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+        for (int c = 0; c < 4; c++) {
+            job.planes[p][c] = mvp.data[c][3] + sign * mvp.data[c][row];
+        }
+        float length = sqrtf(job.planes[p][0] * job.planes[p][0] + job.planes[p][1] * job.planes[p][1] + job.planes[p][2] * job.planes[p][2]);
+        if (length > 0.0f) {
+            for (int c = 0; c < 4; c++) job.planes[p][c] /= length;
+        }
+    }
+
+    // Back faces show through transparent objects, keep them
+    LODView camera = makeCameraLODView(viewMatrix, projMatrix);
+    job.coneCulling = obj->color.w >= 1.0f && objectSpaceEye(modelMatrix, camera.eye, job.eye);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    for (unsigned int i = 0; i < model->meshCount; i++) {
+        const Mesh* mesh = &model->meshes[i];
+        stateBindVertexArray(mesh->VAO);
+
+        if (mesh->meshletCount < MESHLET_MIN_COUNT || !mesh->meshletCullData) {
+            glDrawElements(GL_TRIANGLES, mesh->numIndices, mesh->indexType, 0);
+            recordLODTriangles(LOD_VIEW_CAMERA, mesh->numIndices, mesh->numIndices);
+            continue;
+        }
+
+        unsigned int visibleMeshlets;
+        unsigned int commandCount = cullMesh(mesh, &visibleMeshlets);
+        stats.meshesCulled++;
+        stats.meshletsTested += (int)mesh->meshletCount;
+        stats.meshletsVisible += (int)visibleMeshlets;
+        if (commandCount == 0) continue;
+
+        unsigned int submitted = 0;
+        for (unsigned int c = 0; c < commandCount; c++) submitted += job.commands[c].count;
+        recordLODTriangles(LOD_VIEW_CAMERA, submitted, mesh->numIndices);
+
+        // Orphan the stream once it is full, in-flight draws keep the old storage
+        if (commandCount > MESHLET_INDIRECT_CAPACITY) commandCount = MESHLET_INDIRECT_CAPACITY;
+        if (indirectOffset + commandCount > MESHLET_INDIRECT_CAPACITY) {
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, MESHLET_INDIRECT_CAPACITY * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+            indirectOffset = 0;
+        }
+        size_t byteOffset = indirectOffset * sizeof(DrawElementsIndirectCommand);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, byteOffset, commandCount * sizeof(DrawElementsIndirectCommand), job.commands);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, mesh->indexType, (const void*)byteOffset, (GLsizei)commandCount, 0);
+        indirectOffset += commandCount;
+        stats.draws += (int)commandCount;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    stateBindVertexArray(0);
+    return true;
+}
+
+void resetMeshletStats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+const MeshletStats* getMeshletStats(void) {
+    return &stats;
+}
@@ -0,0 +1,87 @@
+#include "oit.h"
+#include "shaders.h"
+#include "globals.h"
+#include "gl_state.h"
+#include "log.h"
+#include <stdio.h>
+
+bool oitEnabled = false;
+
+static GLuint compositeProgram = 0;
+static GLuint compositeVAO = 0;
+
+bool initOIT(void) {
+    compositeProgram = loadShader("shaders/oit/composite_vertex.glsl", "shaders/oit/composite_fragment.glsl");
+    if (!compositeProgram) {
+        LOG_WARN(LOG_RENDER, "Weighted transparency unavailable: failed to build the composite shader");
+        return false;
+    }
+    stateUseProgram(compositeProgram);
+    glUniform1i(glGetUniformLocation(compositeProgram, "accumulation"), 0);
+    glUniform1i(glGetUniformLocation(compositeProgram, "revealage"), 1);
+    stateUseProgram(0);
+
+    // Core profile draws need a vertex array even without attributes
+    glGenVertexArrays(1, &compositeVAO);
+    return true;
+}
+
+void shutdownOIT(void) {
+    if (compositeProgram) glDeleteProgram(compositeProgram);
+    if (compositeVAO) stateDeleteVertexArrays(1, &compositeVAO);
+    compositeProgram = compositeVAO = 0;
+}
+
+bool isOITAvailable(void) {
+    return compositeProgram != 0;
+}
+
+void beginWeightedTransparency(GLuint depthTexture, int width, int height) {
+    // Transparent fragments behind opaque geometry must still be rejected
+    stateBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    stateBindTexture(GL_TEXTURE_2D, depthTexture);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+    stateBindTexture(GL_TEXTURE_2D, 0);
+
+    static const GLfloat clearAccumulation[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    static const GLfloat clearRevealage[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glClearBufferfv(GL_COLOR, 0, clearAccumulation);
+    glClearBufferfv(GL_COLOR, 1, clearRevealage);
+
+    stateDepthMask(GL_FALSE);
+    stateEnable(GL_BLEND);
+    stateBlendFunci(0, GL_ONE, GL_ONE);
+    stateBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+
+    stateUseProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "weightedTransparency"), 1);
+}
+
+void endWeightedTransparency(void) {
+    stateUseProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "weightedTransparency"), 0);
+    stateDisable(GL_BLEND);
+    stateDepthMask(GL_TRUE);
+}
+
+void compositeWeightedTransparency(GLuint accumulation, GLuint revealage) {
+    // Weighted average over the opaque frame, covered by 1 - revealage
+    stateDisable(GL_DEPTH_TEST);
+    stateEnable(GL_BLEND);
+    stateBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    stateUseProgram(compositeProgram);
+    stateActiveTexture(GL_TEXTURE0);
+    stateBindTexture(GL_TEXTURE_2D, accumulation);
+    stateActiveTexture(GL_TEXTURE1);
+    stateBindTexture(GL_TEXTURE_2D, revealage);
+    stateBindVertexArray(compositeVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    stateBindVertexArray(0);
+    stateBindTexture(GL_TEXTURE_2D, 0);
+    stateActiveTexture(GL_TEXTURE0);
+    stateBindTexture(GL_TEXTURE_2D, 0);
+
+    stateDisable(GL_BLEND);
+    stateEnable(GL_DEPTH_TEST);
+    stateUseProgram(shaderProgram);
+}
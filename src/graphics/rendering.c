@@ -10,6 +10,27 @@
 #include "materials.h"
 #include "gui.h"
 #include "shadow_system.h"
+#include "model_registry.h"
+#include "thread_pool.h"
+#include "upload_queue.h"
+#include "static_batch.h"
+#include "lod.h"
+#include "meshlet.h"
+#include "gpu_culling.h"
+#include "sphere_impostor.h"
+#include "oit.h"
+#include "radix_sort.h"
+#include "frame_graph.h"
+#include "gl_state.h"
+#include "command_list.h"
+#include "simulation.h"
+#include "frame_timing.h"
+#include "latency.h"
+#include "ecs.h"
+#include "scene_graph.h"
+#include "scene_systems.h"
+#include "log.h"
+#include <string.h>
 
 #ifdef AUDIO_ENABLED
 #include "audio.h"
@@ -20,8 +41,8 @@
 static Model* model = NULL;
 
 // Delta time variables
-static float deltaTime = 0.0f;
-static float lastFrame = 0.0f;
+static double deltaTime = 0.0;
+static double lastFrame = 0.0;
 
 void loadResources(int stage, float* progress) {
     switch (stage) {
@@ -34,10 +55,13 @@ void loadResources(int stage, float* progress) {
         break;
     case 2:  // Load PBR Textures
         loadPBRTextures();
+        flushUploads(); // Slab packing copies from the finished textures
+        buildPBRMaterialArrays();
         *progress += 0.2f;
         break;
     case 3:  // Setup Skybox
         initSkybox(7);
+        flushUploads();
         *progress += 0.2f;
         break;
     case 4:  // Setup Lighting
@@ -47,9 +71,9 @@ void loadResources(int stage, float* progress) {
     case 5:  // Setup Audio (NEW)
         #ifdef AUDIO_ENABLED
         if (initAudioSystem()) {
-            printf("Audio system initialized successfully\n");
+            LOG_INFO(LOG_AUDIO, "Audio system initialized successfully");
         } else {
-            printf("Audio system failed to initialize - continuing without audio\n");
+            LOG_WARN(LOG_AUDIO, "Audio system failed to initialize - continuing without audio");
         }
         #endif
         *progress += 0.1f;
@@ -62,7 +86,7 @@ void setup() {
     strncpy(screen.title, "C1ue Engine v1.1.0", sizeof(screen.title) - 1);
 
     if (!glfwInit()) {
-        fprintf(stderr, "Failed to initialize GLFW\n");
+        LOG_ERROR(LOG_RENDER, "Failed to initialize GLFW");
         exit(EXIT_FAILURE);
     }
 
@@ -81,7 +105,7 @@ void setup() {
 
     screen.window = glfwCreateWindow(screen.width, screen.height, screen.title, NULL, NULL);
     if (!screen.window) {
-        fprintf(stderr, "Failed to create window\n");
+        LOG_ERROR(LOG_RENDER, "Failed to create window");
         glfwTerminate();
         exit(EXIT_FAILURE);
     }
@@ -93,87 +117,90 @@ void setup() {
 
     glfwMakeContextCurrent(screen.window);
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        fprintf(stderr, "Failed to initialize GLAD\n");
+        LOG_ERROR(LOG_RENDER, "Failed to initialize GLAD");
         exit(EXIT_FAILURE);
     }
-    glfwSwapInterval(1);
+    glfwSwapInterval(frameTiming.vsync ? 1 : 0);
     setup_nuklear(screen.window);
 
     // Set up shaders and get uniform locations
     shaderProgram = loadShader("shaders/objects/vertex.glsl", "shaders/objects/fragment.glsl");
     if (shaderProgram == 0) {
-        fprintf(stderr, "Failed to load shaders\n");
+        LOG_ERROR(LOG_RENDER, "Failed to load shaders");
     }
-    glUseProgram(shaderProgram);
+    setPBRSamplerUniforms(shaderProgram);
+    stateUseProgram(shaderProgram);
 
     viewLoc = glGetUniformLocation(shaderProgram, "view");
     if (viewLoc == -1) {
-        fprintf(stderr, "Could not find uniform variable 'view'\n");
+        LOG_ERROR(LOG_RENDER, "Could not find uniform variable 'view'");
     }
 
     projLoc = glGetUniformLocation(shaderProgram, "projection");
     if (projLoc == -1) {
-        fprintf(stderr, "Could not find uniform variable 'projection'\n");
+        LOG_ERROR(LOG_RENDER, "Could not find uniform variable 'projection'");
     }
 
     glClearColor(0.0, 0.0, 0.0, 0.0);
     glfwSetInputMode(screen.window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+    // Worker threads for model imports and texture decoding
+    initThreadPool(0);
+    initUploadQueue();
+    initModelRegistry();
+    initPrimitiveLODs();
+    initMeshletCulling();
+    initGPUCulling();
+    initSphereImpostors();
+    initOIT();
+    initLatency();
+
     // Initialize camera, object manager, and other essential systems
     initCamera(&camera);
+    initEcs();
+    initSceneGraph();
     initObjectManager();
     initLightingSystem();
     
     // Initialize shadow system
     if (!initShadowSystem()) {
-        printf("Warning: Shadow system initialization failed\n");
+        LOG_WARN(LOG_RENDER, "Shadow system initialization failed");
         shadowsEnabled = false;
     } else {
-        printf("Shadow system initialized successfully\n");
+        LOG_INFO(LOG_RENDER, "Shadow system initialized successfully");
     }
 
     // Enable depth testing for 3D rendering
-    glEnable(GL_DEPTH_TEST);
+    stateEnable(GL_DEPTH_TEST);
 
     // Disable face culling to ensure all faces are rendered
-    glDisable(GL_CULL_FACE);
+    stateDisable(GL_CULL_FACE);
 
-        printf("OpenGL Version: %s\n", glGetString(GL_VERSION));
-    printf("GLSL Version: %s\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
+        LOG_INFO(LOG_RENDER, "OpenGL Version: %s", (const char*)glGetString(GL_VERSION));
+    LOG_INFO(LOG_RENDER, "GLSL Version: %s", (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION));
 }
 
 void drawMesh(const Mesh* mesh) {
-    glBindVertexArray(mesh->VAO);
-    glDrawElements(GL_TRIANGLES, mesh->numIndices, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    stateBindVertexArray(mesh->VAO);
+    glDrawElements(GL_TRIANGLES, mesh->numIndices, mesh->indexType, 0);
+    stateBindVertexArray(0);
 }
 
-void processKeyboardMovements(Camera* camera, float deltaTime) {
-    float velocity = camera->MovementSpeed * deltaTime;
-    if (glfwGetKey(screen.window, GLFW_KEY_W) == GLFW_PRESS) {
-        camera->Position = vector_add(camera->Position, vector_scale(camera->Front, velocity));
-    }
-    if (glfwGetKey(screen.window, GLFW_KEY_S) == GLFW_PRESS) {
-        camera->Position = vector_sub(camera->Position, vector_scale(camera->Front, velocity));
-    }
-    if (glfwGetKey(screen.window, GLFW_KEY_A) == GLFW_PRESS) {
-        camera->Position = vector_sub(camera->Position, vector_scale(camera->Right, velocity));
-    }
-    if (glfwGetKey(screen.window, GLFW_KEY_D) == GLFW_PRESS) {
-        camera->Position = vector_add(camera->Position, vector_scale(camera->Right, velocity));
-    }
-    if (glfwGetKey(screen.window, GLFW_KEY_SPACE) == GLFW_PRESS) {
-        camera->Position = vector_add(camera->Position, vector_scale(camera->Up, velocity));
-    }
-    if (glfwGetKey(screen.window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
-        camera->Position = vector_sub(camera->Position, vector_scale(camera->Up, velocity));
+// Keys are read here on the main thread, the camera moves wherever the simulation runs
+void processKeyboardMovements(float deltaTime) {
+    static const int keys[] = { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_SPACE, GLFW_KEY_LEFT_SHIFT };
+    static const unsigned int moves[] = { MOVE_FORWARD, MOVE_BACKWARD, MOVE_LEFT, MOVE_RIGHT, MOVE_UP, MOVE_DOWN };
+    unsigned int movementKeys = 0;
+    for (int i = 0; i < 6; i++) {
+        if (glfwGetKey(screen.window, keys[i]) == GLFW_PRESS) movementKeys |= moves[i];
     }
+    moveCamera(movementKeys, deltaTime);
 }
 
 void handleToggleInput(int key, bool* pressedFlag, bool* toggleFlag, const char* toggleName) {
     if (glfwGetKey(screen.window, key) == GLFW_PRESS && !(*pressedFlag)) {
         *toggleFlag = !(*toggleFlag);
-        printf("%s %s.\n", toggleName, *toggleFlag ? "Enabled" : "Disabled");
+        LOG_INFO(LOG_RENDER, "%s %s.", toggleName, *toggleFlag ? "Enabled" : "Disabled");
         *pressedFlag = true;
     }
     else if (glfwGetKey(screen.window, key) == GLFW_RELEASE) {
@@ -183,7 +210,7 @@ void handleToggleInput(int key, bool* pressedFlag, bool* toggleFlag, const char*
 
 void handleObjectCreation(int key, bool* pressedFlag, ObjectType objType) {
     if (glfwGetKey(screen.window, key) == GLFW_PRESS && !(*pressedFlag)) {
-        PBRMaterial defaultMaterial = { 0 }; // Initialize material to zero
+        PBRMaterial defaultMaterial = { .arraySlab = -1 }; // No maps, not packed into any slab
         addObject(&camera, objType, false, -1, true, NULL, defaultMaterial, false); // No texture by default
         *pressedFlag = true;
     }
@@ -194,6 +221,9 @@ void handleObjectCreation(int key, bool* pressedFlag, ObjectType objType) {
 
 
 void render_scene(const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix) {
+    stateUseProgram(shaderProgram);
+    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &viewMatrix.data[0][0]);
+    glUniformMatrix4fv(projLoc, 1, GL_FALSE, &projMatrix.data[0][0]);
     for (int i = 0; i < objectManager.count; i++) {
         drawObject(&objectManager.objects[i], viewMatrix, projMatrix);
     }
@@ -204,16 +234,34 @@ float distanceFromCamera(SceneObject* obj) {
     return vector_length(diff);
 }
 
-int compareObjects(const void* a, const void* b) {
-    SceneObject* objA = *(SceneObject**)a;
-    SceneObject* objB = *(SceneObject**)b;
-    float distanceA = vector_length(vector_sub(camera.Position, objA->position));
-    float distanceB = vector_length(vector_sub(camera.Position, objB->position));
-    return (distanceA < distanceB) - (distanceA > distanceB); // Sort descending
+// Scratch for sorting one list of manager slots, each list has its own so both sort at once
+typedef struct {
+    uint32_t* keys;
+    uint32_t* scratchKeys;
+    uint32_t* scratchSlots;
+} SortScratch;
+
+// Farthest first by squared distance of the bounds center, radix sorted on the float bits
+static void sortBackToFront(uint32_t* slots, int count, SortScratch* scratch) {
+    for (int i = 0; i < count; i++) {
+        const Vector4* bounds = &objectManager.bounds[slots[i]];
+        Vector3 diff = vector_sub(camera.Position, vector(bounds->x, bounds->y, bounds->z));
+        scratch->keys[i] = ~radixKeyFromFloat(vector_dot(diff, diff)); // Inverted for descending order
+    }
+    radixSortKeys(scratch->keys, slots, scratch->scratchKeys, scratch->scratchSlots, count);
+}
+
+// Opaque objects are grouped by material slab so PBR binds happen once per
+// slab, and by geometry within it so equal draws merge into instanced ones
+static void sortByRenderKey(uint32_t* slots, int count, SortScratch* scratch) {
+    for (int i = 0; i < count; i++) {
+        scratch->keys[i] = (uint32_t)objectManager.renderKeys[slots[i]];
+    }
+    radixSortKeys(scratch->keys, slots, scratch->scratchKeys, scratch->scratchSlots, count);
 }
 
 void setShaderUniforms(SceneObject* obj) {
-    glUseProgram(shaderProgram);
+    stateUseProgram(shaderProgram);
     GLint useTextureLoc = glGetUniformLocation(shaderProgram, "useTexture");
     GLint usePBRLoc = glGetUniformLocation(shaderProgram, "usePBR");
     GLint useColorLoc = glGetUniformLocation(shaderProgram, "useColor");
@@ -229,108 +277,497 @@ void setShaderUniforms(SceneObject* obj) {
     glUniform4f(colorLoc, obj->color.x, obj->color.y, obj->color.z, obj->color.w);
 
     if (obj->object.useTexture && texturesEnabled) {
-        glBindTexture(GL_TEXTURE_2D, obj->object.textureID);
+        stateActiveTexture(GL_TEXTURE0);
+        stateBindTexture(GL_TEXTURE_2D, obj->object.textureID);
     }
 
     if (usePBR && obj->object.usePBR) {
-        bindPBRMaterial(obj->object.material);
+        const PBRMaterial* material = &obj->object.material;
+        bool packed = material->arraySlab >= 0 && material->arraySlab < materialSlabCount;
+        glUniform1i(glGetUniformLocation(shaderProgram, "useMaterialArrays"), packed);
+        if (packed) {
+            // Same slab as the previous object means no texture rebinds, only a new layer
+            bindPBRMaterialSlab(material->arraySlab);
+            glVertexAttribI1i(MATERIAL_LAYER_ATTRIB, material->arrayLayer);
+        }
+        else {
+            bindPBRMaterial(*material);
+        }
     }
 }
 
-// In the render() function in rendering.c, modify the rendering pipeline:
-void render() {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    Matrix4x4 projMatrix = getProjectionMatrix(45.0f, (float)screen.width / screen.height, 0.1f, 100.0f);
-    Matrix4x4 viewMatrix = getViewMatrix(&camera);
-
-    // First pass: Render shadow maps
-    if (shadowsEnabled && shadowSystem && shadowSystem->enableShadows) {
-        updateShadowMaps();
-        renderShadowMaps();
+// The commands setShaderUniforms and drawObject amount to, safe on any thread
+static void recordObject(CommandList* list, int slot, const LODView* lodView) {
+    SceneObject* obj = &objectManager.objects[slot];
+    ConstantsCommand constants;
+    constants.model = objectManager.modelMatrices[slot];
+    constants.color = obj->color;
+    constants.useTexture = texturesEnabled && obj->object.useTexture && !obj->object.usePBR;
+    constants.usePBR = usePBR && obj->object.usePBR;
+    constants.useColor = colorsEnabled && obj->object.useColor;
+    constants.useMaterialArrays = false;
+    constants.materialLayer = 0;
+
+    const PBRMaterial* material = &obj->object.material;
+    if (constants.usePBR) {
+        constants.useMaterialArrays = material->arraySlab >= 0 && material->arraySlab < materialSlabCount;
+        if (constants.useMaterialArrays) constants.materialLayer = material->arrayLayer;
+    }
+    unsigned int texture = obj->object.useTexture && texturesEnabled ? obj->object.textureID : 0;
+    int slab = constants.useMaterialArrays ? material->arraySlab : -1;
+
+    // Full-detail models submit only their visible meshlets
+    int level = selectObjectLOD(obj, &constants.model, lodView);
+    bool meshlets = level == 0 && canDrawModelMeshlets(obj);
+
+    // Objects with one draw and no per-object maps share instanced draws, the
+    // render key keeps equal ones next to each other
+    DrawCommand draw;
+    bool instanced = !meshlets && (!constants.usePBR || constants.useMaterialArrays) && getObjectLODDraw(obj, level, &draw);
+    if (instanced && joinInstancedDraw(list, &constants, &draw, texture, slab)) return;
+
+    if (texture) {
+        recordBind(list, 0, CMD_TEXTURE_2D, texture);
+    }
+
+    if (constants.usePBR) {
+        if (constants.useMaterialArrays) {
+            for (int m = 0; m < PBR_MAP_COUNT; m++) {
+                recordBind(list, PBR_ARRAY_TEXTURE_UNIT + m, CMD_TEXTURE_2D_ARRAY, materialSlabs[material->arraySlab].maps[m]);
+            }
+        }
+        else {
+            const GLuint maps[PBR_MAP_COUNT] = { material->albedoMap, material->normalMap, material->metallicMap, material->roughnessMap, material->aoMap };
+            for (int m = 0; m < PBR_MAP_COUNT; m++) {
+                recordBind(list, m, CMD_TEXTURE_2D, maps[m]);
+            }
+        }
+    }
+    if (instanced) {
+        recordDrawInstanced(list, &constants, &draw, texture, slab);
+        return;
     }
+    recordConstants(list, &constants);
 
-    // Draw skybox first if background is enabled
-    if (backgroundEnabled) {
-        glDepthFunc(GL_LEQUAL);
-        drawSkybox(&camera, &projMatrix);
-        glDepthFunc(GL_LESS);
+    if (meshlets) {
+        recordDrawIndirect(list, obj);
+    }
+    else {
+        recordObjectLOD(list, obj, level);
     }
+}
 
-    // Second pass: Render scene with shadows
-    glUseProgram(shaderProgram);
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &viewMatrix.data[0][0]);
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, &projMatrix.data[0][0]);
-    
-    // Update lighting uniforms
-    updateShaderLights();
-    glUniform3fv(glGetUniformLocation(shaderProgram, "viewPos"), 1, (const GLfloat*)&camera.Position);
-    glUniform1i(glGetUniformLocation(shaderProgram, "useLighting"), lightingEnabled);
-    glUniform1i(glGetUniformLocation(shaderProgram, "noShading"), !lightingEnabled);
+// Lights, camera position and shadows for any program built on shaders/common/lighting.glsl
+static void setFrameUniforms(GLuint program) {
+    stateUseProgram(program);
+    setLightUniforms(program);
+    glUniform3fv(glGetUniformLocation(program, "viewPos"), 1, (const GLfloat*)&camera.Position);
+    glUniform1i(glGetUniformLocation(program, "useLighting"), lightingEnabled);
+    glUniform1i(glGetUniformLocation(program, "noShading"), !lightingEnabled);
 
-    // Bind shadow maps and set shadow uniforms
     if (shadowsEnabled && shadowSystem && shadowSystem->enableShadows) {
-        bindShadowMapsForRendering();
-        setShadowUniforms(shaderProgram);
+        setShadowUniforms(program);
     } else {
         // Disable shadows in shader
-        GLint enableShadowsLoc = glGetUniformLocation(shaderProgram, "enableShadows");
+        GLint enableShadowsLoc = glGetUniformLocation(program, "enableShadows");
         if (enableShadowsLoc != -1) {
             glUniform1i(enableShadowsLoc, 0);
         }
     }
+}
+
+// State the passes of one frame share, filled in render() before the graph runs
+typedef struct {
+    Matrix4x4 viewMatrix;
+    Matrix4x4 projMatrix;
+    // Manager slots, sized with the manager by reserveFrameData
+    uint32_t* opaqueObjects;
+    uint32_t* transparentObjects;
+    int opaqueCount;
+    int transparentCount;
+    SortScratch opaqueSort, transparentSort;
+    int objectCapacity;
+    bool shadowsSampled;
+    FGResource oitAccumulation, oitRevealage, oitDepth;
+    FGResource reprojectionSource;
+
+    // One list per COMMAND_LIST_OBJECTS objects, recorded by the workers
+    LODView lodView;
+    CommandList* opaqueLists;
+    CommandList* transparentLists;
+    int opaqueListCount;
+    int transparentListCount;
+    int listCapacity;
+} FrameData;
+
+static FrameGraph frameGraph;
+static FrameData frame;
+
+static void clearPass(void* data) {
+    (void)data;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
 
-    // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
+static void shadowMapPass(void* data) {
+    (void)data;
+    updateShadowMaps();
+    renderShadowMaps();
+}
 
-    // Separate objects into opaque and transparent lists
-    SceneObject* opaqueObjects[MAX_OBJECTS];
-    SceneObject* transparentObjects[MAX_OBJECTS];
-    int opaqueCount = 0;
-    int transparentCount = 0;
+static void skyboxPass(void* data) {
+    FrameData* f = (FrameData*)data;
+    stateDepthFunc(GL_LEQUAL);
+    drawSkybox(&camera, &f->projMatrix);
+    stateDepthFunc(GL_LESS);
+}
 
-    for (int i = 0; i < objectManager.count; i++) {
-        SceneObject* obj = &objectManager.objects[i];
-        if (obj->color.w < 1.0f) {
-            transparentObjects[transparentCount++] = obj;
+// Camera matrices, lights and shadows for the object shader
+static void setObjectPassUniforms(const FrameData* f) {
+    stateUseProgram(shaderProgram);
+    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &f->viewMatrix.data[0][0]);
+    glUniformMatrix4fv(projLoc, 1, GL_FALSE, &f->projMatrix.data[0][0]);
+    if (f->shadowsSampled) {
+        bindShadowMapsForRendering();
+    }
+    setFrameUniforms(shaderProgram);
+    stateEnable(GL_DEPTH_TEST);
+    stateDepthFunc(GL_LESS);
+}
+
+static void replayCommandLists(const FrameData* f, const CommandList* lists, int count) {
+    for (int i = 0; i < count; i++) {
+        replayCommandList(&lists[i], shaderProgram, f->viewMatrix, f->projMatrix);
+    }
+}
+
+static void opaquePass(void* data) {
+    FrameData* f = (FrameData*)data;
+    setObjectPassUniforms(f);
+    replayCommandLists(f, f->opaqueLists, f->opaqueListCount);
+
+    // Static world geometry, a few draws per visible chunk
+    drawStaticBatches(f->viewMatrix, f->projMatrix);
+
+    // Plain primitives culled on the GPU, then ray traced spheres
+    drawGPUCulledObjects(f->viewMatrix, f->projMatrix);
+    if (getSphereImpostorProgram()) {
+        setFrameUniforms(getSphereImpostorProgram());
+        drawSphereImpostors(f->viewMatrix, f->projMatrix);
+    }
+}
+
+// This frame's depth for next frame's occlusion test
+static void depthPyramidPass(void* data) {
+    FrameData* f = (FrameData*)data;
+    buildDepthPyramid(f->viewMatrix, f->projMatrix, screen.width, screen.height);
+}
+
+static void sortedTransparentPass(void* data) {
+    FrameData* f = (FrameData*)data;
+    setObjectPassUniforms(f);
+    stateEnable(GL_BLEND);
+    stateBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    replayCommandLists(f, f->transparentLists, f->transparentListCount);
+    stateDisable(GL_BLEND);
+}
+
+static void transparentAccumulationPass(void* data) {
+    FrameData* f = (FrameData*)data;
+    setObjectPassUniforms(f);
+    beginWeightedTransparency(getFrameGraphTexture(&frameGraph, f->oitDepth), screen.width, screen.height);
+    replayCommandLists(f, f->transparentLists, f->transparentListCount);
+    endWeightedTransparency();
+}
+
+static void transparentCompositePass(void* data) {
+    FrameData* f = (FrameData*)data;
+    compositeWeightedTransparency(getFrameGraphTexture(&frameGraph, f->oitAccumulation),
+                                  getFrameGraphTexture(&frameGraph, f->oitRevealage));
+}
+
+static void loadedModelPass(void* data) {
+    (void)data;
+    for (unsigned int i = 0; i < model->meshCount; i++) {
+        drawMesh(&model->meshes[i]);
+    }
+}
+
+static void shadowDebugPass(void* data) {
+    (void)data;
+    debugRenderShadowMaps();
+}
+
+static void applyCursorMovement(GLFWwindow* window);
+
+// Latency mode reads the mouse again right before the view is used. Events
+// are not pumped here: key and resize callbacks would edit the scene and the
+// viewport while the frame's command lists still refer to them
+static void sampleLateInput(void) {
+    applyCursorMovement(screen.window);
+    refreshRenderCamera();  // The simulation thread queues the input rather than moving the camera
+    markInputSampled();
+}
+
+static void reprojectionCopyPass(void* data) {
+    (void)data;
+    stateBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, screen.width, screen.height, 0, 0, screen.width, screen.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
+
+// Mouse look that arrived while the frame was drawn rotates the finished image
+static void lateReprojectionPass(void* data) {
+    FrameData* f = (FrameData*)data;
+    sampleLateInput();
+    if (prepareReprojection(f->viewMatrix, getViewMatrix(&camera))) {
+        drawReprojection(getFrameGraphTexture(&frameGraph, f->reprojectionSource), f->projMatrix, screen.width, screen.height);
+    }
+}
+
+static void buildFrameGraph(FrameData* f) {
+    FrameGraph* graph = &frameGraph;
+    resetFrameGraph(graph);
+
+    FGResource window = importFrameGraphTarget(graph, "Window", 0, screen.width, screen.height, true);
+    FGResource shadowMaps = importFrameGraphExternal(graph, "Shadow Maps", false);
+    FGResource depthPyramid = importFrameGraphExternal(graph, "Depth Pyramid", true); // Read next frame
+    bool shadowSystemActive = shadowsEnabled && shadowSystem && shadowSystem->enableShadows;
+    // Unlit shading never samples the shadow maps, so their pass is culled
+    f->shadowsSampled = shadowSystemActive && lightingEnabled;
+
+    int pass = addFrameGraphPass(graph, "Clear", clearPass, f);
+    writeFrameGraphResource(graph, pass, window);
+
+    if (shadowSystemActive) {
+        pass = addFrameGraphPass(graph, "Shadow Maps", shadowMapPass, f);
+        writeFrameGraphResource(graph, pass, shadowMaps);
+    }
+
+    if (backgroundEnabled) {
+        pass = addFrameGraphPass(graph, "Skybox", skyboxPass, f);
+        writeFrameGraphResource(graph, pass, window);
+    }
+
+    pass = addFrameGraphPass(graph, "Opaque", opaquePass, f);
+    if (f->shadowsSampled) readFrameGraphResource(graph, pass, shadowMaps);
+    writeFrameGraphResource(graph, pass, window);
+
+    if (gpuCullingEnabled && gpuOcclusionEnabled) {
+        pass = addFrameGraphPass(graph, "Depth Pyramid", depthPyramidPass, f);
+        readFrameGraphResource(graph, pass, window);
+        writeFrameGraphResource(graph, pass, depthPyramid);
+    }
+
+    if (f->transparentCount > 0 && oitEnabled && isOITAvailable()) {
+        FGTextureDesc accumulation = { screen.width, screen.height, OIT_ACCUMULATION_FORMAT };
+        FGTextureDesc revealage = { screen.width, screen.height, OIT_REVEALAGE_FORMAT };
+        FGTextureDesc depth = { screen.width, screen.height, OIT_DEPTH_FORMAT };
+        f->oitAccumulation = createFrameGraphTexture(graph, "OIT Accumulation", accumulation);
+        f->oitRevealage = createFrameGraphTexture(graph, "OIT Revealage", revealage);
+        f->oitDepth = createFrameGraphTexture(graph, "OIT Depth", depth);
+
+        pass = addFrameGraphPass(graph, "Transparent Accumulation", transparentAccumulationPass, f);
+        readFrameGraphResource(graph, pass, window);
+        if (f->shadowsSampled) readFrameGraphResource(graph, pass, shadowMaps);
+        writeFrameGraphResource(graph, pass, f->oitAccumulation);
+        writeFrameGraphResource(graph, pass, f->oitRevealage);
+        writeFrameGraphResource(graph, pass, f->oitDepth);
+
+        pass = addFrameGraphPass(graph, "Transparent Composite", transparentCompositePass, f);
+        readFrameGraphResource(graph, pass, f->oitAccumulation);
+        readFrameGraphResource(graph, pass, f->oitRevealage);
+        writeFrameGraphResource(graph, pass, window);
+    }
+    else if (f->transparentCount > 0) {
+        pass = addFrameGraphPass(graph, "Transparent", sortedTransparentPass, f);
+        if (f->shadowsSampled) readFrameGraphResource(graph, pass, shadowMaps);
+        writeFrameGraphResource(graph, pass, window);
+    }
+
+    if (model) {
+        pass = addFrameGraphPass(graph, "Loaded Model", loadedModelPass, f);
+        writeFrameGraphResource(graph, pass, window);
+    }
+
+    if (shadowSystemActive && shadowSystem->showShadowMaps) {
+        pass = addFrameGraphPass(graph, "Shadow Debug", shadowDebugPass, f);
+        readFrameGraphResource(graph, pass, shadowMaps);
+        writeFrameGraphResource(graph, pass, window);
+    }
+
+    if (latencyMode.enabled && latencyMode.lateReprojection && isReprojectionAvailable()) {
+        FGTextureDesc source = { screen.width, screen.height, REPROJECTION_FORMAT };
+        f->reprojectionSource = createFrameGraphTexture(graph, "Reprojection Source", source);
+
+        pass = addFrameGraphPass(graph, "Reprojection Copy", reprojectionCopyPass, f);
+        readFrameGraphResource(graph, pass, window);
+        writeFrameGraphResource(graph, pass, f->reprojectionSource);
+
+        pass = addFrameGraphPass(graph, "Late Reprojection", lateReprojectionPass, f);
+        readFrameGraphResource(graph, pass, f->reprojectionSource);
+        writeFrameGraphResource(graph, pass, window);
+    }
+
+    compileFrameGraph(graph);
+}
+
+static void sortObjectLists(void* data, int begin, int end, int workerIndex) {
+    (void)workerIndex;
+    FrameData* f = (FrameData*)data;
+    for (int list = begin; list < end; list++) {
+        if (list == 0) {
+            sortByRenderKey(f->opaqueObjects, f->opaqueCount, &f->opaqueSort);
         }
         else {
-            opaqueObjects[opaqueCount++] = obj;
+            sortBackToFront(f->transparentObjects, f->transparentCount, &f->transparentSort);
         }
     }
+}
 
-    // Sort transparent objects by distance from the camera (farthest first)
-    qsort(transparentObjects, transparentCount, sizeof(SceneObject*), compareObjects);
+// Opaque lists come first in the range, then the transparent ones
+static void recordObjectLists(void* data, int begin, int end, int workerIndex) {
+    (void)workerIndex;
+    FrameData* f = (FrameData*)data;
+    for (int list = begin; list < end; list++) {
+        bool opaque = list < f->opaqueListCount;
+        int index = opaque ? list : list - f->opaqueListCount;
+        CommandList* commands = opaque ? &f->opaqueLists[index] : &f->transparentLists[index];
+        const uint32_t* objects = opaque ? f->opaqueObjects : f->transparentObjects;
+        int count = opaque ? f->opaqueCount : f->transparentCount;
+
+        clearCommandList(commands);
+        int last = (index + 1) * COMMAND_LIST_OBJECTS < count ? (index + 1) * COMMAND_LIST_OBJECTS : count;
+        for (int i = index * COMMAND_LIST_OBJECTS; i < last; i++) {
+            recordObject(commands, (int)objects[i], &f->lodView);
+        }
+    }
+}
 
-    // Render opaque objects first
-    for (int i = 0; i < opaqueCount; i++) {
-        SceneObject* obj = opaqueObjects[i];
-        setShaderUniforms(obj);
-        drawObject(obj, viewMatrix, projMatrix);
+static bool growSortScratch(SortScratch* scratch, int capacity) {
+    uint32_t** arrays[3] = { &scratch->keys, &scratch->scratchKeys, &scratch->scratchSlots };
+    for (int i = 0; i < 3; i++) {
+        uint32_t* grown = (uint32_t*)realloc(*arrays[i], capacity * sizeof(uint32_t));
+        if (!grown) return false;
+        *arrays[i] = grown;
     }
+    return true;
+}
 
-    // Render transparent objects last
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    for (int i = 0; i < transparentCount; i++) {
-        SceneObject* obj = transparentObjects[i];
-        setShaderUniforms(obj);
-        drawObject(obj, viewMatrix, projMatrix);
+static bool growCommandLists(CommandList** lists, int oldCapacity, int capacity) {
+    CommandList* grown = (CommandList*)realloc(*lists, capacity * sizeof(CommandList));
+    if (!grown) return false;
+    memset(grown + oldCapacity, 0, (capacity - oldCapacity) * sizeof(CommandList));
+    *lists = grown;
+    return true;
+}
+
+// Grows the per-object arrays with the manager, never shrinks them
+static bool reserveFrameData(FrameData* f, int objects) {
+    if (objects > f->objectCapacity) {
+        int capacity = objectManager.capacity > objects ? objectManager.capacity : objects;
+        uint32_t* opaque = (uint32_t*)realloc(f->opaqueObjects, capacity * sizeof(uint32_t));
+        if (opaque) f->opaqueObjects = opaque;
+        uint32_t* transparent = (uint32_t*)realloc(f->transparentObjects, capacity * sizeof(uint32_t));
+        if (transparent) f->transparentObjects = transparent;
+        if (!opaque || !transparent || !growSortScratch(&f->opaqueSort, capacity) || !growSortScratch(&f->transparentSort, capacity)) {
+            LOG_ERROR(LOG_RENDER, "Out of memory for %d objects in the frame lists", capacity);
+            return false;
+        }
+        f->objectCapacity = capacity;
     }
-    glDisable(GL_BLEND);
 
-    // Draw model's meshes if loaded
-    if (model) {
-        for (unsigned int i = 0; i < model->meshCount; i++) {
-            drawMesh(&model->meshes[i]);
+    int lists = (f->objectCapacity + COMMAND_LIST_OBJECTS - 1) / COMMAND_LIST_OBJECTS;
+    if (lists > f->listCapacity) {
+        // A failure halfway leaves zeroed unused lists behind, safe to grow again later
+        if (!growCommandLists(&f->opaqueLists, f->listCapacity, lists) ||
+            !growCommandLists(&f->transparentLists, f->listCapacity, lists)) {
+            return false;
         }
+        f->listCapacity = lists;
     }
+    return true;
+}
+
+static void freeFrameData(FrameData* f) {
+    for (int i = 0; i < f->listCapacity; i++) {
+        freeCommandList(&f->opaqueLists[i]);
+        freeCommandList(&f->transparentLists[i]);
+    }
+    SortScratch* sorts[2] = { &f->opaqueSort, &f->transparentSort };
+    for (int i = 0; i < 2; i++) {
+        free(sorts[i]->keys);
+        free(sorts[i]->scratchKeys);
+        free(sorts[i]->scratchSlots);
+    }
+    free(f->opaqueObjects);
+    free(f->transparentObjects);
+    free(f->opaqueLists);
+    free(f->transparentLists);
+    memset(f, 0, sizeof(*f));
+}
+
+// Sorting, LOD selection and uniform packing on the workers, the passes only replay
+static void recordFrameCommands(FrameData* f) {
+    parallelFor(2, 1, sortObjectLists, f);
 
-    // Debug render shadow maps if enabled
-    if (shadowsEnabled && shadowSystem && shadowSystem->showShadowMaps) {
-        debugRenderShadowMaps();
+    f->lodView = makeCameraLODView(f->viewMatrix, f->projMatrix);
+    f->opaqueListCount = (f->opaqueCount + COMMAND_LIST_OBJECTS - 1) / COMMAND_LIST_OBJECTS;
+    f->transparentListCount = (f->transparentCount + COMMAND_LIST_OBJECTS - 1) / COMMAND_LIST_OBJECTS;
+    parallelFor(f->opaqueListCount + f->transparentListCount, 1, recordObjectLists, f);
+}
+
+void prepareFrame(void) {
+    // The step's jobs count toward this frame
+    resetJobSystemStats();
+    resetEcsStats();
+
+    // Stream pending GPU uploads within the frame budget
+    processModelImports();
+    processUploads();
+}
+
+void render() {
+    resetLODStats();
+    resetMeshletStats();
+    resetGLStateStats();
+
+    // Matrices and bounds come from the last published step, keys every
+    // pass reads are refreshed here, then the special paths claim their objects
+    updateObjectColumns();
+
+    // Merge static objects before any pass draws them
+    updateStaticBatches();
+
+    if (latencyMode.enabled) sampleLateInput();
+    frame.projMatrix = getProjectionMatrix(45.0f, (float)screen.width / screen.height, 0.1f, 100.0f);
+    frame.viewMatrix = getViewMatrix(&camera);
+
+    // Spheres claimed as impostors first, the GPU-culled primitives take what is left
+    updateSphereImpostors(frame.viewMatrix, frame.projMatrix, screen.height);
+    updateGPUCulling();
+
+    // Separate objects into opaque and transparent lists, skipping those a special path claimed
+    const unsigned int claimed = OBJECT_FLAG_STATIC_BATCHED | OBJECT_FLAG_GPU_CULLED | OBJECT_FLAG_SPHERE_IMPOSTOR;
+    frame.opaqueCount = 0;
+    frame.transparentCount = 0;
+    if (!reserveFrameData(&frame, objectManager.count)) return;
+    for (int i = 0; i < objectManager.count; i++) {
+        unsigned int flags = objectManager.flags[i];
+        if (flags & claimed) continue;
+        if (flags & OBJECT_FLAG_TRANSPARENT) {
+            frame.transparentObjects[frame.transparentCount++] = (uint32_t)i;
+        }
+        else {
+            frame.opaqueObjects[frame.opaqueCount++] = (uint32_t)i;
+        }
     }
+
+    recordFrameCommands(&frame);
+    buildFrameGraph(&frame);
+    executeFrameGraph(&frameGraph);
+}
+
+const FrameGraphStats* getFrameGraphStats(void) {
+    return &frameGraph.stats;
 }
 
 double calculateDeltaTime() {
@@ -346,7 +783,7 @@ void update(double deltaTime) {
     }
 
     if (glfwGetKey(screen.window, GLFW_KEY_E) == GLFW_PRESS) {
-        printf("\nExiting...\n");
+        LOG_INFO(LOG_RENDER, "Exiting...");
         exit(EXIT_SUCCESS);
     }
 
@@ -375,7 +812,7 @@ void update(double deltaTime) {
     if (glfwGetKey(screen.window, GLFW_KEY_COMMA) == GLFW_PRESS && !shadowDebugPressed) {
         if (shadowSystem) {
             shadowSystem->showShadowMaps = !shadowSystem->showShadowMaps;
-            printf("Shadow debug view %s\n", shadowSystem->showShadowMaps ? "enabled" : "disabled");
+            LOG_INFO(LOG_RENDER, "Shadow debug view %s", shadowSystem->showShadowMaps ? "enabled" : "disabled");
         }
         shadowDebugPressed = true;
     }
@@ -397,16 +834,19 @@ void update(double deltaTime) {
         lightPressed2 = false;
     }
 
-    processKeyboardMovements(&camera, deltaTime);
+    processKeyboardMovements(deltaTime);  // Rigid bodies move in the simulation step
     #ifdef AUDIO_ENABLED
     updateAudioSystem();
+    updateAudioEmitters();
     setListenerPosition(&camera.Position);
     setListenerOrientation(&camera.Front, &camera.Up);
     #endif
 }
 
 
-void handleMouseInput(GLFWwindow* window, Camera* camera) {
+// Reads the cursor and turns the movement since the last read into camera
+// motion. Only queries GLFW, no events are dispatched, so it is safe mid-frame
+static void applyCursorMovement(GLFWwindow* window) {
     static double lastX = 0, lastY = 0;
     static bool firstMouse = true;
     double xpos, ypos;
@@ -425,23 +865,43 @@ void handleMouseInput(GLFWwindow* window, Camera* camera) {
     lastY = ypos;
 
     if (!isRunning) {
-        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-
         if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS && glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS) {
-            processMousePan(camera, xoffset, yoffset); // Adjust position in 3D space
+            panCamera(xoffset, yoffset); // Adjust position in 3D space
         }
         else if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
-            processMouseMovement(camera, xoffset, yoffset, true);
+            lookCamera(xoffset, yoffset);
         }
     }
     else {
-        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-        processMouseMovement(camera, xoffset, yoffset, true);
+        lookCamera(xoffset, yoffset);
     }
 }
 
+void handleMouseInput(GLFWwindow* window) {
+    glfwSetInputMode(window, GLFW_CURSOR, isRunning ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
+    applyCursorMovement(window);
+}
+
 void end() {
+    shutdownSimulation();
     cleanupObjects();
+    shutdownSceneSystems();
+    shutdownSceneGraph();
+    shutdownEcs();
+    cleanupStaticBatches();
+    cleanupPrimitiveLODs();
+    shutdownMeshletCulling();
+    shutdownGPUCulling();
+    shutdownSphereImpostors();
+    shutdownOIT();
+    shutdownLatency();
+    destroyFrameGraph(&frameGraph);
+    freeFrameData(&frame);
+    shutdownCommandLists();
+    shutdownUploadQueue();
+    cleanupModelRegistry();
+    shutdownThreadPool();
+    cleanupPBRMaterialArrays();
 
     if (shadowSystem) {
         shutdownShadowSystem();
@@ -31,6 +31,76 @@ char* readFile(const char* filePath) {
     return data;
 }
 
+#define SHADER_INCLUDE_DEPTH 8
+
+static bool appendSource(char** buffer, size_t* length, size_t* capacity, const char* text, size_t count) {
+    if (*length + count + 1 > *capacity) {
+        size_t grown = *capacity ? *capacity : 4096;
+        while (*length + count + 1 > grown) grown *= 2;
+        char* data = (char*)realloc(*buffer, grown);
+        if (!data) return false;
+        *buffer = data;
+        *capacity = grown;
+    }
+    memcpy(*buffer + *length, text, count);
+    *length += count;
+    (*buffer)[*length] = '\0';
+    return true;
+}
+
+// Replaces lines of the form #include "file" with that file, resolved next to the including one
+static char* expandIncludes(const char* filePath, int depth) {
+    if (depth > SHADER_INCLUDE_DEPTH) {
+        fprintf(stderr, "Shader includes nested too deep in: %s\n", filePath);
+        return NULL;
+    }
+    char* source = readFile(filePath);
+    if (!source) return NULL;
+
+    char* buffer = NULL;
+    size_t length = 0, capacity = 0;
+    bool ok = true;
+    const char* line = source;
+    while (ok && *line) {
+        const char* next = strchr(line, '\n');
+        size_t lineLength = next ? (size_t)(next - line) + 1 : strlen(line);
+
+        const char* cursor = line;
+        while (*cursor == ' ' || *cursor == '\t') cursor++;
+        const char* nameStart = strncmp(cursor, "#include", 8) == 0 ? strchr(cursor, '"') : NULL;
+        const char* nameEnd = nameStart && nameStart < line + lineLength ? strchr(nameStart + 1, '"') : NULL;
+        if (nameEnd && nameEnd < line + lineLength) {
+            char includePath[512];
+            const char* slash = strrchr(filePath, '/');
+            int directoryLength = slash ? (int)(slash - filePath) + 1 : 0;
+            snprintf(includePath, sizeof(includePath), "%.*s%.*s", directoryLength, filePath,
+                     (int)(nameEnd - nameStart - 1), nameStart + 1);
+
+            char* included = expandIncludes(includePath, depth + 1);
+            ok = included && appendSource(&buffer, &length, &capacity, included, strlen(included)) &&
+                 appendSource(&buffer, &length, &capacity, "\n", 1);
+            free(included);
+        }
+        else {
+            ok = appendSource(&buffer, &length, &capacity, line, lineLength);
+        }
+        line += lineLength;
+    }
+
+    free(source);
+    if (!ok || !buffer) {
+        if (ok) fprintf(stderr, "Empty shader source: %s\n", filePath);
+        free(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+// Shader source with its #include "file" lines expanded, free() it
+char* readShaderSource(const char* filePath) {
+    return expandIncludes(filePath, 0);
+}
+
 // Function to check and log shader and program compilation/linking errors
 bool checkCompileErrors(unsigned int shader, const char* type) {
     int success;
@@ -56,8 +126,8 @@ bool checkCompileErrors(unsigned int shader, const char* type) {
 
 // Function to load and compile shaders, and link them into a program
 unsigned int loadShader(const char* vertexPath, const char* fragmentPath) {
-    char* vShaderCode = readFile(vertexPath);
-    char* fShaderCode = readFile(fragmentPath);
+    char* vShaderCode = readShaderSource(vertexPath);
+    char* fShaderCode = readShaderSource(fragmentPath);
     if (!vShaderCode || !fShaderCode) {
         if (vShaderCode) free(vShaderCode);
         if (fShaderCode) free(fShaderCode);
@@ -105,3 +175,28 @@ unsigned int loadShader(const char* vertexPath, const char* fragmentPath) {
 
     return shaderProgram;
 }
+
+// Compute programs need GL 4.3, returns 0 when the source is missing or fails to build
+unsigned int loadComputeShader(const char* computePath) {
+    char* cShaderCode = readShaderSource(computePath);
+    if (!cShaderCode) return 0;
+
+    unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, (const GLchar* const*)&cShaderCode, NULL);
+    glCompileShader(compute);
+    free(cShaderCode);
+    if (!checkCompileErrors(compute, "COMPUTE")) {
+        glDeleteShader(compute);
+        return 0;
+    }
+
+    unsigned int shaderProgram = glCreateProgram();
+    glAttachShader(shaderProgram, compute);
+    glLinkProgram(shaderProgram);
+    glDeleteShader(compute);
+    if (!checkCompileErrors(shaderProgram, "PROGRAM")) {
+        glDeleteProgram(shaderProgram);
+        return 0;
+    }
+    return shaderProgram;
+}
@@ -1,7 +1,9 @@
 #include "shadow_system.h"
 #include "shaders.h"
 #include "ObjectManager.h"
+#include "static_batch.h"
 #include "globals.h"
+#include "gl_state.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -96,11 +98,11 @@ void shutdownShadowSystem() {
 bool createShadowFramebuffer(GLuint* framebuffer, GLuint* depthTexture, int size) {
     // Create framebuffer
     glGenFramebuffers(1, framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, *framebuffer);
+    stateBindFramebuffer(GL_FRAMEBUFFER, *framebuffer);
 
     // Create depth texture
     glGenTextures(1, depthTexture);
-    glBindTexture(GL_TEXTURE_2D, *depthTexture);
+    stateBindTexture(GL_TEXTURE_2D, *depthTexture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
     
     // Set texture parameters
@@ -123,23 +125,23 @@ bool createShadowFramebuffer(GLuint* framebuffer, GLuint* depthTexture, int size
     // Check framebuffer completeness
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
         printf("Shadow framebuffer is not complete!\n");
-        glDeleteFramebuffers(1, framebuffer);
-        glDeleteTextures(1, depthTexture);
+        stateDeleteFramebuffers(1, framebuffer);
+        stateDeleteTextures(1, depthTexture);
         return false;
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    stateBindFramebuffer(GL_FRAMEBUFFER, 0);
     return true;
 }
 
 bool createCubeShadowFramebuffer(GLuint* framebuffer, GLuint* depthCubemap, int size) {
     // Create framebuffer
     glGenFramebuffers(1, framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, *framebuffer);
+    stateBindFramebuffer(GL_FRAMEBUFFER, *framebuffer);
 
     // Create cube depth texture
     glGenTextures(1, depthCubemap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, *depthCubemap);
+    stateBindTexture(GL_TEXTURE_CUBE_MAP, *depthCubemap);
     
     for (int i = 0; i < 6; i++) {
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT24, 
@@ -160,12 +162,12 @@ bool createCubeShadowFramebuffer(GLuint* framebuffer, GLuint* depthCubemap, int
 
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
         printf("Cube shadow framebuffer is not complete!\n");
-        glDeleteFramebuffers(1, framebuffer);
-        glDeleteTextures(1, depthCubemap);
+        stateDeleteFramebuffers(1, framebuffer);
+        stateDeleteTextures(1, depthCubemap);
         return false;
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    stateBindFramebuffer(GL_FRAMEBUFFER, 0);
     return true;
 }
 
@@ -308,7 +310,7 @@ void destroyShadowMap(ShadowType type, int index) {
 Matrix4x4 calculateDirectionalLightMatrix(const Light* light) {
     // For directional lights, we create an orthographic projection
     float near_plane = 1.0f, far_plane = 7.5f;
-    float orthoSize = 10.0f;
+    float orthoSize = DIRECTIONAL_SHADOW_ORTHO_SIZE;
     
     // Initialize matrix properly
     Matrix4x4 lightProjection = {0}; // Initialize to zero first
@@ -393,16 +395,17 @@ void renderDirectionalShadow(int shadowIndex) {
 
     // Calculate light space matrix
     shadowMap->lightSpaceMatrix = calculateDirectionalLightMatrix(light);
+    LODView lodView = makeLODView(light->position, 2.0f / DIRECTIONAL_SHADOW_ORTHO_SIZE, true, LOD_VIEW_DIRECTIONAL_SHADOW);
 
     // Render to shadow map
-    glViewport(0, 0, shadowMap->shadowMapSize, shadowMap->shadowMapSize);
-    glBindFramebuffer(GL_FRAMEBUFFER, shadowMap->framebuffer);
+    stateViewport(0, 0, shadowMap->shadowMapSize, shadowMap->shadowMapSize);
+    stateBindFramebuffer(GL_FRAMEBUFFER, shadowMap->framebuffer);
     glClear(GL_DEPTH_BUFFER_BIT);
 
     // Render scene from light's perspective
-    renderSceneToShadowMap(&shadowMap->lightSpaceMatrix);
+    renderSceneToShadowMap(&shadowMap->lightSpaceMatrix, &lodView);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    stateBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void renderPointShadow(int shadowIndex) {
@@ -419,8 +422,8 @@ void renderPointShadow(int shadowIndex) {
 
     // Render to cube shadow map
     int size = cubeShadowMapSizes[shadowSystem->shadowQuality];
-    glViewport(0, 0, size, size);
-    glBindFramebuffer(GL_FRAMEBUFFER, cubeShadowMap->framebuffer);
+    stateViewport(0, 0, size, size);
+    stateBindFramebuffer(GL_FRAMEBUFFER, cubeShadowMap->framebuffer);
 
     // Render each face of the cubemap
     for (int face = 0; face < 6; face++) {
@@ -432,7 +435,7 @@ void renderPointShadow(int shadowIndex) {
         renderSceneToCubeShadowMap(&cubeShadowMap->lightPosition, cubeShadowMap->farPlane);
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    stateBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void renderSpotShadow(int shadowIndex) {
@@ -444,79 +447,53 @@ void renderSpotShadow(int shadowIndex) {
 
     // Calculate light space matrix
     shadowMap->lightSpaceMatrix = calculateSpotLightMatrix(light);
+    // Half the spot cone is the half field of view of its projection
+    LODView lodView = makeLODView(light->position, 1.0f / tanf(acosf(light->cutOff)), false, LOD_VIEW_SPOT_SHADOW);
 
     // Render to shadow map
-    glViewport(0, 0, shadowMap->shadowMapSize, shadowMap->shadowMapSize);
-    glBindFramebuffer(GL_FRAMEBUFFER, shadowMap->framebuffer);
+    stateViewport(0, 0, shadowMap->shadowMapSize, shadowMap->shadowMapSize);
+    stateBindFramebuffer(GL_FRAMEBUFFER, shadowMap->framebuffer);
     glClear(GL_DEPTH_BUFFER_BIT);
 
     // Render scene from light's perspective
-    renderSceneToShadowMap(&shadowMap->lightSpaceMatrix);
+    renderSceneToShadowMap(&shadowMap->lightSpaceMatrix, &lodView);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    stateBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void renderSceneToShadowMap(const Matrix4x4* lightSpaceMatrix) {
-    glUseProgram(shadowSystem->shadowShader);
+void renderSceneToShadowMap(const Matrix4x4* lightSpaceMatrix, const LODView* lodView) {
+    stateUseProgram(shadowSystem->shadowShader);
     
     GLint lightSpaceMatrixLoc = glGetUniformLocation(shadowSystem->shadowShader, "lightSpaceMatrix");
     glUniformMatrix4fv(lightSpaceMatrixLoc, 1, GL_FALSE, &lightSpaceMatrix->data[0][0]);
 
     // Enable back face culling to reduce peter panning
     glCullFace(GL_FRONT);
-    glEnable(GL_CULL_FACE);
+    stateEnable(GL_CULL_FACE);
 
     // Render all objects in the scene
     for (int i = 0; i < objectManager.count; i++) {
+        if (objectManager.flags[i] & OBJECT_FLAG_STATIC_BATCHED) continue; // Drawn with its chunk below
         SceneObject* obj = &objectManager.objects[i];
-        
-        // Calculate model matrix
-        Matrix4x4 modelMatrix = translateMatrix(obj->position);
-        modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.x, vector(1.0f, 0.0f, 0.0f)));
-        modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.y, vector(0.0f, 1.0f, 0.0f)));
-        modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.z, vector(0.0f, 0.0f, 1.0f)));
-        modelMatrix = matrixMultiply(modelMatrix, scaleMatrix(obj->scale));
-
+        Matrix4x4 modelMatrix = objectManager.modelMatrices[i];
         GLint modelLoc = glGetUniformLocation(shadowSystem->shadowShader, "model");
         glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &modelMatrix.data[0][0]);
 
-        // Draw the object (simplified - just geometry, no textures)
-        switch (obj->object.type) {
-            case OBJ_CUBE:
-                glBindVertexArray(obj->object.data.cube.vao);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-                break;
-            case OBJ_SPHERE:
-                glBindVertexArray(obj->object.data.sphere.vao);
-                glDrawElements(GL_TRIANGLES, obj->object.data.sphere.numIndices, GL_UNSIGNED_INT, 0);
-                break;
-            case OBJ_PYRAMID:
-                glBindVertexArray(obj->object.data.pyramid.vao);
-                glDrawElements(GL_TRIANGLES, 18, GL_UNSIGNED_INT, 0);
-                break;
-            case OBJ_CYLINDER:
-                glBindVertexArray(obj->object.data.cylinder.vao);
-                glDrawElements(GL_TRIANGLES, obj->object.data.cylinder.sectorCount * 12, GL_UNSIGNED_INT, 0);
-                break;
-            case OBJ_PLANE:
-                glBindVertexArray(obj->object.data.plane.vao);
-                glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-                break;
-            case OBJ_MODEL:
-                for (unsigned int j = 0; j < obj->object.data.model.meshCount; j++) {
-                    glBindVertexArray(obj->object.data.model.meshes[j].VAO);
-                    glDrawElements(GL_TRIANGLES, obj->object.data.model.meshes[j].numIndices, GL_UNSIGNED_INT, 0);
-                }
-                break;
-        }
+        // Geometry only, at the level this light sees it
+        drawObjectLOD(obj, selectObjectLOD(obj, &modelMatrix, lodView), lodView->slot);
     }
 
-    glDisable(GL_CULL_FACE);
-    glBindVertexArray(0);
+    // Static chunks are already in world space
+    Matrix4x4 identity = identityMatrix();
+    glUniformMatrix4fv(glGetUniformLocation(shadowSystem->shadowShader, "model"), 1, GL_FALSE, &identity.data[0][0]);
+    drawStaticBatchGeometry();
+
+    stateDisable(GL_CULL_FACE);
+    stateBindVertexArray(0);
 }
 
 void renderSceneToCubeShadowMap(const Vector3* lightPos, float farPlane) {
-    glUseProgram(shadowSystem->pointShadowShader);
+    stateUseProgram(shadowSystem->pointShadowShader);
     
     GLint lightPosLoc = glGetUniformLocation(shadowSystem->pointShadowShader, "lightPos");
     GLint farPlaneLoc = glGetUniformLocation(shadowSystem->pointShadowShader, "far_plane");
@@ -524,51 +501,25 @@ void renderSceneToCubeShadowMap(const Vector3* lightPos, float farPlane) {
     glUniform3f(lightPosLoc, lightPos->x, lightPos->y, lightPos->z);
     glUniform1f(farPlaneLoc, farPlane);
 
+    // Each face has a 90 degree frustum, cot(45) is 1
+    LODView lodView = makeLODView(*lightPos, 1.0f, false, LOD_VIEW_POINT_SHADOW);
+
     // Render scene (similar to renderSceneToShadowMap but for point lights)
     for (int i = 0; i < objectManager.count; i++) {
+        if (objectManager.flags[i] & OBJECT_FLAG_STATIC_BATCHED) continue; // Drawn with its chunk below
         SceneObject* obj = &objectManager.objects[i];
-        
-        Matrix4x4 modelMatrix = translateMatrix(obj->position);
-        modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.x, vector(1.0f, 0.0f, 0.0f)));
-        modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.y, vector(0.0f, 1.0f, 0.0f)));
-        modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.z, vector(0.0f, 0.0f, 1.0f)));
-        modelMatrix = matrixMultiply(modelMatrix, scaleMatrix(obj->scale));
-
+        Matrix4x4 modelMatrix = objectManager.modelMatrices[i];
         GLint modelLoc = glGetUniformLocation(shadowSystem->pointShadowShader, "model");
         glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &modelMatrix.data[0][0]);
 
-        // Draw object
-        switch (obj->object.type) {
-            case OBJ_CUBE:
-                glBindVertexArray(obj->object.data.cube.vao);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-                break;
-            case OBJ_SPHERE:
-                glBindVertexArray(obj->object.data.sphere.vao);
-                glDrawElements(GL_TRIANGLES, obj->object.data.sphere.numIndices, GL_UNSIGNED_INT, 0);
-                break;
-            case OBJ_PYRAMID:
-                glBindVertexArray(obj->object.data.pyramid.vao);
-                glDrawElements(GL_TRIANGLES, 18, GL_UNSIGNED_INT, 0);
-                break;
-            case OBJ_CYLINDER:
-                glBindVertexArray(obj->object.data.cylinder.vao);
-                glDrawElements(GL_TRIANGLES, obj->object.data.cylinder.sectorCount * 12, GL_UNSIGNED_INT, 0);
-                break;
-            case OBJ_PLANE:
-                glBindVertexArray(obj->object.data.plane.vao);
-                glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-                break;
-            case OBJ_MODEL:
-                for (unsigned int j = 0; j < obj->object.data.model.meshCount; j++) {
-                    glBindVertexArray(obj->object.data.model.meshes[j].VAO);
-                    glDrawElements(GL_TRIANGLES, obj->object.data.model.meshes[j].numIndices, GL_UNSIGNED_INT, 0);
-                }
-                break;
-        }
+        drawObjectLOD(obj, selectObjectLOD(obj, &modelMatrix, &lodView), LOD_VIEW_POINT_SHADOW);
     }
 
-    glBindVertexArray(0);
+    Matrix4x4 identity = identityMatrix();
+    glUniformMatrix4fv(glGetUniformLocation(shadowSystem->pointShadowShader, "model"), 1, GL_FALSE, &identity.data[0][0]);
+    drawStaticBatchGeometry();
+
+    stateBindVertexArray(0);
 }
 
 void updateShadowMaps() {
@@ -626,9 +577,7 @@ void updateShadowMaps() {
 void renderShadowMaps() {
     if (!shadowSystem || !shadowSystem->enableShadows) return;
 
-    // Store original viewport
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
+    // Each map sets its own framebuffer and viewport, the frame graph rebinds the next pass's target
 
     // Render directional shadow maps
     for (int i = 0; i < MAX_SHADOW_MAPS; i++) {
@@ -650,9 +599,6 @@ void renderShadowMaps() {
             renderSpotShadow(i);
         }
     }
-
-    // Restore original viewport
-    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 }
 
 
@@ -665,8 +611,8 @@ void bindShadowMapsForRendering() {
     // Bind directional shadow maps to individual samplers
     for (int i = 0; i < MAX_SHADOW_MAPS; i++) {
         if (shadowSystem->directionalShadows[i] && shadowSystem->directionalShadows[i]->isActive) {
-            glActiveTexture(GL_TEXTURE0 + textureUnit + shadowMapIndex);
-            glBindTexture(GL_TEXTURE_2D, shadowSystem->directionalShadows[i]->depthTexture);
+            stateActiveTexture(GL_TEXTURE0 + textureUnit + shadowMapIndex);
+            stateBindTexture(GL_TEXTURE_2D, shadowSystem->directionalShadows[i]->depthTexture);
             shadowMapIndex++;
         }
     }
@@ -674,8 +620,8 @@ void bindShadowMapsForRendering() {
     // Bind spot shadow maps to individual samplers
     for (int i = 0; i < MAX_SHADOW_MAPS; i++) {
         if (shadowSystem->spotShadows[i] && shadowSystem->spotShadows[i]->isActive) {
-            glActiveTexture(GL_TEXTURE0 + textureUnit + shadowMapIndex);
-            glBindTexture(GL_TEXTURE_2D, shadowSystem->spotShadows[i]->depthTexture);
+            stateActiveTexture(GL_TEXTURE0 + textureUnit + shadowMapIndex);
+            stateBindTexture(GL_TEXTURE_2D, shadowSystem->spotShadows[i]->depthTexture);
             shadowMapIndex++;
         }
     }
@@ -684,8 +630,8 @@ void bindShadowMapsForRendering() {
     int pointShadowIndex = 0;
     for (int i = 0; i < MAX_SHADOW_MAPS; i++) {
         if (shadowSystem->pointShadows[i] && shadowSystem->pointShadows[i]->isActive) {
-            glActiveTexture(GL_TEXTURE0 + textureUnit + 8 + pointShadowIndex); // Start point shadows at unit 18
-            glBindTexture(GL_TEXTURE_CUBE_MAP, shadowSystem->pointShadows[i]->depthCubemap);
+            stateActiveTexture(GL_TEXTURE0 + textureUnit + 8 + pointShadowIndex); // Start point shadows at unit 18
+            stateBindTexture(GL_TEXTURE_CUBE_MAP, shadowSystem->pointShadows[i]->depthCubemap);
             pointShadowIndex++;
         }
     }
@@ -694,7 +640,7 @@ void bindShadowMapsForRendering() {
 void setShadowUniforms(GLuint shader) {
     if (!shadowSystem || !shadowSystem->enableShadows) return;
 
-    glUseProgram(shader);
+    stateUseProgram(shader);
 
     // Set shadow bias
     GLint shadowBiasLoc = glGetUniformLocation(shader, "shadowBias");
@@ -795,12 +741,12 @@ void debugRenderShadowMaps() {
 
     // Simple debug rendering - display shadow maps as quads on screen
     // This is a basic implementation, can be enhanced with proper UI
-    glUseProgram(shadowSystem->debugShader);
+    stateUseProgram(shadowSystem->debugShader);
     
     // Render first directional shadow map if available
     if (shadowSystem->directionalShadows[0] && shadowSystem->directionalShadows[0]->isActive) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, shadowSystem->directionalShadows[0]->depthTexture);
+        stateActiveTexture(GL_TEXTURE0);
+        stateBindTexture(GL_TEXTURE_2D, shadowSystem->directionalShadows[0]->depthTexture);
         
         GLint textureLoc = glGetUniformLocation(shadowSystem->debugShader, "depthMap");
         if (textureLoc != -1) {
@@ -816,10 +762,10 @@ void cleanupShadowMap(ShadowMap* shadowMap) {
     if (!shadowMap) return;
     
     if (shadowMap->framebuffer) {
-        glDeleteFramebuffers(1, &shadowMap->framebuffer);
+        stateDeleteFramebuffers(1, &shadowMap->framebuffer);
     }
     if (shadowMap->depthTexture) {
-        glDeleteTextures(1, &shadowMap->depthTexture);
+        stateDeleteTextures(1, &shadowMap->depthTexture);
     }
 }
 
@@ -827,9 +773,9 @@ void cleanupCubeShadowMap(CubeShadowMap* cubeShadowMap) {
     if (!cubeShadowMap) return;
     
     if (cubeShadowMap->framebuffer) {
-        glDeleteFramebuffers(1, &cubeShadowMap->framebuffer);
+        stateDeleteFramebuffers(1, &cubeShadowMap->framebuffer);
     }
     if (cubeShadowMap->depthCubemap) {
-        glDeleteTextures(1, &cubeShadowMap->depthCubemap);
+        stateDeleteTextures(1, &cubeShadowMap->depthCubemap);
     }
 }
\ No newline at end of file
@@ -0,0 +1,303 @@
+#include "sphere_impostor.h"
+#include "ObjectManager.h"
+#include "static_batch.h"
+#include "lod.h"
+#include "materials.h"
+#include "shaders.h"
+#include "globals.h"
+#include "gl_state.h"
+#include "log.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Index count of the 20x20 sphere addObject creates, for the triangle statistics
+#define SPHERE_MESH_INDICES ((20 - 1) * 20 * 6)
+
+// Matches the instanced attributes of sphere_vertex.glsl
+typedef struct {
+    float sphere[4];
+    float color[4];
+    float rotation[9];
+    int materialLayer;
+} ImpostorInstance;
+
+// Instances with the same shading and binding draw together: plain color, one texture, or one material slab
+typedef enum {
+    IMPOSTOR_PLAIN,
+    IMPOSTOR_TEXTURED,
+    IMPOSTOR_PBR
+} ImpostorShading;
+
+typedef struct {
+    ImpostorShading shading;
+    GLuint binding;     // Texture name or material slab
+    ImpostorInstance instance;
+} ImpostorEntry;
+
+bool sphereImpostorsEnabled = true;
+bool sphereImpostorsForced = false;
+
+static GLuint impostorProgram = 0;
+static GLuint impostorVAO = 0;
+static GLuint instanceBuffer = 0;
+
+// Sized to the object manager's capacity, the instance buffer to the most entries drawn
+static ImpostorEntry* entries = NULL;
+static ImpostorInstance* instances = NULL;
+static float* pixelRadius = NULL;
+static bool* inView = NULL;
+static int arrayCapacity = 0;
+static int entryCount = 0;
+static int bufferCapacity = 0;
+
+static SphereImpostorStats stats;
+
+bool initSphereImpostors(void) {
+    memset(&stats, 0, sizeof(stats));
+    impostorProgram = loadShader("shaders/impostors/sphere_vertex.glsl", "shaders/impostors/sphere_fragment.glsl");
+    if (!impostorProgram) {
+        LOG_WARN(LOG_RENDER, "Sphere impostors unavailable: failed to build their shaders");
+        return false;
+    }
+    setPBRSamplerUniforms(impostorProgram);
+
+    glGenVertexArrays(1, &impostorVAO);
+    glGenBuffers(1, &instanceBuffer);
+    stateBindVertexArray(impostorVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance), (void*)offsetof(ImpostorInstance, sphere));
+    glVertexAttribDivisor(0, 1);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance), (void*)offsetof(ImpostorInstance, color));
+    glVertexAttribDivisor(1, 1);
+    for (int column = 0; column < 3; column++) {
+        glEnableVertexAttribArray(2 + column);
+        glVertexAttribPointer(2 + column, 3, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance),
+                              (void*)(offsetof(ImpostorInstance, rotation) + column * 3 * sizeof(float)));
+        glVertexAttribDivisor(2 + column, 1);
+    }
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(5, 1, GL_INT, sizeof(ImpostorInstance), (void*)offsetof(ImpostorInstance, materialLayer));
+    glVertexAttribDivisor(5, 1);
+
+    stateBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+void shutdownSphereImpostors(void) {
+    if (impostorProgram) glDeleteProgram(impostorProgram);
+    if (instanceBuffer) glDeleteBuffers(1, &instanceBuffer);
+    if (impostorVAO) stateDeleteVertexArrays(1, &impostorVAO);
+    impostorProgram = instanceBuffer = impostorVAO = 0;
+    free(entries);
+    free(instances);
+    free(pixelRadius);
+    free(inView);
+    entries = NULL;
+    instances = NULL;
+    pixelRadius = NULL;
+    inView = NULL;
+    arrayCapacity = entryCount = bufferCapacity = 0;
+}
+
+GLuint getSphereImpostorProgram(void) {
+    return impostorProgram;
+}
+
+// Same decisions setShaderUniforms makes for the mesh, false when the impostor can't reproduce them
+static bool getShading(const SceneObject* obj, ImpostorShading* shading, GLuint* binding) {
+    *shading = IMPOSTOR_PLAIN;
+    *binding = 0;
+    if (usePBR && obj->object.usePBR) {
+        int slab = obj->object.material.arraySlab;
+        if (slab < 0 || slab >= materialSlabCount) return false;
+        *shading = IMPOSTOR_PBR;
+        *binding = (GLuint)slab;
+    }
+    else if (texturesEnabled && obj->object.useTexture) {
+        *shading = IMPOSTOR_TEXTURED;
+        *binding = (GLuint)obj->object.textureID;
+    }
+    return true;
+}
+
+static bool isImpostorEligible(const SceneObject* obj) {
+    if (obj->object.type != OBJ_SPHERE || obj->color.w < 1.0f) return false;
+    if (isObjectStaticBatched(obj)) return false;
+
+    // Only a uniformly scaled sphere is still a sphere
+    float minScale = fminf(fabsf(obj->scale.x), fminf(fabsf(obj->scale.y), fabsf(obj->scale.z)));
+    float maxScale = fmaxf(fabsf(obj->scale.x), fmaxf(fabsf(obj->scale.y), fabsf(obj->scale.z)));
+    return minScale > 0.0f && maxScale - minScale <= maxScale * 0.001f;
+}
+
+static void buildInstance(const SceneObject* obj, const Matrix4x4* modelMatrix, ImpostorShading shading, ImpostorInstance* instance) {
+    Matrix4x4 model = *modelMatrix;
+    float radius = fabsf(obj->scale.x); // addObject creates spheres with radius 1
+
+    instance->sphere[0] = model.data[3][0];
+    instance->sphere[1] = model.data[3][1];
+    instance->sphere[2] = model.data[3][2];
+    instance->sphere[3] = radius;
+    for (int column = 0; column < 3; column++) {
+        for (int row = 0; row < 3; row++) {
+            instance->rotation[column * 3 + row] = model.data[column][row] / radius;
+        }
+    }
+
+    // useColor off means white, as in the mesh shader
+    bool useColor = colorsEnabled && obj->object.useColor;
+    instance->color[0] = useColor ? obj->color.x : 1.0f;
+    instance->color[1] = useColor ? obj->color.y : 1.0f;
+    instance->color[2] = useColor ? obj->color.z : 1.0f;
+    instance->color[3] = obj->color.w;
+    instance->materialLayer = shading == IMPOSTOR_PBR ? obj->object.material.arrayLayer : 0;
+}
+
+static bool reserveImpostorArrays(int count) {
+    if (count <= arrayCapacity) return true;
+
+    ImpostorEntry* grownEntries = (ImpostorEntry*)realloc(entries, count * sizeof(ImpostorEntry));
+    if (grownEntries) entries = grownEntries;
+    ImpostorInstance* grownInstances = (ImpostorInstance*)realloc(instances, count * sizeof(ImpostorInstance));
+    if (grownInstances) instances = grownInstances;
+    float* grownRadius = (float*)realloc(pixelRadius, count * sizeof(float));
+    if (grownRadius) pixelRadius = grownRadius;
+    bool* grownInView = (bool*)realloc(inView, count * sizeof(bool));
+    if (grownInView) inView = grownInView;
+    if (!grownEntries || !grownInstances || !grownRadius || !grownInView) return false;
+
+    arrayCapacity = count;
+    return true;
+}
+
+static int compareEntries(const void* a, const void* b) {
+    const ImpostorEntry* entryA = (const ImpostorEntry*)a;
+    const ImpostorEntry* entryB = (const ImpostorEntry*)b;
+    if (entryA->shading != entryB->shading) return (entryA->shading > entryB->shading) - (entryA->shading < entryB->shading);
+    return (entryA->binding > entryB->binding) - (entryA->binding < entryB->binding);
+}
+
+void updateSphereImpostors(const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix, int viewportHeight) {
+    memset(&stats, 0, sizeof(stats));
+    entryCount = 0;
+    if (!impostorProgram || (!sphereImpostorsEnabled && !sphereImpostorsForced)) return;
+    if (!reserveImpostorArrays(objectManager.capacity)) return;
+
+    LODView view = makeCameraLODView(viewMatrix, projMatrix);
+    Matrix4x4 viewProj = matrixMultiply(viewMatrix, projMatrix);
+    float planes[6][4];
+    for (int p = 0; p < 6; p++) {
+        int row = p / 2;
+        float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+        for (int c = 0; c < 4; c++) planes[p][c] = viewProj.data[c][3] + sign * viewProj.data[c][row];
+        float length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        if (length > 0.0f) {
+            for (int c = 0; c < 4; c++) planes[p][c] /= length;
+        }
+    }
+
+    // First pass: which spheres could be impostors, how big they are and whether they are in view
+    int visibleSpheres = 0;
+    for (int i = 0; i < objectManager.count; i++) {
+        SceneObject* obj = &objectManager.objects[i];
+        ImpostorShading shading;
+        GLuint binding;
+        pixelRadius[i] = -1.0f;
+        if (!isImpostorEligible(obj) || !getShading(obj, &shading, &binding)) continue;
+
+        Vector3 center = vector(objectManager.bounds[i].x, objectManager.bounds[i].y, objectManager.bounds[i].z);
+        float radius = fabsf(obj->scale.x);
+        float distance = vector_length(vector_sub(center, view.eye));
+        if (distance - radius < SPHERE_IMPOSTOR_NEAR_MARGIN) continue;
+
+        inView[i] = true;
+        for (int p = 0; p < 6 && inView[i]; p++) {
+            float d = planes[p][0] * center.x + planes[p][1] * center.y + planes[p][2] * center.z + planes[p][3];
+            inView[i] = d >= -radius;
+        }
+        pixelRadius[i] = radius * view.projScale / distance * (float)viewportHeight * 0.5f;
+        stats.spheres++;
+        if (inView[i]) visibleSpheres++;
+    }
+
+    stats.countTriggered = visibleSpheres >= SPHERE_IMPOSTOR_AUTO_COUNT;
+    bool allSpheres = sphereImpostorsForced || stats.countTriggered;
+
+    for (int i = 0; i < objectManager.count; i++) {
+        if (pixelRadius[i] < 0.0f) continue;
+        if (!allSpheres && pixelRadius[i] >= SPHERE_IMPOSTOR_MAX_PIXELS) continue;
+
+        // Spheres outside the frustum are still claimed so the mesh path skips them too
+        objectManager.flags[i] |= OBJECT_FLAG_SPHERE_IMPOSTOR;
+        stats.impostors++;
+        if (!inView[i]) {
+            stats.culled++;
+            continue;
+        }
+        const SceneObject* obj = &objectManager.objects[i];
+        ImpostorEntry* entry = &entries[entryCount++];
+        getShading(obj, &entry->shading, &entry->binding);
+        buildInstance(obj, &objectManager.modelMatrices[i], entry->shading, &entry->instance);
+    }
+}
+
+void drawSphereImpostors(const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix) {
+    if (entryCount == 0) return;
+
+    qsort(entries, entryCount, sizeof(ImpostorEntry), compareEntries);
+    for (int i = 0; i < entryCount; i++) instances[i] = entries[i].instance;
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    if (entryCount > bufferCapacity) bufferCapacity = arrayCapacity;
+    glBufferData(GL_ARRAY_BUFFER, sizeof(instances[0]) * bufferCapacity, NULL, GL_STREAM_DRAW); // Orphan last frame's data
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(instances[0]) * entryCount, instances);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    stateUseProgram(impostorProgram);
+    glUniformMatrix4fv(glGetUniformLocation(impostorProgram, "view"), 1, GL_FALSE, &viewMatrix.data[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(impostorProgram, "projection"), 1, GL_FALSE, &projMatrix.data[0][0]);
+    GLint useTextureLoc = glGetUniformLocation(impostorProgram, "useTexture");
+    GLint usePBRLoc = glGetUniformLocation(impostorProgram, "usePBR");
+
+    stateBindVertexArray(impostorVAO);
+    int first = 0;
+    while (first < entryCount) {
+        ImpostorShading shading = entries[first].shading;
+        GLuint binding = entries[first].binding;
+        int last = first + 1;
+        while (last < entryCount && entries[last].shading == shading && entries[last].binding == binding) last++;
+
+        glUniform1i(useTextureLoc, shading == IMPOSTOR_TEXTURED);
+        glUniform1i(usePBRLoc, shading == IMPOSTOR_PBR);
+        if (shading == IMPOSTOR_TEXTURED) {
+            stateActiveTexture(GL_TEXTURE0);
+            stateBindTexture(GL_TEXTURE_2D, binding);
+        }
+        else if (shading == IMPOSTOR_PBR) {
+            bindPBRMaterialSlab((int)binding);
+        }
+
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, last - first, (GLuint)first);
+        stats.draws++;
+        first = last;
+    }
+    stateBindVertexArray(0);
+    stateUseProgram(shaderProgram);
+
+    recordLODTriangles(LOD_VIEW_CAMERA, 6 * (unsigned int)entryCount, SPHERE_MESH_INDICES * (unsigned int)entryCount);
+}
+
+bool isSphereImpostor(const SceneObject* obj) {
+    return hasObjectFlag(obj, OBJECT_FLAG_SPHERE_IMPOSTOR);
+}
+
+const SphereImpostorStats* getSphereImpostorStats(void) {
+    return &stats;
+}
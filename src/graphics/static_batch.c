@@ -0,0 +1,713 @@
+#include "static_batch.h"
+#include "ObjectManager.h"
+#include "model_registry.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "globals.h"
+#include "rendering.h"
+#include "gl_state.h"
+#include "log.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Same parameters addObject creates the primitives with
+#define SPHERE_SECTORS 20
+#define SPHERE_STACKS 20
+#define CYLINDER_SECTORS 20
+
+// A run of indices sharing one material inside a chunk
+typedef struct {
+    SceneObject material;   // First object of the run, supplies the shader state
+    GLsizei indexCount;
+    size_t indexOffset;     // In bytes
+} StaticBatch;
+
+typedef struct {
+    bool used;
+    bool built;
+    int coord[3];
+    uint64_t stateHash;     // Objects the buffers were built from
+    uint64_t pendingHash;   // Objects found in this frame's scan
+    int objectCount;
+    int pendingCount;
+    GLuint vao, vbo, ebo;
+    GLsizei totalIndices;
+    StaticBatch* batches;
+    int batchCount;
+    Vector3 boundsMin, boundsMax;
+} StaticChunk;
+
+// CPU copy of an imported model, mapped from its mesh cache. Holds a model
+// reference while static objects use it
+typedef struct {
+    Model* model;
+    uint64_t contentHash;   // The cache the mapping came from
+    ImportedModel geometry;
+    bool available;
+    unsigned int landed;    // getModelsLanded when a mapping failed, retried once it moves
+    int users;              // Static objects in the current scan
+} ModelGeometry;
+
+typedef struct {
+    StaticVertex* vertices;
+    unsigned int vertexCount;
+    unsigned int vertexCapacity;
+    unsigned int* indices;
+    unsigned int indexCount;
+    unsigned int indexCapacity;
+    Vector3 boundsMin, boundsMax;
+} GeometryBuilder;
+
+// Transform applied while appending, normals use the cofactor matrix
+typedef struct {
+    Matrix4x4 model;
+    float normal[3][3];
+    unsigned char color[4];
+    int materialLayer;
+} VertexTransform;
+
+bool staticBatchingEnabled = true;
+
+static StaticChunk chunks[STATIC_MAX_CHUNKS];
+static StaticBatchStats stats;
+
+// Per manager slot, only valid inside updateStaticBatches
+static int* objectChunk = NULL;
+static int* chunkSlots = NULL;
+static int objectChunkCapacity = 0;
+
+static ModelGeometry* modelGeometry = NULL;
+static int modelGeometryCount = 0;
+
+static bool mapModelGeometry(ModelGeometry* entry) {
+    // The import wrote the cache, so this is only a file mapping
+    entry->available = mapMeshCache(entry->model->path, entry->contentHash, &entry->geometry);
+    entry->landed = getModelsLanded();
+    if (!entry->available) {
+        LOG_DEBUG(LOG_RENDER, "Static batching: no mesh cache for %s, drawing it individually", entry->model->path);
+    }
+    return entry->available;
+}
+
+static void releaseModelGeometry(ModelGeometry* entry) {
+    if (entry->available) releaseImportedModel(&entry->geometry);
+    releaseModel(entry->model);
+}
+
+static ModelGeometry* findModelGeometry(const Model* model) {
+    uint64_t contentHash = getModelContentHash(model);
+    for (int i = 0; i < modelGeometryCount; i++) {
+        ModelGeometry* entry = &modelGeometry[i];
+        if (entry->model != model) continue;
+        if (entry->contentHash != contentHash) {
+            // Re-imported with other contents, the old mapping is of the wrong file
+            if (entry->available) releaseImportedModel(&entry->geometry);
+            entry->available = false;
+            entry->contentHash = contentHash;
+            mapModelGeometry(entry);
+        }
+        else if (!entry->available && entry->landed != getModelsLanded()) {
+            mapModelGeometry(entry);
+        }
+        return entry;
+    }
+
+    ModelGeometry* grown = (ModelGeometry*)realloc(modelGeometry, (modelGeometryCount + 1) * sizeof(ModelGeometry));
+    if (!grown) return NULL;
+    modelGeometry = grown;
+
+    ModelGeometry* entry = &modelGeometry[modelGeometryCount++];
+    memset(entry, 0, sizeof(*entry));
+    entry->model = (Model*)model;
+    entry->contentHash = contentHash;
+    retainModel(entry->model);
+    mapModelGeometry(entry);
+    return entry;
+}
+
+static const ImportedModel* getModelGeometry(const Model* model) {
+    const ModelGeometry* entry = findModelGeometry(model);
+    return entry && entry->available ? &entry->geometry : NULL;
+}
+
+// Entries no static object used in this scan go, with their model reference
+static void releaseUnusedModelGeometry(void) {
+    for (int i = modelGeometryCount - 1; i >= 0; i--) {
+        if (modelGeometry[i].users > 0) continue;
+        releaseModelGeometry(&modelGeometry[i]);
+        modelGeometry[i] = modelGeometry[--modelGeometryCount];
+    }
+}
+
+static bool isStaticBatchEligible(const SceneObject* obj) {
+    // Transparent objects need back-to-front sorting every frame
+    if (!obj->isStatic || obj->color.w < 1.0f) return false;
+
+    if (obj->object.type == OBJ_MODEL) {
+        const Model* model = obj->object.data.model;
+        if (!model || model->meshCount == 0) return false; // Still importing
+        ModelGeometry* entry = findModelGeometry(model);
+        if (!entry) return false;
+        entry->users++;  // Failed mappings count too, so they aren't retried every frame
+        return entry->available && entry->geometry.meshCount == model->meshCount;
+    }
+    return true;
+}
+
+static int findChunk(const int coord[3]) {
+    int freeSlot = -1;
+    for (int i = 0; i < STATIC_MAX_CHUNKS; i++) {
+        if (!chunks[i].used) {
+            if (freeSlot < 0) freeSlot = i;
+            continue;
+        }
+        if (chunks[i].coord[0] == coord[0] && chunks[i].coord[1] == coord[1] && chunks[i].coord[2] == coord[2]) {
+            return i;
+        }
+    }
+    if (freeSlot < 0) return -1;
+
+    StaticChunk* chunk = &chunks[freeSlot];
+    memset(chunk, 0, sizeof(*chunk));
+    chunk->used = true;
+    memcpy(chunk->coord, coord, sizeof(chunk->coord));
+    return freeSlot;
+}
+
+static void destroyChunk(StaticChunk* chunk) {
+    if (chunk->vao) stateDeleteVertexArrays(1, &chunk->vao);
+    if (chunk->vbo) glDeleteBuffers(1, &chunk->vbo);
+    if (chunk->ebo) glDeleteBuffers(1, &chunk->ebo);
+    free(chunk->batches);
+    memset(chunk, 0, sizeof(*chunk));
+}
+
+// Everything that ends up in the merged buffers, a change means a rebuild
+static uint64_t hashObjectState(const SceneObject* obj, int index) {
+    struct {
+        int id;
+        ObjectType type;
+        Matrix4x4 world;  // World, so a moved parent rebuilds its children's chunks
+        Vector4 color;
+        int textureID;
+        PBRMaterial material;
+        const Model* model;
+        unsigned int meshCount;
+        bool useTexture, usePBR, useColor;
+    } state;
+    memset(&state, 0, sizeof(state)); // Padding must hash the same every frame
+
+    state.id = obj->id;
+    state.type = obj->object.type;
+    state.world = objectManager.modelMatrices[index];
+    state.color = obj->color;
+    state.textureID = obj->object.textureID;
+    state.material = obj->object.material;
+    state.useTexture = obj->object.useTexture;
+    state.usePBR = obj->object.usePBR;
+    state.useColor = obj->object.useColor;
+    if (obj->object.type == OBJ_MODEL) {
+        state.model = obj->object.data.model;
+        state.meshCount = obj->object.data.model->meshCount;
+    }
+    return hashMemory(&state, sizeof(state));
+}
+
+// Objects that can share a draw end up next to each other
+static int compareMaterials(const SceneObject* a, const SceneObject* b) {
+    if (a->object.usePBR != b->object.usePBR) return a->object.usePBR ? 1 : -1;
+    if (a->object.usePBR) {
+        // Packed materials differ only by layer, which is per vertex here
+        int slabA = a->object.material.arraySlab, slabB = b->object.material.arraySlab;
+        if (slabA != slabB) return (slabA > slabB) - (slabA < slabB);
+        if (slabA < 0 && a->object.material.albedoMap != b->object.material.albedoMap) {
+            return (a->object.material.albedoMap > b->object.material.albedoMap) - (a->object.material.albedoMap < b->object.material.albedoMap);
+        }
+    }
+    if (a->object.useTexture != b->object.useTexture) return a->object.useTexture ? 1 : -1;
+    if (a->object.useTexture && a->object.textureID != b->object.textureID) {
+        return (a->object.textureID > b->object.textureID) - (a->object.textureID < b->object.textureID);
+    }
+    if (a->object.useColor != b->object.useColor) return a->object.useColor ? 1 : -1;
+    return 0;
+}
+
+static int compareObjectSlots(const void* a, const void* b) {
+    int result = compareMaterials(&objectManager.objects[*(const int*)a], &objectManager.objects[*(const int*)b]);
+    if (result != 0) return result;
+    return (*(const int*)a > *(const int*)b) - (*(const int*)a < *(const int*)b);
+}
+
+static void buildVertexTransform(const SceneObject* obj, VertexTransform* transform) {
+    transform->model = getObjectModelMatrix(obj);
+
+    // Upper 3x3 in column-vector form: m[row][col] = data[col][row]
+    float m[3][3];
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) m[r][c] = transform->model.data[c][r];
+    }
+
+    // Cofactors are the inverse transpose scaled by the determinant
+    float (*n)[3] = transform->normal;
+    n[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+    n[0][1] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+    n[0][2] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+    n[1][0] = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+    n[1][1] = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+    n[1][2] = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+    n[2][0] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+    n[2][1] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+    n[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+
+    float det = m[0][0] * n[0][0] + m[0][1] * n[0][1] + m[0][2] * n[0][2];
+    if (det < 0.0f) {
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) n[r][c] = -n[r][c];
+        }
+    }
+
+    const float channels[4] = { obj->color.x, obj->color.y, obj->color.z, obj->color.w };
+    for (int i = 0; i < 4; i++) {
+        float value = channels[i] < 0.0f ? 0.0f : (channels[i] > 1.0f ? 1.0f : channels[i]);
+        transform->color[i] = (unsigned char)lroundf(value * 255.0f);
+    }
+
+    bool packed = obj->object.usePBR && obj->object.material.arraySlab >= 0;
+    transform->materialLayer = packed ? obj->object.material.arrayLayer : 0;
+}
+
+static bool reserveGeometry(GeometryBuilder* builder, unsigned int vertexCount, unsigned int indexCount) {
+    if (builder->vertexCount + vertexCount > builder->vertexCapacity) {
+        unsigned int capacity = builder->vertexCapacity ? builder->vertexCapacity : 4096;
+        while (capacity < builder->vertexCount + vertexCount) capacity *= 2;
+        StaticVertex* grown = (StaticVertex*)realloc(builder->vertices, capacity * sizeof(StaticVertex));
+        if (!grown) return false;
+        builder->vertices = grown;
+        builder->vertexCapacity = capacity;
+    }
+    if (builder->indexCount + indexCount > builder->indexCapacity) {
+        unsigned int capacity = builder->indexCapacity ? builder->indexCapacity : 8192;
+        while (capacity < builder->indexCount + indexCount) capacity *= 2;
+        unsigned int* grown = (unsigned int*)realloc(builder->indices, capacity * sizeof(unsigned int));
+        if (!grown) return false;
+        builder->indices = grown;
+        builder->indexCapacity = capacity;
+    }
+    return true;
+}
+
+// Appends a float vertex stream with optional uv and normal offsets (-1 when
+// absent). Missing normals are rebuilt from the triangles.
+static bool appendGeometry(GeometryBuilder* builder, const VertexTransform* transform,
+                           const float* vertices, int stride, int uvOffset, int normalOffset, unsigned int vertexCount,
+                           const unsigned int* indices, unsigned int indexCount) {
+    if (!reserveGeometry(builder, vertexCount, indexCount)) return false;
+
+    float* faceNormals = NULL;
+    if (normalOffset < 0) {
+        faceNormals = (float*)calloc((size_t)vertexCount * 3, sizeof(float));
+        if (!faceNormals) return false;
+        for (unsigned int i = 0; i + 2 < indexCount; i += 3) {
+            const float* p0 = &vertices[indices[i] * stride];
+            const float* p1 = &vertices[indices[i + 1] * stride];
+            const float* p2 = &vertices[indices[i + 2] * stride];
+            Vector3 face = vector_cross(vector(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]),
+                                        vector(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]));
+            for (int k = 0; k < 3; k++) {
+                float* n = &faceNormals[indices[i + k] * 3];
+                n[0] += face.x;
+                n[1] += face.y;
+                n[2] += face.z;
+            }
+        }
+    }
+
+    unsigned int base = builder->vertexCount;
+    const Matrix4x4* m = &transform->model;
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        const float* src = &vertices[v * stride];
+        StaticVertex* dst = &builder->vertices[base + v];
+
+        for (int j = 0; j < 3; j++) {
+            dst->position[j] = m->data[0][j] * src[0] + m->data[1][j] * src[1] + m->data[2][j] * src[2] + m->data[3][j];
+        }
+
+        const float* normal = faceNormals ? &faceNormals[v * 3] : &src[normalOffset];
+        Vector3 world = vector(
+            transform->normal[0][0] * normal[0] + transform->normal[0][1] * normal[1] + transform->normal[0][2] * normal[2],
+            transform->normal[1][0] * normal[0] + transform->normal[1][1] * normal[1] + transform->normal[1][2] * normal[2],
+            transform->normal[2][0] * normal[0] + transform->normal[2][1] * normal[1] + transform->normal[2][2] * normal[2]);
+        float length = vector_length(world);
+        if (length > 0.0f) world = vector_scale(world, 1.0f / length);
+        dst->normal[0] = world.x;
+        dst->normal[1] = world.y;
+        dst->normal[2] = world.z;
+
+        dst->texCoord[0] = uvOffset >= 0 ? src[uvOffset] : 0.0f;
+        dst->texCoord[1] = uvOffset >= 0 ? src[uvOffset + 1] : 0.0f;
+        dst->materialLayer = transform->materialLayer;
+        memcpy(dst->color, transform->color, sizeof(dst->color));
+
+        Vector3 p = vector(dst->position[0], dst->position[1], dst->position[2]);
+        if (builder->vertexCount == 0 && v == 0) {
+            builder->boundsMin = builder->boundsMax = p;
+        } else {
+            builder->boundsMin = vector(fminf(builder->boundsMin.x, p.x), fminf(builder->boundsMin.y, p.y), fminf(builder->boundsMin.z, p.z));
+            builder->boundsMax = vector(fmaxf(builder->boundsMax.x, p.x), fmaxf(builder->boundsMax.y, p.y), fmaxf(builder->boundsMax.z, p.z));
+        }
+    }
+
+    for (unsigned int i = 0; i < indexCount; i++) {
+        builder->indices[builder->indexCount++] = base + indices[i];
+    }
+    builder->vertexCount += vertexCount;
+
+    free(faceNormals);
+    return true;
+}
+
+// Decodes the packed cache layout back to floats, then appends it
+static bool appendModelMesh(GeometryBuilder* builder, const VertexTransform* transform, const MeshData* mesh) {
+    float* vertices = (float*)malloc((size_t)mesh->numVertices * 8 * sizeof(float));
+    // Merged chunks always carry the full detail level
+    unsigned int indexCount = mesh->lodIndexCount[0];
+    unsigned int* indices = (unsigned int*)malloc((size_t)indexCount * sizeof(unsigned int));
+    bool appended = false;
+
+    if (vertices && indices) {
+        const PackedVertex* packed = (const PackedVertex*)mesh->vertices;
+        for (unsigned int v = 0; v < mesh->numVertices; v++) {
+            float* dst = &vertices[v * 8];
+            memcpy(dst, packed[v].position, 3 * sizeof(float));
+            for (int k = 0; k < 3; k++) dst[3 + k] = packed[v].normal[k] / 127.0f;
+            dst[6] = halfToFloat(packed[v].texCoords[0]);
+            dst[7] = halfToFloat(packed[v].texCoords[1]);
+        }
+        for (unsigned int i = 0; i < indexCount; i++) {
+            indices[i] = mesh->indexType == GL_UNSIGNED_SHORT ? ((const unsigned short*)mesh->indices)[i] : ((const unsigned int*)mesh->indices)[i];
+        }
+        appended = appendGeometry(builder, transform, vertices, 8, 6, 3, mesh->numVertices, indices, indexCount);
+    }
+
+    free(vertices);
+    free(indices);
+    return appended;
+}
+
+// Primitives are regenerated on the CPU with the layout their VAO uses
+static bool appendPrimitive(GeometryBuilder* builder, const VertexTransform* transform, ObjectType type) {
+    float vertices[(SPHERE_STACKS + 1) * (SPHERE_SECTORS + 1) * 8];
+    unsigned int indices[SPHERE_STACKS * SPHERE_SECTORS * 6];
+
+    switch (type) {
+    case OBJ_CUBE:
+        generateCubeVertices(vertices, indices, 1.0f);
+        return appendGeometry(builder, transform, vertices, 5, 3, -1, 24, indices, 36);
+    case OBJ_SPHERE:
+        generateSphereVertices(vertices, indices, 1.0f, SPHERE_SECTORS, SPHERE_STACKS);
+        // The poles emit one triangle per sector instead of two
+        return appendGeometry(builder, transform, vertices, 8, 6, 3, (SPHERE_STACKS + 1) * (SPHERE_SECTORS + 1),
+                              indices, (SPHERE_STACKS - 1) * SPHERE_SECTORS * 6);
+    case OBJ_PYRAMID:
+        generatePyramidVertices(vertices, indices, 1.0f, 1.0f);
+        return appendGeometry(builder, transform, vertices, 5, 3, -1, 5, indices, 18);
+    case OBJ_CYLINDER:
+        generateCylinderVertices(vertices, indices, 1.0f, 2.0f, CYLINDER_SECTORS);
+        return appendGeometry(builder, transform, vertices, 6, -1, 3, (CYLINDER_SECTORS + 1) * 2, indices, CYLINDER_SECTORS * 12);
+    case OBJ_PLANE:
+        generatePlaneVertices(vertices, indices);
+        return appendGeometry(builder, transform, vertices, 5, 3, -1, 4, indices, 6);
+    case OBJ_MODEL:
+        break;
+    }
+    return false;
+}
+
+static bool appendObject(GeometryBuilder* builder, const SceneObject* obj) {
+    VertexTransform transform;
+    buildVertexTransform(obj, &transform);
+
+    if (obj->object.type != OBJ_MODEL) return appendPrimitive(builder, &transform, obj->object.type);
+
+    const ImportedModel* geometry = getModelGeometry(obj->object.data.model);
+    if (!geometry) return false;
+    for (unsigned int i = 0; i < geometry->meshCount; i++) {
+        if (!geometry->meshes[i].vertices) continue;
+        if (!appendModelMesh(builder, &transform, &geometry->meshes[i])) return false;
+    }
+    return true;
+}
+
+bool buildPrimitiveGeometry(ObjectType type, StaticVertex** vertices, unsigned int* vertexCount,
+                            unsigned int** indices, unsigned int* indexCount) {
+    // Identity transform, white, no material layer
+    VertexTransform transform;
+    memset(&transform, 0, sizeof(transform));
+    transform.model = identityMatrix();
+    for (int i = 0; i < 3; i++) transform.normal[i][i] = 1.0f;
+    memset(transform.color, 255, sizeof(transform.color));
+
+    GeometryBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    if (!appendPrimitive(&builder, &transform, type)) {
+        free(builder.vertices);
+        free(builder.indices);
+        return false;
+    }
+
+    *vertices = builder.vertices;
+    *vertexCount = builder.vertexCount;
+    *indices = builder.indices;
+    *indexCount = builder.indexCount;
+    return true;
+}
+
+static bool uploadChunk(StaticChunk* chunk, const GeometryBuilder* builder) {
+    if (!chunk->vao) {
+        glGenVertexArrays(1, &chunk->vao);
+        glGenBuffers(1, &chunk->vbo);
+        glGenBuffers(1, &chunk->ebo);
+
+        stateBindVertexArray(chunk->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk->ebo);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, texCoord));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, normal));
+        glEnableVertexAttribArray(MATERIAL_LAYER_ATTRIB);
+        glVertexAttribIPointer(MATERIAL_LAYER_ATTRIB, 1, GL_INT, sizeof(StaticVertex), (void*)offsetof(StaticVertex, materialLayer));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, color));
+    } else {
+        stateBindVertexArray(chunk->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+    }
+
+    // Rebuilt chunks replace their storage, an edit shows up the same frame
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)builder->vertexCount * sizeof(StaticVertex), builder->vertices, GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)builder->indexCount * sizeof(unsigned int), builder->indices, GL_STATIC_DRAW);
+
+    stateBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+static void rebuildChunk(int chunkIndex) {
+    StaticChunk* chunk = &chunks[chunkIndex];
+    chunk->built = false;
+    chunk->batchCount = 0;
+    chunk->totalIndices = 0;
+
+    int* slots = chunkSlots;
+    int slotCount = 0;
+    for (int i = 0; i < objectManager.count; i++) {
+        if (objectChunk[i] == chunkIndex) slots[slotCount++] = i;
+    }
+    qsort(slots, slotCount, sizeof(int), compareObjectSlots);
+
+    StaticBatch* batches = (StaticBatch*)realloc(chunk->batches, slotCount * sizeof(StaticBatch));
+    if (!batches) return;
+    chunk->batches = batches;
+
+    GeometryBuilder builder = { 0 };
+    bool ok = true;
+    for (int i = 0; i < slotCount && ok; i++) {
+        const SceneObject* obj = &objectManager.objects[slots[i]];
+        unsigned int firstIndex = builder.indexCount;
+        ok = appendObject(&builder, obj);
+
+        // A new run starts whenever the material changes
+        if (chunk->batchCount == 0 || compareMaterials(&chunk->batches[chunk->batchCount - 1].material, obj) != 0) {
+            StaticBatch* batch = &chunk->batches[chunk->batchCount++];
+            batch->material = *obj;
+            batch->indexOffset = firstIndex * sizeof(unsigned int);
+            batch->indexCount = 0;
+        }
+        chunk->batches[chunk->batchCount - 1].indexCount += (GLsizei)(builder.indexCount - firstIndex);
+    }
+
+    if (ok && builder.indexCount > 0) {
+        ok = uploadChunk(chunk, &builder);
+    }
+    if (ok) {
+        chunk->built = true;
+        chunk->totalIndices = (GLsizei)builder.indexCount;
+        chunk->boundsMin = builder.boundsMin;
+        chunk->boundsMax = builder.boundsMax;
+    } else {
+        LOG_ERROR(LOG_RENDER, "Static batching: failed to build chunk (%d, %d, %d)", chunk->coord[0], chunk->coord[1], chunk->coord[2]);
+        chunk->batchCount = 0;
+    }
+
+    free(builder.vertices);
+    free(builder.indices);
+}
+
+static bool reserveObjectChunks(int count) {
+    if (count <= objectChunkCapacity) return true;
+
+    int* grownChunks = (int*)realloc(objectChunk, count * sizeof(int));
+    if (grownChunks) objectChunk = grownChunks;
+    int* grownSlots = (int*)realloc(chunkSlots, count * sizeof(int));
+    if (grownSlots) chunkSlots = grownSlots;
+    if (!grownChunks || !grownSlots) return false;
+
+    objectChunkCapacity = count;
+    return true;
+}
+
+void updateStaticBatches(void) {
+    // Without room to track chunks every object stays dynamic this frame
+    if (!reserveObjectChunks(objectManager.capacity)) return;
+
+    for (int c = 0; c < STATIC_MAX_CHUNKS; c++) {
+        chunks[c].pendingHash = 14695981039346656037ULL;
+        chunks[c].pendingCount = 0;
+    }
+
+    for (int i = 0; i < modelGeometryCount; i++) modelGeometry[i].users = 0;
+    stats.objects = 0;
+    for (int i = 0; i < objectManager.count; i++) {
+        const SceneObject* obj = &objectManager.objects[i];
+        objectChunk[i] = -1;
+        if (!staticBatchingEnabled || !isStaticBatchEligible(obj)) continue;
+
+        const float* origin = objectManager.modelMatrices[i].data[3];
+        int coord[3] = {
+            (int)floorf(origin[0] / STATIC_CHUNK_SIZE),
+            (int)floorf(origin[1] / STATIC_CHUNK_SIZE),
+            (int)floorf(origin[2] / STATIC_CHUNK_SIZE)
+        };
+        int chunkIndex = findChunk(coord);
+        if (chunkIndex < 0) continue; // Out of chunks, the object stays dynamic
+
+        StaticChunk* chunk = &chunks[chunkIndex];
+        chunk->pendingHash = (chunk->pendingHash ^ hashObjectState(obj, i)) * 1099511628211ULL;
+        chunk->pendingCount++;
+        objectChunk[i] = chunkIndex;
+        stats.objects++;
+    }
+
+    // Only chunks whose objects changed are rebuilt
+    stats.chunks = 0;
+    stats.batches = 0;
+    stats.rebuiltChunks = 0;
+    for (int c = 0; c < STATIC_MAX_CHUNKS; c++) {
+        StaticChunk* chunk = &chunks[c];
+        if (!chunk->used) continue;
+
+        if (chunk->pendingCount == 0) {
+            destroyChunk(chunk);
+            continue;
+        }
+
+        if (chunk->pendingHash != chunk->stateHash || chunk->pendingCount != chunk->objectCount) {
+            rebuildChunk(c);
+            chunk->stateHash = chunk->pendingHash;
+            chunk->objectCount = chunk->pendingCount;
+            stats.rebuiltChunks++;
+        }
+
+        stats.chunks++;
+        stats.batches += chunk->batchCount;
+    }
+
+    releaseUnusedModelGeometry();
+
+    // Claimed for the frame only where the chunk actually built
+    for (int i = 0; i < objectManager.count; i++) {
+        if (objectChunk[i] >= 0 && chunks[objectChunk[i]].built) {
+            objectManager.flags[i] |= OBJECT_FLAG_STATIC_BATCHED;
+        }
+    }
+}
+
+bool isObjectStaticBatched(const SceneObject* obj) {
+    return hasObjectFlag(obj, OBJECT_FLAG_STATIC_BATCHED);
+}
+
+// Rejects the box when it lies fully behind any frustum plane
+static bool isChunkVisible(const StaticChunk* chunk, const float planes[6][4]) {
+    for (int p = 0; p < 6; p++) {
+        float x = planes[p][0] >= 0.0f ? chunk->boundsMax.x : chunk->boundsMin.x;
+        float y = planes[p][1] >= 0.0f ? chunk->boundsMax.y : chunk->boundsMin.y;
+        float z = planes[p][2] >= 0.0f ? chunk->boundsMax.z : chunk->boundsMin.z;
+        if (planes[p][0] * x + planes[p][1] * y + planes[p][2] * z + planes[p][3] < 0.0f) return false;
+    }
+    return true;
+}
+
+void drawStaticBatches(const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix) {
+    stats.visibleChunks = 0;
+    if (stats.chunks == 0) return;
+
+    // Clip space rows of projection * view give the six frustum planes
+    Matrix4x4 viewProj = matrixMultiply(viewMatrix, projMatrix);
+    float planes[6][4];
+    for (int p = 0; p < 6; p++) {
+        int row = p / 2;
+        float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+        for (int c = 0; c < 4; c++) {
+            planes[p][c] = viewProj.data[c][3] + sign * viewProj.data[c][row];
+        }
+    }
+
+    stateUseProgram(shaderProgram);
+    Matrix4x4 identity = identityMatrix();
+    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, &identity.data[0][0]);
+    glUniform1i(glGetUniformLocation(shaderProgram, "useVertexColor"), 1);
+
+    for (int c = 0; c < STATIC_MAX_CHUNKS; c++) {
+        StaticChunk* chunk = &chunks[c];
+        if (!chunk->used || !chunk->built || chunk->totalIndices == 0) continue;
+        if (!isChunkVisible(chunk, planes)) continue;
+
+        stats.visibleChunks++;
+        stateBindVertexArray(chunk->vao);
+        for (int b = 0; b < chunk->batchCount; b++) {
+            StaticBatch* batch = &chunk->batches[b];
+            if (batch->indexCount == 0) continue;
+            setShaderUniforms(&batch->material);
+            glDrawElements(GL_TRIANGLES, batch->indexCount, GL_UNSIGNED_INT, (void*)batch->indexOffset);
+        }
+    }
+
+    stateBindVertexArray(0);
+    glUniform1i(glGetUniformLocation(shaderProgram, "useVertexColor"), 0);
+}
+
+void drawStaticBatchGeometry(void) {
+    for (int c = 0; c < STATIC_MAX_CHUNKS; c++) {
+        const StaticChunk* chunk = &chunks[c];
+        if (!chunk->used || !chunk->built || chunk->totalIndices == 0) continue;
+        stateBindVertexArray(chunk->vao);
+        glDrawElements(GL_TRIANGLES, chunk->totalIndices, GL_UNSIGNED_INT, 0);
+    }
+    stateBindVertexArray(0);
+}
+
+void cleanupStaticBatches(void) {
+    for (int c = 0; c < STATIC_MAX_CHUNKS; c++) {
+        if (chunks[c].used) destroyChunk(&chunks[c]);
+    }
+    for (int i = 0; i < modelGeometryCount; i++) releaseModelGeometry(&modelGeometry[i]);
+    free(modelGeometry);
+    modelGeometry = NULL;
+    modelGeometryCount = 0;
+    free(objectChunk);
+    free(chunkSlots);
+    objectChunk = NULL;
+    chunkSlots = NULL;
+    objectChunkCapacity = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+const StaticBatchStats* getStaticBatchStats(void) {
+    return &stats;
+}
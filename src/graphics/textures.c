@@ -1,5 +1,7 @@
 #include "textures.h"
-#include "SOIL2/SOIL2.h"
+#include "upload_queue.h"
+#include "gl_state.h"
+#include "log.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -20,31 +22,27 @@ GLuint getTexture(const char* name) {
             return textures[i];
         }
     }
-    fprintf(stderr, "Texture %s not found.\n", name);
+    LOG_ERROR(LOG_ASSETS, "Texture %s not found.", name);
     return 0;
 }
 
 
 GLuint loadTexture(const char* filename) {
-    GLuint textureID = SOIL_load_OGL_texture(
-        filename,
-        SOIL_LOAD_AUTO,
-        SOIL_CREATE_NEW_ID,
-        SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y | SOIL_FLAG_NTSC_SAFE_RGB | SOIL_FLAG_COMPRESS_TO_DXT
-    );
+    // Decoded on a worker and streamed in by the upload queue, the id is usable right away
+    GLuint textureID = requestTexture2D(filename, true, NULL, NULL);
 
     if (textureID == 0) {
-        fprintf(stderr, "Failed to load texture file %s: %s\n", filename, SOIL_last_result());
+        LOG_ERROR(LOG_ASSETS, "Failed to queue texture file %s", filename);
         return 0;
     }
 
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    stateBindTexture(GL_TEXTURE_2D, textureID);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    stateBindTexture(GL_TEXTURE_2D, 0);
 
-    fprintf(stderr, "Loaded texture %s, ID %u\n", filename, textureID);
     return textureID;
 }
 
@@ -63,11 +61,11 @@ void loadAllTextures() {
         if (i < MAX_TEXTURES) {
             textures[i] = loadTexture(textureFiles[i]);
             if (textures[i] == 0) {
-                fprintf(stderr, "Failed to load texture: %s\n", textureFiles[i]);
+                LOG_ERROR(LOG_ASSETS, "Failed to load texture: %s", textureFiles[i]);
             }
         }
         else {
-            fprintf(stderr, "Exceeded maximum texture limit of %d\n", MAX_TEXTURES);
+            LOG_ERROR(LOG_ASSETS, "Exceeded maximum texture limit of %d", MAX_TEXTURES);
             break;
         }
     }
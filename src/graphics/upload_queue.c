@@ -0,0 +1,627 @@
+#include "upload_queue.h"
+#include "thread_pool.h"
+#include "threading.h"
+#include "SOIL2/SOIL2.h"
+#include "SOIL2/image_DXT.h"
+#include "gl_state.h"
+#include "log.h"
+#include <GLFW/glfw3.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TEXTURE_FACES 6
+#define MAX_TEXTURE_LEVELS 16
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+typedef struct TextureLoad {
+    GLuint texture;
+    GLenum target;                 // GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP
+    int faceCount;
+    char paths[MAX_TEXTURE_FACES][512];
+    bool flipY;
+    unsigned char* pixels[MAX_TEXTURE_FACES];
+    int width[MAX_TEXTURE_FACES];
+    int height[MAX_TEXTURE_FACES];
+    GLenum format;                 // DXT internal format, 0 for plain RGBA8
+    unsigned char* blocks[MAX_TEXTURE_LEVELS]; // Compressed mip chain of a 2D texture
+    int blockBytes[MAX_TEXTURE_LEVELS];
+    int facesDecoded;              // Guarded by queueMutex
+    int uploadsPending;            // Requests still queued for this texture
+    GLsizei levels;
+    TextureReadyCallback done;
+    void* user;
+    struct TextureLoad* next;
+} TextureLoad;
+
+typedef struct {
+    TextureLoad* load;
+    int face;
+} DecodeTask;
+
+typedef enum {
+    UPLOAD_TEXTURE,
+    UPLOAD_BUFFER
+} UploadKind;
+
+typedef struct UploadRequest {
+    UploadKind kind;
+    size_t size;
+    size_t offset;                 // Bytes already staged
+    TextureLoad* load;
+    int face;
+    int level;
+    GLuint buffer;
+    const unsigned char* data;
+    BufferUploadCallback done;
+    void* user;
+    struct UploadRequest* next;
+} UploadRequest;
+
+typedef struct {
+    GLuint buffer;
+    GLsync fence;
+} StagingSlot;
+
+static StagingSlot slots[UPLOAD_STAGING_SLOTS];
+static int currentSlot = 0;
+static bool queueInitialized = false;
+static bool dxtSupported = false;   // Set before the first decode is submitted
+
+// Shared with decode workers
+static Mutex queueMutex;
+static Condition decodeCondition;
+static TextureLoad* decodedHead = NULL;
+static int decodesInFlight = 0;
+static bool decodesCancelled = false;
+
+// Render thread only
+static UploadRequest* requestHead = NULL;
+static UploadRequest* requestTail = NULL;
+static int requestCount = 0;
+static UploadStats stats;
+
+void initUploadQueue(void) {
+    if (queueInitialized) return;
+
+    initMutex(&queueMutex);
+    initCondition(&decodeCondition);
+    decodesCancelled = false;
+    dxtSupported = SOIL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc") != 0;
+
+    for (int i = 0; i < UPLOAD_STAGING_SLOTS; i++) {
+        glGenBuffers(1, &slots[i].buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slots[i].buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, UPLOAD_STAGING_SIZE, NULL, GL_STREAM_DRAW);
+        slots[i].fence = 0;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    memset(&stats, 0, sizeof(stats));
+    queueInitialized = true;
+}
+
+static void freeTextureLoad(TextureLoad* load) {
+    for (int i = 0; i < load->faceCount; i++) {
+        if (load->pixels[i]) SOIL_free_image_data(load->pixels[i]);
+    }
+    for (int i = 0; i < MAX_TEXTURE_LEVELS; i++) {
+        if (load->blocks[i]) SOIL_free_image_data(load->blocks[i]);
+    }
+    free(load);
+}
+
+void shutdownUploadQueue(void) {
+    if (!queueInitialized) return;
+
+    // Queued decodes bail out early, wait for the ones already running
+    lockMutex(&queueMutex);
+    decodesCancelled = true;
+    while (decodesInFlight > 0) {
+        waitCondition(&decodeCondition, &queueMutex);
+    }
+    while (decodedHead) {
+        TextureLoad* load = decodedHead;
+        decodedHead = load->next;
+        freeTextureLoad(load);
+    }
+    unlockMutex(&queueMutex);
+
+    while (requestHead) {
+        UploadRequest* request = requestHead;
+        requestHead = request->next;
+        // The last request of a texture owns the load
+        if (request->kind == UPLOAD_TEXTURE && --request->load->uploadsPending == 0) {
+            freeTextureLoad(request->load);
+        }
+        free(request);
+    }
+    requestTail = NULL;
+    requestCount = 0;
+
+    for (int i = 0; i < UPLOAD_STAGING_SLOTS; i++) {
+        if (slots[i].fence) glDeleteSync(slots[i].fence);
+        glDeleteBuffers(1, &slots[i].buffer);
+        slots[i].fence = 0;
+        slots[i].buffer = 0;
+    }
+
+    destroyCondition(&decodeCondition);
+    destroyMutex(&queueMutex);
+    queueInitialized = false;
+}
+
+static void flipRows(unsigned char* pixels, int width, int height) {
+    size_t rowBytes = (size_t)width * 4;
+    unsigned char* row = (unsigned char*)malloc(rowBytes);
+    if (!row) return;
+
+    for (int y = 0; y < height / 2; y++) {
+        unsigned char* top = pixels + y * rowBytes;
+        unsigned char* bottom = pixels + (height - 1 - y) * rowBytes;
+        memcpy(row, top, rowBytes);
+        memcpy(top, bottom, rowBytes);
+        memcpy(bottom, row, rowBytes);
+    }
+    free(row);
+}
+
+static int levelSize(int size, int level) {
+    size >>= level;
+    return size > 0 ? size : 1;
+}
+
+static int blockSize(GLenum format) {
+    return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+}
+
+// 2x2 box filter down to the next mip level
+static unsigned char* halveImage(const unsigned char* pixels, int width, int height) {
+    int halfWidth = levelSize(width, 1);
+    int halfHeight = levelSize(height, 1);
+    unsigned char* half = (unsigned char*)malloc((size_t)halfWidth * halfHeight * 4);
+    if (!half) return NULL;
+
+    for (int y = 0; y < halfHeight; y++) {
+        int y0 = y * 2 < height ? y * 2 : height - 1;
+        int y1 = y0 + 1 < height ? y0 + 1 : y0;
+        for (int x = 0; x < halfWidth; x++) {
+            int x0 = x * 2 < width ? x * 2 : width - 1;
+            int x1 = x0 + 1 < width ? x0 + 1 : x0;
+            for (int c = 0; c < 4; c++) {
+                int sum = pixels[((size_t)y0 * width + x0) * 4 + c] + pixels[((size_t)y0 * width + x1) * 4 + c]
+                        + pixels[((size_t)y1 * width + x0) * 4 + c] + pixels[((size_t)y1 * width + x1) * 4 + c];
+                half[((size_t)y * halfWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return half;
+}
+
+// Builds the mip chain and compresses every level, as SOIL_FLAG_COMPRESS_TO_DXT
+// did at load time: DXT1 for images without alpha, DXT5 otherwise.
+// Leaves the load as plain RGBA8 if any level fails.
+static bool compressTexture(TextureLoad* load, int channels) {
+    GLenum format = (channels & 1) ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    int largest = load->width[0] > load->height[0] ? load->width[0] : load->height[0];
+    int levels = (int)floor(log2((double)largest)) + 1;
+    if (levels > MAX_TEXTURE_LEVELS) return false;
+
+    const unsigned char* image = load->pixels[0];
+    bool ok = true;
+    for (int i = 0; i < levels && ok; i++) {
+        int width = levelSize(load->width[0], i);
+        int height = levelSize(load->height[0], i);
+        int size = 0;
+        load->blocks[i] = format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+            ? convert_image_to_DXT1(image, width, height, 4, &size)
+            : convert_image_to_DXT5(image, width, height, 4, &size);
+        load->blockBytes[i] = size;
+        ok = load->blocks[i] && size == ((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+
+        // Each level is filtered from the one above it
+        unsigned char* next = ok && i + 1 < levels ? halveImage(image, width, height) : NULL;
+        if (image != load->pixels[0]) free((void*)image);
+        if (ok && i + 1 < levels && !next) ok = false;
+        image = next;
+    }
+
+    if (!ok) {
+        for (int i = 0; i < MAX_TEXTURE_LEVELS; i++) {
+            if (load->blocks[i]) SOIL_free_image_data(load->blocks[i]);
+            load->blocks[i] = NULL;
+        }
+        return false;
+    }
+
+    // The RGBA copy is no longer needed once every level is compressed
+    load->format = format;
+    load->levels = levels;
+    SOIL_free_image_data(load->pixels[0]);
+    load->pixels[0] = NULL;
+    return true;
+}
+
+static void decodeTask(void* data, int workerIndex) {
+    (void)workerIndex;
+    DecodeTask* task = (DecodeTask*)data;
+    TextureLoad* load = task->load;
+    int face = task->face;
+    free(task);
+
+    lockMutex(&queueMutex);
+    bool cancelled = decodesCancelled;
+    unlockMutex(&queueMutex);
+
+    if (!cancelled) {
+        int channels;
+        load->pixels[face] = SOIL_load_image(load->paths[face], &load->width[face], &load->height[face], &channels, SOIL_LOAD_RGBA);
+        if (load->pixels[face] && load->flipY) {
+            flipRows(load->pixels[face], load->width[face], load->height[face]);
+        }
+        // Cubemaps stay uncompressed, as they were before streaming
+        if (load->pixels[face] && load->target == GL_TEXTURE_2D && dxtSupported) {
+            compressTexture(load, channels);
+        }
+    }
+
+    // The last face to finish hands the whole texture to the render thread
+    lockMutex(&queueMutex);
+    if (++load->facesDecoded == load->faceCount) {
+        load->next = decodedHead;
+        decodedHead = load;
+    }
+    decodesInFlight--;
+    broadcastCondition(&decodeCondition);
+    unlockMutex(&queueMutex);
+}
+
+static GLuint requestTexture(GLenum target, const char** paths, int faceCount, bool flipY, TextureReadyCallback done, void* user) {
+    if (!queueInitialized) initUploadQueue();
+
+    TextureLoad* load = (TextureLoad*)calloc(1, sizeof(TextureLoad));
+    if (!load) return 0;
+
+    glGenTextures(1, &load->texture);
+    load->target = target;
+    load->faceCount = faceCount;
+    load->flipY = flipY;
+    load->done = done;
+    load->user = user;
+    for (int i = 0; i < faceCount; i++) {
+        snprintf(load->paths[i], sizeof(load->paths[i]), "%s", paths[i]);
+    }
+
+    GLuint texture = load->texture;
+    for (int i = 0; i < faceCount; i++) {
+        DecodeTask* task = (DecodeTask*)malloc(sizeof(DecodeTask));
+        if (task) {
+            task->load = load;
+            task->face = i;
+        }
+
+        lockMutex(&queueMutex);
+        decodesInFlight++;
+        unlockMutex(&queueMutex);
+
+        if (!task || !submitTask(decodeTask, task)) {
+            // Count the face as decoded (and failed) so the load still completes
+            free(task);
+            lockMutex(&queueMutex);
+            decodesInFlight--;
+            if (++load->facesDecoded == load->faceCount) {
+                load->next = decodedHead;
+                decodedHead = load;
+            }
+            unlockMutex(&queueMutex);
+        }
+    }
+    return texture;
+}
+
+GLuint requestTexture2D(const char* path, bool flipY, TextureReadyCallback done, void* user) {
+    return requestTexture(GL_TEXTURE_2D, &path, 1, flipY, done, user);
+}
+
+GLuint requestCubemap(const char* faces[6], TextureReadyCallback done, void* user) {
+    return requestTexture(GL_TEXTURE_CUBE_MAP, faces, 6, false, done, user);
+}
+
+static void enqueueRequest(UploadRequest* request) {
+    request->next = NULL;
+    if (requestTail) requestTail->next = request;
+    else requestHead = request;
+    requestTail = request;
+    requestCount++;
+}
+
+bool queueBufferUpload(GLuint buffer, const void* data, size_t size, BufferUploadCallback done, void* user) {
+    if (!queueInitialized) initUploadQueue();
+    if (size == 0) {
+        if (done) done(user);
+        return true;
+    }
+
+    UploadRequest* request = (UploadRequest*)calloc(1, sizeof(UploadRequest));
+    if (!request) {
+        // Fall back to a direct upload rather than losing the data
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)size, data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        if (done) done(user);
+        return false;
+    }
+
+    request->kind = UPLOAD_BUFFER;
+    request->size = size;
+    request->buffer = buffer;
+    request->data = (const unsigned char*)data;
+    request->done = done;
+    request->user = user;
+    enqueueRequest(request);
+    return true;
+}
+
+static void finishTexture(TextureLoad* load, bool success) {
+    stateBindTexture(load->target, load->texture);
+    if (success && load->levels > 1 && !load->format) {
+        glGenerateMipmap(load->target);
+    }
+    stateBindTexture(load->target, 0);
+
+    if (success) {
+        LOG_DEBUG(LOG_ASSETS, "Loaded texture %s, ID %u", load->paths[0], load->texture);
+    }
+    if (load->done) {
+        load->done(load->texture, success, load->user);
+    }
+    freeTextureLoad(load);
+}
+
+// Allocates storage for a decoded texture and queues one request per face,
+// or per mip level of a compressed texture
+static void startTextureUpload(TextureLoad* load) {
+    bool valid = true;
+    for (int i = 0; i < load->faceCount; i++) {
+        if (!load->pixels[i] && !load->format) {
+            LOG_ERROR(LOG_ASSETS, "Failed to load texture file %s: %s", load->paths[i], SOIL_last_result());
+            valid = false;
+        } else if (load->width[i] != load->width[0] || load->height[i] != load->height[0]) {
+            LOG_ERROR(LOG_ASSETS, "Texture face %s does not match the size of %s", load->paths[i], load->paths[0]);
+            valid = false;
+        }
+    }
+
+    stateActiveTexture(GL_TEXTURE0);
+    stateBindTexture(load->target, load->texture);
+
+    if (!valid) {
+        // Give 2D textures a white 1x1 image so the id stays usable
+        if (load->target == GL_TEXTURE_2D && !load->done) {
+            const unsigned char white[4] = { 255, 255, 255, 255 };
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, 1, 1);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+        }
+        stateBindTexture(load->target, 0);
+        finishTexture(load, false);
+        return;
+    }
+
+    if (load->format) {
+        glTexStorage2D(GL_TEXTURE_2D, load->levels, load->format, load->width[0], load->height[0]);
+    } else {
+        int largest = load->width[0] > load->height[0] ? load->width[0] : load->height[0];
+        load->levels = load->target == GL_TEXTURE_2D ? (GLsizei)floor(log2((double)largest)) + 1 : 1;
+        glTexStorage2D(load->target, load->levels, GL_RGBA8, load->width[0], load->height[0]);
+    }
+    stateBindTexture(load->target, 0);
+
+    int count = load->format ? (int)load->levels : load->faceCount;
+    load->uploadsPending = count;
+    for (int i = 0; i < count; i++) {
+        int face = load->format ? 0 : i;
+        int level = load->format ? i : 0;
+        UploadRequest* request = (UploadRequest*)calloc(1, sizeof(UploadRequest));
+        if (!request) {
+            // Upload this face or level directly instead
+            GLenum faceTarget = load->target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+            stateBindTexture(load->target, load->texture);
+            if (load->format) {
+                glCompressedTexSubImage2D(faceTarget, level, 0, 0, levelSize(load->width[0], level), levelSize(load->height[0], level),
+                                          load->format, load->blockBytes[level], load->blocks[level]);
+            } else {
+                glTexSubImage2D(faceTarget, 0, 0, 0, load->width[face], load->height[face], GL_RGBA, GL_UNSIGNED_BYTE, load->pixels[face]);
+            }
+            stateBindTexture(load->target, 0);
+            if (--load->uploadsPending == 0) finishTexture(load, true);
+            continue;
+        }
+        request->kind = UPLOAD_TEXTURE;
+        request->size = load->format ? (size_t)load->blockBytes[level] : (size_t)load->width[face] * load->height[face] * 4;
+        request->load = load;
+        request->face = face;
+        request->level = level;
+        enqueueRequest(request);
+    }
+}
+
+// Stages as much of the request as fits in one slot. Returns bytes staged.
+static size_t stageChunk(UploadRequest* request, StagingSlot* slot, size_t byteLimit) {
+    size_t bytes;
+    size_t rowBytes = 0;
+
+    if (request->kind == UPLOAD_TEXTURE) {
+        // Whole rows (of 4x4 blocks when compressed) only, so each chunk is one sub-image call
+        TextureLoad* load = request->load;
+        int width = levelSize(load->width[request->face], request->level);
+        rowBytes = load->format ? (size_t)((width + 3) / 4) * blockSize(load->format) : (size_t)width * 4;
+        size_t limit = byteLimit < UPLOAD_STAGING_SIZE ? byteLimit : UPLOAD_STAGING_SIZE;
+        size_t rows = limit / rowBytes;
+        if (rows == 0) rows = 1;
+        bytes = rows * rowBytes;
+    } else {
+        bytes = byteLimit < UPLOAD_STAGING_SIZE ? byteLimit : UPLOAD_STAGING_SIZE;
+    }
+    if (bytes > request->size - request->offset) bytes = request->size - request->offset;
+    if (bytes > UPLOAD_STAGING_SIZE) return 0;
+
+    const unsigned char* source;
+    if (request->kind == UPLOAD_TEXTURE) {
+        TextureLoad* load = request->load;
+        source = (load->format ? load->blocks[request->level] : load->pixels[request->face]) + request->offset;
+    } else {
+        source = request->data + request->offset;
+    }
+
+    // The slot's fence has passed, so the unsynchronized map is safe
+    glBindBuffer(GL_COPY_READ_BUFFER, slot->buffer);
+    void* mapped = glMapBufferRange(GL_COPY_READ_BUFFER, 0, (GLsizeiptr)bytes,
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!mapped) {
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        return 0;
+    }
+    memcpy(mapped, source, bytes);
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    if (request->kind == UPLOAD_TEXTURE) {
+        TextureLoad* load = request->load;
+        GLenum faceTarget = load->target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + request->face : GL_TEXTURE_2D;
+
+        stateActiveTexture(GL_TEXTURE0);
+        stateBindTexture(load->target, load->texture);
+        int width = levelSize(load->width[request->face], request->level);
+        int height = levelSize(load->height[request->face], request->level);
+        int rowPixels = load->format ? 4 : 1;
+        GLint y = (GLint)(request->offset / rowBytes) * rowPixels;
+        GLsizei rows = (GLsizei)(bytes / rowBytes) * rowPixels;
+        if (y + rows > height) rows = height - y;
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->buffer);
+        if (load->format) {
+            glCompressedTexSubImage2D(faceTarget, request->level, 0, y, width, rows, load->format, (GLsizei)bytes, (void*)0);
+        } else {
+            glTexSubImage2D(faceTarget, 0, 0, y, width, rows, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        stateBindTexture(load->target, 0);
+    } else {
+        glBindBuffer(GL_COPY_READ_BUFFER, slot->buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, request->buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, (GLintptr)request->offset, (GLsizeiptr)bytes);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    request->offset += bytes;
+    return bytes;
+}
+
+static void finishRequest(UploadRequest* request) {
+    if (request->kind == UPLOAD_TEXTURE) {
+        TextureLoad* load = request->load;
+        if (--load->uploadsPending == 0) finishTexture(load, true);
+    } else if (request->done) {
+        request->done(request->user);
+    }
+    free(request);
+}
+
+static void collectDecodedTextures(void) {
+    lockMutex(&queueMutex);
+    TextureLoad* decoded = decodedHead;
+    decodedHead = NULL;
+    stats.pendingDecodes = decodesInFlight;
+    unlockMutex(&queueMutex);
+
+    while (decoded) {
+        TextureLoad* next = decoded->next;
+        startTextureUpload(decoded);
+        decoded = next;
+    }
+}
+
+// Returns true if it made progress
+static bool runUploads(size_t budgetBytes, double budgetMs, bool blocking) {
+    double start = glfwGetTime();
+    size_t staged = 0;
+    bool stalled = false;
+
+    collectDecodedTextures();
+
+    while (requestHead && staged < budgetBytes) {
+        StagingSlot* slot = &slots[currentSlot];
+        if (slot->fence) {
+            GLuint64 timeout = blocking ? 1000000000ull : 0;
+            GLenum status = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+            if (status == GL_TIMEOUT_EXPIRED) {
+                stalled = true; // GPU still reading this slot, try again next frame
+                break;
+            }
+            glDeleteSync(slot->fence);
+            slot->fence = 0;
+        }
+
+        UploadRequest* request = requestHead;
+        size_t bytes = stageChunk(request, slot, budgetBytes - staged);
+        if (bytes == 0) break;
+        staged += bytes;
+        currentSlot = (currentSlot + 1) % UPLOAD_STAGING_SLOTS;
+
+        if (request->offset >= request->size) {
+            requestHead = request->next;
+            if (!requestHead) requestTail = NULL;
+            requestCount--;
+            finishRequest(request);
+        }
+
+        if ((glfwGetTime() - start) * 1000.0 > budgetMs) break;
+    }
+
+    stats.bytesLastFrame = staged;
+    stats.msLastFrame = (glfwGetTime() - start) * 1000.0;
+    stats.totalBytes += staged;
+    stats.pendingUploads = requestCount;
+    if (stalled) stats.stalledFrames++;
+    return staged > 0;
+}
+
+void processUploads(void) {
+    if (!queueInitialized) return;
+    runUploads((size_t)UPLOAD_BUDGET_MB * 1024 * 1024, UPLOAD_BUDGET_MS, false);
+}
+
+void flushUploads(void) {
+    if (!queueInitialized) return;
+
+    for (;;) {
+        runUploads((size_t)-1, 1.0e9, true);
+
+        lockMutex(&queueMutex);
+        bool idle = decodesInFlight == 0 && !decodedHead && !requestHead;
+        // Nothing to stage yet, wait for a worker to finish decoding
+        while (!idle && !requestHead && !decodedHead && decodesInFlight > 0) {
+            waitCondition(&decodeCondition, &queueMutex);
+        }
+        unlockMutex(&queueMutex);
+
+        if (idle) break;
+    }
+}
+
+int getUploadQueueDepth(void) {
+    return stats.pendingDecodes + requestCount;
+}
+
+const UploadStats* getUploadStats(void) {
+    return &stats;
+}
@@ -4,114 +4,670 @@
 #include "globals.h"
 #include "SceneObject.h"
 #include "ModelLoad.h"
+#include "model_registry.h"
+#include "components.h"
+#include "scene_graph.h"
+#include "log.h"
+#include <GLFW/glfw3.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #ifdef AUDIO_ENABLED
 #include "audio.h"
 #endif
 
-// Define the stacks for undo and redo
-Action undoStack[MAX_ACTIONS];
-Action redoStack[MAX_ACTIONS];
-int undoTop = -1;
-int redoTop = -1;
+#define JOURNAL_ALIGN _Alignof(max_align_t)
+#define INVALID_KEY UINT_MAX
+#define RECORDED_COMPONENTS (COMPONENT_BIT(COMPONENT_RIGID_BODY) | COMPONENT_BIT(COMPONENT_AUDIO_EMITTER))
 
-// Define the action history
-Action actionHistory[MAX_ACTIONS];
-int historyCount = 0;
+typedef enum {
+    ENTRY_FIELDS,     // Field edit of one object
+    ENTRY_ADDED,      // Objects added, see ObjectsPayload
+    ENTRY_REMOVED,    // Objects removed, see ObjectsPayload
+    ENTRY_PARENT,     // Parent of one object changed, parent keys before and after
+    ENTRY_NOTE        // Shown in the history, skipped by undo and redo
+} EntryKind;
 
-void pushUndoAction(Action action) {
-    if (undoTop < MAX_ACTIONS - 1) {
-        undoStack[++undoTop] = action;
-        redoTop = -1; // Clear redo stack whenever a new action is performed
+// Every entry starts with this, the payload follows
+typedef struct {
+    unsigned int size;      // Whole entry, a multiple of JOURNAL_ALIGN
+    unsigned short kind;    // EntryKind
+    unsigned short fields;  // UNDO_FIELD_* of a field edit
+    unsigned int count;     // Objects in an add or remove
+    unsigned int key;       // Object of a field or parent edit
+    unsigned int children;  // Children outside a removed batch
+    double time;            // Last write, for coalescing
+} EntryHeader;
+
+// Per object of an add or remove
+typedef struct {
+    unsigned int key;
+    unsigned int parentKey;     // INVALID_KEY for roots
+    ComponentMask components;   // RECORDED_COMPONENTS the entity had
+} ObjectRecord;
+
+// Removing an object moves its children up a level, the ones outside the
+// batch are recorded so undo can put them back
+typedef struct {
+    unsigned int key;
+    unsigned int parentKey;
+    Vector3 position;           // Local to the parent, before the removal
+    Vector3 rotation;
+    Vector3 scale;
+} ChildRecord;
+
+// An add or remove: records, then states, then one RigidBody and one
+// AudioEmitter per record that has it, in record order, then the children
+typedef struct {
+    ObjectRecord* records;
+    SceneObject* states;
+    RigidBody* bodies;
+    AudioEmitter* emitters;
+    ChildRecord* children;
+} ObjectsPayload;
+
+typedef struct {
+    unsigned int generation;
+    unsigned int key;
+} SlotKey;
+
+static unsigned char* arena = NULL;
+static size_t arenaUsed = 0;
+static size_t arenaCapacity = 0;
+static unsigned int* entryOffsets = NULL;
+static int entryCount = 0;
+static int entryCapacity = 0;
+static int cursor = 0;
+static bool coalesceOpen = false;  // The last entry may still absorb edits
+
+// Key to current handle, and slot to key for the reverse lookup. Keys no
+// entry names any more are reused
+static ObjectHandle* keyHandles = NULL;
+static unsigned int* keyRefs = NULL;   // Entries naming the key
+static unsigned int* freeKeys = NULL;
+static unsigned int freeKeyCount = 0;
+static unsigned int keyCount = 0;
+static unsigned int keyCapacity = 0;
+static SlotKey* slotKeys = NULL;
+static unsigned int slotKeyCapacity = 0;
+
+static UndoStats stats = { 0, 0, 0, UNDO_DEFAULT_BUDGET, 0, 0, 0 };
+
+static size_t alignSize(size_t size) {
+    return (size + JOURNAL_ALIGN - 1) & ~(size_t)(JOURNAL_ALIGN - 1);
+}
+
+static bool growBuffer(void** buffer, size_t bytes) {
+    void* grown = realloc(*buffer, bytes);
+    if (!grown) return false;
+    *buffer = grown;
+    return true;
+}
+
+static EntryHeader* entryAt(int index) {
+    return (EntryHeader*)(arena + entryOffsets[index]);
+}
+
+static size_t objectsPayloadSize(unsigned int count, unsigned int bodies, unsigned int emitters, unsigned int children) {
+    return alignSize(count * sizeof(ObjectRecord)) + alignSize(count * sizeof(SceneObject)) +
+        alignSize(bodies * sizeof(RigidBody)) + alignSize(emitters * sizeof(AudioEmitter)) +
+        children * sizeof(ChildRecord);
+}
+
+static ObjectsPayload entryObjects(EntryHeader* entry) {
+    ObjectsPayload payload;
+    unsigned char* at = (unsigned char*)entry + alignSize(sizeof(EntryHeader));
+    payload.records = (ObjectRecord*)at;
+    unsigned int bodies = 0;
+    unsigned int emitters = 0;
+    for (unsigned int i = 0; i < entry->count; i++) {
+        if (payload.records[i].components & COMPONENT_BIT(COMPONENT_RIGID_BODY)) bodies++;
+        if (payload.records[i].components & COMPONENT_BIT(COMPONENT_AUDIO_EMITTER)) emitters++;
     }
+    at += alignSize(entry->count * sizeof(ObjectRecord));
+    payload.states = (SceneObject*)at;
+    at += alignSize(entry->count * sizeof(SceneObject));
+    payload.bodies = (RigidBody*)at;
+    at += alignSize(bodies * sizeof(RigidBody));
+    payload.emitters = (AudioEmitter*)at;
+    at += alignSize(emitters * sizeof(AudioEmitter));
+    payload.children = (ChildRecord*)at;
+    return payload;
+}
+
+static float* entryValues(EntryHeader* entry) {
+    return (float*)((unsigned char*)entry + alignSize(sizeof(EntryHeader)));
+}
+
+static unsigned int* entryParentKeys(EntryHeader* entry) {
+    return (unsigned int*)((unsigned char*)entry + alignSize(sizeof(EntryHeader)));
+}
+
+static char* entryText(EntryHeader* entry) {
+    return (char*)entry + alignSize(sizeof(EntryHeader));
 }
 
-Action popUndoAction() {
-    if (undoTop >= 0) {
-        return undoStack[undoTop--];
+// Keys
+
+static bool sameHandle(ObjectHandle a, ObjectHandle b) {
+    return a.index == b.index && a.generation == b.generation;
+}
+
+static unsigned int keyForHandle(ObjectHandle handle) {
+    if (handle.index < slotKeyCapacity && slotKeys[handle.index].generation == handle.generation &&
+        slotKeys[handle.index].key < keyCount) {
+        return slotKeys[handle.index].key;
+    }
+
+    if (handle.index >= slotKeyCapacity) {
+        unsigned int capacity = slotKeyCapacity ? slotKeyCapacity : 256;
+        while (capacity <= handle.index) capacity *= 2;
+        if (!growBuffer((void**)&slotKeys, capacity * sizeof(SlotKey))) return INVALID_KEY;
+        memset(slotKeys + slotKeyCapacity, 0, (capacity - slotKeyCapacity) * sizeof(SlotKey));
+        slotKeyCapacity = capacity;
+    }
+
+    // A key handed out for a recording that failed names no entry, the slot's
+    // next object takes it over
+    SlotKey* slot = &slotKeys[handle.index];
+    unsigned int key;
+    if (slot->generation != 0 && slot->key < keyCount && keyRefs[slot->key] == 0 &&
+        sameHandle(keyHandles[slot->key], (ObjectHandle){ handle.index, slot->generation })) {
+        key = slot->key;
+    }
+    else if (freeKeyCount > 0) {
+        key = freeKeys[--freeKeyCount];
+    }
+    else {
+        if (keyCount == keyCapacity) {
+            unsigned int capacity = keyCapacity ? keyCapacity * 2 : 256;
+            if (!growBuffer((void**)&keyHandles, capacity * sizeof(ObjectHandle)) ||
+                !growBuffer((void**)&keyRefs, capacity * sizeof(unsigned int)) ||
+                !growBuffer((void**)&freeKeys, capacity * sizeof(unsigned int))) return INVALID_KEY;
+            keyCapacity = capacity;
+        }
+        key = keyCount++;
     }
-    return (Action) { .type = -1 };
+    keyHandles[key] = handle;
+    keyRefs[key] = 0;
+    *slot = (SlotKey){ handle.generation, key };
+    return key;
 }
 
-void pushRedoAction(Action action) {
-    if (redoTop < MAX_ACTIONS - 1) {
-        redoStack[++redoTop] = action;
+static void retainKey(unsigned int key) {
+    if (key != INVALID_KEY) keyRefs[key]++;
+}
+
+// The last entry naming the key is gone
+static void releaseKey(unsigned int key) {
+    if (key == INVALID_KEY || --keyRefs[key] > 0) return;
+    ObjectHandle handle = keyHandles[key];
+    if (handle.index < slotKeyCapacity && slotKeys[handle.index].key == key &&
+        slotKeys[handle.index].generation == handle.generation) {
+        slotKeys[handle.index] = (SlotKey){ 0, 0 };
     }
+    freeKeys[freeKeyCount++] = key;
 }
 
-Action popRedoAction() {
-    if (redoTop >= 0) {
-        return redoStack[redoTop--];
+// INVALID_KEY for no object
+static ObjectHandle handleForKey(unsigned int key) {
+    return key == INVALID_KEY ? INVALID_OBJECT_HANDLE : keyHandles[key];
+}
+
+// An undo or redo added the object back under a new handle
+static void rebindKey(unsigned int key, ObjectHandle handle) {
+    keyHandles[key] = handle;
+    if (handle.generation != 0 && handle.index < slotKeyCapacity) {
+        slotKeys[handle.index] = (SlotKey){ handle.generation, key };
     }
-    return (Action) { .type = -1 };
 }
 
-void addToHistory(Action action) {
-    if (historyCount < MAX_ACTIONS) {
-        actionHistory[historyCount++] = action;
+// Entries
+
+// Counts the entry in or out of every key it names
+static void adjustEntryKeys(EntryHeader* entry, bool retain) {
+    void (*adjust)(unsigned int) = retain ? retainKey : releaseKey;
+    switch (entry->kind) {
+    case ENTRY_FIELDS:
+        adjust(entry->key);
+        break;
+    case ENTRY_PARENT:
+        adjust(entry->key);
+        adjust(entryParentKeys(entry)[0]);
+        adjust(entryParentKeys(entry)[1]);
+        break;
+    case ENTRY_ADDED:
+    case ENTRY_REMOVED: {
+        ObjectsPayload payload = entryObjects(entry);
+        for (unsigned int i = 0; i < entry->count; i++) {
+            adjust(payload.records[i].key);
+            adjust(payload.records[i].parentKey);
+        }
+        for (unsigned int i = 0; i < entry->children; i++) {
+            adjust(payload.children[i].key);
+            adjust(payload.children[i].parentKey);
+        }
+        break;
+    }
+    default:
+        break;
     }
 }
 
-void undo_last_action() {
-    if (undoTop >= 0) {
-        Action action = popUndoAction();
-        switch (action.type) {
-        case ACTION_ADD:
-            removeObject(action.objectIndex);
-            break;
-        case ACTION_REMOVE:
-            addObjectToManager(action.previousState);
-            break;
-        case ACTION_TRANSFORM:
-            objectManager.objects[action.objectIndex] = action.previousState;
-            break;
-        case ACTION_CHANGE_COLOR:
-            objectManager.objects[action.objectIndex].color = action.previousState.color;
-            break;
-        default:
-            break;
+// Model states hold a reference while they are in the journal
+static void releaseEntry(EntryHeader* entry) {
+    adjustEntryKeys(entry, false);
+    if (entry->kind != ENTRY_ADDED && entry->kind != ENTRY_REMOVED) return;
+    SceneObject* states = entryObjects(entry).states;
+    for (unsigned int i = 0; i < entry->count; i++) {
+        if (states[i].object.type == OBJ_MODEL) releaseModel(states[i].object.data.model);
+    }
+}
+
+static void truncateRedo(void) {
+    for (int i = cursor; i < entryCount; i++) releaseEntry(entryAt(i));
+    if (cursor < entryCount) arenaUsed = entryOffsets[cursor];
+    entryCount = cursor;
+}
+
+// Drops the oldest entries down to three quarters of the budget. Only
+// applied entries go, the newest one and anything still to redo stay
+static void enforceBudget(void) {
+    if (arenaUsed <= stats.budget || entryCount < 2) return;
+    size_t target = stats.budget / 4 * 3;
+    int drop = 0;
+    while (drop < cursor && drop < entryCount - 1 && arenaUsed - entryOffsets[drop] > target) {
+        releaseEntry(entryAt(drop));
+        drop++;
+    }
+    if (drop == 0) return;
+
+    unsigned int shift = entryOffsets[drop];
+    memmove(arena, arena + shift, arenaUsed - shift);
+    arenaUsed -= shift;
+    for (int i = drop; i < entryCount; i++) entryOffsets[i - drop] = entryOffsets[i] - shift;
+    entryCount -= drop;
+    cursor -= drop;
+    stats.dropped += drop;
+}
+
+// Room for a new entry after the cursor, NULL when out of memory. Recording
+// calls truncateRedo before taking keys, dropping redo entries can free them
+static EntryHeader* appendEntry(EntryKind kind, size_t payloadBytes) {
+    truncateRedo();
+    size_t size = alignSize(sizeof(EntryHeader)) + alignSize(payloadBytes);
+    if (size > UINT_MAX || arenaUsed + size > UINT_MAX) return NULL;
+
+    if (arenaUsed + size > arenaCapacity) {
+        size_t capacity = arenaCapacity ? arenaCapacity : 64 * 1024;
+        while (capacity < arenaUsed + size) capacity *= 2;
+        if (!growBuffer((void**)&arena, capacity)) return NULL;
+        arenaCapacity = capacity;
+    }
+    if (entryCount == entryCapacity) {
+        int capacity = entryCapacity ? entryCapacity * 2 : 256;
+        if (!growBuffer((void**)&entryOffsets, capacity * sizeof(unsigned int))) return NULL;
+        entryCapacity = capacity;
+    }
+
+    entryOffsets[entryCount] = (unsigned int)arenaUsed;
+    EntryHeader* entry = (EntryHeader*)(arena + arenaUsed);
+    memset(entry, 0, size);
+    entry->size = (unsigned int)size;
+    entry->kind = (unsigned short)kind;
+    entry->time = glfwGetTime();
+    arenaUsed += size;
+    entryCount++;
+    cursor = entryCount;
+    coalesceOpen = false;
+    return entry;
+}
+
+// The budget can drop entries and free their keys, so it runs once the new
+// entry is filled in and holds its own
+static void finishEntry(EntryHeader* entry) {
+    adjustEntryKeys(entry, true);
+    enforceBudget();
+}
+
+// Fields
+
+static int fieldFloats(unsigned int field) {
+    return field == UNDO_FIELD_COLOR ? 4 : 3;
+}
+
+static float* fieldValues(SceneObject* obj, unsigned int field) {
+    switch (field) {
+    case UNDO_FIELD_POSITION: return &obj->position.x;
+    case UNDO_FIELD_ROTATION: return &obj->rotation.x;
+    case UNDO_FIELD_SCALE: return &obj->scale.x;
+    default: return &obj->color.x;
+    }
+}
+
+static int fieldsFloats(unsigned int fields) {
+    int floats = 0;
+    for (unsigned int field = 1; field <= UNDO_FIELD_COLOR; field <<= 1) {
+        if (fields & field) floats += fieldFloats(field);
+    }
+    return floats;
+}
+
+// Values are stored field by field, before then after
+static void writeFields(float* values, unsigned int fields, const SceneObject* obj, bool after) {
+    for (unsigned int field = 1; field <= UNDO_FIELD_COLOR; field <<= 1) {
+        if (!(fields & field)) continue;
+        int floats = fieldFloats(field);
+        memcpy(values + (after ? floats : 0), fieldValues((SceneObject*)obj, field), floats * sizeof(float));
+        values += 2 * floats;
+    }
+}
+
+static void applyFields(EntryHeader* entry, bool after) {
+    SceneObject* obj = getObject(keyHandles[entry->key]);
+    if (!obj) return;
+    const float* values = entryValues(entry);
+    for (unsigned int field = 1; field <= UNDO_FIELD_COLOR; field <<= 1) {
+        if (!(entry->fields & field)) continue;
+        int floats = fieldFloats(field);
+        memcpy(fieldValues(obj, field), values + (after ? floats : 0), floats * sizeof(float));
+        values += 2 * floats;
+    }
+}
+
+static unsigned int changedFields(const SceneObject* before, const SceneObject* after) {
+    unsigned int fields = 0;
+    for (unsigned int field = 1; field <= UNDO_FIELD_COLOR; field <<= 1) {
+        if (memcmp(fieldValues((SceneObject*)before, field), fieldValues((SceneObject*)after, field), fieldFloats(field) * sizeof(float)) != 0) {
+            fields |= field;
         }
-        pushRedoAction(action);
     }
+    return fields;
 }
 
-void redo_last_action() {
-    if (redoTop >= 0) {
-        Action action = popRedoAction();
-        switch (action.type) {
-        case ACTION_ADD:
-            addObjectToManager(action.newState);
-            break;
-        case ACTION_REMOVE:
-            removeObject(action.objectIndex);
-            break;
-        case ACTION_TRANSFORM:
-            objectManager.objects[action.objectIndex] = action.newState;
-            break;
-        case ACTION_CHANGE_COLOR:
-            objectManager.objects[action.objectIndex].color = action.newState.color;
-            break;
-        default:
-            break;
+void recordObjectEdit(const SceneObject* before, const SceneObject* after) {
+    unsigned int fields = changedFields(before, after);
+    if (fields == 0) return;
+    truncateRedo();
+    unsigned int key = keyForHandle(after->handle);
+    if (key == INVALID_KEY) return;
+
+    // A drag keeps extending its entry, only the after values move
+    double now = glfwGetTime();
+    if (coalesceOpen && cursor == entryCount && entryCount > 0) {
+        EntryHeader* last = entryAt(entryCount - 1);
+        if (last->kind == ENTRY_FIELDS && last->key == key && last->fields == fields && now - last->time < UNDO_COALESCE_SECONDS) {
+            writeFields(entryValues(last), fields, after, true);
+            last->time = now;
+            stats.coalesced++;
+            return;
         }
-        pushUndoAction(action);
     }
+
+    EntryHeader* entry = appendEntry(ENTRY_FIELDS, 2 * fieldsFloats(fields) * sizeof(float));
+    if (!entry) {
+        LOG_ERROR(LOG_SCENE, "Out of memory recording an undo entry");
+        return;
+    }
+    entry->fields = (unsigned short)fields;
+    entry->key = key;
+    writeFields(entryValues(entry), fields, before, false);
+    writeFields(entryValues(entry), fields, after, true);
+    finishEntry(entry);
+    coalesceOpen = true;
 }
 
-void removeObjectWithAction(int index) {
-    if (index < 0 || index >= objectManager.count) return;
+// Objects
 
-    printf("Removing object at index: %d\n", index);
+static unsigned int parentKeyOf(ObjectHandle handle, bool* failed) {
+    ObjectHandle parent = getObjectParent(handle);
+    if (parent.generation == 0) return INVALID_KEY;
+    unsigned int key = keyForHandle(parent);
+    if (key == INVALID_KEY) *failed = true;
+    return key;
+}
 
-    Action action = {
-        .type = ACTION_REMOVE,
-        .previousState = objectManager.objects[index],
-        .objectIndex = index
-    };
+// Children of obj outside the batch, with their keys
+static bool gatherChildren(const SceneObject* obj, const unsigned char* inBatch, ChildRecord** children, unsigned int* count, unsigned int* capacity) {
+    int total = getChildren(obj->entity, NULL, 0);
+    if (total == 0) return true;
+    EntityId* entities = (EntityId*)malloc((size_t)total * sizeof(EntityId));
+    if (!entities) return false;
+    getChildren(obj->entity, entities, total);
+
+    bool ok = true;
+    unsigned int parentKey = keyForHandle(obj->handle);
+    for (int i = 0; i < total && ok; i++) {
+        const Renderable* renderable = getComponent(entities[i], COMPONENT_RENDERABLE);
+        int index = renderable ? getObjectIndex(renderable->object) : -1;
+        if (index < 0 || inBatch[index]) continue;
+        if (*count == *capacity) {
+            unsigned int grown = *capacity ? *capacity * 2 : 16;
+            if (!growBuffer((void**)children, grown * sizeof(ChildRecord))) {
+                ok = false;
+                break;
+            }
+            *capacity = grown;
+        }
+        const SceneObject* child = &objectManager.objects[index];
+        ChildRecord* record = &(*children)[(*count)++];
+        record->key = keyForHandle(child->handle);
+        record->parentKey = parentKey;
+        record->position = child->position;
+        record->rotation = child->rotation;
+        record->scale = child->scale;
+        if (record->key == INVALID_KEY) ok = false;
+    }
+    free(entities);
+    return ok;
+}
 
-    pushUndoAction(action);
-    addToHistory(action);
+// Records, states and components of the live objects among the handles, and
+// for a remove the children it would move
+static EntryHeader* recordObjects(EntryKind kind, const ObjectHandle* handles, int count) {
+    unsigned char* inBatch = (unsigned char*)calloc(objectManager.count > 0 ? (size_t)objectManager.count : 1, 1);
+    if (!inBatch) {
+        LOG_ERROR(LOG_SCENE, "Out of memory recording an undo entry for %d objects", count);
+        return NULL;
+    }
+
+    // Keys first, a failure leaves nothing half recorded. Repeated handles count once
+    truncateRedo();
+    bool failed = false;
+    unsigned int live = 0, bodies = 0, emitters = 0;
+    for (int i = 0; i < count && !failed; i++) {
+        int index = getObjectIndex(handles[i]);
+        if (index < 0 || inBatch[index]) continue;
+        inBatch[index] = 1;
+        EntityId entity = objectManager.objects[index].entity;
+        if (hasComponents(entity, COMPONENT_BIT(COMPONENT_RIGID_BODY))) bodies++;
+        if (hasComponents(entity, COMPONENT_BIT(COMPONENT_AUDIO_EMITTER))) emitters++;
+        if (keyForHandle(handles[i]) == INVALID_KEY) failed = true;
+        parentKeyOf(handles[i], &failed);
+        live++;
+    }
+    ChildRecord* children = NULL;
+    unsigned int childCount = 0, childCapacity = 0;
+    for (int i = 0; i < count && !failed; i++) {
+        int index = getObjectIndex(handles[i]);
+        if (index < 0 || inBatch[index] != 1) continue;
+        inBatch[index] = 2;
+        if (!gatherChildren(&objectManager.objects[index], inBatch, &children, &childCount, &childCapacity)) failed = true;
+    }
+
+    EntryHeader* entry = NULL;
+    if (!failed && live > 0) entry = appendEntry(kind, objectsPayloadSize(live, bodies, emitters, childCount));
+    if (!entry) {
+        if (failed || live > 0) LOG_ERROR(LOG_SCENE, "Out of memory recording an undo entry for %d objects", count);
+        free(children);
+        free(inBatch);
+        return NULL;
+    }
+
+    // Records first, the sections after them are placed by their components
+    entry->count = live;
+    entry->children = childCount;
+    ObjectRecord* records = entryObjects(entry).records;
+    unsigned int stored = 0;
+    for (int i = 0; i < count; i++) {
+        int index = getObjectIndex(handles[i]);
+        if (index < 0 || inBatch[index] != 2) continue;
+        inBatch[index] = 3;
+        EntityId entity = objectManager.objects[index].entity;
+        ObjectRecord* record = &records[stored++];
+        record->key = keyForHandle(handles[i]);
+        record->parentKey = parentKeyOf(handles[i], &failed);  // Taken above, can't fail
+        record->components = 0;
+        if (hasComponents(entity, COMPONENT_BIT(COMPONENT_RIGID_BODY))) record->components |= COMPONENT_BIT(COMPONENT_RIGID_BODY);
+        if (hasComponents(entity, COMPONENT_BIT(COMPONENT_AUDIO_EMITTER))) record->components |= COMPONENT_BIT(COMPONENT_AUDIO_EMITTER);
+    }
+    free(inBatch);
+
+    ObjectsPayload payload = entryObjects(entry);
+    RigidBody* body = payload.bodies;
+    AudioEmitter* emitter = payload.emitters;
+    for (unsigned int i = 0; i < live; i++) {
+        const SceneObject* obj = getObject(keyHandles[payload.records[i].key]);
+        payload.states[i] = *obj;
+        if (obj->object.type == OBJ_MODEL) retainModel(obj->object.data.model);
+        if (payload.records[i].components & COMPONENT_BIT(COMPONENT_RIGID_BODY)) {
+            *body++ = *(const RigidBody*)getComponent(obj->entity, COMPONENT_RIGID_BODY);
+        }
+        if (payload.records[i].components & COMPONENT_BIT(COMPONENT_AUDIO_EMITTER)) {
+            *emitter++ = *(const AudioEmitter*)getComponent(obj->entity, COMPONENT_AUDIO_EMITTER);
+        }
+    }
+    if (childCount > 0) memcpy(payload.children, children, childCount * sizeof(ChildRecord));
+    free(children);
+    finishEntry(entry);
+    return entry;
+}
+
+static void addEntryObjects(EntryHeader* entry) {
+    ObjectHandle* handles = (ObjectHandle*)malloc(entry->count * sizeof(ObjectHandle));
+    if (!handles) {
+        LOG_ERROR(LOG_SCENE, "Out of memory restoring %u objects", entry->count);
+        return;
+    }
+    // Fresh geometry, the recorded buffers went with the removed objects
+    ObjectsPayload payload = entryObjects(entry);
+    addObjectsToManager(payload.states, (int)entry->count, handles);
+    for (unsigned int i = 0; i < entry->count; i++) rebindKey(payload.records[i].key, handles[i]);
+
+    // Links once every object is back, a parent may be in the same batch
+    const RigidBody* body = payload.bodies;
+    const AudioEmitter* emitter = payload.emitters;
+    for (unsigned int i = 0; i < entry->count; i++) {
+        const ObjectRecord* record = &payload.records[i];
+        SceneObject* obj = getObject(handles[i]);
+        if (record->components & COMPONENT_BIT(COMPONENT_RIGID_BODY)) {
+            if (obj && addComponents(obj->entity, COMPONENT_BIT(COMPONENT_RIGID_BODY))) {
+                *(RigidBody*)writeComponent(obj->entity, COMPONENT_RIGID_BODY) = *body;
+            }
+            body++;
+        }
+        if (record->components & COMPONENT_BIT(COMPONENT_AUDIO_EMITTER)) {
+            if (obj && addComponents(obj->entity, COMPONENT_BIT(COMPONENT_AUDIO_EMITTER))) {
+                AudioEmitter* restored = writeComponent(obj->entity, COMPONENT_AUDIO_EMITTER);
+                *restored = *emitter;
+                restored->sourceIndex = -1;  // The old source was released with the object
+            }
+            emitter++;
+        }
+        if (obj && record->parentKey != INVALID_KEY) setObjectParent(handles[i], keyHandles[record->parentKey]);
+    }
+
+    // Children the removal moved up a level go back with their old transform
+    for (unsigned int i = 0; i < entry->children; i++) {
+        const ChildRecord* record = &payload.children[i];
+        SceneObject* child = getObject(keyHandles[record->key]);
+        if (!child || !setObjectParent(keyHandles[record->key], keyHandles[record->parentKey])) continue;
+        child->position = record->position;
+        child->rotation = record->rotation;
+        child->scale = record->scale;
+    }
+    free(handles);
+}
+
+static void removeEntryObjects(EntryHeader* entry) {
+    ObjectHandle* handles = (ObjectHandle*)malloc(entry->count * sizeof(ObjectHandle));
+    if (!handles) {
+        LOG_ERROR(LOG_SCENE, "Out of memory removing %u objects", entry->count);
+        return;
+    }
+    const ObjectRecord* records = entryObjects(entry).records;
+    for (unsigned int i = 0; i < entry->count; i++) handles[i] = keyHandles[records[i].key];
+    removeObjects(handles, (int)entry->count);
+    free(handles);
+}
+
+static void applyEntry(EntryHeader* entry, bool redo) {
+    switch (entry->kind) {
+    case ENTRY_FIELDS:
+        applyFields(entry, redo);
+        break;
+    case ENTRY_PARENT:
+        setObjectParent(keyHandles[entry->key], handleForKey(entryParentKeys(entry)[redo ? 1 : 0]));
+        break;
+    case ENTRY_ADDED:
+        if (redo) addEntryObjects(entry);
+        else removeEntryObjects(entry);
+        break;
+    case ENTRY_REMOVED:
+        if (redo) removeEntryObjects(entry);
+        else addEntryObjects(entry);
+        break;
+    default:
+        break;
+    }
+}
+
+void undo_last_action() {
+    coalesceOpen = false;
+    while (cursor > 0) {
+        EntryHeader* entry = entryAt(--cursor);
+        if (entry->kind == ENTRY_NOTE) continue;
+        applyEntry(entry, false);
+        break;
+    }
+}
+
+void redo_last_action() {
+    coalesceOpen = false;
+    while (cursor < entryCount) {
+        EntryHeader* entry = entryAt(cursor++);
+        if (entry->kind == ENTRY_NOTE) continue;
+        applyEntry(entry, true);
+        break;
+    }
+}
+
+void clearUndoHistory(void) {
+    for (int i = 0; i < entryCount; i++) releaseEntry(entryAt(i));
+    arenaUsed = 0;
+    entryCount = 0;
+    cursor = 0;
+    coalesceOpen = false;
+    keyCount = 0;
+    freeKeyCount = 0;
+    if (slotKeys) memset(slotKeys, 0, slotKeyCapacity * sizeof(SlotKey));
+}
+
+void setUndoBudget(size_t bytes) {
+    stats.budget = bytes;
+    enforceBudget();
+}
+
+// Operations
+
+void removeObjectWithAction(ObjectHandle handle) {
+    int index = getObjectIndex(handle);
+    if (index < 0) return;
+
+    LOG_DEBUG(LOG_SCENE, "Removing object at index: %d", index);
+    recordObjects(ENTRY_REMOVED, &handle, 1);
 
     // AUDIO FEEDBACK
     #ifdef AUDIO_ENABLED
@@ -119,9 +675,9 @@ void removeObjectWithAction(int index) {
     #endif
 
     // Remove the object
-    removeObject(index);
+    removeObject(handle);
 
-    // Adjust selected_object to a valid object if possible
+    // Adjust selected_object to a valid object if possible, the gap now holds what was last
     if (objectManager.count > 0) {
         if (index >= objectManager.count) {
             selected_object = &objectManager.objects[objectManager.count - 1];
@@ -135,10 +691,10 @@ void removeObjectWithAction(int index) {
     }
 
     if (selected_object) {
-        printf("New selected object: ID=%d, Index=%ld\n", selected_object->id, selected_object - objectManager.objects);
+        LOG_DEBUG(LOG_SCENE, "New selected object: ID=%d, Index=%ld", selected_object->id, (long)(selected_object - objectManager.objects));
     }
     else {
-        printf("No selected object\n");
+        LOG_DEBUG(LOG_SCENE, "No selected object");
     }
 
     // Hide the relevant windows
@@ -149,62 +705,165 @@ void removeObjectWithAction(int index) {
 }
 
 void addObjectWithAction(ObjectType type, bool useTextures, int textureID, bool useColors, Model* model, PBRMaterial material, bool usePBR) {
-    addObject(&camera, type, useTextures, textureID, useColors, model, material, usePBR);
-    SceneObject* newObject = &objectManager.objects[objectManager.count - 1]; // Get the last added object
-    Action action = {
-        .type = ACTION_ADD,
-        .newState = *newObject,
-        .objectIndex = objectManager.count - 1
-    };
-    snprintf(action.description, sizeof(action.description), "Added object of type %d", type);
-    pushUndoAction(action);
-    addToHistory(action);
-    
+    ObjectHandle handle = addObject(&camera, type, useTextures, textureID, useColors, model, material, usePBR);
+    if (!isObjectAlive(handle)) return;
+    recordObjects(ENTRY_ADDED, &handle, 1);
+
     // AUDIO FEEDBACK
     #ifdef AUDIO_ENABLED
     playSound("resources/audio/object_create.wav");
     #endif
 }
 
-void transformObjectWithAction(int index, Vector3 position, Vector3 rotation, Vector3 scale) {
-    if (index < 0 || index >= objectManager.count) return;
-    Action action = {
-        .type = ACTION_TRANSFORM,
-        .previousState = objectManager.objects[index],
-        .objectIndex = index,
-        .newState = objectManager.objects[index]
-    };
-    snprintf(action.description, sizeof(action.description), "Transformed object at index %d", index);
-    action.newState.position = position;
-    action.newState.rotation = rotation;
-    action.newState.scale = scale;
-    pushUndoAction(action);
-    addToHistory(action);
-    objectManager.objects[index].position = position;
-    objectManager.objects[index].rotation = rotation;
-    objectManager.objects[index].scale = scale;
-}
-
-void changeColorWithAction(int index, Vector4 color) {
-    if (index < 0 || index >= objectManager.count) return;
-    Action action = {
-        .type = ACTION_CHANGE_COLOR,
-        .previousState = objectManager.objects[index],
-        .objectIndex = index,
-        .newState = objectManager.objects[index]
-    };
-    snprintf(action.description, sizeof(action.description), "Changed color of object at index %d", index);
-    action.newState.color = color;
-    pushUndoAction(action);
-    addToHistory(action);
-    objectManager.objects[index].color = color;
+int spawnObjectsWithAction(const SceneObject* templateObject, const ObjectTransform* transforms, int count) {
+    if (count <= 0) return 0;
+    ObjectHandle* handles = (ObjectHandle*)malloc((size_t)count * sizeof(ObjectHandle));
+    if (!handles) {
+        LOG_ERROR(LOG_SCENE, "Out of memory spawning %d objects", count);
+        return 0;
+    }
+    int added = spawnObjects(templateObject, transforms, count, handles);
+    recordObjects(ENTRY_ADDED, handles, count);
+    free(handles);
+
+    // AUDIO FEEDBACK
+    #ifdef AUDIO_ENABLED
+    if (added > 0) playSound("resources/audio/object_create.wav");
+    #endif
+    return added;
+}
+
+int removeObjectsWithAction(const ObjectHandle* handles, int count) {
+    if (count <= 0) return 0;
+    recordObjects(ENTRY_REMOVED, handles, count);
+
+    int removed = removeObjects(handles, count);
+    LOG_DEBUG(LOG_SCENE, "Removed %d objects", removed);
+
+    // AUDIO FEEDBACK
+    #ifdef AUDIO_ENABLED
+    if (removed > 0) playSound("resources/audio/object_delete.wav");
+    #endif
+
+    selected_object = NULL;
+    show_color_picker = false;
+    show_inspector = false;
+    show_change_texture = false;
+    show_change_material = false;
+    return removed;
+}
+
+void transformObjectWithAction(ObjectHandle handle, Vector3 position, Vector3 rotation, Vector3 scale) {
+    SceneObject* obj = getObject(handle);
+    if (!obj) return;
+    SceneObject before = *obj;
+    obj->position = position;
+    obj->rotation = rotation;
+    obj->scale = scale;
+    recordObjectEdit(&before, obj);
+}
+
+bool parentObjectWithAction(ObjectHandle child, ObjectHandle parent) {
+    if (!isObjectAlive(child)) return false;
+    ObjectHandle before = getObjectParent(child);
+    if (before.index == parent.index && before.generation == parent.generation) return true;
+
+    // Keys first, a failure leaves the link as it was
+    truncateRedo();
+    unsigned int key = keyForHandle(child);
+    unsigned int beforeKey = before.generation != 0 ? keyForHandle(before) : INVALID_KEY;
+    unsigned int afterKey = parent.generation != 0 ? keyForHandle(parent) : INVALID_KEY;
+    if (key == INVALID_KEY || (before.generation != 0 && beforeKey == INVALID_KEY) ||
+        (parent.generation != 0 && afterKey == INVALID_KEY)) {
+        LOG_ERROR(LOG_SCENE, "Out of memory recording an undo entry");
+        return false;
+    }
+    if (!setObjectParent(child, parent)) return false;
+
+    EntryHeader* entry = appendEntry(ENTRY_PARENT, 2 * sizeof(unsigned int));
+    if (!entry) {
+        LOG_ERROR(LOG_SCENE, "Out of memory recording an undo entry");
+        return true;
+    }
+    entry->key = key;
+    entryParentKeys(entry)[0] = beforeKey;
+    entryParentKeys(entry)[1] = afterKey;
+    finishEntry(entry);
+    return true;
+}
+
+void changeColorWithAction(ObjectHandle handle, Vector4 color) {
+    SceneObject* obj = getObject(handle);
+    if (!obj) return;
+    SceneObject before = *obj;
+    obj->color = color;
+    recordObjectEdit(&before, obj);
 }
 
 void toggleOptionWithAction(const char* optionName, bool newValue) {
-    Action action = {
-        .type = ACTION_TOGGLE_OPTION,
-        .objectIndex = -1
-    };
-    snprintf(action.description, sizeof(action.description), "Toggled option %s to %s", optionName, newValue ? "true" : "false");
-    addToHistory(action);
+    char text[128];
+    int length = snprintf(text, sizeof(text), "Toggled option %s to %s", optionName, newValue ? "true" : "false");
+    if (length < 0) return;
+    if (length >= (int)sizeof(text)) length = sizeof(text) - 1;
+
+    EntryHeader* entry = appendEntry(ENTRY_NOTE, (size_t)length + 1);
+    if (!entry) return;
+    memcpy(entryText(entry), text, (size_t)length + 1);
+    finishEntry(entry);
+}
+
+// History
+
+int getUndoEntryCount(void) {
+    return entryCount;
+}
+
+void describeUndoEntry(int index, char* buffer, size_t size) {
+    if (index < 0 || index >= entryCount) {
+        snprintf(buffer, size, "-");
+        return;
+    }
+    EntryHeader* entry = entryAt(index);
+    const char* state = index < cursor ? "" : " (undone)";
+    switch (entry->kind) {
+    case ENTRY_FIELDS: {
+        char fields[64] = "";
+        static const char* names[] = { "position", "rotation", "scale", "color" };
+        for (int i = 0; i < 4; i++) {
+            if (!(entry->fields & (1u << i))) continue;
+            if (fields[0]) strncat(fields, ", ", sizeof(fields) - strlen(fields) - 1);
+            strncat(fields, names[i], sizeof(fields) - strlen(fields) - 1);
+        }
+        snprintf(buffer, size, "Changed %s of object %u%s", fields, entry->key + 1, state);
+        break;
+    }
+    case ENTRY_PARENT: {
+        unsigned int parentKey = entryParentKeys(entry)[1];
+        if (parentKey == INVALID_KEY) snprintf(buffer, size, "Detached object %u%s", entry->key + 1, state);
+        else snprintf(buffer, size, "Attached object %u to object %u%s", entry->key + 1, parentKey + 1, state);
+        break;
+    }
+    case ENTRY_ADDED:
+    case ENTRY_REMOVED: {
+        const char* verb = entry->kind == ENTRY_ADDED ? "Added" : "Removed";
+        if (entry->count == 1) {
+            snprintf(buffer, size, "%s object of type %d%s", verb, entryObjects(entry).states[0].object.type, state);
+        }
+        else {
+            snprintf(buffer, size, "%s %u objects%s", verb, entry->count, state);
+        }
+        break;
+    }
+    default:
+        snprintf(buffer, size, "%s", entryText(entry));
+        break;
+    }
+}
+
+const UndoStats* getUndoStats(void) {
+    stats.entries = entryCount;
+    stats.cursor = cursor;
+    stats.bytes = arenaUsed;
+    stats.keys = (int)(keyCount - freeKeyCount);
+    return &stats;
 }
@@ -37,6 +37,22 @@
 #include "file_operations.h"
 #include "background.h"
 #include "actions.h"
+#include "model_registry.h"
+#include "ecs.h"
+#include "scene_graph.h"
+#include "upload_queue.h"
+#include "static_batch.h"
+#include "lod.h"
+#include "meshlet.h"
+#include "gpu_culling.h"
+#include "sphere_impostor.h"
+#include "oit.h"
+#include "gl_state.h"
+#include "thread_pool.h"
+#include "simulation.h"
+#include "frame_timing.h"
+#include "latency.h"
+#include "log.h"
 
 // Audio system header
 #ifdef AUDIO_ENABLED
@@ -81,12 +97,7 @@ struct nk_context* get_nk_context() {
 }
 
 int find_selected_object_index(SceneObject* selected_object) {
-    for (int i = 0; i < objectManager.count; i++) {
-        if (&objectManager.objects[i] == selected_object) {
-            return i;
-        }
-    }
-    return -1; // Not found
+    return getObjectSlot(selected_object);
 }
 
 // Change material function
@@ -152,10 +163,11 @@ void import_model() {
         return;
     }
 
-    Model* model = loadModel(filePath);
+    Model* model = acquireModel(filePath);
     if (model) {
-        PBRMaterial defaultMaterial = { 0 };
+        PBRMaterial defaultMaterial = { .arraySlab = -1 };
         addObjectWithAction(OBJ_MODEL, false, -1, true, model, defaultMaterial, false);
+        releaseModel(model); // The new object holds its own reference
     }
 }
 
@@ -167,7 +179,7 @@ void cut_object() {
             if (clipboard_object) {
                 *clipboard_object = *selected_object;
                 isCutOperation = true;
-                removeObjectWithAction(index);
+                removeObjectWithAction(objectManager.handles[index]);
                 selected_object = NULL;
                 printf("Cut object at index: %d\n", index);
             }
@@ -180,12 +192,6 @@ void copy_object() {
         clipboard_object = (SceneObject*)malloc(sizeof(SceneObject));
         if (clipboard_object) {
             *clipboard_object = *selected_object;
-            if (selected_object->object.type == OBJ_MODEL) {
-                clipboard_object->object.data.model.meshes = (Mesh*)malloc(selected_object->object.data.model.meshCount * sizeof(Mesh));
-                for (unsigned int i = 0; i < selected_object->object.data.model.meshCount; i++) {
-                    clipboard_object->object.data.model.meshes[i] = selected_object->object.data.model.meshes[i];
-                }
-            }
             isCutOperation = false;
         }
     }
@@ -193,26 +199,20 @@ void copy_object() {
 
 void paste_object() {
     if (clipboard_object) {
-        SceneObject newObject = *clipboard_object;
-        if (clipboard_object->object.type == OBJ_MODEL) {
-            newObject.object.data.model.meshes = (Mesh*)malloc(clipboard_object->object.data.model.meshCount * sizeof(Mesh));
-            for (unsigned int i = 0; i < clipboard_object->object.data.model.meshCount; i++) {
-                newObject.object.data.model.meshes[i] = clipboard_object->object.data.model.meshes[i];
-            }
-        }
+        // The copy keeps its look and shape and lands in front of the camera
+        ObjectTransform transform = {
+            vector_add(camera.Position, vector_scale(camera.Front, 5.0f)),
+            clipboard_object->rotation,
+            clipboard_object->scale
+        };
+        spawnObjectsWithAction(clipboard_object, &transform, 1);
 
         if (isCutOperation) {
-            addObjectWithAction(newObject.object.type, newObject.object.useTexture, newObject.object.textureID, newObject.object.useColor,
-                (newObject.object.type == OBJ_MODEL ? &newObject.object.data.model : NULL), newObject.object.material, newObject.object.usePBR);
             free(clipboard_object);
             clipboard_object = NULL;
             isCutOperation = false;
         }
-        else {
-            addObjectWithAction(newObject.object.type, newObject.object.useTexture, newObject.object.textureID, newObject.object.useColor,
-                (newObject.object.type == OBJ_MODEL ? &newObject.object.data.model : NULL), newObject.object.material, newObject.object.usePBR);
-        }
-        selected_object = &objectManager.objects[objectManager.count - 1];
+        selected_object = objectManager.count > 0 ? &objectManager.objects[objectManager.count - 1] : NULL;
     }
 }
 
@@ -276,6 +276,171 @@ void debug_window(struct nk_context* ctx, int x, int y, int width, int height) {
         sprintf(buffer, "Light Shading: %d", lightingEnabled);
         nk_label(ctx, buffer, NK_TEXT_LEFT);
 
+        // Shared model imports
+        sprintf(buffer, "Models: %d imported, %d resident, %d loading", getRegisteredModelCount(), getResidentModelCount(), getPendingImportCount());
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+
+        // GPU upload queue, a growing depth means uploads are falling behind
+        const UploadStats* uploads = getUploadStats();
+        sprintf(buffer, "Upload queue: %d pending (%d decoding), stalls %d", getUploadQueueDepth(), uploads->pendingDecodes, uploads->stalledFrames);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+        sprintf(buffer, "Uploaded: %.2f MB in %.2f ms last frame, %.1f MB total",
+            uploads->bytesLastFrame / (1024.0 * 1024.0), uploads->msLastFrame, uploads->totalBytes / (1024.0 * 1024.0));
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+
+        // Static world batches
+        const StaticBatchStats* batches = getStaticBatchStats();
+        sprintf(buffer, "Static: %d objects in %d chunks, %d draws, %d visible, %d rebuilt",
+            batches->objects, batches->chunks, batches->batches, batches->visibleChunks, batches->rebuiltChunks);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+        int batchingEnabled = staticBatchingEnabled;
+        if (nk_checkbox_label(ctx, "Static Batching", &batchingEnabled)) {
+            staticBatchingEnabled = batchingEnabled;
+        }
+
+        // Level of detail, triangles drawn against full detail
+        const LODStats* lod = getLODStats();
+        unsigned long long shadowDrawn = 0, shadowFull = 0;
+        for (int slot = LOD_VIEW_DIRECTIONAL_SHADOW; slot < LOD_VIEW_SLOTS; slot++) {
+            shadowDrawn += lod->trianglesDrawn[slot];
+            shadowFull += lod->trianglesFull[slot];
+        }
+        sprintf(buffer, "LOD: camera %llu / %llu tris, shadows %llu / %llu tris",
+            lod->trianglesDrawn[LOD_VIEW_CAMERA], lod->trianglesFull[LOD_VIEW_CAMERA], shadowDrawn, shadowFull);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+        int lodToggle = lodEnabled;
+        if (nk_checkbox_label(ctx, "Level of Detail", &lodToggle)) {
+            lodEnabled = lodToggle;
+        }
+
+        // Meshlet culling of full-detail models
+        const MeshletStats* meshlets = getMeshletStats();
+        sprintf(buffer, "Meshlets: %d / %d visible in %d meshes, %d indirect draws",
+            meshlets->meshletsVisible, meshlets->meshletsTested, meshlets->meshesCulled, meshlets->draws);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+        int cullingToggle = meshletCullingEnabled;
+        if (nk_checkbox_label(ctx, "Meshlet Culling", &cullingToggle)) {
+            meshletCullingEnabled = cullingToggle;
+        }
+
+        // Compute shader culling of plain primitives
+        const GPUCullingStats* gpuCulling = getGPUCullingStats();
+        if (gpuCulling->available) {
+            sprintf(buffer, "GPU Culling: %d objects, %d uploaded, %s%s", gpuCulling->objects, gpuCulling->updatedObjects,
+                gpuCulling->indirectCount ? "indirect count" : "fixed indirect", gpuCulling->occlusion ? ", Hi-Z" : "");
+            nk_label(ctx, buffer, NK_TEXT_LEFT);
+            int gpuCullingToggle = gpuCullingEnabled;
+            if (nk_checkbox_label(ctx, "GPU Culling", &gpuCullingToggle)) {
+                gpuCullingEnabled = gpuCullingToggle;
+            }
+            int occlusionToggle = gpuOcclusionEnabled;
+            if (nk_checkbox_label(ctx, "Hi-Z Occlusion", &occlusionToggle)) {
+                gpuOcclusionEnabled = occlusionToggle;
+            }
+        }
+
+        // Ray traced sphere quads
+        const SphereImpostorStats* impostors = getSphereImpostorStats();
+        sprintf(buffer, "Sphere Impostors: %d / %d spheres, %d culled, %d draws%s", impostors->impostors, impostors->spheres,
+            impostors->culled, impostors->draws, impostors->countTriggered ? " (count)" : "");
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+        int impostorToggle = sphereImpostorsEnabled;
+        if (nk_checkbox_label(ctx, "Sphere Impostors", &impostorToggle)) {
+            sphereImpostorsEnabled = impostorToggle;
+        }
+        int forceToggle = sphereImpostorsForced;
+        if (nk_checkbox_label(ctx, "Impostors For All Spheres", &forceToggle)) {
+            sphereImpostorsForced = forceToggle;
+        }
+
+        // Passes the frame graph ran and the transient targets behind them
+        const FrameGraphStats* graphStats = getFrameGraphStats();
+        sprintf(buffer, "Frame Graph: %d passes, %d culled, %d transients in %d textures (%.1f MB), %d target binds",
+            graphStats->passes, graphStats->culledPasses, graphStats->transientResources, graphStats->transientTextures,
+            graphStats->transientBytes / (1024.0 * 1024.0), graphStats->framebufferBinds);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+
+        // State changes the cache let through versus dropped this frame
+        const GLStateStats* glStats = getGLStateStats();
+        sprintf(buffer, "GL State: %u calls issued, %u redundant filtered", glStats->issued, glStats->filtered);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+
+        // Jobs this frame, how many moved between threads and how many ran inside a wait
+        const JobSystemStats* jobStats = getJobSystemStats();
+        sprintf(buffer, "Jobs: %d workers, %u run, %u stolen, %u helped", getWorkerCount(),
+            jobStats->jobsRun, jobStats->jobsStolen, jobStats->jobsHelped);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+
+        // Chunks the systems walked this frame versus skipped as unchanged
+        const EcsStats* ecsStats = getEcsStats();
+        sprintf(buffer, "ECS: %d entities, %d archetypes, %d chunks, %u visited, %u unchanged",
+            ecsStats->entities, ecsStats->archetypes, ecsStats->chunks, ecsStats->chunksVisited, ecsStats->chunksSkipped);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+
+        // World matrices recomputed this frame, only dirty subtrees count
+        const SceneGraphStats* sceneStats = getSceneGraphStats();
+        sprintf(buffer, "Scene Graph: %d nodes, %d levels, %d updated%s", sceneStats->nodes, sceneStats->levels,
+            sceneStats->updated, sceneStats->reordered ? ", re-sorted" : "");
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+
+        // Messages the log thread wrote, and lost to a full ring
+        const LogStats* logStats = getLogStats();
+        sprintf(buffer, "Log: %u written, %u dropped", logStats->written, logStats->dropped);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+
+        int simulationToggle = pipelinedSimulation;
+        if (nk_checkbox_label(ctx, "Simulation Thread", &simulationToggle)) {
+            pipelinedSimulation = simulationToggle;
+        }
+        const SimulationStats* simStats = getSimulationStats();
+        if (simStats->threaded) {
+            // Time the frame blocked on the step shows when simulation outruns rendering
+            sprintf(buffer, "Simulation: %u steps, %.2f ms step, %.2f ms waited",
+                simStats->steps, simStats->stepTime * 1000.0, simStats->waitTime * 1000.0);
+            nk_label(ctx, buffer, NK_TEXT_LEFT);
+        }
+
+        // Fixed-step clock and render pacing, independent of each other
+        const FrameTimingStats* timing = getFrameTimingStats();
+        sprintf(buffer, "Timing: %.2f ms frame, %d ticks at %d Hz, %.2f s dropped",
+            timing->frameTime * 1000.0, timing->ticks, frameTiming.tickRate, timing->droppedTime);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+        int vsyncToggle = frameTiming.vsync;
+        if (nk_checkbox_label(ctx, "Vsync", &vsyncToggle)) {
+            frameTiming.vsync = vsyncToggle;
+        }
+        nk_property_int(ctx, "#Frame Cap:", 0, &frameTiming.frameRateCap, 500, 5, 1);
+        nk_property_int(ctx, "#Tick Rate:", 10, &frameTiming.tickRate, 240, 5, 1);
+        nk_property_int(ctx, "#Catch-up Ticks:", 1, &frameTiming.maxCatchUpTicks, 20, 1, 1);
+
+        // Input to present, as seen when each frame's fence signals
+        const LatencyStats* latency = getLatencyStats();
+        sprintf(buffer, "Latency: %.1f ms input to present (avg %.1f), %.2f ms fence wait, %d queued",
+            latency->inputToPresent, latency->averageInputToPresent, latency->fenceWait, latency->framesQueued);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+        int latencyToggle = latencyMode.enabled;
+        if (nk_checkbox_label(ctx, "Low Latency Mode", &latencyToggle)) {
+            latencyMode.enabled = latencyToggle;
+        }
+        if (latencyMode.enabled) {
+            nk_property_int(ctx, "#Frames In Flight:", 1, &latencyMode.framesInFlight, MAX_FRAMES_IN_FLIGHT, 1, 1);
+            if (isReprojectionAvailable()) {
+                int reprojectionToggle = latencyMode.lateReprojection;
+                if (nk_checkbox_label(ctx, "Late Reprojection", &reprojectionToggle)) {
+                    latencyMode.lateReprojection = reprojectionToggle;
+                }
+            }
+            if (latencyMode.lateReprojection) {
+                sprintf(buffer, "Reprojected: %.2f degrees", latency->reprojectionDegrees);
+                nk_label(ctx, buffer, NK_TEXT_LEFT);
+            }
+        }
+
+        int oitToggle = oitEnabled;
+        if (nk_checkbox_label(ctx, "Weighted Blended Transparency", &oitToggle)) {
+            oitEnabled = oitToggle;
+        }
+
         // Light details
         nk_label(ctx, "Light Details:", NK_TEXT_LEFT);
         for (int i = 0; i < lightCount; i++) {
@@ -386,7 +551,7 @@ void toggle_theme() {
 
 // Framebuffer size callback
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-    glViewport(0, 0, width, height);
+    stateViewport(0, 0, width, height);
     windowed_width = width;
     windowed_height = height;
 }
@@ -416,7 +581,7 @@ void resize_callback(GLFWwindow* window, int width, int height) {
     printf("Resizing: width=%d, height=%d\n", width, height);
     windowed_width = width;
     windowed_height = height;
-    glViewport(0, 0, width, height);
+    stateViewport(0, 0, width, height);
 }
 
 
@@ -453,8 +618,7 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     }
     if (key == GLFW_KEY_DELETE && action == GLFW_PRESS) {
         if (selected_object) {
-            int index = selected_object - objectManager.objects;
-            removeObjectWithAction(index);
+            removeObjectWithAction(selected_object->handle);
             selected_object = NULL;
         }
     }
@@ -481,6 +645,7 @@ void display_loading_screen(const char* stage, float progress) {
     nk_end(ctx);
 
     nk_glfw3_render(NK_ANTI_ALIASING_ON, MAX_VERTEX_BUFFER, MAX_ELEMENT_BUFFER);
+    invalidateGLState();
     glfwSwapBuffers(window);
     glfwPollEvents();
 }
@@ -532,7 +697,9 @@ void hierarchy_window(struct nk_context* ctx, int hierarchyX, int hierarchyY, in
             char label[128];
 
             const char* typeName = objectTypeName(sceneObj->object.type);
-            snprintf(label, sizeof(label), "%d. %s", i + 1, typeName);
+            // Children are indented under their parent's depth
+            int depth = getSceneDepth(sceneObj->entity);
+            snprintf(label, sizeof(label), "%*s%d. %s", 2 * (depth > 0 ? depth : 0), "", i + 1, typeName);
 
             if (nk_button_label(ctx, label)) {
                 select_object(i);  // Use the new selection function
@@ -565,7 +732,7 @@ void hierarchy_window(struct nk_context* ctx, int hierarchyX, int hierarchyY, in
                         updateObjectInManager(selected_object);
                     }
                     if (nk_contextual_item_label(ctx, "Delete", NK_TEXT_CENTERED)) {
-                        removeObject(i);
+                        removeObject(objectManager.handles[i]);
                         selected_object = NULL;
                     }
                 }
@@ -595,7 +762,7 @@ void hierarchy_window(struct nk_context* ctx, int hierarchyX, int hierarchyY, in
                 snprintf(buffer, sizeof(buffer), "Use PBR: %s", sceneObj->object.usePBR ? "Yes" : "No");
                 nk_label(ctx, buffer, NK_TEXT_LEFT);
                 if (nk_button_label(ctx, "Delete Object")) {
-                    removeObject(i);
+                    removeObject(objectManager.handles[i]);
                     selected_object = NULL;
                 }
             }
@@ -651,6 +818,8 @@ void inspector_window(struct nk_context* ctx, int inspectorX, int inspectorY, in
     if (selected_object != NULL) {
         if (nk_begin(ctx, "Inspector", nk_rect(inspectorX, inspectorY, inspectorWidth, inspectorHeight), NK_WINDOW_BORDER | NK_WINDOW_TITLE | NK_WINDOW_MOVABLE | NK_WINDOW_SCALABLE | NK_WINDOW_CLOSABLE)) {
             nk_layout_row_dynamic(ctx, 25, 1);
+            // Edits land in place, the journal gets what changed this frame
+            SceneObject before = *selected_object;
 
             nk_label(ctx, "Position", NK_TEXT_LEFT);
             nk_property_float(ctx, "#X:", -100.0f, &selected_object->position.x, 100.0f, 0.1f, 0.1f);
@@ -671,6 +840,37 @@ void inspector_window(struct nk_context* ctx, int inspectorX, int inspectorY, in
             nk_property_float(ctx, "#R:", 0.0f, &selected_object->color.x, 1.0f, 0.01f, 0.01f);
             nk_property_float(ctx, "#G:", 0.0f, &selected_object->color.y, 1.0f, 0.01f, 0.01f);
             nk_property_float(ctx, "#B:", 0.0f, &selected_object->color.z, 1.0f, 0.01f, 0.01f);
+            recordObjectEdit(&before, selected_object);
+
+            // Static objects are merged into world chunks, edits rebuild their chunk
+            int isStatic = selected_object->isStatic;
+            if (nk_checkbox_label(ctx, "Static", &isStatic)) {
+                selected_object->isStatic = isStatic;
+            }
+
+            // The transform above is relative to the parent
+            char parentLabel[64] = "None";
+            int parentIndex = getObjectIndex(getObjectParent(selected_object->handle));
+            if (parentIndex >= 0) {
+                snprintf(parentLabel, sizeof(parentLabel), "%d. %s", parentIndex + 1, objectTypeName(objectManager.objects[parentIndex].object.type));
+            }
+            nk_label(ctx, "Parent", NK_TEXT_LEFT);
+            if (nk_combo_begin_label(ctx, parentLabel, nk_vec2(nk_widget_width(ctx), 200))) {
+                nk_layout_row_dynamic(ctx, 20, 1);
+                ObjectHandle child = selected_object->handle;
+                if (nk_combo_item_label(ctx, "None", NK_TEXT_LEFT)) {
+                    parentObjectWithAction(child, INVALID_OBJECT_HANDLE);
+                }
+                for (int i = 0; i < objectManager.count; i++) {
+                    if (&objectManager.objects[i] == selected_object) continue;
+                    char label[64];
+                    snprintf(label, sizeof(label), "%d. %s", i + 1, objectTypeName(objectManager.objects[i].object.type));
+                    if (nk_combo_item_label(ctx, label, NK_TEXT_LEFT) && !parentObjectWithAction(child, objectManager.handles[i])) {
+                        LOG_WARN(LOG_UI, "Cannot attach an object to one of its own children");
+                    }
+                }
+                nk_combo_end(ctx);
+            }
 
             nk_end(ctx);
         }
@@ -836,8 +1036,11 @@ void settings_window(struct nk_context* ctx) {
         nk_property_float(ctx, "Movement Speed:", 0.1f, &movement_speed, 50.0f, 0.1f, 0.1f);
 
         // Apply the changes to the camera settings
-        camera.MovementSpeed = movement_speed;
-        camera.MouseSensitivity = camera_speed;
+        if (camera.MovementSpeed != movement_speed || camera.MouseSensitivity != camera_speed) {
+            camera.MovementSpeed = movement_speed;
+            camera.MouseSensitivity = camera_speed;
+            cameraEdited();
+        }
 
         // AUDIO SETTINGS SECTION
         #ifdef AUDIO_ENABLED
@@ -1162,8 +1365,14 @@ void object_menu(struct nk_context* ctx) {
 void history_window(struct nk_context* ctx) {
     if (nk_begin(ctx, "History", nk_rect(50, 50, 400, 600), NK_WINDOW_BORDER | NK_WINDOW_TITLE | NK_WINDOW_MOVABLE | NK_WINDOW_SCALABLE)) {
         nk_layout_row_dynamic(ctx, 25, 1);
-        for (int i = 0; i < historyCount; i++) {
-            nk_label(ctx, actionHistory[i].description, NK_TEXT_LEFT);
+        char buffer[160];
+        const UndoStats* undoStats = getUndoStats();
+        snprintf(buffer, sizeof(buffer), "Journal: %d entries, %d keys, %.1f / %.1f KB, %d merged, %d dropped", undoStats->entries,
+            undoStats->keys, undoStats->bytes / 1024.0, undoStats->budget / 1024.0, undoStats->coalesced, undoStats->dropped);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+        for (int i = 0; i < getUndoEntryCount(); i++) {
+            describeUndoEntry(i, buffer, sizeof(buffer));
+            nk_label(ctx, buffer, NK_TEXT_LEFT);
         }
         nk_end(ctx);
     }
@@ -1260,6 +1469,8 @@ void teardown_nuklear() {
 // Render Nuklear function
 void render_nuklear() {
     nk_glfw3_render(NK_ANTI_ALIASING_ON, MAX_VERTEX_BUFFER, MAX_ELEMENT_BUFFER);
+    // Nuklear sets program, texture, blend and scissor state with raw GL
+    invalidateGLState();
 }
 
 
@@ -0,0 +1,179 @@
+#include "log.h"
+#include "threading.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_RING_MASK (LOG_RING_SIZE - 1)
+#define LOG_DRAIN_INTERVAL 0.005  // Seconds the writer sleeps when the ring is empty
+
+// The sequence says whose turn a slot is: equal to the write position when a
+// producer may claim it, one past it once the message is ready to read
+typedef struct {
+    volatile unsigned int sequence;
+    unsigned char level;
+    unsigned char module;
+    char text[LOG_MESSAGE_SIZE];
+} LogRecord;
+
+static LogRecord ring[LOG_RING_SIZE];
+static volatile unsigned int writePosition = 0;  // Claimed by producers with a compare-exchange
+static unsigned int readPosition = 0;            // Only the writer thread moves it
+
+static Thread writerThread;
+static volatile unsigned int running = 0;
+static volatile unsigned int dropped = 0;
+static unsigned int droppedReported = 0;
+static LogStats stats;
+
+static int levels[LOG_MODULE_COUNT] = {
+    LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO
+};
+
+static const char* moduleNames[LOG_MODULE_COUNT] = { "core", "scene", "render", "assets", "audio", "ui" };
+static const char* levelNames[] = { "debug", "info", "warn", "error", "off" };
+
+static void writeRecord(int level, int module, const char* text) {
+    FILE* stream = level >= LOG_LEVEL_WARN ? stderr : stdout;
+    size_t length = strlen(text);
+    const char* newline = length > 0 && text[length - 1] == '\n' ? "" : "\n";
+    fprintf(stream, "[%s] %s: %s%s", levelNames[level], moduleNames[module], text, newline);
+}
+
+// Writes every ready message, returns how many
+static int drainRing(void) {
+    int count = 0;
+    for (;;) {
+        LogRecord* record = &ring[readPosition & LOG_RING_MASK];
+        if (atomicLoad(&record->sequence) != readPosition + 1) break;
+        writeRecord(record->level, record->module, record->text);
+        // Hands the slot to the producer one lap ahead
+        atomicStore(&record->sequence, readPosition + LOG_RING_SIZE);
+        readPosition++;
+        count++;
+    }
+
+    unsigned int lost = atomicLoad(&dropped);
+    if (lost != droppedReported) {
+        fprintf(stderr, "[warn] core: %u log messages dropped, the ring was full\n", lost - droppedReported);
+        droppedReported = lost;
+    }
+    if (count > 0) {
+        stats.written += count;
+        fflush(stdout);
+        fflush(stderr);
+    }
+    return count;
+}
+
+static void writerMain(void* arg) {
+    (void)arg;
+    while (atomicLoad(&running)) {
+        if (drainRing() == 0) sleepSeconds(LOG_DRAIN_INTERVAL);
+    }
+    drainRing();
+}
+
+static int parseLevel(const char* name, size_t length) {
+    for (int level = LOG_LEVEL_DEBUG; level <= LOG_LEVEL_OFF; level++) {
+        if (strlen(levelNames[level]) == length && strncmp(levelNames[level], name, length) == 0) return level;
+    }
+    return -1;
+}
+
+// CLUE_LOG=level sets every module, module=level one of them, comma separated
+static void applyEnvironmentLevels(void) {
+    const char* spec = getenv("CLUE_LOG");
+    while (spec && *spec) {
+        size_t length = strcspn(spec, ",");
+        const char* equals = memchr(spec, '=', length);
+        if (equals) {
+            int level = parseLevel(equals + 1, length - (size_t)(equals + 1 - spec));
+            for (int module = 0; module < LOG_MODULE_COUNT && level >= 0; module++) {
+                size_t nameLength = (size_t)(equals - spec);
+                if (strlen(moduleNames[module]) == nameLength && strncmp(moduleNames[module], spec, nameLength) == 0) {
+                    levels[module] = level;
+                }
+            }
+        }
+        else {
+            int level = parseLevel(spec, length);
+            for (int module = 0; module < LOG_MODULE_COUNT && level >= 0; module++) levels[module] = level;
+        }
+        spec += length;
+        if (*spec == ',') spec++;
+    }
+}
+
+void initLogging(void) {
+    if (atomicLoad(&running)) return;
+    for (unsigned int i = 0; i < LOG_RING_SIZE; i++) ring[i].sequence = i;
+    writePosition = readPosition = 0;
+    applyEnvironmentLevels();
+
+    atomicStore(&running, 1);
+    if (!createThread(&writerThread, writerMain, NULL)) {
+        atomicStore(&running, 0);
+        fprintf(stderr, "[warn] core: Failed to start the log thread, logging synchronously\n");
+    }
+}
+
+void shutdownLogging(void) {
+    if (!atomicLoad(&running)) return;
+    atomicStore(&running, 0);
+    joinThread(&writerThread);
+}
+
+void setLogLevel(LogModule module, int level) {
+    if (module >= 0 && module < LOG_MODULE_COUNT) levels[module] = level;
+}
+
+int getLogLevel(LogModule module) {
+    return module >= 0 && module < LOG_MODULE_COUNT ? levels[module] : LOG_LEVEL_OFF;
+}
+
+void logMessage(int level, LogModule module, const char* format, ...) {
+    if (module < 0 || module >= LOG_MODULE_COUNT || level < levels[module] || level >= LOG_LEVEL_OFF) return;
+
+    va_list args;
+    va_start(args, format);
+    if (!atomicLoad(&running)) {
+        char text[LOG_MESSAGE_SIZE];
+        vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+        writeRecord(level, module, text);
+        return;
+    }
+
+    // Claim the slot at the write position, unless the writer hasn't freed it yet
+    LogRecord* record;
+    unsigned int position = atomicLoad(&writePosition);
+    for (;;) {
+        record = &ring[position & LOG_RING_MASK];
+        int lag = (int)(atomicLoad(&record->sequence) - position);
+        if (lag == 0) {
+            if (atomicCompareExchange(&writePosition, position, position + 1)) break;
+            position = atomicLoad(&writePosition);
+        }
+        else if (lag < 0) {
+            va_end(args);
+            atomicIncrement(&dropped);
+            return;
+        }
+        else {
+            position = atomicLoad(&writePosition);
+        }
+    }
+
+    record->level = (unsigned char)level;
+    record->module = (unsigned char)module;
+    vsnprintf(record->text, sizeof(record->text), format, args);
+    va_end(args);
+    atomicStore(&record->sequence, position + 1);
+}
+
+const LogStats* getLogStats(void) {
+    stats.dropped = atomicLoad(&dropped);
+    return &stats;
+}
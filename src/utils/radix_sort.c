@@ -0,0 +1,51 @@
+#include "radix_sort.h"
+#include <string.h>
+
+void radixSortKeys(uint32_t* keys, uint32_t* values, uint32_t* scratchKeys, uint32_t* scratchValues, int count) {
+    if (count < 2) return;
+
+    // All four histograms in one pass over the keys
+    uint32_t histograms[4][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (int i = 0; i < count; i++) {
+        uint32_t key = keys[i];
+        histograms[0][key & 0xFF]++;
+        histograms[1][(key >> 8) & 0xFF]++;
+        histograms[2][(key >> 16) & 0xFF]++;
+        histograms[3][key >> 24]++;
+    }
+
+    uint32_t* sourceKeys = keys;
+    uint32_t* sourceValues = values;
+    uint32_t* destinationKeys = scratchKeys;
+    uint32_t* destinationValues = scratchValues;
+    for (int pass = 0; pass < 4; pass++) {
+        int shift = pass * 8;
+        uint32_t* histogram = histograms[pass];
+        if (histogram[(sourceKeys[0] >> shift) & 0xFF] == (uint32_t)count) continue;
+
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < 256; bucket++) {
+            uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        for (int i = 0; i < count; i++) {
+            uint32_t slot = histogram[(sourceKeys[i] >> shift) & 0xFF]++;
+            destinationKeys[slot] = sourceKeys[i];
+            destinationValues[slot] = sourceValues[i];
+        }
+
+        uint32_t* swapKeys = sourceKeys;
+        uint32_t* swapValues = sourceValues;
+        sourceKeys = destinationKeys;
+        sourceValues = destinationValues;
+        destinationKeys = swapKeys;
+        destinationValues = swapValues;
+    }
+
+    if (sourceKeys != keys) {
+        memcpy(keys, sourceKeys, count * sizeof(uint32_t));
+        memcpy(values, sourceValues, count * sizeof(uint32_t));
+    }
+}
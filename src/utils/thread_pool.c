@@ -0,0 +1,435 @@
+#include "thread_pool.h"
+#include "threading.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEQUE_INITIAL_CAPACITY 64
+
+typedef struct Task {
+    TaskFunction function;
+    void* data;
+    struct Task* next;
+} Task;
+
+typedef struct {
+    TaskFunction function;
+    void* data;
+    JobCounter* counter;
+} Job;
+
+// Ring buffer, the owner pushes and pops at the back, thieves take the front
+typedef struct {
+    Job* jobs;
+    int capacity;
+    int front;
+    int count;
+    Mutex mutex;
+} JobDeque;
+
+typedef struct {
+    Thread thread;
+    int index;
+} Worker;
+
+static Worker workers[MAX_WORKER_THREADS];
+static int workerCount = 0;
+static THREAD_LOCAL int currentWorker = -1;
+
+// Workers own deques 0 to workerCount - 1, threads outside the pool the ones
+// from MAX_WORKER_THREADS on, claimed the first time they need one
+static JobDeque deques[MAX_JOB_THREADS];
+static volatile unsigned int helperSlots = 0;       // Bit per claimed helper deque
+static volatile unsigned int helperHighWater = 0;   // Helper deques ever claimed, stealing walks these
+
+// Lock-free bookkeeping. A job is counted in queuedJobs before it is pushed,
+// so the count never goes below the jobs actually sitting in deques
+static volatile unsigned int queuedJobs = 0;
+static volatile unsigned int sleepingWorkers = 0;
+static volatile unsigned int counterWaiters = 0;
+static JobSystemStats stats;  // Updated with atomic increments
+static JobSystemStats statsSnapshot;
+
+// Only for sleeping and waking, plus the background task queue
+static Mutex poolMutex;
+static Condition workCondition;     // Workers sleeping for jobs or tasks
+static Condition counterCondition;  // Threads in waitForJobs with nothing to run
+static Task* queueHead = NULL;
+static Task* queueTail = NULL;
+static int pendingTasks = 0;
+static bool stopping = false;
+
+static int currentDeque(void) {
+    while (currentWorker < 0) {
+        unsigned int used = atomicLoad(&helperSlots);
+        unsigned int slot = 0;
+        while (slot < MAX_HELPER_THREADS && (used & (1u << slot))) slot++;
+        if (slot == MAX_HELPER_THREADS) {
+            LOG_ERROR(LOG_CORE, "More than %d threads outside the pool are using jobs", MAX_HELPER_THREADS);
+            abort();
+        }
+        if (!atomicCompareExchange(&helperSlots, used, used | (1u << slot))) continue;
+
+        unsigned int highWater = atomicLoad(&helperHighWater);
+        while (highWater < slot + 1 && !atomicCompareExchange(&helperHighWater, highWater, slot + 1)) {
+            highWater = atomicLoad(&helperHighWater);
+        }
+        currentWorker = MAX_WORKER_THREADS + (int)slot;
+    }
+    return currentWorker;
+}
+
+// Deques in use, workers first then helpers, so stealing can walk them in a ring
+static int dequeCount(void) {
+    return workerCount + (int)atomicLoad(&helperHighWater);
+}
+
+static int dequeAt(int position) {
+    return position < workerCount ? position : MAX_WORKER_THREADS + (position - workerCount);
+}
+
+static int dequePosition(int index) {
+    return index < MAX_WORKER_THREADS ? index : workerCount + (index - MAX_WORKER_THREADS);
+}
+
+static bool pushJob(JobDeque* deque, const Job* job) {
+    lockMutex(&deque->mutex);
+    if (deque->count == deque->capacity) {
+        int capacity = deque->capacity ? deque->capacity * 2 : DEQUE_INITIAL_CAPACITY;
+        Job* grown = (Job*)malloc(capacity * sizeof(Job));
+        if (!grown) {
+            unlockMutex(&deque->mutex);
+            return false;
+        }
+        // Unwrap into the new buffer so the front starts at zero
+        for (int i = 0; i < deque->count; i++) {
+            grown[i] = deque->jobs[(deque->front + i) % deque->capacity];
+        }
+        free(deque->jobs);
+        deque->jobs = grown;
+        deque->capacity = capacity;
+        deque->front = 0;
+    }
+    deque->jobs[(deque->front + deque->count) % deque->capacity] = *job;
+    deque->count++;
+    unlockMutex(&deque->mutex);
+    return true;
+}
+
+static bool popBack(JobDeque* deque, Job* job) {
+    lockMutex(&deque->mutex);
+    bool found = deque->count > 0;
+    if (found) {
+        deque->count--;
+        *job = deque->jobs[(deque->front + deque->count) % deque->capacity];
+    }
+    unlockMutex(&deque->mutex);
+    return found;
+}
+
+static bool popFront(JobDeque* deque, Job* job) {
+    lockMutex(&deque->mutex);
+    bool found = deque->count > 0;
+    if (found) {
+        *job = deque->jobs[deque->front];
+        deque->front = (deque->front + 1) % deque->capacity;
+        deque->count--;
+    }
+    unlockMutex(&deque->mutex);
+    return found;
+}
+
+// Own deque first (newest, still warm in cache), then steal the oldest elsewhere
+static bool takeJob(int self, bool helping, Job* job) {
+    bool stolen = false;
+    bool found = popBack(&deques[self], job);
+    int count = dequeCount();
+    int position = dequePosition(self);
+    for (int i = 1; !found && i < count; i++) {
+        found = popFront(&deques[dequeAt((position + i) % count)], job);
+        stolen = found;
+    }
+    if (!found) return false;
+
+    atomicDecrement(&queuedJobs);
+    atomicIncrement(&stats.jobsRun);
+    if (stolen) atomicIncrement(&stats.jobsStolen);
+    if (helping) atomicIncrement(&stats.jobsHelped);
+    return true;
+}
+
+static void runJob(const Job* job, int self) {
+    job->function(job->data, self);
+    if (!job->counter) return;
+
+    // The counter may go away as soon as it reads zero, it is not touched after
+    if (atomicDecrement(&job->counter->pending) == 0 && atomicLoad(&counterWaiters) > 0) {
+        lockMutex(&poolMutex);
+        broadcastCondition(&counterCondition);
+        unlockMutex(&poolMutex);
+    }
+}
+
+static void workerMain(void* arg) {
+    Worker* worker = (Worker*)arg;
+    currentWorker = worker->index;
+
+    for (;;) {
+        Job job;
+        if (takeJob(worker->index, false, &job)) {
+            runJob(&job, worker->index);
+            continue;
+        }
+        if (atomicLoad(&queuedJobs) > 0) continue;  // Pushed but not visible in a deque yet
+
+        lockMutex(&poolMutex);
+        if (queueHead) {
+            Task* task = queueHead;
+            queueHead = task->next;
+            if (!queueHead) queueTail = NULL;
+            pendingTasks--;
+            unlockMutex(&poolMutex);
+
+            task->function(task->data, worker->index);
+            free(task);
+            continue;
+        }
+        if (stopping) {
+            unlockMutex(&poolMutex);
+            break;
+        }
+        // Announce the sleep before the last look, submitJob checks in the other order
+        atomicIncrement(&sleepingWorkers);
+        if (atomicLoad(&queuedJobs) == 0) waitCondition(&workCondition, &poolMutex);
+        atomicDecrement(&sleepingWorkers);
+        unlockMutex(&poolMutex);
+    }
+}
+
+void initThreadPool(int requestedWorkers) {
+    if (workerCount > 0) return;
+
+    // Leave one core for the render thread
+    int count = requestedWorkers > 0 ? requestedWorkers : getProcessorCount() - 1;
+    if (count < 1) count = 1;
+    if (count > MAX_WORKER_THREADS) count = MAX_WORKER_THREADS;
+
+    initMutex(&poolMutex);
+    initCondition(&workCondition);
+    initCondition(&counterCondition);
+    for (int i = 0; i < MAX_JOB_THREADS; i++) {
+        memset(&deques[i], 0, sizeof(JobDeque));
+        initMutex(&deques[i].mutex);
+    }
+    atomicStore(&queuedJobs, 0);
+    atomicStore(&sleepingWorkers, 0);
+    atomicStore(&counterWaiters, 0);
+    stopping = false;
+
+    // Workers index the deques by workerCount, so it is fixed before any starts
+    for (int i = 0; i < count; i++) workers[i].index = i;
+    workerCount = count;
+    int started = 0;
+    for (; started < count; started++) {
+        if (!createThread(&workers[started].thread, workerMain, &workers[started])) {
+            LOG_WARN(LOG_CORE, "Failed to start worker thread %d", started);
+            break;
+        }
+    }
+    if (started < count) {
+        // Nothing was pushed to the deques of workers that never started
+        lockMutex(&poolMutex);
+        workerCount = started;
+        unlockMutex(&poolMutex);
+    }
+    LOG_INFO(LOG_CORE, "Thread pool started with %d workers", started);
+}
+
+void shutdownThreadPool(void) {
+    if (workerCount == 0) return;
+
+    lockMutex(&poolMutex);
+    stopping = true;
+    broadcastCondition(&workCondition);
+    unlockMutex(&poolMutex);
+
+    for (int i = 0; i < workerCount; i++) {
+        joinThread(&workers[i].thread);
+    }
+    workerCount = 0;
+
+    for (int i = 0; i < MAX_JOB_THREADS; i++) {
+        free(deques[i].jobs);
+        destroyMutex(&deques[i].mutex);
+    }
+    destroyCondition(&counterCondition);
+    destroyCondition(&workCondition);
+    destroyMutex(&poolMutex);
+}
+
+bool submitTask(TaskFunction function, void* data) {
+    // Without workers the task simply runs inline
+    if (workerCount == 0) {
+        function(data, currentDeque());
+        return true;
+    }
+
+    Task* task = (Task*)malloc(sizeof(Task));
+    if (!task) return false;
+    task->function = function;
+    task->data = data;
+    task->next = NULL;
+
+    lockMutex(&poolMutex);
+    if (queueTail) queueTail->next = task;
+    else queueHead = task;
+    queueTail = task;
+    pendingTasks++;
+    signalCondition(&workCondition);
+    unlockMutex(&poolMutex);
+    return true;
+}
+
+int getPendingTaskCount(void) {
+    if (workerCount == 0) return 0;
+
+    lockMutex(&poolMutex);
+    int count = pendingTasks;
+    unlockMutex(&poolMutex);
+    return count;
+}
+
+void submitJob(TaskFunction function, void* data, JobCounter* counter) {
+    Job job = { function, data, counter };
+    int self = currentDeque();
+    if (workerCount == 0) {
+        function(data, self);
+        return;
+    }
+
+    // Counted before it can run, so the counter never dips below zero
+    if (counter) atomicIncrement(&counter->pending);
+
+    atomicIncrement(&queuedJobs);
+    if (!pushJob(&deques[self], &job)) {
+        // Out of memory for the deque, run it here rather than lose it
+        atomicDecrement(&queuedJobs);
+        runJob(&job, self);
+        return;
+    }
+
+    // Sleepers count themselves before their last look at queuedJobs
+    if (atomicLoad(&sleepingWorkers) > 0) {
+        lockMutex(&poolMutex);
+        signalCondition(&workCondition);
+        unlockMutex(&poolMutex);
+    }
+    if (atomicLoad(&counterWaiters) > 0) {
+        lockMutex(&poolMutex);
+        broadcastCondition(&counterCondition);
+        unlockMutex(&poolMutex);
+    }
+}
+
+void waitForJobs(JobCounter* counter) {
+    if (workerCount == 0) return;
+
+    int self = currentDeque();
+    while (atomicLoad(&counter->pending) > 0) {
+        Job job;
+        if (takeJob(self, true, &job)) {
+            runJob(&job, self);
+            continue;
+        }
+
+        // Everything left is running elsewhere, sleep until it finishes or new jobs arrive
+        lockMutex(&poolMutex);
+        atomicIncrement(&counterWaiters);
+        if (atomicLoad(&counter->pending) > 0 && atomicLoad(&queuedJobs) == 0) {
+            waitCondition(&counterCondition, &poolMutex);
+        }
+        atomicDecrement(&counterWaiters);
+        unlockMutex(&poolMutex);
+    }
+}
+
+// Shared by the helper jobs of one parallelFor, lives on the caller's stack
+typedef struct {
+    RangeFunction function;
+    void* data;
+    int count;
+    int rangeSize;
+    unsigned int rangeCount;
+    volatile unsigned int nextRange;  // Claimed with an atomic increment
+} ParallelJob;
+
+static void runParallelRanges(void* data, int workerIndex) {
+    ParallelJob* job = (ParallelJob*)data;
+    for (;;) {
+        unsigned int range = atomicIncrement(&job->nextRange) - 1;
+        if (range >= job->rangeCount) break;
+
+        int begin = (int)range * job->rangeSize;
+        int end = begin + job->rangeSize < job->count ? begin + job->rangeSize : job->count;
+        job->function(job->data, begin, end, workerIndex);
+    }
+}
+
+void parallelFor(int count, int rangeSize, RangeFunction function, void* data) {
+    if (count <= 0) return;
+    if (rangeSize < 1) rangeSize = 1;
+    int rangeCount = (count + rangeSize - 1) / rangeSize;
+    if (rangeCount == 1 || workerCount == 0) {
+        function(data, 0, count, currentDeque());
+        return;
+    }
+
+    ParallelJob job;
+    job.function = function;
+    job.data = data;
+    job.count = count;
+    job.rangeSize = rangeSize;
+    job.rangeCount = (unsigned int)rangeCount;
+    job.nextRange = 0;
+
+    // Helpers claim ranges until none are left; the caller takes one share itself
+    JobCounter counter = { 0 };
+    int helpers = rangeCount - 1 < workerCount ? rangeCount - 1 : workerCount;
+    for (int i = 0; i < helpers; i++) {
+        submitJob(runParallelRanges, &job, &counter);
+    }
+    runParallelRanges(&job, currentDeque());
+    waitForJobs(&counter);
+}
+
+int getWorkerCount(void) {
+    return workerCount;
+}
+
+int getJobThreadIndex(void) {
+    return currentDeque();
+}
+
+void releaseJobThreadIndex(void) {
+    if (currentWorker < MAX_WORKER_THREADS) return;  // Workers, and threads that never claimed one
+
+    // Jobs still in the deque are stolen as usual, the next owner just shares them
+    unsigned int bit = 1u << (currentWorker - MAX_WORKER_THREADS);
+    unsigned int used = atomicLoad(&helperSlots);
+    while (!atomicCompareExchange(&helperSlots, used, used & ~bit)) used = atomicLoad(&helperSlots);
+    currentWorker = -1;
+}
+
+void resetJobSystemStats(void) {
+    atomicStore(&stats.jobsRun, 0);
+    atomicStore(&stats.jobsStolen, 0);
+    atomicStore(&stats.jobsHelped, 0);
+}
+
+const JobSystemStats* getJobSystemStats(void) {
+    statsSnapshot.jobsRun = atomicLoad(&stats.jobsRun);
+    statsSnapshot.jobsStolen = atomicLoad(&stats.jobsStolen);
+    statsSnapshot.jobsHelped = atomicLoad(&stats.jobsHelped);
+    return &statsSnapshot;
+}
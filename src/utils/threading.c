@@ -0,0 +1,150 @@
+#include "threading.h"
+#include <stdlib.h>
+
+#ifdef _WIN32
+    #include <process.h>
+#else
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+typedef struct {
+    ThreadFunction function;
+    void* arg;
+} ThreadStart;
+
+#ifdef _WIN32
+static unsigned __stdcall threadEntry(void* param) {
+#else
+static void* threadEntry(void* param) {
+#endif
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.function(start.arg);
+    return 0;
+}
+
+bool createThread(Thread* thread, ThreadFunction function, void* arg) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!start) return false;
+    start->function = function;
+    start->arg = arg;
+
+#ifdef _WIN32
+    thread->handle = (HANDLE)_beginthreadex(NULL, 0, threadEntry, start, 0, NULL);
+    if (!thread->handle) {
+        free(start);
+        return false;
+    }
+#else
+    if (pthread_create(&thread->handle, NULL, threadEntry, start) != 0) {
+        free(start);
+        return false;
+    }
+#endif
+    return true;
+}
+
+void joinThread(Thread* thread) {
+#ifdef _WIN32
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
+}
+
+void initMutex(Mutex* mutex) {
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void destroyMutex(Mutex* mutex) {
+#ifdef _WIN32
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+void lockMutex(Mutex* mutex) {
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void unlockMutex(Mutex* mutex) {
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+void initCondition(Condition* condition) {
+#ifdef _WIN32
+    InitializeConditionVariable(condition);
+#else
+    pthread_cond_init(condition, NULL);
+#endif
+}
+
+void destroyCondition(Condition* condition) {
+#ifdef _WIN32
+    (void)condition; // Win32 condition variables need no cleanup
+#else
+    pthread_cond_destroy(condition);
+#endif
+}
+
+void waitCondition(Condition* condition, Mutex* mutex) {
+#ifdef _WIN32
+    SleepConditionVariableCS(condition, mutex, INFINITE);
+#else
+    pthread_cond_wait(condition, mutex);
+#endif
+}
+
+void signalCondition(Condition* condition) {
+#ifdef _WIN32
+    WakeConditionVariable(condition);
+#else
+    pthread_cond_signal(condition);
+#endif
+}
+
+void broadcastCondition(Condition* condition) {
+#ifdef _WIN32
+    WakeAllConditionVariable(condition);
+#else
+    pthread_cond_broadcast(condition);
+#endif
+}
+
+int getProcessorCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+void sleepSeconds(double seconds) {
+    if (seconds <= 0.0) return;
+#ifdef _WIN32
+    Sleep((DWORD)(seconds * 1000.0));
+#else
+    struct timespec duration;
+    duration.tv_sec = (time_t)seconds;
+    duration.tv_nsec = (long)((seconds - (double)duration.tv_sec) * 1e9);
+    nanosleep(&duration, NULL);
+#endif
+}
@@ -0,0 +1,249 @@
+// Stress test and scaling benchmark for the job system (thread_pool.c).
+// Run without arguments for the tests, with "bench" for the scaling table.
+// Exits non-zero when a check fails.
+#include "thread_pool.h"
+#include "threading.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ITEM_COUNT 100000
+#define ROUNDS 50
+
+static int failures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Busy work that the optimizer cannot drop
+static unsigned int spin(unsigned int seed, int iterations) {
+    for (int i = 0; i < iterations; i++) seed = seed * 1664525u + 1013904223u;
+    return seed;
+}
+
+// Each thread index may only be in use by one thread at a time
+static volatile unsigned int indexBusy[MAX_JOB_THREADS];
+static volatile unsigned int indexClashes = 0;
+
+static void enterIndex(int workerIndex) {
+    if (workerIndex < 0 || workerIndex >= MAX_JOB_THREADS || !atomicCompareExchange(&indexBusy[workerIndex], 0, 1)) {
+        atomicIncrement(&indexClashes);
+    }
+}
+
+static void leaveIndex(int workerIndex) {
+    if (workerIndex >= 0 && workerIndex < MAX_JOB_THREADS) atomicStore(&indexBusy[workerIndex], 0);
+}
+
+// parallelFor writes every item exactly once
+
+typedef struct {
+    volatile unsigned int* hits;
+} CoverageData;
+
+static void markRange(void* data, int begin, int end, int workerIndex) {
+    CoverageData* coverage = (CoverageData*)data;
+    enterIndex(workerIndex);
+    for (int i = begin; i < end; i++) atomicIncrement(&coverage->hits[i]);
+    leaveIndex(workerIndex);
+}
+
+static void testCoverage(void) {
+    volatile unsigned int* hits = calloc(ITEM_COUNT, sizeof(unsigned int));
+    CoverageData coverage = { hits };
+    for (int round = 0; round < ROUNDS; round++) {
+        parallelFor(ITEM_COUNT, 1 + round * 37, markRange, &coverage);
+    }
+    int wrong = 0;
+    for (int i = 0; i < ITEM_COUNT; i++) {
+        if (hits[i] != ROUNDS) wrong++;
+    }
+    CHECK(wrong == 0, "%d items not visited exactly %d times", wrong, ROUNDS);
+    free((void*)hits);
+}
+
+// parallelFor inside parallelFor, the outer ranges wait while helping
+
+typedef struct {
+    volatile unsigned int total;
+} NestedData;
+
+static void innerRange(void* data, int begin, int end, int workerIndex) {
+    NestedData* nested = (NestedData*)data;
+    (void)workerIndex;
+    for (int i = begin; i < end; i++) atomicIncrement(&nested->total);
+}
+
+static void outerRange(void* data, int begin, int end, int workerIndex) {
+    (void)workerIndex;
+    for (int i = begin; i < end; i++) parallelFor(1000, 16, innerRange, data);
+}
+
+static void testNested(void) {
+    NestedData nested = { 0 };
+    parallelFor(64, 1, outerRange, &nested);
+    CHECK(nested.total == 64 * 1000, "nested parallelFor counted %u, expected %d", nested.total, 64 * 1000);
+}
+
+// Jobs that submit more jobs against their own counters
+
+typedef struct {
+    int depth;
+    volatile unsigned int* leaves;
+} TreeJob;
+
+static void treeJob(void* data, int workerIndex) {
+    TreeJob* job = (TreeJob*)data;
+    (void)workerIndex;
+    if (job->depth == 0) {
+        atomicIncrement(job->leaves);
+        return;
+    }
+    TreeJob children[4];
+    JobCounter counter = { 0 };
+    for (int i = 0; i < 4; i++) {
+        children[i].depth = job->depth - 1;
+        children[i].leaves = job->leaves;
+        submitJob(treeJob, &children[i], &counter);
+    }
+    waitForJobs(&counter);
+    CHECK(counter.pending == 0, "counter left at %u", counter.pending);
+}
+
+static void testCounters(void) {
+    volatile unsigned int leaves = 0;
+    TreeJob root = { 6, &leaves };
+    JobCounter counter = { 0 };
+    submitJob(treeJob, &root, &counter);
+    waitForJobs(&counter);
+    CHECK(leaves == 4096, "job tree reached %u leaves, expected 4096", leaves);
+}
+
+// Jobs all pushed to one deque have to be stolen to run in parallel
+
+static void unevenJob(void* data, int workerIndex) {
+    (void)workerIndex;
+    *(unsigned int*)data = spin(*(unsigned int*)data, 200000);
+}
+
+static void testStealing(void) {
+    unsigned int seeds[256];
+    JobCounter counter = { 0 };
+    resetJobSystemStats();
+    for (int i = 0; i < 256; i++) {
+        seeds[i] = (unsigned int)i;
+        submitJob(unevenJob, &seeds[i], &counter);
+    }
+    waitForJobs(&counter);
+    CHECK(seeds[255] != 255, "a job never ran");
+
+    // Jobs run inline are not counted
+    const JobSystemStats* stats = getJobSystemStats();
+    if (getWorkerCount() > 0) {
+        CHECK(stats->jobsRun == 256, "%u jobs run, expected 256", stats->jobsRun);
+        CHECK(stats->jobsStolen > 0, "no job was stolen from the submitting thread");
+    }
+}
+
+// Several threads outside the pool helping at once get distinct indices
+
+static void helperThread(void* arg) {
+    int* index = (int*)arg;
+    *index = getJobThreadIndex();
+    testCoverage();
+    testNested();
+    testCounters();
+    releaseJobThreadIndex();
+}
+
+static void testHelpers(void) {
+    Thread threads[2];
+    int indices[2] = { -1, -1 };
+    for (int i = 0; i < 2; i++) createThread(&threads[i], helperThread, &indices[i]);
+    testNested();
+    for (int i = 0; i < 2; i++) joinThread(&threads[i]);
+
+    int self = getJobThreadIndex();
+    CHECK(indices[0] >= MAX_WORKER_THREADS && indices[1] >= MAX_WORKER_THREADS, "helper threads got worker indices");
+    CHECK(indices[0] != indices[1] && indices[0] != self && indices[1] != self,
+          "helper threads share an index (%d, %d, main %d)", indices[0], indices[1], self);
+}
+
+// Zero workers leaves the pool stopped, so every job runs inline
+static void runTests(int workers) {
+    if (workers > 0) initThreadPool(workers);
+    testCoverage();
+    testNested();
+    testCounters();
+    testStealing();
+    testHelpers();
+    CHECK(indexClashes == 0, "%u ranges ran with an index another thread was using", indexClashes);
+    printf("%d workers: %s\n", getWorkerCount(), failures ? "failed" : "ok");
+    if (workers > 0) shutdownThreadPool();
+}
+
+// Scaling: one fixed amount of work at growing worker counts
+
+typedef struct {
+    unsigned int results[ITEM_COUNT];
+} BenchData;
+
+static void benchRange(void* data, int begin, int end, int workerIndex) {
+    BenchData* bench = (BenchData*)data;
+    (void)workerIndex;
+    for (int i = begin; i < end; i++) bench->results[i] = spin((unsigned int)i, 2000);
+}
+
+static double timeRuns(BenchData* bench) {
+    parallelFor(ITEM_COUNT, 256, benchRange, bench);  // Warm up
+    double start = now();
+    for (int round = 0; round < 10; round++) parallelFor(ITEM_COUNT, 256, benchRange, bench);
+    return (now() - start) / 10.0;
+}
+
+static void runBenchmark(void) {
+    BenchData* bench = malloc(sizeof(BenchData));
+    int maxWorkers = getProcessorCount() - 1;
+    if (maxWorkers > MAX_WORKER_THREADS) maxWorkers = MAX_WORKER_THREADS;
+
+    // The calling thread alone, then 1, 2, 4... workers helping it
+    double baseline = timeRuns(bench);
+    printf("threads      ms   speedup\n");
+    printf("%7d %7.2f %8.2fx\n", 1, baseline * 1000.0, 1.0);
+    for (int workers = 1; workers <= maxWorkers; workers = workers * 2 > maxWorkers && workers < maxWorkers ? maxWorkers : workers * 2) {
+        initThreadPool(workers);
+        double elapsed = timeRuns(bench);
+        printf("%7d %7.2f %8.2fx\n", getWorkerCount() + 1, elapsed * 1000.0, baseline / elapsed);
+        shutdownThreadPool();
+    }
+    free(bench);
+}
+
+int main(int argc, char** argv) {
+    setLogLevel(LOG_CORE, LOG_LEVEL_WARN);
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        runBenchmark();
+        return 0;
+    }
+
+    // Inline fallback, one worker, and several
+    runTests(0);
+    runTests(1);
+    runTests(4);
+    return failures ? 1 : 0;
+}